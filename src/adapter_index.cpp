@@ -0,0 +1,110 @@
+#include "adapter_index.h"
+#include "suffix_tree.h"
+
+static int get_base_code(char b) {
+  switch(b) {
+    case 'A':
+      return 0;
+    case 'C':
+      return 1;
+    case 'G':
+      return 2;
+    case 'T':
+      return 3;
+  }
+
+  return -1;
+}
+
+// Add every k-mer of adapter to seeds. k-mers with a base other than ACGT are skipped.
+static void add_seeds(const std::string &adapter, uint32_t index, bool reverse, std::vector<std::vector<adapter_seed> > &seeds) {
+  uint32_t code = 0, mask = (1u << (2 * ADAPTER_SEED_LENGTH)) - 1;
+  int valid = 0, b;
+  adapter_seed seed;
+
+  for (unsigned int i = 0; i < adapter.length(); ++i) {
+    b = get_base_code(adapter[i]);
+    if (b == -1) {
+      valid = 0;
+      continue;
+    }
+
+    code = ((code << 2) | b) & mask;
+    if (++valid < ADAPTER_SEED_LENGTH)
+      continue;
+
+    seed.adapter = index;
+    seed.pos = i + 1 - ADAPTER_SEED_LENGTH;
+    seed.reverse = reverse;
+    seeds[code].push_back(seed);
+  }
+}
+
+adapter_index::adapter_index(const std::vector<std::string> &adapters) : adapters(adapters), seeds(1u << (2 * ADAPTER_SEED_LENGTH)) {
+  for (uint32_t i = 0; i < adapters.size(); ++i) {
+    rc_adapters.push_back(get_reverse_complement(adapters[i]));
+    aligners.push_back(adapter_aligner(adapters[i]));
+    add_seeds(adapters[i], i, false, seeds);
+    add_seeds(rc_adapters[i], i, true, seeds);
+  }
+}
+
+const std::string& adapter_index::get_adapter(int adapter, bool reverse) const {
+  return reverse ? rc_adapters[adapter] : adapters[adapter];
+}
+
+adapter_aligner& adapter_index::get_aligner(int adapter) {
+  return aligners[adapter];
+}
+
+/*
+  Longest exact match of at least ADAPTER_SEED_LENGTH bases between read and any adapter or
+  reverse complement of an adapter. A seed is only extended if it starts its diagonal, so every
+  match is extended once.
+*/
+adapter_hit adapter_index::find(const std::string &read) const {
+  adapter_hit hit;
+  hit.adapter = -1;
+  hit.reverse = false;
+  hit.read_pos = 0;
+  hit.adapter_pos = 0;
+  hit.length = 0;
+
+  uint32_t code = 0, mask = (1u << (2 * ADAPTER_SEED_LENGTH)) - 1;
+  int valid = 0, b, r, a, len;
+  std::vector<adapter_seed>::const_iterator it;
+
+  for (int i = 0; i < (int) read.length(); ++i) {
+    b = get_base_code(read[i]);
+    if (b == -1) {
+      valid = 0;
+      continue;
+    }
+
+    code = ((code << 2) | b) & mask;
+    if (++valid < ADAPTER_SEED_LENGTH)
+      continue;
+
+    r = i + 1 - ADAPTER_SEED_LENGTH;
+    for (it = seeds[code].begin(); it != seeds[code].end(); ++it) {
+      const std::string &adp = get_adapter(it->adapter, it->reverse);
+      a = it->pos;
+      if (r > 0 && a > 0 && read[r - 1] == adp[a - 1] && get_base_code(read[r - 1]) != -1)
+        continue;		// Already extended from the seed before it
+
+      len = ADAPTER_SEED_LENGTH;
+      while (r + len < (int) read.length() && a + len < (int) adp.length() && read[r + len] == adp[a + len])
+        len++;
+
+      if (len > hit.length) {
+        hit.adapter = it->adapter;
+        hit.reverse = it->reverse;
+        hit.read_pos = r;
+        hit.adapter_pos = a;
+        hit.length = len;
+      }
+    }
+  }
+
+  return hit;
+}
@@ -0,0 +1,47 @@
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "alignment.h"
+
+#ifndef IVAR_ADAPTER_INDEX_H
+#define IVAR_ADAPTER_INDEX_H
+
+const int ADAPTER_SEED_LENGTH = 8;
+
+// Exact match between a read and an adapter or its reverse complement
+struct adapter_hit {
+  int adapter;			// Index in the adapter list, -1 if there is no hit
+  bool reverse;			// Match is with the reverse complement of the adapter
+  int read_pos;
+  int adapter_pos;		// Position on the adapter or on its reverse complement
+  int length;
+};
+
+struct adapter_seed {
+  uint32_t adapter;
+  uint32_t pos;
+  bool reverse;
+};
+
+/*
+  Table of the k-mers of every adapter and of its reverse complement, built once before the reads
+  are read together with the alignment profile of every adapter. A read is scanned once with a
+  rolling k-mer. Every seed hit is extended along its diagonal to the full exact match and the
+  longest match over all adapters is kept.
+*/
+class adapter_index {
+public:
+  adapter_index(const std::vector<std::string> &adapters);
+  const std::string& get_adapter(int adapter, bool reverse) const;
+  adapter_aligner& get_aligner(int adapter);
+  adapter_hit find(const std::string &read) const;
+
+private:
+  std::vector<std::string> adapters;
+  std::vector<std::string> rc_adapters;
+  std::vector<adapter_aligner> aligners;		// Query profile of every adapter
+  std::vector<std::vector<adapter_seed> > seeds;	// Indexed by 2 bit encoded k-mer
+};
+
+#endif
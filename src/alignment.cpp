@@ -63,164 +63,246 @@ int get_gap_penalty(int k, char a) {
   return k * gap_open; // Linear Gap Penalty
 }
 
-void print_matrix(int h[][max_adapter_size], int r, int c, std::string read, std::string adap) {
-  for (int i =0; i< r;i++) {
-    if (i == 0) {
-      std::cout << "    ";
-      for (int k =0; k < c-1; k++) std::cout << adap[k] << " ";
-      std::cout << "\n";
-    }
-
-    for (int j = 0; j < c;j++) {
-      if (j == 0 && i > 0) {
-        if (i -1 < (int)read.length())
-          std::cout << read[i-1] << " ";
-      }
+#ifdef __SSE2__
+#include <emmintrin.h>
+
+typedef __m128i score_vec;
+
+static inline score_vec vec_load(const int16_t *p) { return _mm_loadu_si128((const __m128i*) p); }
+static inline void vec_store(int16_t *p, score_vec v) { _mm_storeu_si128((__m128i*) p, v); }
+static inline score_vec vec_set1(int16_t x) { return _mm_set1_epi16(x); }
+static inline score_vec vec_adds(score_vec a, score_vec b) { return _mm_adds_epi16(a, b); }
+static inline score_vec vec_subs(score_vec a, score_vec b) { return _mm_subs_epi16(a, b); }
+static inline score_vec vec_max(score_vec a, score_vec b) { return _mm_max_epi16(a, b); }
+static inline score_vec vec_and(score_vec a, score_vec b) { return _mm_and_si128(a, b); }
+static inline score_vec vec_shift(score_vec a) { return _mm_slli_si128(a, 2); }	// Lane l gets lane l - 1, lane 0 gets 0
+static inline bool vec_any_gt(score_vec a, score_vec b) { return _mm_movemask_epi8(_mm_cmpgt_epi16(a, b)) != 0; }
+#else
+// Same operations on 8 lanes without SSE2
+
+struct score_vec {
+  int16_t x[ALIGN_LANES];
+};
+
+static inline int16_t sat16(int v) { return (int16_t) std::max(-32768, std::min(32767, v)); }
+
+static inline score_vec vec_load(const int16_t *p) { score_vec v; std::copy(p, p + ALIGN_LANES, v.x); return v; }
+static inline void vec_store(int16_t *p, score_vec v) { std::copy(v.x, v.x + ALIGN_LANES, p); }
+static inline score_vec vec_set1(int16_t x) { score_vec v; std::fill(v.x, v.x + ALIGN_LANES, x); return v; }
+static inline score_vec vec_adds(score_vec a, score_vec b) { for (int l = 0; l < ALIGN_LANES; l++) a.x[l] = sat16(a.x[l] + b.x[l]); return a; }
+static inline score_vec vec_subs(score_vec a, score_vec b) { for (int l = 0; l < ALIGN_LANES; l++) a.x[l] = sat16(a.x[l] - b.x[l]); return a; }
+static inline score_vec vec_max(score_vec a, score_vec b) { for (int l = 0; l < ALIGN_LANES; l++) a.x[l] = std::max(a.x[l], b.x[l]); return a; }
+static inline score_vec vec_and(score_vec a, score_vec b) { for (int l = 0; l < ALIGN_LANES; l++) a.x[l] &= b.x[l]; return a; }
+static inline score_vec vec_shift(score_vec a) { for (int l = ALIGN_LANES - 1; l > 0; l--) a.x[l] = a.x[l - 1]; a.x[0] = 0; return a; }
+static inline bool vec_any_gt(score_vec a, score_vec b) { for (int l = 0; l < ALIGN_LANES; l++) if (a.x[l] > b.x[l]) return true; return false; }
+#endif
+
+static const std::string profile_bases = "ATGCN";
+
+// Row of the substitution matrix used for a read base. Bases other than ATGCN score like N.
+static int get_profile_row(char b) {
+  size_t r = profile_bases.find(b);
+  return (r == std::string::npos) ? 4 : r;
+}
 
-      if (i == 0 && j == 0)
-        std::cout << " " << " ";
+/*
+  Walk back from the best cell (max_i, max_j) until a cell with score 0, choosing the same move
+  as the fill: diagonal, then a gap in the adapter, then a gap in the read. start is set to the
+  read position where the alignment starts. The alignment is kept only if it starts at the
+  beginning of the adapter and has almost no mismatches or gaps for its length.
+*/
+template <class score_fn>
+static int traceback(const score_fn &h, const std::string &read, const std::string &adap, int max_i, int max_j, int max_v, int &start) {
+  int max_score = max_v, align_n = 0, s0, s1, s2, best;
 
-      std::cout << h[i][j] << " ";
+  while (max_v != 0) {
+    s0 = h(max_i - 1, max_j - 1) + get_sub_score(read[max_i - 1], adap[max_j - 1]);
+    s1 = h(max_i - 1, max_j) - get_gap_penalty(1, adap[max_j - 1]);
+    s2 = h(max_i, max_j - 1) - get_gap_penalty(1, read[max_i - 1]);
+    best = std::max(std::max(s0, s1), std::max(s2, 0));
+
+    if (best == s0) {
+      max_i--;
+      max_j--;
+    } else if (best == s1) {
+      max_i--;
+    } else if (best == s2) {
+      max_j--;
+    } else {
+      break;
     }
 
-    std::cout << "\n";
+    max_v = h(max_i, max_j);
+    align_n++;
   }
-}
 
-// Return Value 1 - Diag, 2->Right, 3->Down, 0-> 0
-int*  get_score_cell(int h[][max_adapter_size], int i, int j, std::string read, std::string adap) {
-  int s[] = {0,0,0};
-  int *tmp = new int[2];
-
-  tmp[0] = 0;
-  tmp[1] = 0;
-
-  s[0] = h[i-1][j-1] + get_sub_score(read[i-1], adap[j-1]);
-  s[1] = h[i-1][j] - get_gap_penalty(1, adap[j-1]);
-  s[2] = h[i][j-1] - get_gap_penalty(1, read[i-1]);
-
-  int max = (s[0]>=s[1]) ? s[0] : s[1];
-  max = (max>=s[2]) ? max : s[2];
-  max = (max > 0) ? max : 0;
-  tmp[0] = max;
-
-  if (max == s[0]) {
-    tmp[1] = 1;
-  } else if (max == s[1]) {
-    tmp[1] = 3;
-  } else if (max == s[2]) {
-    tmp[1] = 2;
-  }
+  start = max_i;
+  if (max_score <= ((align_n - 2) * unit_score) - get_gap_penalty(2, 'A') || max_j != 0) // If alignment does not start at beginning of adapter
+    return -1;
 
-  return tmp;
+  return max_score;
 }
 
-void print_alignment(char a[2][max_read_size], int n) {
-  std::cout << "Alignment: " << std::endl << std::endl;
+// Reference implementation of the alignment, one cell at a time
+int align_seqs_scalar(const std::string &read, const std::string &adap, int &start) {
+  int m = read.length() + 1, n = adap.length() + 1, max_i = 0, max_j = 0, max_v = -1, v;
+  start = read.length();
+  if (m == 1 || n == 1)
+    return -1;
+
+  std::vector<int> h(m * n, 0);
+  for (int i = 1; i < m; i++) {
+    for (int j = 1; j < n; j++) {
+      v = h[(i - 1) * n + j - 1] + get_sub_score(read[i - 1], adap[j - 1]);
+      v = std::max(v, h[(i - 1) * n + j] - get_gap_penalty(1, adap[j - 1]));
+      v = std::max(v, h[i * n + j - 1] - get_gap_penalty(1, read[i - 1]));
+      v = std::max(v, 0);
+      h[i * n + j] = v;
 
-  for (int j =0;j<2;j++) {
-    if (j == 0)
-      std::cout << "Read: ";
-    else if (j == 1)
-      std::cout << "Adap: ";
-    for (int i = n -1; i >= 0;i--) {
-      std::cout << a[j][i] << " ";
+      if (v >= max_v) {
+        max_i = i;
+        max_j = j;
+        max_v = v;
+      }
     }
+  }
+
+  auto score = [&h, n](int i, int j) { return h[i * n + j]; };
+  return traceback(score, read, adap, max_i, max_j, max_v, start);
+}
 
-    std::cout << std::endl;
+adapter_aligner::adapter_aligner(const std::string &adap) : adap(adap) {
+  seg_len = (adap.length() + ALIGN_LANES - 1) / ALIGN_LANES;
+  profile.assign(profile_bases.length() * seg_len * ALIGN_LANES, 0);
+  gap_profile.assign(seg_len * ALIGN_LANES, 0);
+  pad_mask.assign(seg_len * ALIGN_LANES, 0);
+
+  // Adapter position l * seg_len + k is in lane l of vector k
+  unsigned int a;
+  for (int k = 0; k < seg_len; k++) {
+    for (int l = 0; l < ALIGN_LANES; l++) {
+      a = l * seg_len + k;
+      if (a >= adap.length())
+        continue;
+
+      for (unsigned int r = 0; r < profile_bases.length(); r++) {
+        profile[(r * seg_len + k) * ALIGN_LANES + l] = get_sub_score(profile_bases[r], adap[a]);
+      }
+      gap_profile[k * ALIGN_LANES + l] = get_gap_penalty(1, adap[a]);
+      pad_mask[k * ALIGN_LANES + l] = -1;
+    }
   }
 }
 
-int* align_seqs(std::string read, std::string adap) {
-  int h[max_read_size][max_adapter_size],
-    t[max_read_size][max_adapter_size],
-    m = read.length() + 1,
-    n=adap.length()+ 1,
-    max_i = 0,
-    max_j = 0,
-    max_v = -1,
-    max_score,
-    *rt = new int[2],
-    *tmp = new int[2];
-
-  rt[0] = -1;
-  rt[1] = read.length();
-
-  // Initialize first column to 0
-  for (int i = 0; i < n; i++) h[0][i] = 0;
-
-  // Initialize first row to 0
-  for (int i = 0; i < m; i++) h[i][0] = 0;
-
-  // print_matrix(h, m, n, read, adap);
+// Score of read position i and adapter position j, 1 based, from the rows of the last read
+int adapter_aligner::get_score(int i, int j) const {
+  if (j == 0)
+    return 0;
+
+  int k = (j - 1) % seg_len, l = (j - 1) / seg_len;
+  return scores[((size_t) i * seg_len + k) * ALIGN_LANES + l];
+}
+
+/*
+  Fill one row per read base. Within a row the diagonal and the gap in the adapter come from
+  the previous row for all lanes at once. A gap in the read runs along the row, so it is carried
+  to the next vector and corrected across lanes with the lazy F loop of Farrar's striped
+  algorithm.
+*/
+int adapter_aligner::align(const std::string &read, int &start) {
+  if (adap.length() > MAX_SIMD_ADAPTER_SIZE)	// Scores could overflow 16 bits
+    return align_seqs_scalar(read, adap, start);
+
+  int m = read.length() + 1, n = adap.length() + 1, max_i = 0, max_j = 0, max_v = -1, row_max, k;
+  start = read.length();
+  if (m == 1 || n == 1)
+    return -1;
+
+  size_t row_size = seg_len * ALIGN_LANES;
+  if (scores.size() < m * row_size)
+    scores.resize(m * row_size);
+  std::fill(scores.begin(), scores.begin() + row_size, 0);
+
+  score_vec zero = vec_set1(0), vh, vf, vdiag, vup, vmax, vgap;
+  int16_t lanes[ALIGN_LANES];
+
   for (int i = 1; i < m; i++) {
-    for (int j = 1; j < n; j++) {
-      tmp = get_score_cell(h, i, j, read, adap);
-      h[i][j] = *tmp;
-      t[i][j] = *(tmp+1);
+    const int16_t *prev = &scores[(i - 1) * row_size];
+    int16_t *cur = &scores[i * row_size];
+    const int16_t *prof = &profile[get_profile_row(read[i - 1]) * row_size];
+
+    vgap = vec_set1(get_gap_penalty(1, read[i - 1]));
+    vf = zero;
+    vmax = zero;
+    vdiag = vec_shift(vec_load(prev + (seg_len - 1) * ALIGN_LANES));
+
+    for (k = 0; k < seg_len; k++) {
+      vup = vec_load(prev + k * ALIGN_LANES);
+      vh = vec_max(vec_adds(vdiag, vec_load(prof + k * ALIGN_LANES)), vec_subs(vup, vec_load(&gap_profile[k * ALIGN_LANES])));
+      vh = vec_max(vec_max(vh, zero), vf);
+      vh = vec_and(vh, vec_load(&pad_mask[k * ALIGN_LANES]));
+      vec_store(cur + k * ALIGN_LANES, vh);
+      vf = vec_subs(vh, vgap);
+      vdiag = vup;
+    }
 
-      if (*tmp >= max_v) {
-        max_i = i;
-        max_j = j;
-        max_v = *tmp;
+    // Gaps in the read that cross into the next lane
+    vf = vec_shift(vf);
+    k = 0;
+    while (vec_any_gt(vec_and(vf, vec_load(&pad_mask[k * ALIGN_LANES])), vec_load(cur + k * ALIGN_LANES))) {
+      vh = vec_and(vec_max(vec_load(cur + k * ALIGN_LANES), vf), vec_load(&pad_mask[k * ALIGN_LANES]));
+      vec_store(cur + k * ALIGN_LANES, vh);
+      vf = vec_subs(vf, vgap);
+      if (++k == seg_len) {
+        k = 0;
+        vf = vec_shift(vf);
       }
     }
-  }
 
-  max_score = max_v;
-  // if (max_i != read.length())	// Ensure alignment to end of read.
-  //   return rt;
-  // std::cout << "Score: " << max_v << " ";
-  // print_matrix(h, m, n, read, adap);
-  // print_matrix(t, m, n, read, adap);
-  // Traceback
-  int _t, _l, _d, _align_n = 0;
-  char _align[2][max_read_size];
-
-  // 1 - Diag, 2->Right, 3->Down
-  while (max_v != 0) {
-    _d = h[max_i-1][max_j-1];
-    _l = h[max_i][max_j-1];
-    _t = h[max_i-1][max_j];
-
-    switch(t[max_i][max_j]) {
-      case 1:
-        max_v = _d;
-        max_i = max_i -1;
-        max_j = max_j - 1;
-        _align[0][_align_n] = read[max_i];
-        _align[1][_align_n] = adap[max_j];
-        _align_n++;
-        break;
-      case 2:
-        max_v = _l;
-        max_j = max_j - 1;
-        _align[0][_align_n] = '-';
-        _align[1][_align_n] = adap[max_j];
-        _align_n++;
-        break;
-      case 3:
-        max_v = _t;
-        max_i = max_i - 1;
-        _align[0][_align_n] = read[max_i];
-        _align[1][_align_n] = '-';
-        _align_n++;
-        break;
-      case 0:
-        max_v = 0;
-        break;
+    for (k = 0; k < seg_len; k++) {
+      vmax = vec_max(vmax, vec_load(cur + k * ALIGN_LANES));
+    }
+    vec_store(lanes, vmax);
+    row_max = *std::max_element(lanes, lanes + ALIGN_LANES);
+
+    if (row_max >= max_v) {	// Last best cell in row order, as in the scalar fill
+      max_v = row_max;
+      max_i = i;
     }
   }
 
-  rt[1] = max_i;
-  print_alignment(_align, _align_n);
+  for (max_j = n - 1; max_j > 1 && get_score(max_i, max_j) != max_v; max_j--);
 
-  if (max_score <= ((_align_n - 2) * unit_score) - get_gap_penalty(2, 'A') || max_j != 0) // If alignment does not start at beginning of adapter
-    return rt;
+  auto score = [this](int i, int j) { return get_score(i, j); };
+  return traceback(score, read, adap, max_i, max_j, max_v, start);
+}
 
-  rt[0] = max_score;
-  
-  // print_alignment(_align, _align_n);
+/*
+  Number of positions where a and b differ, comparing 16 bases at a time with SSE2. Stops once
+  more than max_mismatches are found.
+*/
+int count_mismatches(const char *a, const char *b, int n, int max_mismatches) {
+  int mismatches = 0, i = 0;
+#ifdef __SSE2__
+  for (; i + 16 <= n && mismatches <= max_mismatches; i += 16) {
+    __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (a + i)), _mm_loadu_si128((const __m128i*) (b + i)));
+    for (int m = ~_mm_movemask_epi8(eq) & 0xFFFF; m != 0; m &= m - 1)
+      mismatches++;
+  }
+#endif
+  for (; i < n && mismatches <= max_mismatches; i++) {
+    if (a[i] != b[i])
+      mismatches++;
+  }
+
+  return mismatches;
+}
+
+// Returns {score, start of the alignment on the read}. Score is -1 if the adapter was not found.
+int* align_seqs(std::string read, std::string adap) {
+  int *rt = new int[2];
+  adapter_aligner aligner(adap);
+  rt[0] = aligner.align(read, rt[1]);
 
   return rt;
 }
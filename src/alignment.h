@@ -3,10 +3,11 @@
 #include<vector>
 #include<fstream>
 #include<ctime>
+#include <stdint.h>
+#include <string>
 
-
-#ifndef primer_bed
-#define primer_bed
+#ifndef IVAR_ALIGNMENT_H
+#define IVAR_ALIGNMENT_H
 
 /* Substitution Matrix
 
@@ -30,17 +31,39 @@ const int substitution[5][5] = {
 
 const int gap_open = unit_score - 1;
 const int gap_extension = -1;
-const int max_read_size = 500;
-const int max_adapter_size = 60;
 const int MAX_GAP = 2;
 
+const int ALIGN_LANES = 8;			// 16 bit scores in a 128 bit vector
+const unsigned int MAX_SIMD_ADAPTER_SIZE = 16000;	// Scores are at most unit_score * adapter length and fit in 16 bits
+
 int get_sub_score(char a, char b);
 int get_gap_penalty(int k, char a);
-void print_matrix(int h[][max_adapter_size], int r, int c, std::string read, std::string adap);
-int*  get_score_cell(int h[][max_adapter_size], int i, int j, std::string read, std::string adap);
-void print_alignment(char a[2][max_read_size], int n);
+
+/*
+  Local alignment of reads to one adapter with a striped SIMD kernel. The query profile of the
+  adapter is built once and the score rows are kept between reads, so aligning a read allocates
+  nothing once the buffer has grown to the longest read. Scores and traceback are the same as
+  align_seqs_scalar().
+*/
+class adapter_aligner {
+public:
+  adapter_aligner(const std::string &adap);
+  int align(const std::string &read, int &start);
+
+private:
+  int get_score(int i, int j) const;
+
+  std::string adap;
+  int seg_len;
+  std::vector<int16_t> profile;		// Substitution score by read base, striped over the adapter
+  std::vector<int16_t> gap_profile;	// Gap penalty of every adapter base, striped
+  std::vector<int16_t> pad_mask;	// 0 for lanes past the end of the adapter
+  std::vector<int16_t> scores;		// Score rows of the last read
+};
+
+int align_seqs_scalar(const std::string &read, const std::string &adap, int &start);
 int* align_seqs(std::string read, std::string adap);
+int count_mismatches(const char *a, const char *b, int n, int max_mismatches);
 int find_adapters_contaminants(std::istream &cin, std::string adp_cntms_file);
-int main(int argc, char* argv[]);
 
 #endif
@@ -19,8 +19,8 @@ void print_allele_depths(std::vector<allele> ad) {
   }
 }
 
-int check_allele_exists(std::string n, std::vector<allele> ad) {
-  for (std::vector<allele>::iterator it = ad.begin(); it != ad.end(); ++it) {
+int check_allele_exists(const std::string &n, const std::vector<allele> &ad) {
+  for (std::vector<allele>::const_iterator it = ad.begin(); it != ad.end(); ++it) {
     if (it->nuc.compare(n) == 0) {
       return it - ad.begin();
     }
@@ -43,6 +43,56 @@ int find_ref_in_allele(std::vector<allele> ad, char ref) {
   return -1;
 }
 
+// Count one read supporting allele b with quality q at a position. Observations below min_qual are ignored.
+void add_allele_observation(std::vector<allele> &ad, const std::string &b, uint8_t q, uint8_t min_qual, bool forward, bool beg, bool end) {
+  if (q < min_qual)
+    return;
+
+  int ind = check_allele_exists(b, ad);
+
+  if (ind==-1) {
+    allele tmp;
+    tmp.nuc = b;
+    tmp.depth = 1;
+    tmp.tmp_mean_qual = q;
+
+    if (!forward)
+      tmp.reverse = 1;
+    else
+      tmp.reverse = 0;
+    if (beg)
+      tmp.beg = 1;
+    else
+      tmp.beg = 0;
+    if (end)
+      tmp.end = 1;
+    else
+      tmp.end = 0;
+
+    ad.push_back(tmp);
+  } else {
+    ad.at(ind).tmp_mean_qual = (ad.at(ind).tmp_mean_qual * ad.at(ind).depth + q)/(ad.at(ind).depth + 1);
+    ad.at(ind).depth += 1;
+
+    if (beg)
+      ad.at(ind).beg += 1;
+    if (end)
+      ad.at(ind).end += 1;
+    if (!forward)
+      ad.at(ind).reverse += 1;
+  }
+}
+
+// Set mean quality and sort alleles once all observations at a position are added.
+void finalize_allele_depth(std::vector<allele> &ad) {
+  for (std::vector<allele>::iterator it = ad.begin(); it!=ad.end(); ++it) {
+    it->mean_qual = (uint8_t) it->tmp_mean_qual;
+  }
+
+  if (ad.size() > 0)
+    std::sort(ad.begin(), ad.end());
+}
+
 std::vector<allele> update_allele_depth(char ref,std::string bases, std::string qualities, uint8_t min_qual) {
   std::vector<allele> ad;
   std::string indel;
@@ -68,7 +118,6 @@ std::vector<allele> update_allele_depth(char ref,std::string bases, std::string
 
     q = qualities[q_ind] - 33;
     std::string b;
-    allele tmp;
     bool forward= true;
 
     switch(bases[i]) {
@@ -123,40 +172,7 @@ std::vector<allele> update_allele_depth(char ref,std::string bases, std::string
         beg = (bases[i+1] == '^');
     }
 
-    int ind = check_allele_exists(b, ad);
-
-    if (q >= min_qual) {
-      if (ind==-1) {
-        tmp.nuc = b;
-        tmp.depth = 1;
-        tmp.tmp_mean_qual = q;
-
-        if (!forward)
-          tmp.reverse = 1;
-        else
-          tmp.reverse = 0;
-        if (beg)
-          tmp.beg = 1;
-        else
-          tmp.beg = 0;
-        if (end)
-          tmp.end = 1;
-        else
-          tmp.end = 0;
-
-        ad.push_back(tmp);
-      } else {
-        ad.at(ind).tmp_mean_qual = (ad.at(ind).tmp_mean_qual * ad.at(ind).depth + q)/(ad.at(ind).depth + 1);
-        ad.at(ind).depth += 1;
-
-        if (beg)
-          ad.at(ind).beg += 1;
-        if (end)
-          ad.at(ind).end += 1;
-        if (!forward)
-          ad.at(ind).reverse += 1;
-      }
-    }
+    add_allele_observation(ad, b, q, min_qual, forward, beg, end);
 
     i++;
 
@@ -164,12 +180,7 @@ std::vector<allele> update_allele_depth(char ref,std::string bases, std::string
       q_ind++;
   }
 
-  for (std::vector<allele>::iterator it = ad.begin(); it!=ad.end(); ++it) {
-    it->mean_qual = (uint8_t) it->tmp_mean_qual;
-  }
-
-  if (ad.size() > 0)
-    std::sort(ad.begin(), ad.end());
+  finalize_allele_depth(ad);
 
   return ad;
 }
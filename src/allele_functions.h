@@ -2,8 +2,8 @@
 #include<vector>
 #include<stdint.h>
 
-#ifndef allele_functions
-#define allele_functions
+#ifndef IVAR_ALLELE_FUNCTIONS_H
+#define IVAR_ALLELE_FUNCTIONS_H
 
 struct allele{
   std::string nuc;
@@ -21,8 +21,10 @@ struct allele{
   }
 };
 
-int check_allele_exists(std::string n, std::vector<allele> ad);
+int check_allele_exists(const std::string &n, const std::vector<allele> &ad);
 std::vector<allele> update_allele_depth(char ref,std::string bases, std::string qualities, uint8_t min_qual);
+void add_allele_observation(std::vector<allele> &ad, const std::string &b, uint8_t q, uint8_t min_qual, bool forward, bool beg, bool end);
+void finalize_allele_depth(std::vector<allele> &ad);
 void print_allele_depths(std::vector<allele> ad);
 int find_ref_in_allele(std::vector<allele> ad, char ref);
 char gt2iupac(char a, char b);
@@ -0,0 +1,318 @@
+#include "bam_pileup.h"
+
+struct plp_reader {
+  samFile *in;
+  bam_hdr_t *header;
+  hts_itr_t *iter;
+  pileup_opts *opts;
+};
+
+// Read filter applied by samtools mpileup before reads are added to the pileup
+bool pileup_read_passes(const bam1_t *b, const pileup_opts &opts) {
+  if (b->core.tid < 0 || (b->core.flag & BAM_FUNMAP))
+    return false;
+
+  if (b->core.flag & opts.flag_filter)
+    return false;
+
+  if (b->core.qual < opts.min_map_qual)
+    return false;
+
+  if (!opts.count_orphans && (b->core.flag & BAM_FPAIRED) && !(b->core.flag & BAM_FPROPER_PAIR))
+    return false;
+
+  return true;
+}
+
+static int read_plp(void *data, bam1_t *b) {
+  plp_reader *r = (plp_reader*) data;
+  int ret;
+
+  while (true) {
+    ret = (r->iter) ? sam_itr_next(r->in, r->iter, b) : sam_read1(r->in, r->header, b);
+    if (ret < 0 || pileup_read_passes(b, *r->opts))
+      break;
+  }
+
+  return ret;
+}
+
+static char ref_base_or_n(const ref_antd &refantd, int64_t pos, int region_id) {
+  char base = refantd.get_base(pos, region_id);
+  return (base == 0) ? 'N' : base;
+}
+
+static uint8_t plp_qual(const bam_pileup1_t *p) {
+  int q = (p->qpos < p->b->core.l_qseq) ? bam_get_qual(p->b)[p->qpos] : 0;
+  return (q > 93) ? 93 : q;	// mpileup caps printed qualities at '~'
+}
+
+/*
+  Add the alleles of every read at pos (0-based) the same way update_allele_depth() reads them from
+  the mpileup bases column. This includes its quirks so that both paths give identical counts:
+  reference skips count as an empty allele, insertions and deletions are always forward and the
+  beg/end flags look at the token that follows the base.
+*/
+static void add_plp_alleles(const bam_pileup1_t *plp, int n, int64_t pos, int region_id, char ref, const ref_antd &refantd, pileup_opts &opts, uint8_t min_qual, std::vector<allele> &ad, uint32_t &depth) {
+  std::vector<const bam_pileup1_t*> reads;
+  const bam_pileup1_t *p;
+  std::string b, indel;
+  uint8_t *seq;
+  char c;
+  bool beg, end;
+  int i, j;
+
+  for (i = 0; i < n; ++i) {
+    if (plp_qual(plp + i) >= opts.min_base_qual)
+      reads.push_back(plp + i);
+  }
+
+  depth = reads.size();
+
+  for (i = 0; i < (int) reads.size(); ++i) {
+    p = reads[i];
+    seq = bam_get_seq(p->b);
+    end = (p->indel == 0 && p->is_tail);
+    beg = (p->indel == 0 && !p->is_tail && i + 1 < (int) reads.size() && reads[i+1]->is_head);
+
+    if (p->is_del && !p->is_refskip) {
+      add_allele_observation(ad, "*", plp_qual(p), min_qual, true, false, false);
+    } else if (p->is_refskip) {
+      add_allele_observation(ad, "", plp_qual(p), min_qual, true, beg, end);
+    } else {
+      c = (p->qpos < p->b->core.l_qseq) ? seq_nt16_str[bam_seqi(seq, p->qpos)] : 'N';
+      if (c == '=' || seq_nt16_table[(int) c] == seq_nt16_table[(int) ref])
+        b = ref;
+      else
+        b = c;
+      add_allele_observation(ad, b, plp_qual(p), min_qual, !bam_is_rev(p->b), beg, end);
+    }
+
+    if (p->indel > 0) {
+      indel = "+";
+      for (j = 1; j <= p->indel; ++j) {
+        indel += seq_nt16_str[bam_seqi(seq, p->qpos + j)];
+      }
+      add_allele_observation(ad, indel, min_qual, min_qual, true, false, false);
+    } else if (p->indel < 0) {
+      indel = "-";
+      for (j = 1; j <= -p->indel; ++j) {
+        indel += toupper(ref_base_or_n(refantd, pos + j + 1, region_id));
+      }
+      add_allele_observation(ad, indel, min_qual, min_qual, true, false, false);
+    }
+  }
+
+  finalize_allele_depth(ad);
+}
+
+/*
+  Pileup reads from iter, or the whole file if iter is NULL, and call callback for every position
+  of the references. With a region only positions within it are reported.
+*/
+int pileup_alleles(samFile *in, bam_hdr_t *header, hts_itr_t *iter, pileup_region *region, pileup_opts &opts, const ref_antd &refantd, uint8_t min_qual, unsigned int worker, pileup_callback callback, variant_sink &out) {
+  plp_reader reader;
+  reader.in = in;
+  reader.header = header;
+  reader.iter = iter;
+  reader.opts = &opts;
+
+  return pileup_reads(read_plp, &reader, header, region, opts, refantd, min_qual, worker, callback, out);
+}
+
+/*
+  Pileup the reads returned by read, sorted by position, and call callback for every position of
+  every reference in header, or of region, as mpileup -aa does. Positions without reads have a
+  depth of 0 and no alleles, the same as a `0 * *` mpileup line. read has to apply
+  pileup_read_passes() itself. Returns -1 if the pileup stops on an error of read or htslib.
+*/
+int pileup_reads(bam_plp_auto_f read, void *data, bam_hdr_t *header, pileup_region *region, pileup_opts &opts, const ref_antd &refantd, uint8_t min_qual, unsigned int worker, pileup_callback callback, variant_sink &out) {
+  bam_plp_t plp_iter = bam_plp_init(read, data);
+  if (opts.detect_overlaps)
+    bam_plp_init_overlaps(plp_iter);
+  bam_plp_set_maxcnt(plp_iter, (opts.max_depth > 0) ? opts.max_depth : INT_MAX);
+
+  const bam_pileup1_t *plp;
+  int tid, n = 0, region_id = -1;
+  int cur_tid = (region != NULL) ? region->tid : 0, last_tid = (region != NULL) ? region->tid : header->n_targets - 1;
+  hts_pos_t pos, next = (region != NULL) ? region->beg : 0;
+  std::string region_name;
+  std::vector<allele> ad;
+  uint32_t depth;
+  char ref;
+
+  // Report positions next to end - 1 of cur_tid without reads
+  auto add_empty = [&](hts_pos_t end) {
+    if (next < end && region_name.empty()) {
+      region_name = sam_hdr_tid2name(header, cur_tid);
+      region_id = refantd.get_region_id(region_name);
+    }
+    for (; next < end; ++next) {
+      ref = ref_base_or_n(refantd, next + 1, region_id);
+      ad.clear();
+      callback(worker, region_name, next + 1, ref, 0, ad, out);
+    }
+  };
+  auto reference_end = [&]() -> hts_pos_t {
+    hts_pos_t len = sam_hdr_tid2len(header, cur_tid);
+    return (region != NULL && region->end < len) ? region->end : len;
+  };
+
+  while ((plp = bam_plp64_auto(plp_iter, &tid, &pos, &n)) != NULL) {
+    if (tid < 0 || (region != NULL && (tid != region->tid || pos < region->beg)))
+      continue;
+
+    if (region != NULL && pos >= region->end)
+      break;
+
+    while (cur_tid < tid) {
+      add_empty(reference_end());
+      cur_tid++;
+      next = 0;
+      region_name.clear();
+    }
+
+    add_empty(pos);
+    if (region_name.empty()) {
+      region_name = sam_hdr_tid2name(header, tid);
+      region_id = refantd.get_region_id(region_name);
+    }
+
+    ref = ref_base_or_n(refantd, pos + 1, region_id);
+    ad.clear();
+    add_plp_alleles(plp, n, pos, region_id, ref, refantd, opts, min_qual, ad, depth);
+    callback(worker, region_name, pos + 1, ref, depth, ad, out);
+    next = pos + 1;
+  }
+
+  if (n >= 0) {
+    for (; cur_tid <= last_tid; ++cur_tid, next = 0, region_name.clear()) {
+      add_empty(reference_end());
+    }
+  }
+
+  bam_plp_destroy(plp_iter);
+
+  return (n < 0) ? -1 : 0;	// bam_plp64_auto sets n to -1 on errors
+}
+
+// Split all references into windows of at most window bases
+std::vector<pileup_region> split_pileup_regions(bam_hdr_t *header, int64_t window) {
+  std::vector<pileup_region> regions;
+  pileup_region r;
+  int64_t len;
+
+  for (int i = 0; i < header->n_targets; ++i) {
+    len = sam_hdr_tid2len(header, i);
+    for (int64_t beg = 0; beg < len; beg += window) {
+      r.tid = i;
+      r.beg = beg;
+      r.end = (beg + window < len) ? beg + window : len;
+      regions.push_back(r);
+    }
+  }
+
+  return regions;
+}
+
+struct bam_source {
+  samFile *in;
+  bam_hdr_t *header;
+  hts_idx_t *idx;
+};
+
+static int open_bam_source(std::string bam, bam_source &src, bool load_index) {
+  src.in = hts_open(bam.c_str(), "r");
+  src.header = NULL;
+  src.idx = NULL;
+
+  if (src.in == NULL) {
+    std::cout << ("Unable to open BAM/SAM file.") << std::endl;
+    return -1;
+  }
+
+  src.header = sam_hdr_read(src.in);
+  if (src.header == NULL) {
+    std::cout << "Unable to open BAM/SAM header." << std::endl;
+    return -1;
+  }
+
+  if (load_index)
+    src.idx = sam_index_load(src.in, bam.c_str());
+
+  return 0;
+}
+
+static void close_bam_source(bam_source &src) {
+  if (src.idx) hts_idx_destroy(src.idx);
+  if (src.header) bam_hdr_destroy(src.header);
+  if (src.in) sam_close(src.in);
+}
+
+/*
+  Pileup every position in bam and write the callback output to out in reference order. With more
+  than one thread the references are split into windows that are piled up concurrently through
+  the BAM index. Reads overlapping a window boundary are seen by both windows so the counts are
+  the same as a single pass over the file. Returns -1 if any part of bam or its index cannot be
+  read, in which case out only has part of the output.
+*/
+int pileup_bam(std::string bam, pileup_opts opts, uint8_t min_qual, const ref_antd &refantd, unsigned int nthreads, pileup_callback callback, variant_sink &out) {
+  std::vector<bam_source> sources(nthreads);
+  int res = 0;
+
+  for (unsigned int i = 0; i < nthreads; ++i) {
+    res = open_bam_source(bam, sources[i], nthreads > 1);
+    if (res != 0)
+      break;
+  }
+
+  if (res == 0 && nthreads > 1 && sources[0].idx == NULL) {
+    std::cout << "Unable to open BAM/SAM index. Using one thread." << std::endl;
+    nthreads = 1;
+  }
+
+  if (res == 0 && nthreads == 1) {
+    res = pileup_alleles(sources[0].in, sources[0].header, NULL, NULL, opts, refantd, min_qual, 0, callback, out);
+    if (res != 0)
+      std::cout << "Unable to read " << bam << "." << std::endl;
+  } else if (res == 0) {
+    int64_t total_len = 0;
+    for (int i = 0; i < sources[0].header->n_targets; ++i) {
+      total_len += sam_hdr_tid2len(sources[0].header, i);
+    }
+
+    int64_t window = total_len / (nthreads * 8);
+    window = (window < 1000) ? 1000 : window;
+    std::vector<pileup_region> regions = split_pileup_regions(sources[0].header, window);
+
+    std::atomic<bool> failed(false);
+    ordered_pool pool(nthreads);
+    for (std::vector<pileup_region>::iterator it = regions.begin(); it != regions.end(); ++it) {
+      pileup_region r = *it;
+      std::shared_ptr<variant_buffer> region_out(new variant_buffer);
+      pool.submit([r, region_out, &sources, &opts, &refantd, min_qual, callback, &failed](unsigned int id) mutable {
+          if (failed)
+            return;
+          hts_itr_t *iter = sam_itr_queryi(sources[id].idx, r.tid, r.beg, r.end);
+          if (iter == NULL || pileup_alleles(sources[id].in, sources[id].header, iter, &r, opts, refantd, min_qual, id, callback, *region_out) != 0)
+            failed = true;
+          if (iter != NULL)
+            hts_itr_destroy(iter);
+        }, [region_out, &out]() {
+          region_out->write_to(out);
+        });
+    }
+    pool.finish();
+
+    if (failed) {
+      std::cout << "Unable to read " << bam << "." << std::endl;
+      res = -1;
+    }
+  }
+
+  for (std::vector<bam_source>::iterator it = sources.begin(); it != sources.end(); ++it) {
+    close_bam_source(*it);
+  }
+
+  return res;
+}
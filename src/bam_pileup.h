@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <climits>
+#include <atomic>
+#include <htslib/sam.h>
+
+#include "allele_functions.h"
+#include "ref_seq.h"
+#include "ordered_pool.h"
+#include "variant_sink.h"
+
+#ifndef IVAR_BAM_PILEUP_H
+#define IVAR_BAM_PILEUP_H
+
+/*
+  Allele counts built directly from the reads in a BAM file. The counts match those from parsing
+  the output of `samtools mpileup -aa -A -d 0 -B -Q 0 --reference <ref.fa>` with
+  update_allele_depth(). Defaults correspond to those mpileup options.
+*/
+
+struct pileup_opts {
+  uint8_t min_base_qual;	// mpileup -Q
+  uint8_t min_map_qual;		// mpileup -q
+  int max_depth;		// mpileup -d. 0 for no limit.
+  bool count_orphans;		// mpileup -A
+  bool detect_overlaps;		// Disabled by mpileup -x
+  uint16_t flag_filter;		// mpileup --ff
+  pileup_opts() : min_base_qual(0), min_map_qual(0), max_depth(0), count_orphans(true), detect_overlaps(true), flag_filter(BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP) {}
+};
+
+struct pileup_region {
+  int tid;
+  int64_t beg, end;		// 0-based, end exclusive
+};
+
+// Called for every position of the references, as mpileup -aa, with the region name, 1-based position, reference base, mpileup depth and alleles. Variants called there are written to out.
+typedef std::function<void(unsigned int worker, const std::string &region, int64_t pos, char ref, uint32_t depth, std::vector<allele> &ad, variant_sink &out)> pileup_callback;
+
+std::vector<pileup_region> split_pileup_regions(bam_hdr_t *header, int64_t window);
+bool pileup_read_passes(const bam1_t *b, const pileup_opts &opts);
+int pileup_reads(bam_plp_auto_f read, void *data, bam_hdr_t *header, pileup_region *region, pileup_opts &opts, const ref_antd &refantd, uint8_t min_qual, unsigned int worker, pileup_callback callback, variant_sink &out);
+int pileup_alleles(samFile *in, bam_hdr_t *header, hts_itr_t *iter, pileup_region *region, pileup_opts &opts, const ref_antd &refantd, uint8_t min_qual, unsigned int worker, pileup_callback callback, variant_sink &out);
+int pileup_bam(std::string bam, pileup_opts opts, uint8_t min_qual, const ref_antd &refantd, unsigned int nthreads, pileup_callback callback, variant_sink &out);
+
+#endif
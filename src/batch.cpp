@@ -0,0 +1,210 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "batch.h"
+#include "ordered_pool.h"
+#include "buffered_writer.h"
+
+// Columns of a manifest. trim, variants and consensus are the output prefixes of the steps run for a sample.
+static const std::vector<std::string> BATCH_COLUMNS = {"sample", "bam", "mpileup", "bed", "pairs", "ref", "gff", "trim", "variants", "consensus"};
+static const std::vector<std::string> BATCH_STEPS = {"trim", "variants", "consensus"};
+
+static std::vector<std::string> split_tabs(const std::string &line) {
+  std::vector<std::string> fields;
+  std::stringstream s(line);
+  std::string field;
+  while (std::getline(s, field, '\t'))
+    fields.push_back(field);
+  if (!line.empty() && line[line.size() - 1] == '\t')
+    fields.push_back("");
+  return fields;
+}
+
+/*
+  Read a tab separated manifest with a header line naming its columns, one of BATCH_COLUMNS
+  each. Every following line is one sample. Empty lines and lines starting with # are skipped.
+*/
+int read_batch_manifest(std::istream &in, std::vector<job_request> &samples) {
+  std::string line;
+  std::vector<std::string> header, fields;
+  unsigned int line_no = 0;
+  samples.clear();
+  while (std::getline(in, line)) {
+    line_no++;
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (line.empty() || line[0] == '#')
+      continue;
+    fields = split_tabs(line);
+    if (header.empty()) {
+      header = fields;
+      for (std::vector<std::string>::iterator it = header.begin(); it != header.end(); ++it) {
+        if (std::find(BATCH_COLUMNS.begin(), BATCH_COLUMNS.end(), *it) == BATCH_COLUMNS.end()) {
+          std::cout << "Unknown column in manifest: " << *it << std::endl;
+          return -1;
+        }
+      }
+      if (std::find(header.begin(), header.end(), "sample") == header.end()) {
+        std::cout << "Manifest has no sample column" << std::endl;
+        return -1;
+      }
+      continue;
+    }
+    if (fields.size() > header.size()) {
+      std::cout << "Line " << line_no << " of the manifest has more fields than the header" << std::endl;
+      return -1;
+    }
+    job_request sample;
+    for (size_t i = 0; i < fields.size(); ++i)
+      sample[header[i]] = fields[i];
+    if (sample["sample"].empty()) {
+      std::cout << "Line " << line_no << " of the manifest has no sample name" << std::endl;
+      return -1;
+    }
+    samples.push_back(sample);
+  }
+  if (header.empty()) {
+    std::cout << "Manifest is empty" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+static std::string get_column(const job_request &sample, const std::string &column, const std::string &def = "") {
+  job_request::const_iterator it = sample.find(column);
+  return (it == sample.end() || it->second.empty()) ? def : it->second;
+}
+
+// Jobs of the steps that have an output prefix in the manifest, in the order trim, variants, consensus
+std::vector<job_request> get_batch_jobs(const job_request &sample, const batch_settings &settings) {
+  std::vector<job_request> jobs;
+  std::string min_qual = std::to_string(settings.min_qual);
+  if (!get_column(sample, "trim").empty()) {
+    job_request job;
+    job["cmd"] = "trim";
+    job["bam"] = get_column(sample, "bam");
+    job["prefix"] = get_column(sample, "trim");
+    job["bed"] = get_column(sample, "bed", settings.bed);
+    job["pairs"] = get_column(sample, "pairs", settings.pair_info);
+    job["primer_offset"] = std::to_string(settings.primer_offset);
+    job["min_qual"] = min_qual;
+    job["write_no_primer_reads"] = settings.write_no_primer_reads ? "true" : "false";
+    job["keep_for_reanalysis"] = settings.keep_for_reanalysis ? "true" : "false";
+    jobs.push_back(job);
+  }
+  if (!get_column(sample, "variants").empty()) {
+    job_request job;
+    job["cmd"] = "variants";
+    if (!get_column(sample, "mpileup").empty())
+      job["mpileup"] = get_column(sample, "mpileup");
+    else
+      job["bam"] = get_column(sample, "bam");
+    job["prefix"] = get_column(sample, "variants");
+    job["ref"] = get_column(sample, "ref", settings.ref);
+    job["gff"] = get_column(sample, "gff", settings.gff);
+    job["min_qual"] = min_qual;
+    job["min_threshold"] = std::to_string(settings.min_threshold);
+    jobs.push_back(job);
+  }
+  if (!get_column(sample, "consensus").empty()) {
+    job_request job;
+    job["cmd"] = "consensus";
+    job["mpileup"] = get_column(sample, "mpileup");
+    job["prefix"] = get_column(sample, "consensus");
+    job["min_qual"] = min_qual;
+    job["min_depth"] = std::to_string(settings.min_depth);
+    job["gap"] = std::string(1, settings.gap);
+    jobs.push_back(job);
+  }
+  return jobs;
+}
+
+// One line of the report with the status of every step of a sample and the counts of the steps that ran
+static void write_batch_report(buffered_ofstream &out, const job_request &sample, const std::vector<job_request> &responses, double seconds, bool &failed) {
+  const std::string counts[] = {"primer_trimmed", "no_primer", "low_quality", "unmapped", "outside_amplicon", "total_bases", "bases_zero_depth", "bases_min_depth"};
+  job_request steps, values;
+  std::string message;
+  failed = false;
+  for (std::vector<job_request>::const_iterator it = responses.begin(); it != responses.end(); ++it) {
+    std::string status = get_column(*it, "status");
+    steps[get_column(*it, "cmd")] = status;
+    if (status != "ok") {
+      failed = true;
+      if (message.empty())
+        message = get_column(*it, "cmd", "job") + ": " + get_column(*it, "message", "failed with " + get_column(*it, "result"));
+    }
+    values.insert(it->begin(), it->end());
+  }
+  out << get_column(sample, "sample") << "\t" << (failed ? "error" : "ok") << "\t" << seconds;
+  for (std::vector<std::string>::const_iterator it = BATCH_STEPS.begin(); it != BATCH_STEPS.end(); ++it)
+    out << "\t" << get_column(steps, *it, "NA");
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    out << "\t" << get_column(values, counts[i], "NA");
+  out << "\t" << message << "\n";
+}
+
+/*
+  Run the steps of every sample in manifest and write one line per sample to out_file, in the
+  order of the manifest. Samples run on nthreads threads, the steps of a sample one after the
+  other on one thread. All samples share one job_runner, so every BED file and reference is
+  loaded once. A failed step does not stop the other steps or samples. Returns -1 if the
+  manifest cannot be read or any sample failed.
+*/
+int run_batch(std::string manifest, const batch_settings &settings, std::string out_file, unsigned int nthreads) {
+  std::vector<job_request> samples;
+  std::ifstream in(manifest.c_str());
+  if (!in.is_open()) {
+    std::cout << "Unable to open manifest " << manifest << std::endl;
+    return -1;
+  }
+  if (read_batch_manifest(in, samples) != 0)
+    return -1;
+  buffered_ofstream out;
+  if (out.open(out_file) != 0) {
+    std::cout << "Unable to write to " << out_file << std::endl;
+    return -1;
+  }
+  out << "SAMPLE\tSTATUS\tSECONDS\tTRIM\tVARIANTS\tCONSENSUS\tPRIMER_TRIMMED\tNO_PRIMER\tLOW_QUALITY\tUNMAPPED\tOUTSIDE_AMPLICON\tTOTAL_BASES\tBASES_ZERO_DEPTH\tBASES_MIN_DEPTH\tMESSAGE\n";
+
+  job_runner runner;
+  std::vector<std::vector<job_request> > responses(samples.size());
+  std::vector<double> seconds(samples.size(), 0);
+  unsigned int nfailed = 0;
+  std::unique_ptr<ordered_pool> pool((nthreads > 1) ? new ordered_pool(nthreads) : NULL);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    std::function<void(unsigned int)> work = [&, i](unsigned int) {
+      std::vector<job_request> jobs = get_batch_jobs(samples[i], settings);
+      for (std::vector<job_request>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+        job_request response;
+        if (parse_job_request(runner.run_job(*it), response) != 0)
+          response["status"] = "error";
+        response["cmd"] = (*it)["cmd"];
+        seconds[i] += std::stod(get_column(response, "seconds", "0"));
+        responses[i].push_back(response);
+      }
+    };
+    std::function<void()> emit = [&, i]() {
+      bool failed;
+      write_batch_report(out, samples[i], responses[i], seconds[i], failed);
+      out.flush();
+      if (failed)
+        nfailed++;
+      responses[i].clear();
+    };
+    if (pool) {
+      pool->submit(work, emit);
+    } else {
+      work(0);
+      emit();
+    }
+  }
+  if (pool)
+    pool->finish();
+  if (out.close() != 0) {
+    std::cout << "Unable to write to " << out_file << std::endl;
+    return -1;
+  }
+  std::cout << samples.size() - nfailed << " of " << samples.size() << " samples completed. Report written to " << out_file << std::endl;
+  return (nfailed == 0) ? 0 : -1;
+}
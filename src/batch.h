@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "job_runner.h"
+
+#ifndef IVAR_BATCH_H
+#define IVAR_BATCH_H
+
+// Inputs and settings shared by every sample of a batch. bed, pairs, ref and gff can be set per sample in the manifest.
+struct batch_settings {
+  std::string bed;		// -b
+  std::string pair_info;	// -f
+  int32_t primer_offset;	// -x
+  std::string ref;		// -r
+  std::string gff;		// -g
+  uint8_t min_qual;		// -q
+  double min_threshold;		// -t for variants
+  uint8_t min_depth;		// -m for consensus
+  char gap;			// -n
+  bool write_no_primer_reads;	// -e
+  bool keep_for_reanalysis;	// -k
+  batch_settings() : primer_offset(0), min_qual(20), min_threshold(0.03), min_depth(10), gap('N'), write_no_primer_reads(false), keep_for_reanalysis(false) {}
+};
+
+int read_batch_manifest(std::istream &in, std::vector<job_request> &samples);
+std::vector<job_request> get_batch_jobs(const job_request &sample, const batch_settings &settings);
+int run_batch(std::string manifest, const batch_settings &settings, std::string out_file, unsigned int nthreads = 1);
+
+#endif
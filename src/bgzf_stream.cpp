@@ -0,0 +1,136 @@
+#include "bgzf_stream.h"
+
+bgzf_streambuf::bgzf_streambuf() : buf(BGZF_BLOCK_SIZE) {
+  this->fp = NULL;
+}
+
+bgzf_streambuf::~bgzf_streambuf() {
+  close();
+}
+
+// mode is "r" or "w". With more than one thread bgzipped blocks are compressed or decompressed in parallel.
+int bgzf_streambuf::open(const std::string &fname, const char *mode, int nthreads) {
+  close();
+
+  this->fp = bgzf_open(fname.c_str(), mode);
+  if (this->fp == NULL)
+    return -1;
+
+  if (nthreads > 1)
+    bgzf_mt(this->fp, nthreads, 256);
+
+  if (mode[0] == 'w') {
+    setp(buf.data(), buf.data() + buf.size());
+  } else {
+    setg(buf.data(), buf.data(), buf.data());
+  }
+
+  return 0;
+}
+
+int bgzf_streambuf::close() {
+  int res = 0;
+
+  if (this->fp == NULL)
+    return 0;
+
+  if (flush_buffer() != 0)
+    res = -1;
+
+  if (bgzf_close(this->fp) != 0)
+    res = -1;
+
+  this->fp = NULL;
+  setp(NULL, NULL);
+  setg(NULL, NULL, NULL);
+
+  return res;
+}
+
+bool bgzf_streambuf::is_open() const {
+  return this->fp != NULL;
+}
+
+int bgzf_streambuf::flush_buffer() {
+  std::ptrdiff_t n = pptr() - pbase();
+
+  if (n > 0 && bgzf_write(this->fp, pbase(), n) != n)
+    return -1;
+
+  pbump(-n);
+
+  return 0;
+}
+
+int bgzf_streambuf::overflow(int c) {
+  if (this->fp == NULL || flush_buffer() != 0)
+    return traits_type::eof();
+
+  if (c != traits_type::eof()) {
+    *pptr() = c;
+    pbump(1);
+  }
+
+  return traits_type::not_eof(c);
+}
+
+int bgzf_streambuf::sync() {
+  if (this->fp == NULL || pbase() == NULL)
+    return 0;
+
+  return flush_buffer();
+}
+
+int bgzf_streambuf::underflow() {
+  if (this->fp == NULL)
+    return traits_type::eof();
+
+  ssize_t n = bgzf_read(this->fp, buf.data(), buf.size());
+  if (n <= 0)
+    return traits_type::eof();
+
+  setg(buf.data(), buf.data(), buf.data() + n);
+
+  return traits_type::to_int_type(*gptr());
+}
+
+bgzf_ostream::bgzf_ostream() : std::ostream(&buf) {
+}
+
+int bgzf_ostream::open(const std::string &fname, int nthreads) {
+  if (buf.open(fname, "w", nthreads) != 0) {
+    setstate(std::ios::failbit);
+    return -1;
+  }
+
+  clear();
+
+  return 0;
+}
+
+int bgzf_ostream::close() {
+  if (buf.close() != 0) {
+    setstate(std::ios::badbit);
+    return -1;
+  }
+
+  return 0;
+}
+
+bgzf_istream::bgzf_istream() : std::istream(&buf) {
+}
+
+int bgzf_istream::open(const std::string &fname, int nthreads) {
+  if (buf.open(fname, "r", nthreads) != 0) {
+    setstate(std::ios::failbit);
+    return -1;
+  }
+
+  clear();
+
+  return 0;
+}
+
+int bgzf_istream::close() {
+  return buf.close();
+}
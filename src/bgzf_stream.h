@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <htslib/bgzf.h>
+
+#ifndef IVAR_BGZF_STREAM_H
+#define IVAR_BGZF_STREAM_H
+
+/*
+  std::iostream wrappers around htslib BGZF so text output can be bgzipped, and indexed with
+  tabix, without changing the code that writes it. Reading goes through bgzf_read() which also
+  reads uncompressed files, so readers accept both plain and bgzipped text.
+*/
+
+class bgzf_streambuf : public std::streambuf {
+public:
+  bgzf_streambuf();
+  ~bgzf_streambuf();
+  int open(const std::string &fname, const char *mode, int nthreads);
+  int close();
+  bool is_open() const;
+
+protected:
+  int overflow(int c);
+  int sync();
+  int underflow();
+
+private:
+  int flush_buffer();
+
+  BGZF *fp;
+  std::vector<char> buf;
+};
+
+class bgzf_ostream : public std::ostream {
+public:
+  bgzf_ostream();
+  int open(const std::string &fname, int nthreads = 1);
+  int close();
+
+private:
+  bgzf_streambuf buf;
+};
+
+class bgzf_istream : public std::istream {
+public:
+  bgzf_istream();
+  int open(const std::string &fname, int nthreads = 1);
+  int close();
+
+private:
+  bgzf_streambuf buf;
+};
+
+#endif
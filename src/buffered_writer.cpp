@@ -0,0 +1,161 @@
+#include "buffered_writer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+buffered_streambuf::buffered_streambuf() {
+  this->fd = -1;
+  this->buf = NULL;
+  this->size = 0;
+}
+
+buffered_streambuf::~buffered_streambuf() {
+  close();
+}
+
+int buffered_streambuf::open(const std::string &fname, size_t buffer_size) {
+  close();
+
+  this->fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (this->fd < 0)
+    return -1;
+
+  this->size = (buffer_size == 0) ? OUTPUT_BUFFER_SIZE : buffer_size;
+  if (posix_memalign((void**) &this->buf, OUTPUT_BUFFER_ALIGNMENT, this->size) != 0) {
+    ::close(this->fd);
+    this->fd = -1;
+    this->buf = NULL;
+    return -1;
+  }
+
+  setp(buf, buf + size);
+
+  return 0;
+}
+
+int buffered_streambuf::close() {
+  int res = 0;
+
+  if (this->fd < 0)
+    return 0;
+
+  if (flush_buffer() != 0)
+    res = -1;
+
+  if (::close(this->fd) != 0)
+    res = -1;
+
+  free(this->buf);
+  this->fd = -1;
+  this->buf = NULL;
+  setp(NULL, NULL);
+
+  return res;
+}
+
+bool buffered_streambuf::is_open() const {
+  return this->fd >= 0;
+}
+
+int buffered_streambuf::write_all(const char *s, size_t n) {
+  ssize_t written;
+
+  while (n > 0) {
+    written = ::write(this->fd, s, n);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return -1;
+    s += written;
+    n -= written;
+  }
+
+  return 0;
+}
+
+int buffered_streambuf::flush_buffer() {
+  std::ptrdiff_t n = pptr() - pbase();
+
+  if (n > 0 && write_all(pbase(), n) != 0)
+    return -1;
+
+  setp(buf, buf + size);
+
+  return 0;
+}
+
+int buffered_streambuf::overflow(int c) {
+  if (this->fd < 0 || flush_buffer() != 0)
+    return traits_type::eof();
+
+  if (c != traits_type::eof()) {
+    *pptr() = c;
+    pbump(1);
+  }
+
+  return traits_type::not_eof(c);
+}
+
+std::streamsize buffered_streambuf::xsputn(const char *s, std::streamsize n) {
+  if (this->fd < 0)
+    return 0;
+
+  if (n <= epptr() - pptr()) {
+    memcpy(pptr(), s, n);
+    pbump(n);
+    return n;
+  }
+
+  if (flush_buffer() != 0)
+    return 0;
+
+  // Blocks larger than the buffer are written without copying
+  if ((size_t) n >= size)
+    return (write_all(s, n) == 0) ? n : 0;
+
+  memcpy(pptr(), s, n);
+  pbump(n);
+
+  return n;
+}
+
+int buffered_streambuf::sync() {
+  if (this->fd < 0)
+    return 0;
+
+  return flush_buffer();
+}
+
+buffered_ofstream::buffered_ofstream() : std::ostream(&buf) {
+}
+
+buffered_ofstream::buffered_ofstream(const std::string &fname, size_t buffer_size) : std::ostream(&buf) {
+  open(fname, buffer_size);
+}
+
+int buffered_ofstream::open(const std::string &fname, size_t buffer_size) {
+  if (buf.open(fname, buffer_size) != 0) {
+    setstate(std::ios::failbit);
+    return -1;
+  }
+
+  clear();
+
+  return 0;
+}
+
+int buffered_ofstream::close() {
+  if (buf.close() != 0) {
+    setstate(std::ios::badbit);
+    return -1;
+  }
+
+  return 0;
+}
+
+bool buffered_ofstream::is_open() const {
+  return buf.is_open();
+}
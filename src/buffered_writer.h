@@ -0,0 +1,51 @@
+#include <iostream>
+#include <string>
+
+#ifndef IVAR_BUFFERED_WRITER_H
+#define IVAR_BUFFERED_WRITER_H
+
+const size_t OUTPUT_BUFFER_SIZE = 4 << 20;
+const size_t OUTPUT_BUFFER_ALIGNMENT = 4096;
+
+/*
+  Output file that only writes once buffer_size bytes are buffered, on an explicit flush or when
+  it is closed. Writes go straight to the file descriptor in large aligned chunks so slow or
+  network file systems see a few big writes instead of one per line. Use '\n' rather than
+  std::endl, which forces a flush.
+*/
+
+class buffered_streambuf : public std::streambuf {
+public:
+  buffered_streambuf();
+  ~buffered_streambuf();
+  int open(const std::string &fname, size_t buffer_size);
+  int close();
+  bool is_open() const;
+
+protected:
+  int overflow(int c);
+  std::streamsize xsputn(const char *s, std::streamsize n);
+  int sync();
+
+private:
+  int write_all(const char *s, size_t n);
+  int flush_buffer();
+
+  int fd;
+  char *buf;
+  size_t size;
+};
+
+class buffered_ofstream : public std::ostream {
+public:
+  buffered_ofstream();
+  buffered_ofstream(const std::string &fname, size_t buffer_size = OUTPUT_BUFFER_SIZE);
+  int open(const std::string &fname, size_t buffer_size = OUTPUT_BUFFER_SIZE);
+  int close();
+  bool is_open() const;
+
+private:
+  buffered_streambuf buf;
+};
+
+#endif
@@ -158,105 +158,566 @@ ret_t get_consensus_allele(std::vector<allele> ad, uint8_t min_qual, double thre
   return t;
 }
 
-int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, double threshold, uint8_t min_depth, char gap, bool min_coverage_flag) {
-  std::string line, cell;
-  std::ofstream fout((out_file+".fa").c_str());
-  std::ofstream tmp_qout((out_file+".qual.txt").c_str());
+// Index of c in BASE_SYMBOLS or -1
+int base_symbol_index(char c) {
+  switch(c) {
+    case 'T': return 0;
+    case 'N': return 1;
+    case 'G': return 2;
+    case 'C': return 3;
+    case 'A': return 4;
+    case '*': return 5;
+  }
+  return -1;
+}
 
-  char *o = new char[out_file.length() + 1];
-  strcpy(o, out_file.c_str());
+// IUPAC code of every set of symbols. Same as combining the symbols with gt2iupac() in any order.
+static const char* get_iupac_lookup() {
+  static const std::vector<char> lookup = [] {
+    std::vector<char> l(1 << NUM_BASE_SYMBOLS, 'N');
+    for (int m = 1; m < (1 << NUM_BASE_SYMBOLS); ++m) {
+      char n = 0;
+      for (int s = 0; s < NUM_BASE_SYMBOLS; ++s) {
+        if (m & (1 << s))
+          n = (n == 0) ? BASE_SYMBOLS[s] : gt2iupac(n, BASE_SYMBOLS[s]);
+      }
+      l[m] = n;
+    }
+    return l;
+  }();
 
-  if (seq_id.empty()) {
-    fout << ">Consensus_" << basename(o) << "_threshold_" << threshold << "_quality_" << (uint16_t) min_qual  <<std::endl;
-  } else {
-    fout << ">" << seq_id <<std::endl;
+  return lookup.data();
+}
+
+/*
+  Count the bases of one mpileup column the same way update_allele_depth() does. Returns false if
+  the column has an insertion or a base other than A, C, G, T, N and *, which need
+  get_consensus_allele().
+*/
+bool count_bases(char ref, const std::string &bases, const std::string &qualities, uint8_t min_qual, base_counts &counts) {
+  int ref_index = base_symbol_index(ref), s;
+  size_t i = 0, j, q_ind = 0, len = bases.length();
+  uint32_t n, d;
+  uint8_t q;
+  char c;
+
+  for (s = 0; s < NUM_BASE_SYMBOLS; ++s) {
+    counts.depth[s] = 0;
+    counts.mean_qual[s] = 0;
   }
+  counts.observed = false;
 
-  delete [] o;
+  while (i < len) {
+    c = bases[i];
 
-  int ctr = 0, mdepth = 0;
-  uint32_t prev_pos = 0, pos = 0;
-  std::stringstream lineStream;
+    if (c == '^') {
+      i += 2;
+      continue;
+    }
 
-  char ref;
-  std::string bases;
-  std::string qualities;
+    if (c == '$') {
+      i++;
+      continue;
+    }
 
-  std::vector<allele> ad;
-  uint32_t bases_zero_depth = 0, bases_min_depth = 0, total_bases = 0;
-
-  while (std::getline(cin, line)) {
-    lineStream << line;
-    ctr = 0;
-    ref = 'N';
-
-    while (std::getline(lineStream,cell,'\t')) {
-      switch(ctr) {
-        case 0:
-          break;
-        case 1:
-          pos = stoi(cell);
-          break;
-        case 2:
-          ref = cell[0];
-          break;
-        case 3:
-          mdepth = stoi(cell);
-          break;
-        case 4:
-          bases = cell;
-          break;
-        case 5:
-          qualities = cell;
-          break;
-        case 6:
-          break;
+    if (c == '+')
+      return false;
+
+    if (c == '-') {			// Deletions are dropped by the consensus but still count as an observation
+      for (j = i + 1, n = 0; j < len && isdigit(bases[j]); ++j) {
+        n = n * 10 + (bases[j] - '0');
       }
+      counts.observed = true;
+      i = j + n;
+      continue;
+    }
+
+    q = qualities[q_ind++] - 33;
+    i++;
+
+    if (c == '.' || c == ',') {
+      s = ref_index;
+    } else if (c == '*' || (c >= 'A' && c <= 'Z')) {
+      s = base_symbol_index(c);
+    } else if (c >= 'a' && c <= 'z') {
+      s = base_symbol_index(c - ('a' - 'A'));
+    } else {
+      s = NUM_BASE_SYMBOLS;		// Empty allele of update_allele_depth()
+    }
+
+    if (q < min_qual)
+      continue;
+
+    if (s < 0)
+      return false;
+
+    counts.observed = true;
+
+    if (s == NUM_BASE_SYMBOLS)
+      continue;
+
+    d = counts.depth[s];
+    counts.mean_qual[s] = (d == 0) ? q : (counts.mean_qual[s] * d + q)/(d + 1);
+    counts.depth[s] = d + 1;
+  }
+
+  return true;
+}
+
+/*
+  Consensus of a column counted by count_bases(). Gives the same base and quality as
+  get_consensus_allele() on the alleles of the column. Returns the number of bases written to nuc
+  and q, which is 0 if the consensus is a deletion.
+*/
+int get_consensus_base(const base_counts &counts, uint8_t min_qual, double threshold, char gap, char &nuc, char &q) {
+  int order[NUM_BASE_SYMBOLS], k = 0, i, j, mask;
+  uint32_t total_depth = 0, max_depth;
+  double mean_q, cur_threshold;
+  uint8_t ambg_n = 1;
+
+  // Alleles sorted by depth. Ties keep the symbol order.
+  for (i = 0; i < NUM_BASE_SYMBOLS; ++i) {
+    if (counts.depth[i] == 0)
+      continue;
+    total_depth += counts.depth[i];
+    for (j = k; j > 0 && counts.depth[order[j - 1]] < counts.depth[i]; --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+    k++;
+  }
+
+  if (k == 0) {
+    if (counts.observed)	// Only deletions or empty alleles
+      return 0;
+    nuc = gap;
+    q = min_qual + 33;
+    return 1;
+  }
+
+  cur_threshold = threshold * (double) total_depth;
+  mask = 1 << order[0];
+  max_depth = counts.depth[order[0]];
+  mean_q = (uint8_t) counts.mean_qual[order[0]];
+
+  for (i = 1; i < k && (max_depth < cur_threshold || counts.depth[order[i]] == counts.depth[order[i - 1]]); ++i) {
+    mask |= 1 << order[i];
+    mean_q = ((mean_q * ambg_n) + (uint8_t) counts.mean_qual[order[i]])/(ambg_n + 1);
+    ambg_n += 1;
+    max_depth += counts.depth[order[i]];
+  }
+
+  nuc = (max_depth < cur_threshold) ? 'N' : get_iupac_lookup()[mask];
+  if (nuc == '*')
+    return 0;
 
-      ctr++;
+  mean_q += 0.5;			// For rounding before converting to int
+  q = ((uint8_t) mean_q) + 33;
+
+  return 1;
+}
+
+/*
+  Append the consensus for one line of mpileup output to fout[i] and qout[i] for every setting.
+  The line is parsed and its alleles are counted once and shared by all settings. prev_pos is the
+  position of the previous line and is used to fill gaps.
+*/
+int call_consensus_from_line(const std::string &line, uint32_t &prev_pos, const std::vector<consensus_setting> &settings, std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, std::vector<consensus_stats> &stats, uint8_t min_qual, char gap, bool min_coverage_flag) {
+  std::string cell, bases, qualities;
+  std::stringstream lineStream(line);
+  int ctr = 0, mdepth = 0;
+  uint32_t pos = 0;
+  char ref = 'N';
+  std::vector<allele> ad;
+  bool counted = false, fast = false;
+  size_t i, j;
+
+  while (std::getline(lineStream,cell,'\t')) {
+    switch(ctr) {
+      case 0:
+        break;
+      case 1:
+        pos = stoi(cell);
+        break;
+      case 2:
+        ref = cell[0];
+        break;
+      case 3:
+        mdepth = stoi(cell);
+        break;
+      case 4:
+        bases = cell;
+        break;
+      case 5:
+        qualities = cell;
+        break;
+      case 6:
+        break;
     }
 
-    total_bases++;
+    ctr++;
+  }
+
+  if (prev_pos == 0)		// No -/N before alignment starts
+    prev_pos = pos;
 
-    if (prev_pos == 0)		// No -/N before alignment starts
-      prev_pos = pos;
+  std::vector<ret_t> t;
+  base_counts counts;
+  char nuc, q;
+  int len;
+
+  for (i = 0; i < settings.size(); ++i) {
+    stats[i].total_bases++;
 
     if ((pos > prev_pos && min_coverage_flag)) {
-      fout << std::string((pos - prev_pos) - 1, gap);
-      tmp_qout << std::string((pos - prev_pos) - 1, '!'); // ! represents 0 quality score.
+      *fout[i] << std::string((pos - prev_pos) - 1, gap);
+      *qout[i] << std::string((pos - prev_pos) - 1, '!'); // ! represents 0 quality score.
     }
 
-    ret_t t;
+    if (mdepth >= settings[i].min_depth) {
+      if (!counted) {
+        fast = count_bases(ref, bases, qualities, min_qual, counts);
+        if (!fast) {
+          ad = update_allele_depth(ref, bases, qualities, min_qual);
+          t.resize(settings.size());
+        }
+        counted = true;
+      }
 
-    if (mdepth >= min_depth) {
-      ad = update_allele_depth(ref, bases, qualities, min_qual);
-      t = get_consensus_allele(ad, min_qual, threshold, gap);
-      fout << t.nuc;
-      tmp_qout << t.q;
+      if (fast) {
+        len = get_consensus_base(counts, min_qual, settings[i].threshold, gap, nuc, q);
+        if (len > 0) {
+          fout[i]->put(nuc);
+          qout[i]->put(q);
+        }
+        continue;
+      }
+
+      // Settings that only differ in depth share the consensus allele
+      for (j = 0; j < i && !(settings[j].threshold == settings[i].threshold && mdepth >= settings[j].min_depth); ++j);
+      t[i] = (j < i) ? t[j] : get_consensus_allele(ad, min_qual, settings[i].threshold, gap);
+
+      *fout[i] << t[i].nuc;
+      *qout[i] << t[i].q;
     } else {
-      bases_min_depth += 1;
+      stats[i].bases_min_depth += 1;
 
       if (mdepth == 0)
-        bases_zero_depth += 1;
+        stats[i].bases_zero_depth += 1;
 
       if (min_coverage_flag) {
-        fout << gap;
-        tmp_qout << '!';
+        *fout[i] << gap;
+        *qout[i] << '!';
       }
     }
+  }
 
-    lineStream.clear();
-    ad.clear();
-    prev_pos = pos;
+  prev_pos = pos;
+
+  return 0;
+}
+
+// Append the consensus for one line of mpileup output to fout and qout. prev_pos is the position of the previous line and is used to fill gaps.
+int call_consensus_from_line(const std::string &line, uint32_t &prev_pos, std::ostream &fout, std::ostream &qout, consensus_stats &stats, uint8_t min_qual, double threshold, uint8_t min_depth, char gap, bool min_coverage_flag) {
+  std::vector<consensus_setting> settings(1, consensus_setting(threshold, min_depth));
+  std::vector<std::ostream*> fouts(1, &fout), qouts(1, &qout);
+  std::vector<consensus_stats> all_stats(1, stats);
+
+  call_consensus_from_line(line, prev_pos, settings, fouts, qouts, all_stats, min_qual, gap, min_coverage_flag);
+  stats = all_stats[0];
+
+  return 0;
+}
+
+// Position in the last line of a block of mpileup lines. Used to carry gap filling across blocks.
+uint32_t get_last_pos(const std::string &block) {
+  size_t end = block.find_last_not_of('\n');
+  if (end == std::string::npos)
+    return 0;
+
+  size_t start = block.rfind('\n', end);
+  start = (start == std::string::npos) ? 0 : start + 1;
+
+  std::stringstream lineStream(block.substr(start, end - start + 1));
+  std::string cell;
+  if (!std::getline(lineStream, cell, '\t') || !std::getline(lineStream, cell, '\t'))
+    return 0;
+
+  return stoi(cell);
+}
+
+consensus_records::consensus_records(std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, const std::vector<std::string> &headers) : fout(fout), qout(qout), headers(headers), first_seq(headers.size()), first_qual(headers.size()), nrecords(0) {}
+
+// Start a new record unless region is the reference of the current one
+void consensus_records::start(const std::string &region) {
+  if (nrecords > 0 && region == cur_region)
+    return;
+
+  size_t i;
+  for (i = 0; i < headers.size() && nrecords > 0; ++i) {
+    if (nrecords == 1) {
+      *fout[i] << headers[i] << "_" << cur_region << "\n" << first_seq[i];
+      *qout[i] << first_qual[i];
+      first_seq[i].clear();
+      first_qual[i].clear();
+    }
+    *fout[i] << "\n";
+    *qout[i] << "\n";
+    *fout[i] << headers[i] << "_" << region << "\n";
+  }
+
+  cur_region = region;
+  nrecords++;
+}
+
+void consensus_records::append(size_t i, const std::string &seq, const std::string &qual) {
+  if (nrecords > 1) {
+    *fout[i] << seq;
+    *qout[i] << qual;
+  } else {
+    first_seq[i] += seq;
+    first_qual[i] += qual;
+  }
+}
+
+void consensus_records::finish() {
+  for (size_t i = 0; i < headers.size(); ++i) {
+    if (nrecords <= 1)
+      *fout[i] << headers[i] << "\n" << first_seq[i];
+    *fout[i] << "\n";			// Add new line character after end of sequence
+    *qout[i] << first_qual[i] << "\n";
+  }
+}
+
+consensus_builder::consensus_builder(consensus_records &records, const std::vector<consensus_setting> &settings, std::vector<consensus_stats> &stats, uint8_t min_qual, char gap, bool min_coverage_flag) : records(records), settings(settings), stats(stats), min_qual(min_qual), gap(gap), min_coverage_flag(min_coverage_flag), prev_pos(0), seq(settings.size()), qual(settings.size()) {
+  this->stats.resize(settings.size());
+}
+
+// Same steps as call_consensus_from_line() with the alleles already counted
+void consensus_builder::add(const std::string &region, int64_t pos, uint32_t depth, const std::vector<allele> &ad) {
+  std::vector<ret_t> t(settings.size());
+  size_t i, j;
+
+  if (region != cur_region) {
+    flush();
+    records.start(region);
+    cur_region = region;
+    prev_pos = pos;		// No -/N before alignment starts
+  }
+
+  for (i = 0; i < settings.size(); ++i) {
+    stats[i].total_bases++;
+
+    if (pos > prev_pos && min_coverage_flag) {
+      seq[i].append((pos - prev_pos) - 1, gap);
+      qual[i].append((pos - prev_pos) - 1, '!');
+    }
+
+    if (depth >= settings[i].min_depth) {
+      for (j = 0; j < i && !(settings[j].threshold == settings[i].threshold && depth >= settings[j].min_depth); ++j);
+      t[i] = (j < i) ? t[j] : get_consensus_allele(ad, min_qual, settings[i].threshold, gap);
+      seq[i] += t[i].nuc;
+      qual[i] += t[i].q;
+    } else {
+      stats[i].bases_min_depth += 1;
+
+      if (depth == 0)
+        stats[i].bases_zero_depth += 1;
+
+      if (min_coverage_flag) {
+        seq[i] += gap;
+        qual[i] += '!';
+      }
+    }
+  }
+
+  prev_pos = pos;
+
+  if (!seq.empty() && seq[0].size() >= LINE_BLOCK_SIZE)
+    flush();
+}
+
+void consensus_builder::flush() {
+  for (size_t i = 0; i < settings.size(); ++i) {
+    if (!seq[i].empty() || !qual[i].empty())
+      records.append(i, seq[i], qual[i]);
+    seq[i].clear();
+    qual[i].clear();
+  }
+}
+
+void consensus_builder::finish() {
+  flush();
+  records.finish();
+}
+
+/*
+  Reader cuts the pileup into line aligned segments of at most one block that never span two
+  references. Segments are called independently, by the pool with more than one thread, and
+  start from the position of the last line of the segment before them on the same reference so
+  gaps are filled the same way as with one thread. Gap filling starts over on every reference.
+  Segments and their counts are merged in input order.
+*/
+int call_consensus_segments(std::istream &cin, const std::vector<consensus_setting> &settings, consensus_records &records, std::vector<consensus_stats> &stats, uint8_t min_qual, char gap, bool min_coverage_flag, unsigned int nthreads) {
+  std::unique_ptr<ordered_pool> pool((nthreads > 1) ? new ordered_pool(nthreads) : NULL);
+  std::string block, carry, seg_region, prev_region;
+  uint32_t prev_pos = 0;
+  size_t n = settings.size(), start, end, tab, seg_start;
+
+  auto submit = [&](size_t seg_end) {
+    std::shared_ptr<std::string> seg(new std::string(block, seg_start, seg_end - seg_start));
+    std::shared_ptr<std::vector<std::ostringstream> > seq_out(new std::vector<std::ostringstream>(n)), qual_out(new std::vector<std::ostringstream>(n));
+    std::shared_ptr<std::vector<consensus_stats> > seg_stats(new std::vector<consensus_stats>(n));
+    std::string region = seg_region;
+    uint32_t seg_prev_pos = (seg_region == prev_region) ? prev_pos : 0;
+    prev_region = seg_region;
+    prev_pos = get_last_pos(*seg);
+
+    std::function<void(unsigned int)> work = [=, &settings](unsigned int) {
+      std::vector<std::ostream*> seg_fout, seg_qout;
+      for (size_t i = 0; i < n; ++i) {
+        seg_fout.push_back(&seq_out->at(i));
+        seg_qout.push_back(&qual_out->at(i));
+      }
+      uint32_t p = seg_prev_pos;
+      size_t s = 0, e;
+      while ((e = seg->find('\n', s)) != std::string::npos) {
+        call_consensus_from_line(seg->substr(s, e - s), p, settings, seg_fout, seg_qout, *seg_stats, min_qual, gap, min_coverage_flag);
+        s = e + 1;
+      }
+      seg->clear();
+    };
+    std::function<void()> emit = [=, &records, &stats]() {
+      records.start(region);
+      for (size_t i = 0; i < n; ++i) {
+        records.append(i, seq_out->at(i).str(), qual_out->at(i).str());
+        stats[i].total_bases += seg_stats->at(i).total_bases;
+        stats[i].bases_zero_depth += seg_stats->at(i).bases_zero_depth;
+        stats[i].bases_min_depth += seg_stats->at(i).bases_min_depth;
+      }
+    };
+
+    if (pool) {
+      pool->submit(work, emit);
+    } else {
+      work(0);
+      emit();
+    }
+  };
+
+  while (read_line_block(cin, block, carry)) {
+    start = 0;
+    seg_start = 0;
+    while ((end = block.find('\n', start)) != std::string::npos) {
+      tab = block.find('\t', start);
+      tab = (tab == std::string::npos || tab > end) ? end : tab;
+      if (end > start && (start == seg_start || block.compare(start, tab - start, seg_region) != 0)) {
+        if (start > seg_start)
+          submit(start);
+        seg_start = start;
+        seg_region.assign(block, start, tab - start);
+      }
+      start = end + 1;
+    }
+    if (start > seg_start)
+      submit(start);
   }
-  fout << "\n";			// Add new line character after end of sequence
-  tmp_qout << "\n";
-  tmp_qout.close();
-  fout.close();
-
-  std::cout << "Reference length: " << total_bases << std::endl;
-  std::cout << "Positions with 0 depth: " << bases_zero_depth << std::endl;
-  std::cout << "Positions with depth below " <<(unsigned) min_depth << ": " << bases_min_depth << std::endl;
-  
+
+  if (pool)
+    pool->finish();
+
   return 0;
 }
+
+// Output prefix of one setting. With more than one setting the threshold and depth are added to out_file.
+std::string get_consensus_out_file(std::string out_file, consensus_setting setting, bool multiple) {
+  if (!multiple)
+    return out_file;
+
+  std::ostringstream name;
+  name << out_file << "_t" << setting.threshold << "_m" << (unsigned) setting.min_depth;
+
+  return name.str();
+}
+
+// FASTA header of one setting. Defaults to Consensus_<basename of out_file>_threshold_<threshold>_quality_<min_qual>.
+std::string get_consensus_header(std::string seq_id, std::string out_file, consensus_setting setting, uint8_t min_qual) {
+  if (!seq_id.empty())
+    return ">" + seq_id;
+
+  char *o = new char[out_file.length() + 1];
+  strcpy(o, out_file.c_str());
+
+  std::ostringstream header;
+  header << ">Consensus_" << basename(o) << "_threshold_" << setting.threshold << "_quality_" << (uint16_t) min_qual;
+  delete [] o;
+
+  return header.str();
+}
+
+/*
+  Call the consensus for every setting in one pass over the pileup and write it to the streams of
+  that setting in fout and qout, with the record header in headers. Counts of every setting are
+  added to stats.
+*/
+int call_consensus_from_plup(std::istream &cin, std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, const std::vector<std::string> &headers, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, std::vector<consensus_stats> &stats, unsigned int nthreads) {
+  consensus_records records(fout, qout, headers);
+
+  stats.resize(settings.size());
+  call_consensus_segments(cin, settings, records, stats, min_qual, gap, min_coverage_flag, nthreads);
+  records.finish();
+
+  return 0;
+}
+
+/*
+  Call the consensus for every combination of threshold and minimum depth in settings in one pass
+  over the pileup. Each setting is written to its own FASTA and quality file with one record, and
+  one line of qualities, per reference in the order of the pileup. Counts of every setting are
+  returned in stats.
+*/
+int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, std::vector<consensus_stats> &stats, unsigned int nthreads) {
+  size_t n = settings.size(), i;
+  std::vector<std::unique_ptr<buffered_ofstream> > files;
+  std::vector<std::ostream*> fout, tmp_qout;
+  std::vector<std::string> out_files, headers;
+
+  for (i = 0; i < n; ++i) {
+    out_files.push_back(get_consensus_out_file(out_file, settings[i], n > 1));
+    files.push_back(std::unique_ptr<buffered_ofstream>(new buffered_ofstream(out_files[i]+".fa")));
+    fout.push_back(files.back().get());
+    files.push_back(std::unique_ptr<buffered_ofstream>(new buffered_ofstream(out_files[i]+".qual.txt")));
+    tmp_qout.push_back(files.back().get());
+
+    headers.push_back(get_consensus_header(seq_id, out_files[i], settings[i], min_qual));
+  }
+
+  stats.assign(n, consensus_stats());
+  call_consensus_from_plup(cin, fout, tmp_qout, headers, min_qual, settings, gap, min_coverage_flag, stats, nthreads);
+
+  for (i = 0; i < files.size(); ++i) {
+    files[i]->close();
+  }
+
+  for (i = 0; i < n; ++i) {
+    if (n > 1)
+      std::cout << "Consensus " << out_files[i] << ".fa" << std::endl;
+    std::cout << "Reference length: " << stats[i].total_bases << std::endl;
+    std::cout << "Positions with 0 depth: " << stats[i].bases_zero_depth << std::endl;
+    std::cout << "Positions with depth below " <<(unsigned) settings[i].min_depth << ": " << stats[i].bases_min_depth << std::endl;
+  }
+
+  return 0;
+}
+
+int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, unsigned int nthreads) {
+  std::vector<consensus_stats> stats;
+
+  return call_consensus_from_plup(cin, seq_id, out_file, min_qual, settings, gap, min_coverage_flag, stats, nthreads);
+}
+
+int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, double threshold, uint8_t min_depth, char gap, bool min_coverage_flag, unsigned int nthreads) {
+  std::vector<consensus_setting> settings(1, consensus_setting(threshold, min_depth));
+
+  return call_consensus_from_plup(cin, seq_id, out_file, min_qual, settings, gap, min_coverage_flag, nthreads);
+}
@@ -7,19 +7,102 @@
 #include<string>
 #include<regex>
 #include<libgen.h>
+#include<cstring>
+#include<memory>
 
 #include "allele_functions.h"
+#include "ordered_pool.h"
+#include "buffered_writer.h"
 
-#ifndef call_consensus_from_pileup
-#define call_consensus_from_pileup
+#ifndef IVAR_CALL_CONSENSUS_PILEUP_H
+#define IVAR_CALL_CONSENSUS_PILEUP_H
 
 struct ret_t {
   std::string nuc;
   std::string q;
 };
 
+struct consensus_stats {
+  uint32_t total_bases, bases_zero_depth, bases_min_depth;
+  consensus_stats() : total_bases(0), bases_zero_depth(0), bases_min_depth(0) {}
+};
+
+// Frequency threshold and minimum depth of one consensus sequence
+struct consensus_setting {
+  double threshold;
+  uint8_t min_depth;
+  consensus_setting(double threshold, uint8_t min_depth) : threshold(threshold), min_depth(min_depth) {}
+};
+
+const int NUM_BASE_SYMBOLS = 6;
+// Symbols of base_counts in the order update_allele_depth() sorts them
+const char BASE_SYMBOLS[NUM_BASE_SYMBOLS] = {'T', 'N', 'G', 'C', 'A', '*'};
+
+// Depth and mean quality of A, C, G, T, N and * in one mpileup column
+struct base_counts {
+  uint32_t depth[NUM_BASE_SYMBOLS];
+  float mean_qual[NUM_BASE_SYMBOLS];
+  bool observed;		// Any observation above the minimum quality, including deletions
+};
+
+/*
+  Records of a consensus run, one per reference. The first record is held in memory until a second
+  reference shows up or the output is finished. Output with one reference keeps the plain header
+  and with several references the name of the reference is added to every header.
+*/
+class consensus_records {
+public:
+  consensus_records(std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, const std::vector<std::string> &headers);
+  void start(const std::string &region);
+  void append(size_t i, const std::string &seq, const std::string &qual);
+  void finish();
+
+private:
+  std::vector<std::ostream*> &fout, &qout;
+  std::vector<std::string> headers;
+  std::vector<std::string> first_seq, first_qual;
+  std::string cur_region;
+  size_t nrecords;
+};
+
+/*
+  Consensus of allele counts given one position at a time, as they come from a pileup callback.
+  Gives the same records and counts as call_consensus_from_plup on the mpileup text of the same
+  reads. Positions of a reference have to be added in order.
+*/
+class consensus_builder {
+public:
+  consensus_builder(consensus_records &records, const std::vector<consensus_setting> &settings, std::vector<consensus_stats> &stats, uint8_t min_qual, char gap, bool min_coverage_flag);
+  void add(const std::string &region, int64_t pos, uint32_t depth, const std::vector<allele> &ad);
+  void finish();
+
+private:
+  void flush();
+
+  consensus_records &records;
+  std::vector<consensus_setting> settings;
+  std::vector<consensus_stats> &stats;
+  uint8_t min_qual;
+  char gap;
+  bool min_coverage_flag;
+  std::string cur_region;
+  int64_t prev_pos;
+  std::vector<std::string> seq, qual;
+};
+
 void format_alleles(std::vector<allele> &ad);
-int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, double threshold, uint8_t min_depth, char gap, bool min_coverage_flag);
+int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, double threshold, uint8_t min_depth, char gap, bool min_coverage_flag, unsigned int nthreads = 1);
+int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, unsigned int nthreads = 1);
+int call_consensus_from_plup(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, std::vector<consensus_stats> &stats, unsigned int nthreads = 1);
+int call_consensus_from_plup(std::istream &cin, std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, const std::vector<std::string> &headers, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, std::vector<consensus_stats> &stats, unsigned int nthreads = 1);
+int call_consensus_segments(std::istream &cin, const std::vector<consensus_setting> &settings, consensus_records &records, std::vector<consensus_stats> &stats, uint8_t min_qual, char gap, bool min_coverage_flag, unsigned int nthreads);
+int call_consensus_from_line(const std::string &line, uint32_t &prev_pos, std::ostream &fout, std::ostream &qout, consensus_stats &stats, uint8_t min_qual, double threshold, uint8_t min_depth, char gap, bool min_coverage_flag);
+int call_consensus_from_line(const std::string &line, uint32_t &prev_pos, const std::vector<consensus_setting> &settings, std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, std::vector<consensus_stats> &stats, uint8_t min_qual, char gap, bool min_coverage_flag);
+std::string get_consensus_out_file(std::string out_file, consensus_setting setting, bool multiple);
+std::string get_consensus_header(std::string seq_id, std::string out_file, consensus_setting setting, uint8_t min_qual);
 ret_t get_consensus_allele(std::vector<allele> ad, uint8_t min_qual, double threshold, char gap);
+int base_symbol_index(char c);
+bool count_bases(char ref, const std::string &bases, const std::string &qualities, uint8_t min_qual, base_counts &counts);
+int get_consensus_base(const base_counts &counts, uint8_t min_qual, double threshold, char gap, char &nuc, char &q);
 
 #endif
@@ -2,6 +2,9 @@
 
 const float sig_level = 0.01;
 
+// Tabix index of bgzipped variants on REGION and POS, skipping the header row
+const tbx_conf_t variants_tbx_conf = {TBX_GENERIC, 1, 2, 2, '#', 1};
+
 std::vector<allele>::iterator get_ref_allele(std::vector<allele> &ad, char ref) {
   for (std::vector<allele>::iterator it = ad.begin(); it != ad.end(); ++it) {
     if (it->nuc[0] == ref)
@@ -28,12 +31,7 @@ double* get_frequency_depth(allele a, uint32_t pos_depth, uint32_t total_depth)
   return val;
 }
 
-int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, std::string ref_path, std::string gff_path) {
-  std::string line, cell, bases, qualities, region;
-  ref_antd refantd(ref_path, gff_path);
-  std::ostringstream out_str;
-  std::ofstream fout((out_file+".tsv").c_str());
-
+void print_variants_header(std::ostream &fout) {
   fout << "REGION"
     "\tPOS"
     "\tREF"
@@ -53,137 +51,327 @@ int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min
     "\tREF_AA"
     "\tALT_CODON"
     "\tALT_AA"
-    << std::endl;
+    "\n";
+}
 
-  int ctr = 0;
-  int64_t pos = 0;
-  uint32_t mdepth = 0, pdepth = 0; // mpdepth for mpileup depth and pdeth for ungapped depth at position
+tsv_variants::tsv_variants(std::ostream &out, ref_antd &refantd) : out(out), refantd(refantd) {}
+
+int tsv_variants::write(const variant_record &v) {
+  row.str("");
+  row.clear();
+  row << v.region << "\t";
+  row << v.pos << "\t";
+  row << v.ref << "\t";
+  row << v.alt << "\t";
+  row << v.ref_dp << "\t";
+  row << v.ref_rv << "\t";
+  row << (uint16_t) v.ref_qual << "\t";
+  row << v.alt_dp << "\t";
+  row << v.alt_rv << "\t";
+  row << (uint16_t) v.alt_qual << "\t";
+  row << v.freq << "\t";
+  row << (double) v.total_dp << "\t";	// Printed as a double, as the tsv always has been
+  row << v.pval << "\t";
+  row << (v.pass ? "TRUE" : "FALSE") << "\t";
+
+  if (v.alt[0] != '+' && v.alt[0] != '-') {
+    refantd.codon_aa_stream(regions.get_region_id(refantd, v.region), v.region, row, out, v.pos, v.alt[0]);
+  } else {
+    out << row.str() << "NA\tNA\tNA\tNA\tNA\n";
+  }
+
+  return 0;
+}
 
+// Write the variants among the alleles ad observed at a position to out.
+int call_variants_from_alleles(const std::string &region, int64_t pos, char ref, uint32_t mdepth, std::vector<allele> &ad, variant_sink &out, double min_threshold, uint8_t min_depth) {
+  uint32_t pdepth = 0; // pdeth for ungapped depth at position
   double pval_left, pval_right, pval_twotailed, *freq_depth, err;
-  std::stringstream line_stream;
-  char ref;
-  std::vector<allele> ad;
   std::vector<allele>::iterator ref_it;
+  variant_record v;
+  int res = 0;
 
-  while (std::getline(cin, line)) {
-    line_stream << line;
-    ctr = 0;
-    ref = 'N';
-
-    while (std::getline(line_stream,cell,'\t')) {
-      switch(ctr) {
-        case 0:
-          region = cell;
-          break;
-        case 1:
-          pos = stoi(cell);
-          break;
-        case 2:
-          ref = refantd.get_base(pos, region);
-          ref = (ref == 0) ? cell[0] : ref; // If ref does not exist then use from mpileup
-          break;
-        case 3:
-          mdepth = stoi(cell);
-          break;
-        case 4:
-          bases = cell;
-          break;
-        case 5:
-          qualities = cell;
-          break;
-        case 6:
-          break;
-      }
-
-      ctr++;
-    }
+  if (ad.size() == 0)
+    return 0;
 
-    ad = update_allele_depth(ref, bases, qualities, min_qual);
-    if (ad.size() == 0) {
-      line_stream.clear();
+  // Get ungapped depth
+  for (std::vector<allele>::iterator it = ad.begin(); it != ad.end(); ++it) {
+    if (it->nuc[0]=='*' || it->nuc[0] == '+' || it->nuc[0] == '-')
       continue;
-    }
 
-    // Get ungapped depth
-    pdepth = 0;
+    pdepth += it->depth;
+  }
 
-    for (std::vector<allele>::iterator it = ad.begin(); it != ad.end(); ++it) {
-      if (it->nuc[0]=='*' || it->nuc[0] == '+' || it->nuc[0] == '-')
-        continue;
+  if (pdepth < min_depth)	// Check for minimum depth
+    return 0;
+
+  ref_it = get_ref_allele(ad, ref);
+  if (ref_it == ad.end()) {	// If ref not present in reads.
+    allele a;
+    a.nuc = ref;
+    a.depth = 0;
+    a.reverse = 0;
+    a.mean_qual = 0;
+    ad.push_back(a);
+    ref_it = ad.end() - 1;
+  }
 
-      pdepth += it->depth;
-    }
+  v.region = region;
+  v.pos = pos;
+  v.ref = ref;
+  v.ref_dp = ref_it->depth;
+  v.ref_rv = ref_it->reverse;
+  v.ref_qual = ref_it->mean_qual;
 
-    if (pdepth < min_depth) {	// Check for minimum depth
-      line_stream.clear();
+  for (std::vector<allele>::iterator it = ad.begin(); it != ad.end(); ++it) {
+    if ((*it == *ref_it) || it->nuc[0]=='*')
+      continue;
+
+    freq_depth = get_frequency_depth(*it, pdepth, mdepth);
+
+    if (freq_depth[0] < min_threshold) {
+      delete[] freq_depth;
       continue;
     }
 
-    ref_it = get_ref_allele(ad, ref);
-    if (ref_it == ad.end()) {	// If ref not present in reads.
-      allele a;
-      a.nuc = ref;
-      a.depth = 0;
-      a.reverse = 0;
-      a.mean_qual = 0;
-      ad.push_back(a);
-      ref_it = ad.end() - 1;
+    v.alt = it->nuc;
+    v.alt_dp = it->depth;
+    v.alt_rv = it->reverse;
+    v.alt_qual = it->mean_qual;
+    v.freq = freq_depth[0];
+    v.total_dp = (uint32_t) freq_depth[1];
+
+    /*
+          | Var   | Ref      |
+      Exp | Error | Err free |
+      Obs | AD    | RD       |
+     */
+
+    err = pow(10, ( -1 * (it->mean_qual)/10));
+    kt_fisher_exact((err * mdepth), (1-err) * mdepth, it->depth, ref_it->depth, &pval_left, &pval_right, &pval_twotailed);
+    v.pval = pval_left;
+    v.pass = (pval_left <= sig_level);
+
+    if (out.write(v) != 0)
+      res = -1;
+
+    delete[] freq_depth;
+  }
+
+  return res;
+}
+
+// Call variants at the position described by one line of mpileup output and write them to fout.
+// regions keeps the id of the region of the previous line.
+int call_variants_from_line(const std::string &line, ref_antd &refantd, region_cache &regions, variant_sink &out, uint8_t min_qual, double min_threshold, uint8_t min_depth) {
+  std::string cell, bases, qualities, region;
+  std::stringstream line_stream(line);
+
+  int ctr = 0;
+  int64_t pos = 0;
+  uint32_t mdepth = 0; // mpdepth for mpileup depth
+  char ref = 'N';
+  std::vector<allele> ad;
+
+  while (std::getline(line_stream,cell,'\t')) {
+    switch(ctr) {
+      case 0:
+        region = cell;
+        break;
+      case 1:
+        pos = stoi(cell);
+        break;
+      case 2:
+        ref = refantd.get_base(pos, regions.get_region_id(refantd, region));
+        ref = (ref == 0) ? cell[0] : ref; // If ref does not exist then use from mpileup
+        break;
+      case 3:
+        mdepth = stoi(cell);
+        break;
+      case 4:
+        bases = cell;
+        break;
+      case 5:
+        qualities = cell;
+        break;
+      case 6:
+        break;
     }
 
-    for (std::vector<allele>::iterator it = ad.begin(); it != ad.end(); ++it) {
-      if ((*it == *ref_it) || it->nuc[0]=='*')
-        continue;
-
-      freq_depth = get_frequency_depth(*it, pdepth, mdepth);
-
-      if (freq_depth[0] < min_threshold)
-        continue;
-
-      out_str << region << "\t";
-      out_str << pos << "\t";
-      out_str << ref << "\t";
-      out_str << it->nuc << "\t";
-      out_str << ref_it->depth << "\t";
-      out_str << ref_it->reverse << "\t";
-      out_str << (uint16_t)ref_it->mean_qual << "\t";
-      out_str << it->depth << "\t";
-      out_str << it->reverse << "\t";
-      out_str << (uint16_t) it->mean_qual << "\t";
-      out_str << freq_depth[0] << "\t";
-      out_str << freq_depth[1] << "\t";
-
-      /*
-            | Var   | Ref      |
-        Exp | Error | Err free |
-        Obs | AD    | RD       |
-       */
-
-      err = pow(10, ( -1 * (it->mean_qual)/10));
-      kt_fisher_exact((err * mdepth), (1-err) * mdepth, it->depth, ref_it->depth, &pval_left, &pval_right, &pval_twotailed);
-      out_str << pval_left << "\t";
-      
-      if (pval_left <= sig_level) {
-        out_str << "TRUE" << "\t";
-      } else {
-        out_str << "FALSE" << "\t";
-      }
-
-      if (it->nuc[0] != '+' && it->nuc[0] != '-') {
-        refantd.codon_aa_stream(region, out_str, fout, pos, it->nuc[0]);
-      } else {
-        fout << out_str.str() << "NA\tNA\tNA\tNA\tNA" << std::endl;
-      }
-
-      out_str.str("");
-      out_str.clear();
+    ctr++;
+  }
 
-      delete[] freq_depth;
+  ad = update_allele_depth(ref, bases, qualities, min_qual);
+
+  return call_variants_from_alleles(region, pos, ref, mdepth, ad, out, min_threshold, min_depth);
+}
+
+/*
+  Reader cuts the pileup into line aligned blocks and the pool calls variants on each block. The
+  reference is only read after loading so all workers share it. Blocks are written out in input
+  order so the output matches a run with one thread.
+*/
+int call_variants_parallel(std::istream &cin, variant_sink &out, uint8_t min_qual, double min_threshold, uint8_t min_depth, ref_antd &refantd, unsigned int nthreads) {
+  ordered_pool pool(nthreads);
+  std::string carry;
+
+  while (true) {
+    std::shared_ptr<std::string> block(new std::string);
+    if (!read_line_block(cin, *block, carry))
+      break;
+
+    std::shared_ptr<variant_buffer> variants(new variant_buffer);
+    pool.submit([block, variants, &refantd, min_qual, min_threshold, min_depth](unsigned int) {
+        size_t start = 0, end;
+        region_cache regions;
+        while ((end = block->find('\n', start)) != std::string::npos) {
+          call_variants_from_line(block->substr(start, end - start), refantd, regions, *variants, min_qual, min_threshold, min_depth);
+          start = end + 1;
+        }
+        block->clear();
+      }, [variants, &out]() {
+        variants->write_to(out);
+      });
+  }
+
+  pool.finish();
+
+  return 0;
+}
+
+bool output_format_needs_ref(char out_format) {
+  return out_format == VCF_OUTPUT || out_format == BCF_OUTPUT;
+}
+
+variant_sink* variants_output::open(std::string out_file, char out_format, ref_antd &refantd, unsigned int nthreads) {
+  this->format = out_format;
+
+  if (out_format == VCF_OUTPUT || out_format == BCF_OUTPUT) {
+    fname = out_file + ((out_format == VCF_OUTPUT) ? ".vcf.gz" : ".bcf");
+    std::string sample_name = out_file.substr(out_file.find_last_of('/') + 1);
+    if (vcf.init(out_format, fname, sample_name, refantd) != 0)
+      return NULL;
+    return &vcf;
+  }
+
+  if (out_format == TSV_GZ_OUTPUT) {
+    fname = out_file + ".tsv.gz";
+    if (tsv_gz.open(fname, nthreads) != 0) {
+      std::cout << "Unable to write " << fname << std::endl;
+      return NULL;
     }
+    print_variants_header(tsv_gz);
+    rows.reset(new tsv_variants(tsv_gz, refantd));
+    return rows.get();
+  }
+
+  fname = out_file + ".tsv";
+  tsv.open(fname);
+  print_variants_header(tsv);
+  rows.reset(new tsv_variants(tsv, refantd));
+
+  return rows.get();
+}
+
+int variants_output::close() {
+  if (format == VCF_OUTPUT || format == BCF_OUTPUT)
+    return vcf.close();
+
+  if (format != TSV_GZ_OUTPUT) {
+    tsv.close();
+    return 0;
+  }
+
+  if (tsv_gz.close() != 0) {
+    std::cout << "Unable to write " << fname << std::endl;
+    return -1;
+  }
+
+  if (tbx_index_build(fname.c_str(), 0, &variants_tbx_conf) != 0) {
+    std::cout << "Unable to build index for " << fname << std::endl;
+    return -1;
+  }
+
+  return 0;
+}
 
-    line_stream.clear();
+// Call variants from mpileup text in cin and write them to out
+int call_variants_from_plup(std::istream &cin, variant_sink &out, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, unsigned int nthreads) {
+  if (nthreads > 1)
+    return call_variants_parallel(cin, out, min_qual, min_threshold, min_depth, refantd, nthreads);
+
+  std::string line;
+  region_cache regions;
+
+  while (std::getline(cin, line)) {
+    call_variants_from_line(line, refantd, regions, out, min_qual, min_threshold, min_depth);
   }
 
-  fout.close();
-  
   return 0;
 }
+
+// Call variants from mpileup text in cin and write the rows, without a header, to fout
+int call_variants_from_plup(std::istream &cin, std::ostream &fout, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, unsigned int nthreads) {
+  tsv_variants rows(fout, refantd);
+
+  return call_variants_from_plup(cin, rows, refantd, min_qual, min_threshold, min_depth, nthreads);
+}
+
+// Call variants from mpileup text in cin and write them to <out_file> in out_format
+int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, ref_antd &refantd, unsigned int nthreads, char out_format) {
+  variants_output output;
+  variant_sink *out = output.open(out_file, out_format, refantd, nthreads);
+
+  if (out == NULL)
+    return -1;
+
+  call_variants_from_plup(cin, *out, refantd, min_qual, min_threshold, min_depth, nthreads);
+
+  return output.close();
+}
+
+int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, std::string ref_path, std::string gff_path, unsigned int nthreads, char out_format) {
+  ref_antd refantd(ref_path, gff_path);
+
+  return call_variants_from_plup(cin, out_file, min_qual, min_threshold, min_depth, refantd, nthreads, out_format);
+}
+
+// Call variants from the reads in a BAM file and write them to out
+int call_variants_from_bam(std::string bam, variant_sink &out, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, pileup_opts opts, unsigned int nthreads) {
+  return pileup_bam(bam, opts, min_qual, refantd, nthreads, [min_threshold, min_depth](unsigned int, const std::string &region, int64_t pos, char ref, uint32_t depth, std::vector<allele> &ad, variant_sink &out) {
+      call_variants_from_alleles(region, pos, ref, depth, ad, out, min_threshold, min_depth);
+    }, out);
+}
+
+// Call variants from the reads in a BAM file and write the rows, without a header, to fout
+int call_variants_from_bam(std::string bam, std::ostream &fout, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, pileup_opts opts, unsigned int nthreads) {
+  tsv_variants rows(fout, refantd);
+
+  return call_variants_from_bam(bam, rows, refantd, min_qual, min_threshold, min_depth, opts, nthreads);
+}
+
+/*
+  Call variants from the reads in a BAM file instead of mpileup text. Output is the same as
+  piping `samtools mpileup -aa -A -d 0 -B -Q 0 --reference <ref.fa>` into call_variants_from_plup.
+*/
+int call_variants_from_bam(std::string bam, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, ref_antd &refantd, pileup_opts opts, unsigned int nthreads, char out_format) {
+  variants_output output;
+  variant_sink *out = output.open(out_file, out_format, refantd, nthreads);
+  int res;
+
+  if (out == NULL)
+    return -1;
+
+  res = call_variants_from_bam(bam, *out, refantd, min_qual, min_threshold, min_depth, opts, nthreads);
+
+  if (output.close() != 0)
+    return -1;
+
+  return res;
+}
+
+int call_variants_from_bam(std::string bam, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, std::string ref_path, std::string gff_path, pileup_opts opts, unsigned int nthreads, char out_format) {
+  ref_antd refantd(ref_path, gff_path);
+
+  return call_variants_from_bam(bam, out_file, min_qual, min_threshold, min_depth, refantd, opts, nthreads, out_format);
+}
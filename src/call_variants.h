@@ -7,15 +7,74 @@
 #include <string>
 #include <regex>
 #include <cmath>
+#include <memory>
 #include <htslib/kfunc.h>
+#include <htslib/tbx.h>
 
 #include "allele_functions.h"
 #include "ref_seq.h"
+#include "ordered_pool.h"
+#include "bam_pileup.h"
+#include "variant_sink.h"
+#include "vcf_writer.h"
+#include "bgzf_stream.h"
+#include "buffered_writer.h"
 
-#ifndef call_variants
-#define call_variants
+#ifndef IVAR_CALL_VARIANTS_H
+#define IVAR_CALL_VARIANTS_H
 
-int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, std::string ref_path, std::string gff_path);
+// Output formats of ivar variants. VCF and BCF use the htslib mode letter.
+const char TSV_OUTPUT = 't';
+const char TSV_GZ_OUTPUT = 'g';
+const char VCF_OUTPUT = 'z';
+const char BCF_OUTPUT = 'b';
+
+// VCF and BCF list the contigs of the reference in their header, tsv and bgzipped tsv need no reference
+bool output_format_needs_ref(char out_format);
+
+// Rows of the variants tsv. Variants in a CDS get one row per CDS with the codon of the feature.
+class tsv_variants : public variant_sink {
+public:
+  tsv_variants(std::ostream &out, ref_antd &refantd);
+  int write(const variant_record &v);
+
+private:
+  std::ostream &out;
+  ref_antd &refantd;
+  region_cache regions;
+  std::ostringstream row;
+};
+
+/*
+  Output file of ivar variants. Bgzipped tsv is compressed on nthreads threads and indexed with
+  tabix once it is closed.
+*/
+class variants_output {
+public:
+  variant_sink* open(std::string out_file, char out_format, ref_antd &refantd, unsigned int nthreads);
+  int close();
+
+private:
+  char format;
+  std::string fname;
+  buffered_ofstream tsv;
+  bgzf_ostream tsv_gz;
+  std::unique_ptr<tsv_variants> rows;
+  vcf_writer vcf;
+};
+
+int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, std::string ref_path, std::string gff_path, unsigned int nthreads = 1, char out_format = TSV_OUTPUT);
+int call_variants_from_plup(std::istream &cin, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, ref_antd &refantd, unsigned int nthreads = 1, char out_format = TSV_OUTPUT);
+int call_variants_from_plup(std::istream &cin, std::ostream &fout, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, unsigned int nthreads = 1);
+int call_variants_from_plup(std::istream &cin, variant_sink &out, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, unsigned int nthreads = 1);
+int call_variants_parallel(std::istream &cin, variant_sink &out, uint8_t min_qual, double min_threshold, uint8_t min_depth, ref_antd &refantd, unsigned int nthreads);
+int call_variants_from_line(const std::string &line, ref_antd &refantd, region_cache &regions, variant_sink &out, uint8_t min_qual, double min_threshold, uint8_t min_depth);
+void print_variants_header(std::ostream &fout);
+int call_variants_from_alleles(const std::string &region, int64_t pos, char ref, uint32_t mdepth, std::vector<allele> &ad, variant_sink &out, double min_threshold, uint8_t min_depth);
+int call_variants_from_bam(std::string bam, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, std::string ref_path, std::string gff_path, pileup_opts opts, unsigned int nthreads = 1, char out_format = TSV_OUTPUT);
+int call_variants_from_bam(std::string bam, std::string out_file, uint8_t min_qual, double min_threshold, uint8_t min_depth, ref_antd &refantd, pileup_opts opts, unsigned int nthreads = 1, char out_format = TSV_OUTPUT);
+int call_variants_from_bam(std::string bam, std::ostream &fout, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, pileup_opts opts, unsigned int nthreads = 1);
+int call_variants_from_bam(std::string bam, variant_sink &out, ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, pileup_opts opts, unsigned int nthreads = 1);
 std::vector<allele>::iterator get_ref_allele(std::vector<allele> &ad, char ref);
 
 #endif
@@ -0,0 +1,104 @@
+#include <cstring>
+
+#include "fastq_reader.h"
+
+void fastq_batch::clear() {
+  data.clear();
+  lines.assign(1, 0);
+}
+
+size_t fastq_batch::size() const {
+  return (lines.size() - 1) / 4;
+}
+
+// Line l (0 to 3) of record rec
+const char* fastq_batch::line(size_t rec, int l) const {
+  return data.data() + lines[4 * rec + l];
+}
+
+size_t fastq_batch::line_length(size_t rec, int l) const {
+  return lines[4 * rec + l + 1] - lines[4 * rec + l] - 1;
+}
+
+fastq_reader::fastq_reader() : buf(FASTQ_READ_SIZE) {
+  this->pos = 0;
+  this->end = 0;
+  this->incomplete = false;
+}
+
+int fastq_reader::open(const std::string &fname, int nthreads) {
+  this->pos = 0;
+  this->end = 0;
+  this->incomplete = false;
+
+  return in.open(fname, nthreads);
+}
+
+int fastq_reader::close() {
+  return in.close();
+}
+
+// File ended in the middle of a record. The partial record is not returned.
+bool fastq_reader::truncated() const {
+  return incomplete;
+}
+
+bool fastq_reader::fill() {
+  in.read(buf.data(), buf.size());
+  this->pos = 0;
+  this->end = in.gcount();
+
+  return this->end > 0;
+}
+
+// Append the next line to data, adding a newline if the file does not end with one. Returns false at the end of the file.
+bool fastq_reader::read_line(std::string &data) {
+  size_t start = data.size();
+  const char *b, *nl;
+
+  while (pos < end || fill()) {
+    b = buf.data() + pos;
+    nl = (const char*) memchr(b, '\n', end - pos);
+    if (nl != NULL) {
+      data.append(b, nl - b + 1);
+      pos += nl - b + 1;
+      return true;
+    }
+
+    data.append(b, end - pos);
+    pos = end;
+  }
+
+  if (data.size() == start)
+    return false;
+
+  data += '\n';
+
+  return true;
+}
+
+// Read up to max_records records into batch, replacing what it held. Returns the number of records read.
+size_t fastq_reader::read(fastq_batch &batch, size_t max_records) {
+  int l;
+
+  batch.clear();
+  while (batch.size() < max_records) {
+    for (l = 0; l < 4; ++l) {
+      if (!read_line(batch.data))
+        break;
+      batch.lines.push_back(batch.data.size());
+    }
+
+    if (l == 4)
+      continue;
+
+    if (l > 0) {
+      this->incomplete = true;
+      batch.lines.resize(batch.lines.size() - l);
+      batch.data.resize(batch.lines.back());
+    }
+    break;
+  }
+
+  return batch.size();
+}
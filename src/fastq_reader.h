@@ -0,0 +1,50 @@
+#include <string>
+#include <vector>
+
+#include "bgzf_stream.h"
+
+#ifndef IVAR_FASTQ_READER_H
+#define IVAR_FASTQ_READER_H
+
+const size_t FASTQ_BATCH_SIZE = 2048;		// Records per batch
+const size_t FASTQ_READ_SIZE = 1 << 16;		// Bytes read from the file at a time
+
+/*
+  Batch of FASTQ records stored as one buffer with the offset of every line. Each record has four
+  lines, every line ends with a newline in data and line lengths do not include it. Clearing a
+  batch keeps its buffers so reading into it again does not allocate.
+*/
+struct fastq_batch {
+  std::string data;
+  std::vector<size_t> lines;		// Start of every line and the end of data
+
+  void clear();
+  size_t size() const;
+  const char* line(size_t rec, int l) const;
+  size_t line_length(size_t rec, int l) const;
+};
+
+/*
+  Reads plain, gzipped or bgzipped FASTQ through htslib. Bgzipped files are decompressed on
+  nthreads threads. Records are copied from the read buffer straight into a batch, so there is
+  no allocation per line.
+*/
+class fastq_reader {
+public:
+  fastq_reader();
+  int open(const std::string &fname, int nthreads = 1);
+  int close();
+  size_t read(fastq_batch &batch, size_t max_records);
+  bool truncated() const;
+
+private:
+  bool fill();
+  bool read_line(std::string &data);
+
+  bgzf_istream in;
+  std::vector<char> buf;
+  size_t pos, end;
+  bool incomplete;
+};
+
+#endif
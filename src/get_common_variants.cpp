@@ -23,69 +23,69 @@ const std::string fields[NUM_FIELDS] = {"REGION",
 
 const std::string na_tab_delimited_str = "NA\tNA\tNA\tNA\tNA\tNA\tNA\tNA\tNA\tNA";
 
-int read_variant_file(std::ifstream &fin, unsigned int file_number, std::map<std::string, unsigned int> &counts, std::map<std::string, std::string> &file_tab_delimited_str) {
-  unsigned int ctr;
+// Header of a variant file must match the columns of ivar variants
+bool check_variant_header(std::istream &fin) {
+  std::string line, cell;
+  unsigned int ctr = 0;
 
-  std::string line, cell, tab_delimited_key, tab_delimited_val;
-  std::stringstream line_stream;
-  std::string region, ref, alt;
-
-  // Make sure format of header matches
   std::getline(fin, line);
-  line_stream << line;
-  ctr = 0;
+  std::stringstream line_stream(line);
 
   while (std::getline(line_stream,cell,'\t')) {
-    if (cell.compare(fields[ctr]) != 0) {
-      return -1;
+    if (ctr >= NUM_FIELDS || cell.compare(fields[ctr]) != 0) {
+      return false;
     }
 
     ctr++;
   }
 
-  line_stream.clear();
+  return true;
+}
 
-  while (std::getline(fin, line)) {
-    line_stream << line;
-    ctr = 0;
-
-    tab_delimited_key = "";
-    tab_delimited_val = "";
-
-    while (std::getline(line_stream,cell,'\t')) {
-      switch(ctr) {
-        case 0:			// REGION
-        case 1:			// POS
-        case 2:			// REF
-        case 3:			// ALT
-        case 14:			// GFF_FEATURE
-        case 15:			// REF_CODON
-        case 16:			// REF_AA
-        case 17:			// ALT_CODON
-        case 18:			// ALT_AA
-          tab_delimited_key += cell + "\t";
-          break;
-        case 4:
-        case 5:
-        case 6:
-        case 7:
-        case 8:
-        case 9:
-        case 10:
-        case 11:
-        case 12:
-        case 13:
-        default:
-          tab_delimited_val += cell;
-          if (ctr < 13) {
-            tab_delimited_val += "\t";
-          }
-          break;
-      }
+// Split one row into the columns that identify a variant and the columns with its counts
+void parse_variant_row(const std::string &line, std::string &tab_delimited_key, std::string &tab_delimited_val) {
+  std::stringstream line_stream(line);
+  std::string cell;
+  unsigned int ctr = 0;
 
-      ctr++;
+  tab_delimited_key = "";
+  tab_delimited_val = "";
+
+  while (std::getline(line_stream,cell,'\t')) {
+    switch(ctr) {
+      case 0:			// REGION
+      case 1:			// POS
+      case 2:			// REF
+      case 3:			// ALT
+      case 14:			// GFF_FEATURE
+      case 15:			// REF_CODON
+      case 16:			// REF_AA
+      case 17:			// ALT_CODON
+      case 18:			// ALT_AA
+        tab_delimited_key += cell + "\t";
+        break;
+      default:
+        tab_delimited_val += cell;
+        if (ctr < 13) {
+          tab_delimited_val += "\t";
+        }
+        break;
     }
 
+    ctr++;
+  }
+}
+
+int read_variant_file(std::istream &fin, unsigned int file_number, std::map<std::string, unsigned int> &counts, std::map<std::string, std::string> &file_tab_delimited_str) {
+  std::string line, tab_delimited_key, tab_delimited_val;
+
+  // Make sure format of header matches
+  if (!check_variant_header(fin))
+    return -1;
+
+  while (std::getline(fin, line)) {
+    parse_variant_row(line, tab_delimited_key, tab_delimited_val);
+
     if (counts.find(tab_delimited_key) == counts.end()) {
       counts[tab_delimited_key] = 1;
     } else {
@@ -93,69 +93,299 @@ int read_variant_file(std::ifstream &fin, unsigned int file_number, std::map<std
     }
 
     file_tab_delimited_str[tab_delimited_key + std::to_string(file_number)] = tab_delimited_val;
-    line_stream.clear();
   }
 
   return 0;
 }
 
-int common_variants(std::string out, double min_threshold, char* files[], unsigned int nfiles) {
-  out += ".tsv";
-  std::ofstream fout(out.c_str());
+// Position of a row in the merge. Regions are ranked in the order they appear in the files.
+struct variant_pos {
+  int region;
+  int64_t pos;
+  bool operator < (const variant_pos &p) const {
+    return (region != p.region) ? region < p.region : pos < p.pos;
+  }
+  bool operator == (const variant_pos &p) const {
+    return region == p.region && pos == p.pos;
+  }
+};
+
+// One variant file in the merge with the rows of its current position
+struct variant_source {
+  bgzf_istream fin;
+  std::string line;		// First row of the next position
+  bool has_line;
+  variant_pos cur;
+  std::vector<std::pair<std::string, std::string> > rows;
+};
+
+static std::string get_row_region(const std::string &line) {
+  return line.substr(0, line.find('\t'));
+}
+
+static int64_t get_row_pos(const std::string &line) {
+  size_t start = line.find('\t');
+  if (start == std::string::npos)
+    return 0;
+  return strtoll(line.c_str() + start + 1, NULL, 10);
+}
+
+static bool read_row(variant_source &src) {
+  while ((src.has_line = (bool) std::getline(src.fin, src.line)) && src.line.empty());
+  return src.has_line;
+}
+
+/*
+  Order of the regions across all files. Every file lists its regions in reference order but may
+  skip the ones it has no variants in, so a region seen for the first time is placed right after
+  the region before it in the same file.
+*/
+static int get_region_order(char* files[], unsigned int nfiles, std::map<std::string, int> &ranks) {
+  std::list<std::string> order;
+  std::map<std::string, std::list<std::string>::iterator> placed;
+  std::list<std::string>::iterator it;
+  std::string line, region, prev;
+  bgzf_istream fin;
+
+  for (unsigned int i = 0; i < nfiles; ++i) {
+    if (fin.open(files[i]) != 0)
+      continue;
+
+    if (check_variant_header(fin)) {
+      prev.clear();
+      while (std::getline(fin, line)) {
+        if (line.empty())
+          continue;
+        region = get_row_region(line);
+        if (region == prev)
+          continue;
+        if (placed.find(region) == placed.end()) {
+          it = prev.empty() ? order.begin() : std::next(placed[prev]);
+          placed[region] = order.insert(it, region);
+        }
+        prev = region;
+      }
+    }
+
+    fin.close();
+  }
+
+  ranks.clear();
+  int rank = 0;
+  for (it = order.begin(); it != order.end(); ++it) {
+    ranks[*it] = rank++;
+  }
+
+  return 0;
+}
+
+// Rank of region. Regions missing from ranks are placed after all the others.
+static int get_region_rank(std::map<std::string, int> &ranks, const std::string &region) {
+  std::map<std::string, int>::iterator it = ranks.find(region);
+  if (it != ranks.end())
+    return it->second;
+  int rank = ranks.size();
+  ranks[region] = rank;
+  return rank;
+}
+
+// Read the rows of the next position of src. Returns -1 if the file is not sorted.
+static int read_position(variant_source &src, std::map<std::string, int> &ranks) {
+  variant_pos next;
+  std::string key, val;
+
+  src.rows.clear();
+  if (!src.has_line)
+    return 0;
+
+  next.region = get_region_rank(ranks, get_row_region(src.line));
+  next.pos = get_row_pos(src.line);
+  src.cur = next;
+
+  while (src.has_line && next == src.cur) {
+    parse_variant_row(src.line, key, val);
+    src.rows.push_back(std::make_pair(key, val));
+    if (read_row(src)) {
+      next.region = get_region_rank(ranks, get_row_region(src.line));
+      next.pos = get_row_pos(src.line);
+    }
+  }
+
+  if (src.has_line && next < src.cur)
+    return -1;
+
+  return 0;
+}
+
+// Make sure one descriptor per file is available for the merge
+static void raise_open_file_limit(unsigned int nfiles) {
+  struct rlimit rl;
+  rlim_t needed = nfiles + 32;
+
+  if (getrlimit(RLIMIT_NOFILE, &rl) != 0 || rl.rlim_cur >= needed)
+    return;
+
+  rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > needed) ? needed : rl.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+const int MERGE_REORDER = 1;
+
+/*
+  Merge the variant files by position with a heap over the current position of every file. Files
+  are read one position at a time so memory grows with the number of files, not their length.
+  All rows of a position are written as soon as every file has moved past it, ordered by REF,
+  ALT and GFF feature within the position. Regions missing from ranks are ranked as they are
+  first seen. With reorder set, a file that goes back to a region ranked before its current one
+  stops the merge with MERGE_REORDER instead of an error.
+*/
+static int merge_variants(std::string out, double min_threshold, char* files[], unsigned int nfiles, char out_format, std::map<std::string, int> &ranks, bool reorder) {
+  buffered_ofstream fout;
+  variant_matrix_writer matrix;
   unsigned int i, j;
 
-  std::ifstream fin;
-  std::map<std::string, unsigned int> counts = std::map<std::string, unsigned int>();
-  std::map<std::string, std::string> file_tab_delimited_str = std::map<std::string, std::string>();
+  if (out_format == OUT_FORMAT_MATRIX) {
+    if (matrix.open(out + MATRIX_EXT, std::vector<std::string>(files, files + nfiles)) != 0)
+      return -1;
+  } else {
+    fout.open(out + ".tsv");
+  }
+
+  std::vector<std::unique_ptr<variant_source> > sources;
+  typedef std::pair<variant_pos, unsigned int> heap_entry;
+  std::priority_queue<heap_entry, std::vector<heap_entry>, std::greater<heap_entry> > heap;
 
   for (i = 0; i < nfiles; ++i) {
-    fin.open(files[i]);
+    sources.push_back(std::unique_ptr<variant_source>(new variant_source));
+    variant_source &src = *sources.back();
+    src.has_line = false;
+
+    if (src.fin.open(files[i]) != 0) {
+      std::cout << "Unable to open " << files[i] << std::endl;
+      continue;
+    }
 
-    if (read_variant_file(fin, i, counts, file_tab_delimited_str) != 0) {
+    if (!check_variant_header(src.fin)) {
       std::cout << "Header format of "  << files[i]  << " did not match!";
       std::cout << " Please use files generated using \"ivar variants\" command." << std::endl;
+      src.fin.close();
+      continue;
     }
 
-    fin.close();
+    read_row(src);
+    if (read_position(src, ranks) != 0) {
+      if (reorder)
+        return MERGE_REORDER;
+      std::cout << files[i] << " is not sorted by position" << std::endl;
+      return -1;
+    }
+    if (!src.rows.empty())
+      heap.push(heap_entry(src.cur, i));
   }
 
-  std::map<std::string, unsigned int>::iterator it = counts.begin();
-
   // Write header
-  for (i = 0; i < 4; ++i) {
+  for (i = 0; i < 4 && out_format != OUT_FORMAT_MATRIX; ++i) {
     fout << fields[i] << "\t";
   }
 
-  for (i = 14; i < 19; ++i) {
+  for (i = 14; i < 19 && out_format != OUT_FORMAT_MATRIX; ++i) {
     fout << fields[i] << "\t";
   }
 
-  for (i = 0; i < nfiles; ++i) {
+  for (i = 0; i < nfiles && out_format != OUT_FORMAT_MATRIX; ++i) {
     for (j = 4; j < 14; ++j) {
       fout << fields[j] << "_" << files[i] << "\t";
     }
   }
 
-  fout << "\n";
+  if (out_format != OUT_FORMAT_MATRIX)
+    fout << "\n";
 
   // Write rows
-  while (it != counts.end()) {
-    if (((float)it->second)/(float)nfiles >= min_threshold) { // Check if variant occurs in more 'min_threshold' fraction of files
+  std::vector<unsigned int> at_pos;
+  std::vector<const std::string*> values(nfiles);
+  std::map<std::string, std::vector<std::pair<unsigned int, const std::string*> > > variants;
+  std::map<std::string, std::vector<std::pair<unsigned int, const std::string*> > >::iterator it;
+  std::vector<std::pair<std::string, std::string> >::iterator row;
+  variant_pos cur;
+  int res = 0;
+
+  while (!heap.empty()) {
+    cur = heap.top().first;
+    at_pos.clear();
+    variants.clear();
+
+    while (!heap.empty() && heap.top().first == cur) {
+      i = heap.top().second;
+      heap.pop();
+      at_pos.push_back(i);
+      for (row = sources[i]->rows.begin(); row != sources[i]->rows.end(); ++row) {
+        variants[row->first].push_back(std::make_pair(i, &row->second));
+      }
+    }
+
+    for (it = variants.begin(); it != variants.end(); ++it) {
+      if (((float)it->second.size())/(float)nfiles < min_threshold) // Check if variant occurs in more 'min_threshold' fraction of files
+        continue;
+
+      std::fill(values.begin(), values.end(), (const std::string*) NULL);
+      for (std::vector<std::pair<unsigned int, const std::string*> >::iterator v = it->second.begin(); v != it->second.end(); ++v) {
+        values[v->first] = v->second;	// Last row of a file wins
+      }
+
+      if (out_format == OUT_FORMAT_MATRIX) {
+        matrix.add_variant(it->first, values);
+        continue;
+      }
+
       fout << it->first;
       for (j = 0; j < nfiles; ++j) {
-        if (file_tab_delimited_str.find(it->first + std::to_string(j)) == file_tab_delimited_str.end()) {
-          fout << na_tab_delimited_str;
-        } else {
-          fout << file_tab_delimited_str[it->first + std::to_string(j)];
-        }
-
+        fout << ((values[j] != NULL) ? *values[j] : na_tab_delimited_str);
         if (j < nfiles - 1)
           fout << "\t";
       }
       fout << "\n";
     }
-    it++;
+
+    for (std::vector<unsigned int>::iterator s = at_pos.begin(); s != at_pos.end(); ++s) {
+      if (read_position(*sources[*s], ranks) != 0) {
+        if (!reorder)
+          std::cout << files[*s] << " is not sorted by position" << std::endl;
+        res = reorder ? MERGE_REORDER : -1;
+        break;
+      }
+      if (!sources[*s]->rows.empty())
+        heap.push(heap_entry(sources[*s]->cur, *s));
+    }
+
+    if (res != 0)
+      break;
   }
 
-  return 0;
+  if (out_format == OUT_FORMAT_MATRIX) {
+    if (matrix.close() != 0 && res == 0)
+      res = -1;
+  } else {
+    fout.close();
+  }
+
+  return res;
+}
+
+/*
+  Merge the variant files into <out>.tsv, or with the matrix format into a variant matrix,
+  <out>.ivm, with one sample per file. Regions are ranked in the merge as they are first seen.
+  When the files disagree with that order, e.g. one starts in a later region, the files are read
+  once more to order the regions and the merge is repeated.
+*/
+int common_variants(std::string out, double min_threshold, char* files[], unsigned int nfiles, char out_format) {
+  std::map<std::string, int> ranks;
+  raise_open_file_limit(nfiles);
+
+  int res = merge_variants(out, min_threshold, files, nfiles, out_format, ranks, true);
+  if (res != MERGE_REORDER)
+    return res;
+
+  get_region_order(files, nfiles, ranks);
+  return merge_variants(out, min_threshold, files, nfiles, out_format, ranks, false);
 }
@@ -2,11 +2,28 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <list>
+#include <vector>
+#include <queue>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+#include <cstdlib>
+#include <sys/resource.h>
 
-#ifndef get_common_variants
-#define get_common_variants
+#include "bgzf_stream.h"
+#include "buffered_writer.h"
+#include "variant_matrix.h"
 
-int read_variant_file(std::ifstream &fin, unsigned int file_number, std::map<std::string, unsigned int> &counts, std::map<std::string, std::string> &file_tab_delimited_str);
-int common_variants(std::string out, double min_threshold, char* files[], unsigned int nfiles);
+#ifndef IVAR_GET_COMMON_VARIANTS_H
+#define IVAR_GET_COMMON_VARIANTS_H
+
+const char OUT_FORMAT_TSV = 't';
+const char OUT_FORMAT_MATRIX = 'm';
+
+bool check_variant_header(std::istream &fin);
+void parse_variant_row(const std::string &line, std::string &tab_delimited_key, std::string &tab_delimited_val);
+int read_variant_file(std::istream &fin, unsigned int file_number, std::map<std::string, unsigned int> &counts, std::map<std::string, std::string> &file_tab_delimited_str);
+int common_variants(std::string out, double min_threshold, char* files[], unsigned int nfiles, char out_format = OUT_FORMAT_TSV);
 
 #endif
@@ -1,21 +1,22 @@
 #include "get_masked_amplicons.h"
 
-int get_primers_with_mismatches(std::string bed, std::string vpath, std::string out, std::string primer_pair_file) {
-  std::vector<primer> primers = populate_from_file(bed);
-  std::vector<primer> mismatches_primers;
-  std::vector<primer> tmp;
-
-  if (primers.size() == 0) {
-    return 0;
-  }
-
-  populate_pair_indices(primers, primer_pair_file);
+/*
+  Indices of the primers covering a variant position in vpath and their pairs, in the order they
+  are first found. primers must have their pair indices set.
+*/
+int get_masked_primers(std::vector<primer> &primers, std::string vpath, std::vector<int> &masked) {
   std::string line, cell;
-  std::ifstream fin(vpath.c_str());
-  out += ".txt";
-  std::ofstream fout(out.c_str());
+  bgzf_istream fin;		// Plain or bgzipped variants
+  if (fin.open(vpath) != 0) {
+    std::cout << "Unable to open " << vpath << std::endl;
+    return -1;
+  }
 
+  primer_index index(primers);
+  std::vector<bool> seen(primers.size(), false);
+  std::vector<int> overlapping;
   unsigned int ctr, pos;
+  int pair;
   std::stringstream line_stream;
 
   while (std::getline(fin, line)) {
@@ -41,35 +42,49 @@ int get_primers_with_mismatches(std::string bed, std::string vpath, std::string
     }
 
     pos--;			// 1 based to 0 based
-    tmp = get_primers(primers, pos);
-
-    // mismatches_primers.insert(mismatches_primers.end(), tmp.begin(), tmp.end());
-    std::vector<primer>::iterator tmp_it;
-    for (std::vector<primer>::iterator it = tmp.begin(); it != tmp.end(); ++it) {
-      tmp_it = std::find(mismatches_primers.begin(), mismatches_primers.end(), *it);
-      if (tmp_it == mismatches_primers.end()) {
-        std::cout << it->get_name() << std::endl;
-        mismatches_primers.push_back(*it);
+    index.get_primers(pos, overlapping);
+
+    for (std::vector<int>::iterator it = overlapping.begin(); it != overlapping.end(); ++it) {
+      if (!seen[*it]) {
+        std::cout << primers[*it].get_name() << std::endl;
+        seen[*it] = true;
+        masked.push_back(*it);
       }
 
       // Look for primer pair
-      if (it->get_pair_indice() != -1) {
-        tmp_it = std::find(mismatches_primers.begin(), mismatches_primers.end(), primers.at(it->get_pair_indice()));
-        if (tmp_it == mismatches_primers.end()) {
-          mismatches_primers.push_back(primers.at(it->get_pair_indice()));
-        }
+      pair = primers[*it].get_pair_indice();
+      if (pair != -1 && !seen[pair]) {
+        seen[pair] = true;
+        masked.push_back(pair);
       }
     }
 
     line_stream.clear();
-    tmp.clear();
   }
 
-  for (std::vector<primer>::iterator it = mismatches_primers.begin(); it != mismatches_primers.end(); ++it) {
-    fout << it->get_name();
-    std::cout << it->get_name();
+  return 0;
+}
+
+int get_primers_with_mismatches(std::string bed, std::string vpath, std::string out, std::string primer_pair_file) {
+  std::vector<primer> primers = populate_from_file(bed);
+  std::vector<int> masked;
+
+  if (primers.size() == 0) {
+    return 0;
+  }
+
+  populate_pair_indices(primers, primer_pair_file);
+  if (get_masked_primers(primers, vpath, masked) != 0)
+    return -1;
+
+  out += ".txt";
+  buffered_ofstream fout(out);
+
+  for (std::vector<int>::iterator it = masked.begin(); it != masked.end(); ++it) {
+    fout << primers[*it].get_name();
+    std::cout << primers[*it].get_name();
 
-    if (it != mismatches_primers.end() - 1) {
+    if (it != masked.end() - 1) {
       fout << "\t";
       std::cout << "\t";
     }
@@ -4,10 +4,13 @@
 #include <algorithm>
 
 #include "primer_bed.h"
+#include "bgzf_stream.h"
+#include "buffered_writer.h"
 
-#ifndef get_masked_amplicons
-#define get_masked_amplicons
+#ifndef IVAR_GET_MASKED_AMPLICONS_H
+#define IVAR_GET_MASKED_AMPLICONS_H
 
+int get_masked_primers(std::vector<primer> &primers, std::string vpath, std::vector<int> &masked);
 int get_primers_with_mismatches(std::string bed, std::string vpath, std::string out, std::string primer_pair_file);
 
 #endif
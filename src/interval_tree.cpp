@@ -80,8 +80,8 @@ void IntervalTree::inOrder(ITNode *root) {
 
   inOrder(root->left);
 
-  cout << "[" << root->data->low << ", " << root->data->high << "]"
-       << " max = " << root->max << endl;
+  std::cout << "[" << root->data->low << ", " << root->data->high << "]"
+       << " max = " << root->max << std::endl;
        
   inOrder(root->right);
 }
@@ -1,9 +1,8 @@
 #include <iostream>
 #include "primer_bed.h"
-using namespace std;
 
-#ifndef interval_tree
-#define interval_tree
+#ifndef IVAR_INTERVAL_TREE_H
+#define IVAR_INTERVAL_TREE_H
 
 // Structure to represent an interval
 class Interval{   public:
@@ -10,11 +10,15 @@
 
 #include "remove_reads_from_amplicon.h"
 #include "call_consensus_pileup.h"
+#include "live_consensus.h"
 #include "call_variants.h"
 #include "trim_primer_quality.h"
 #include "get_masked_amplicons.h"
 #include "suffix_tree.h"
 #include "get_common_variants.h"
+#include "serve.h"
+#include "batch.h"
+#include "pipeline.h"
 
 const std::string VERSION = "1.3.1";
 
@@ -42,19 +46,40 @@ struct args_t {
   bool write_no_primers_flag;	  // -e
   std::string gff;		          // -g
   bool keep_for_reanalysis;     // -k
+  int nthreads;                 // -@
+  uint8_t min_base_qual;        // -Q
+  int max_depth;                // -d
+  uint8_t min_map_qual;         // -M
+  bool skip_orphans;            // -O
+  bool ignore_overlaps;         // -x
+  std::string out_format;       // -F
+  std::vector<double> thresholds;   // -t for consensus
+  std::vector<int> min_depths;      // -m for consensus
+  bool live;                        // -l for consensus
+  double live_interval;             // -u for consensus
+  std::vector<std::string> samples; // -s for slicematrix
+  std::string variants;             // -v for maskreads
+  std::string socket;               // -s for serve and client
+  std::string job;                  // -j for client
 } g_args;
 
 void print_usage(){
   std::cout <<
-    "Usage:	ivar [command <trim|variants|filtervariants|consensus|getmasked|removereads|version|help>]\n"
+    "Usage:	ivar [command <trim|variants|filtervariants|slicematrix|consensus|getmasked|removereads|maskreads|pipeline|batch|serve|client|version|help>]\n"
     "\n"
     "        Command       Description\n"
     "           trim       Trim reads in aligned BAM file\n"
     "       variants       Call variants from aligned BAM file\n"
     " filtervariants       Filter variants across replicates or samples\n"
+    "    slicematrix       Slice a variant matrix from filtervariants by region or sample\n"
     "      consensus       Call consensus from aligned BAM file\n"
     "      getmasked       Detect primer mismatches and get primer indices for the amplicon to be masked\n"
     "    removereads       Remove reads from trimmed BAM file\n"
+    "      maskreads       Run getmasked and removereads in a single pass\n"
+    "       pipeline       Trim reads and call variants and consensus from aligned BAM file in one pass\n"
+    "          batch       Run trim, variants and consensus for every sample of a manifest in one process\n"
+    "          serve       Run trim, variants and consensus jobs sent to a local socket, keeping primers and references loaded\n"
+    "         client       Send jobs to a running ivar serve\n"
     "        version       Show version information\n"
     "\n"
     "To view detailed usage for each command type `ivar <command>` \n";
@@ -81,27 +106,49 @@ void print_trim_usage(){
 
 void print_variants_usage(){
   std::cout <<
-      "Usage: samtools mpileup -aa -A -d 0 -B -Q 0 --reference [<reference-fasta] <input.bam> | ivar variants -p <prefix> [-q <min-quality>] [-t <min-frequency-threshold>] [-m <minimum depth>] [-r <reference-fasta>] [-g GFF file]\n\n"
-    "Note : samtools mpileup output must be piped into ivar variants\n\n"
+      "Usage: samtools mpileup -aa -A -d 0 -B -Q 0 --reference [<reference-fasta] <input.bam> | ivar variants -p <prefix> [-q <min-quality>] [-t <min-frequency-threshold>] [-m <minimum depth>] [-r <reference-fasta>] [-g GFF file] [-@ <threads>]\n"
+    "       ivar variants -i <input.bam> -p <prefix> [-q <min-quality>] [-t <min-frequency-threshold>] [-m <minimum depth>] [-r <reference-fasta>] [-g GFF file] [-@ <threads>] [-Q <min-base-quality>] [-d <max-depth>] [-M <min-mapping-quality>] [-O] [-x] [-F <tsv|tsv.gz|vcf|bcf>]\n\n"
+    "Note : samtools mpileup output must be piped into ivar variants unless a BAM file is given with -i\n\n"
     "Input Options    Description\n"
     "           -q    Minimum quality score threshold to count base (Default: 20)\n"
     "           -t    Minimum frequency threshold(0 - 1) to call variants (Default: 0.03)\n"
     "           -m    Minimum read depth to call variants (Default: 0)\n"
     "           -r    Reference file used for alignment. This is used to translate the nucleotide sequences and identify intra host single nucleotide variants\n"
-    "           -g    A GFF file in the GFF3 format can be supplied to specify coordinates of open reading frames (ORFs). In absence of GFF file, amino acid translation will not be done.\n\n"
+    "           -g    A GFF file in the GFF3 format can be supplied to specify coordinates of open reading frames (ORFs). In absence of GFF file, amino acid translation will not be done.\n"
+    "           -@    Number of threads used to call variants. Output is identical to a run with one thread. Use 0 for all available cores (Default: 1)\n\n"
+    "BAM Input Options  Description\n"
+    "           -i    Sorted BAM file to call variants from directly. Reads are counted the same way as with `samtools mpileup -aa -A -d 0 -B -Q 0`. An index is required for more than one thread\n"
+    "           -Q    Minimum base quality for a read to be counted in the depth, mpileup -Q (Default: 0)\n"
+    "           -d    Maximum number of reads per position, mpileup -d. 0 for no limit (Default: 0)\n"
+    "           -M    Minimum mapping quality of reads, mpileup -q (Default: 0)\n"
+    "           -O    Skip anomalous read pairs, the opposite of mpileup -A\n"
+    "           -x    Disable read-pair overlap detection, mpileup -x\n\n"
     "Output Options   Description\n"
-    "           -p    (Required) Prefix for the output tsv variant file\n\n";
+    "           -p    (Required) Prefix for the output tsv variant file\n"
+    "           -F    Output format. tsv, tsv.gz for bgzipped tsv with a tabix index (<prefix>.tsv.gz), vcf for bgzipped VCF (<prefix>.vcf.gz) or bcf for BCF (<prefix>.bcf). VCF and BCF require a reference (-r) and are indexed with a CSI index. Bgzipped output is compressed using the threads given by -@ (Default: tsv)\n\n";
 }
 
 void print_filtervariants_usage(){
   std::cout <<
     "Usage: ivar filtervariants -p <prefix> replicate-one.tsv replicate-two.tsv ... OR ivar filtervariants -p <prefix> -f <text file with one variant file per line> \n"
-    "Input: Variant tsv files for each replicate/sample\n\n"
+    "Input: Variant tsv files for each replicate/sample. Files can be bgzipped (-F tsv.gz)\n\n"
     "Input Options    Description\n"
     "           -t    Minimum fration of files required to contain the same variant. Specify value within [0,1]. (Default: 1)\n"
     "           -f    A text file with one variant file per line.\n\n"
     "Output Options   Description\n"
-    "           -p    (Required) Prefix for the output filtered tsv file\n";
+    "           -p    (Required) Prefix for the output filtered tsv file\n"
+    "           -F    Output format. tsv or matrix for a binary variant matrix (<prefix>.ivm) that can be read with `ivar slicematrix` (Default: tsv)\n";
+}
+
+void print_slicematrix_usage(){
+  std::cout <<
+    "Usage: ivar slicematrix -i <filtered.ivm> -p <prefix> [-R <region>[:<start>-<end>]] [-s <sample1,sample2,...>]\n\n"
+    "Input Options    Description\n"
+    "           -i    (Required) Variant matrix generated using `ivar filtervariants -F matrix`\n"
+    "           -R    Region and optional 1-based inclusive position range to write. (Default: all variants)\n"
+    "           -s    Comma separated list of samples to write, as the variant files were named in `ivar filtervariants`. (Default: all samples)\n\n"
+    "Output Options   Description\n"
+    "           -p    (Required) Prefix for the output tsv file\n";
 }
 
 void print_consensus_usage(){
@@ -110,7 +157,7 @@ void print_consensus_usage(){
     "Note : samtools mpileup output must be piped into `ivar consensus`\n\n"
     "Input Options    Description\n"
     "           -q    Minimum quality score threshold to count base (Default: 20)\n"
-    "           -t    Minimum frequency threshold(0 - 1) to call consensus. (Default: 0)\n"
+    "           -t    Minimum frequency threshold(0 - 1) to call consensus. A comma separated list such as 0,0.5,0.9 calls one consensus per threshold in a single pass (Default: 0)\n"
     "                 Frequently used thresholds | Description\n"
     "                 ---------------------------|------------\n"
     "                                          0 | Majority or most common base\n"
@@ -118,22 +165,40 @@ void print_consensus_usage(){
     "                                        0.5 | Strict or bases that make up atleast 50% of the depth at a position\n"
     "                                        0.9 | Strict or bases that make up atleast 90% of the depth at a position\n"
     "                                          1 | Identical or bases that make up 100% of the depth at a position. Will have highest ambiguities\n"
-    "           -m    Minimum depth to call consensus(Default: 10)\n"
+    "           -m    Minimum depth to call consensus. Can be a comma separated list like -t (Default: 10)\n"
     "           -k    If '-k' flag is added, regions with depth less than minimum depth will not be added to the consensus sequence. Using '-k' will override any option specified using -n \n"
-    "           -n    (N/-) Character to print in regions with less than minimum coverage(Default: N)\n\n"
+    "           -n    (N/-) Character to print in regions with less than minimum coverage(Default: N)\n"
+    "           -@    Number of threads used to call consensus. Output is identical to a run with one thread. Use 0 for all available cores (Default: 1)\n"
+    "           -l    Live mode. Pileups of new batches of reads are added to the counts of earlier ones and the consensus is rewritten as they come in. End a batch with an empty line to write the consensus right away\n"
+    "           -u    Seconds between consensus snapshots in live mode. 0 only writes on empty lines and at the end of the input (Default: 60)\n\n"
     "Output Options   Description\n"
-    "           -p    (Required) Prefix for the output fasta file and quality file\n"
+    "           -p    (Required) Prefix for the output fasta file and quality file. With more than one threshold or minimum depth every combination is written to <prefix>_t<threshold>_m<depth>.fa and .qual.txt\n"
     "           -i    (Optional) Name of fasta header. By default, the prefix is used to create the fasta header in the following format, Consensus_<prefix>_threshold_<frequency-threshold>_quality_<minimum-quality>\n";
 }
 
 void print_removereads_usage(){
   std::cout <<
-    "Usage: ivar removereads -i <input.trimmed.bam> -p <prefix> -t <text-file-with-primer-indices> -b <primers.bed> \n"
+    "Usage: ivar removereads -i <input.trimmed.bam> -p <prefix> -t <text-file-with-primer-indices> -b <primers.bed> [-@ <threads>]\n"
     "Note: This step is used only for amplicon-based sequencing.\n\n"
     "Input Options    Description\n"
-    "           -i    (Required) Input BAM file  trimmed with ‘ivar trim’. Must be sorted which can be done using `samtools sort`.\n"
+    "           -i    (Required) Input BAM file  trimmed with ‘ivar trim’. Every reference and the unmapped reads are written, in the order of the input. No index is needed.\n"
     "           -t    (Required) Text file with primer indices separated by spaces. This is the output of `getmasked` command.\n"
-    "           -b    (Required) BED file with primer sequences and positions.\n\n"
+    "           -b    (Required) BED file with primer sequences and positions.\n"
+    "           -@    Number of threads used to read and compress the BAM file. Use 0 for all available cores (Default: 1)\n\n"
+    "Output Options   Description\n"
+    "           -p    (Required) Prefix for the output filtered BAM file\n";
+}
+
+void print_maskreads_usage(){
+  std::cout <<
+    "Usage: ivar maskreads -i <input.trimmed.bam> -v <input-filtered.tsv> -b <primers.bed> -f <primer_pairs.tsv> -p <prefix> [-@ <threads>]\n"
+    "Note: This step is used only for amplicon-based sequencing. It is the same as `ivar getmasked` followed by `ivar removereads`.\n\n"
+    "Input Options    Description\n"
+    "           -i    (Required) Input BAM file  trimmed with ‘ivar trim’. No index is needed.\n"
+    "           -v    (Required) Input filtered variants tsv generated from `ivar filtervariants`. The file can be bgzipped\n"
+    "           -b    (Required) BED file with primer sequences and positions\n"
+    "           -f    (Required) Primer pair information file containing left and right primer names for the same amplicon separated by a tab\n"
+    "           -@    Number of threads used to read and compress the BAM file. Use 0 for all available cores (Default: 1)\n\n"
     "Output Options   Description\n"
     "           -p    (Required) Prefix for the output filtered BAM file\n";
 }
@@ -143,7 +208,7 @@ void print_getmasked_usage(){
     "Usage: ivar getmasked -i <input-filtered.tsv> -b <primers.bed> -f <primer_pairs.tsv> -p <prefix>\n"
     "Note: This step is used only for amplicon-based sequencing.\n\n"
     "Input Options    Description\n"
-    "           -i    (Required) Input filtered variants tsv generated from `ivar filtervariants`\n"
+    "           -i    (Required) Input filtered variants tsv generated from `ivar filtervariants`. The file can be bgzipped\n"
     "           -b    (Required) BED file with primer sequences and positions\n"
     "           -f    (Required) Primer pair information file containing left and right primer names for the same amplicon separated by a tab\n"
     "Output Options   Description\n"
@@ -153,13 +218,93 @@ void print_getmasked_usage(){
 void print_trimadapter_usage(){
   std::cout <<
     "NOTE: EXPERIMENTAL FEATURE\n"
-    "Usage: ivar trimadapter [-f1 <input-fastq>] [-f2 <input-fastq-2>] [-p prefix] [-a <adapter-fasta-file>]\n\n"
+    "Usage: ivar trimadapter [-f1 <input-fastq>] [-f2 <input-fastq-2>] [-p prefix] [-a <adapter-fasta-file>] [-@ <threads>] [-F <fastq|fastq.gz>]\n\n"
+    "Input Options    Description\n"
+    "           -1    (Required) Input fastq file. The file can be gzipped or bgzipped\n"
+    "           -2    Input fastq file 2 (for pair ended reads). The file can be gzipped or bgzipped\n"
+    "           -a    (Required) Adapter Fasta File\n"
+    "           -@    Number of threads used to decompress, trim and compress reads. Values less than 1 use all available cores (Default: 1)\n\n"
+    "Output Options   Description\n"
+    "           -p    (Required) Prefix of output fastq files. Pair ended reads are written to <prefix>_1.trimmed.fastq and <prefix>_2.trimmed.fastq\n"
+    "           -F    Output format. fastq or fastq.gz for bgzipped fastq (<prefix>.trimmed.fastq.gz) (Default: fastq.gz if the input fastq file ends with .gz, otherwise fastq)\n";
+}
+
+void print_pipeline_usage(){
+  std::cout <<
+    "Usage: ivar pipeline -i <input.bam> -b <primers.bed> -p <prefix> [-r <reference-fasta>] [-g <GFF file>] [-f <primer-pair-file>] [-x <primer-offset>] [-q <min-quality>] [-s <sliding-window-width>] [-l <min-length>] [-e] [-k] [-t <min-frequency-threshold>] [-m <minimum depth>] [-c <consensus-threshold>] [-d <consensus-min-depth>] [-n <gap>] [-F <format>] [-w] [-@ <threads>]\n\n"
+    "Trims primers and low quality bases, piles up the trimmed reads as `samtools mpileup -aa -A -d 0 -B -Q 0` and calls variants and the consensus without writing intermediate files.\n\n"
     "Input Options    Description\n"
-    "           -1    (Required) Input fastq file\n"
-    "           -2    Input fastq file 2 (for pair ended reads)\n"
-    "           -a    (Required) Adapter Fasta File\n\n"
+    "           -i    (Required) Sorted bam file, with aligned reads\n"
+    "           -b    BED file with primer sequences and positions. If no BED file is specified, only quality trimming will be done.\n"
+    "           -f    Primer pair information file containing left and right primer names for the same amplicon separated by a tab\n"
+    "           -x    Primer position offset (Default: 0)\n"
+    "           -r    Reference file used to translate variants\n"
+    "           -g    GFF file with the open reading frames of the reference\n\n"
+    "Trimming Options Description\n"
+    "           -q    Minimum quality threshold for the sliding window, and to count bases for variants and consensus (Default: 20)\n"
+    "           -s    Width of sliding window (Default: 4)\n"
+    "           -l    Minimum length of read to retain after trimming (Default: 30)\n"
+    "           -e    Include reads with no primers. By default, reads with no primers are excluded\n"
+    "           -k    Keep reads that would be dropped by trimming, marked QCFAIL. They are not counted for variants or consensus\n\n"
+    "Calling Options  Description\n"
+    "           -t    Minimum frequency threshold(0 - 1) to call variants (Default: 0.03)\n"
+    "           -m    Minimum read depth to call variants (Default: 0)\n"
+    "           -c    Minimum frequency threshold(0 - 1) to call consensus (Default: 0)\n"
+    "           -d    Minimum depth to call consensus (Default: 10)\n"
+    "           -n    Character to print in regions with less than minimum coverage (Default: N)\n\n"
     "Output Options   Description\n"
-    "           -p    (Required) Prefix of output fastq files\n";
+    "           -p    (Required) Prefix of the output files: <prefix>.tsv, <prefix>.fa and <prefix>.qual.txt\n"
+    "           -F    Format of the variants: tsv, tsv.gz, vcf or bcf (Default: tsv)\n"
+    "           -w    Also write the trimmed reads, sorted by coordinate, to <prefix>.trimmed.bam\n"
+    "           -@    Number of threads used to read and write compressed files. Values less than 1 use all available cores (Default: 1)\n";
+}
+
+void print_batch_usage(){
+  std::cout <<
+    "Usage: ivar batch -p <prefix> [-b <primers.bed>] [-f <primer-pair-file>] [-x <primer-offset>] [-r <reference-fasta>] [-g <GFF file>] [-q <min-quality>] [-t <min-frequency-threshold>] [-m <minimum depth>] [-n <gap>] [-e] [-k] [-@ <threads>] <manifest.tsv>\n\n"
+    "The manifest is a tab separated file with a header line naming its columns, and one line per sample.\n"
+    "  sample      (Required) Name of the sample\n"
+    "  bam         Sorted BAM file to trim and to call variants from\n"
+    "  mpileup     samtools mpileup output to call variants and consensus from. Used for variants instead of bam if both are given\n"
+    "  trim        Prefix of the trimmed BAM file. Trimming is skipped if empty\n"
+    "  variants    Prefix of the variants tsv file. Variant calling is skipped if empty\n"
+    "  consensus   Prefix of the consensus files. Consensus calling is skipped if empty\n"
+    "  bed, pairs, ref, gff   Set -b, -f, -r and -g for this sample\n\n"
+    "Input Options    Description\n"
+    "           -b    BED file with primer sequences and positions\n"
+    "           -f    Primer pair information file\n"
+    "           -x    Primer position offset (Default: 0)\n"
+    "           -r    Reference file used to translate variants\n"
+    "           -g    GFF file with the open reading frames of the reference\n"
+    "           -q    Minimum quality score threshold, for trimming and to count bases (Default: 20)\n"
+    "           -t    Minimum frequency threshold(0 - 1) to call variants (Default: 0.03)\n"
+    "           -m    Minimum depth to call consensus (Default: 10)\n"
+    "           -n    Character to print in regions with less than minimum coverage (Default: N)\n"
+    "           -e    Include reads with no primers in trimmed BAM files\n"
+    "           -k    Keep reads that would be dropped by trimming, marked QCFAIL\n"
+    "           -@    Number of samples run at the same time. Each sample runs on one thread. Values less than 1 use all available cores (Default: 1)\n\n"
+    "Output Options   Description\n"
+    "           -p    (Required) Prefix of the report with one line of counts per sample (<prefix>.tsv)\n";
+}
+
+void print_serve_usage(){
+  std::cout <<
+    "Usage: ivar serve -s <socket> [-@ <threads>]\n\n"
+    "Jobs are sent with `ivar client` as one line of JSON each. Primer schemes, references and GFF files are loaded by the first job that uses them and kept until the server is stopped with a {\"cmd\": \"shutdown\"} job. Only the user running the server can connect to the socket.\n\n"
+    "Options          Description\n"
+    "           -s    (Required) Path of the Unix domain socket to listen on\n"
+    "           -@    Number of jobs run at the same time. Values less than 1 use all available cores (Default: 1)\n";
+}
+
+void print_client_usage(){
+  std::cout <<
+    "Usage: ivar client -s <socket> [-j <job>]\n\n"
+    "Jobs are read from -j or one per line from standard input, for example\n"
+    "  {\"cmd\": \"variants\", \"bam\": \"s1.bam\", \"prefix\": \"s1\", \"ref\": \"ref.fa\", \"gff\": \"ref.gff\"}\n"
+    "The response of every job is written to standard output as one line of JSON, in the order of the jobs.\n\n"
+    "Options          Description\n"
+    "           -s    (Required) Socket of a running ivar serve\n"
+    "           -j    Job to run, as JSON\n";
 }
 
 void print_version_info(){
@@ -168,12 +313,18 @@ void print_version_info(){
 }
 
 static const char *trim_opt_str = "i:b:f:x:p:m:q:s:ekh?";
-static const char *variants_opt_str = "p:t:q:m:r:g:h?";
-static const char *consensus_opt_str = "i:p:q:t:m:n:kh?";
-static const char *removereads_opt_str = "i:p:t:b:h?";
-static const char *filtervariants_opt_str = "p:t:f:h?";
+static const char *variants_opt_str = "p:t:q:m:r:g:@:i:Q:d:M:OxF:h?";
+static const char *consensus_opt_str = "i:p:q:t:m:n:k@:lu:h?";
+static const char *removereads_opt_str = "i:p:t:b:@:h?";
+static const char *filtervariants_opt_str = "p:t:f:F:h?";
+static const char *slicematrix_opt_str = "i:p:R:s:h?";
 static const char *getmasked_opt_str = "i:b:f:p:h?";
-static const char *trimadapter_opt_str = "1:2:p:a:h?";
+static const char *maskreads_opt_str = "i:v:b:f:p:@:h?";
+static const char *trimadapter_opt_str = "1:2:p:a:@:F:h?";
+static const char *pipeline_opt_str = "i:b:f:x:r:g:p:q:s:l:ekt:m:c:d:n:F:w@:h?";
+static const char *batch_opt_str = "p:b:f:x:r:g:q:t:m:n:ek@:h?";
+static const char *serve_opt_str = "s:@:h?";
+static const char *client_opt_str = "s:j:h?";
 
 std::string get_filename_without_extension(std::string f, std::string ext){
   if (ext.length() > f.length())	// If extension longer than filename
@@ -185,6 +336,18 @@ std::string get_filename_without_extension(std::string f, std::string ext){
   return f;
 }
 
+// Split a comma separated option value such as "0,0.5,0.9"
+std::vector<std::string> split_option_list(std::string val){
+  std::vector<std::string> items;
+  std::string item;
+  std::stringstream ss(val);
+
+  while (std::getline(ss, item, ','))
+    items.push_back(item);
+
+  return items;
+}
+
 /*!
  Main Function
 
@@ -289,6 +452,14 @@ int main(int argc, char* argv[]){
     g_args.min_depth = 0;
     g_args.ref = "";
     g_args.gff = "";
+    g_args.nthreads = 1;
+    g_args.bam = "";
+    g_args.min_base_qual = 0;
+    g_args.max_depth = 0;
+    g_args.min_map_qual = 0;
+    g_args.skip_orphans = false;
+    g_args.ignore_overlaps = false;
+    g_args.out_format = "tsv";
 
     opt = getopt( argc, argv, variants_opt_str);
     while( opt != -1 ) {
@@ -311,6 +482,30 @@ int main(int argc, char* argv[]){
         case 'g':
           g_args.gff = optarg;
           break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'i':
+          g_args.bam = optarg;
+          break;
+        case 'Q':
+          g_args.min_base_qual = std::stoi(optarg);
+          break;
+        case 'd':
+          g_args.max_depth = std::stoi(optarg);
+          break;
+        case 'M':
+          g_args.min_map_qual = std::stoi(optarg);
+          break;
+        case 'O':
+          g_args.skip_orphans = true;
+          break;
+        case 'x':
+          g_args.ignore_overlaps = true;
+          break;
+        case 'F':
+          g_args.out_format = optarg;
+          break;
         case 'h':
         case '?':
           print_variants_usage();
@@ -336,16 +531,46 @@ int main(int argc, char* argv[]){
       return -1;
     }
 
+    char out_format = TSV_OUTPUT;
+    if (g_args.out_format.compare("vcf") == 0) {
+      out_format = VCF_OUTPUT;
+    } else if (g_args.out_format.compare("bcf") == 0) {
+      out_format = BCF_OUTPUT;
+    } else if (g_args.out_format.compare("tsv.gz") == 0) {
+      out_format = TSV_GZ_OUTPUT;
+    } else if (g_args.out_format.compare("tsv") != 0) {
+      std::cout << "Output format must be one of tsv, tsv.gz, vcf or bcf." << std::endl;
+      print_variants_usage();
+      return -1;
+    }
+
+    if (output_format_needs_ref(out_format) && g_args.ref.empty()) {
+      std::cout << "Please specify a reference (using -r) to write VCF/BCF output." << std::endl;
+      print_variants_usage();
+      return -1;
+    }
+
+    g_args.prefix = get_filename_without_extension(g_args.prefix,".tsv.gz");
     g_args.prefix = get_filename_without_extension(g_args.prefix,".tsv");
+    g_args.prefix = get_filename_without_extension(g_args.prefix,".vcf.gz");
+    g_args.prefix = get_filename_without_extension(g_args.prefix,".bcf");
     g_args.min_threshold = (g_args.min_threshold < 0 || g_args.min_threshold > 1) ? 0.03: g_args.min_threshold;
 
-    if (isatty(STDIN_FILENO)) {
+    if (!g_args.bam.empty()) {
+      pileup_opts plp_opts;
+      plp_opts.min_base_qual = g_args.min_base_qual;
+      plp_opts.max_depth = g_args.max_depth;
+      plp_opts.min_map_qual = g_args.min_map_qual;
+      plp_opts.count_orphans = !g_args.skip_orphans;
+      plp_opts.detect_overlaps = !g_args.ignore_overlaps;
+      res = call_variants_from_bam(g_args.bam, g_args.prefix, g_args.min_qual, g_args.min_threshold, g_args.min_depth, g_args.ref, g_args.gff, plp_opts, get_thread_count(g_args.nthreads), out_format);
+    } else if (isatty(STDIN_FILENO)) {
       std::cout << "Please pipe mpileup into `ivar variants` command.\n\n";
       print_variants_usage();
       return -1;
+    } else {
+      res = call_variants_from_plup(std::cin, g_args.prefix, g_args.min_qual, g_args.min_threshold, g_args.min_depth, g_args.ref, g_args.gff, get_thread_count(g_args.nthreads), out_format);
     }
-
-    res = call_variants_from_plup(std::cin, g_args.prefix, g_args.min_qual, g_args.min_threshold, g_args.min_depth, g_args.ref, g_args.gff);
   } else if (cmd.compare("consensus") == 0) { // ivar consensus
     opt = getopt( argc, argv, consensus_opt_str);
     g_args.seq_id = "";
@@ -354,11 +579,19 @@ int main(int argc, char* argv[]){
     g_args.gap = 'N';
     g_args.min_qual = 20;
     g_args.keep_min_coverage = true;
+    g_args.nthreads = 1;
+    g_args.live = false;
+    g_args.live_interval = 60;
+    std::vector<std::string> items;
 
     while( opt != -1 ) {
       switch( opt ) {
         case 't':
-          g_args.min_threshold = atof(optarg);
+          g_args.thresholds.clear();
+          items = split_option_list(optarg);
+          for (std::vector<std::string>::iterator it = items.begin(); it != items.end(); ++it) {
+            g_args.thresholds.push_back(atof(it->c_str()));
+          }
           break;
         case 'i':
           g_args.seq_id = optarg;
@@ -367,7 +600,11 @@ int main(int argc, char* argv[]){
           g_args.prefix = optarg;
           break;
         case 'm':
-          g_args.min_depth = std::stoi(optarg);
+          g_args.min_depths.clear();
+          items = split_option_list(optarg);
+          for (std::vector<std::string>::iterator it = items.begin(); it != items.end(); ++it) {
+            g_args.min_depths.push_back(std::stoi(*it));
+          }
           break;
         case 'n':
           g_args.gap = optarg[0];
@@ -379,6 +616,15 @@ int main(int argc, char* argv[]){
           g_args.keep_min_coverage = false;
         case 'g':
           break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'l':
+          g_args.live = true;
+          break;
+        case 'u':
+          g_args.live_interval = atof(optarg);
+          break;
         case 'h':
         case '?':
           print_consensus_usage();
@@ -402,18 +648,43 @@ int main(int argc, char* argv[]){
     g_args.prefix = get_filename_without_extension(g_args.prefix,".fasta");
     g_args.gap = (g_args.gap != 'N' && g_args.gap != '-') ? 'N' : g_args.gap; // Accept only N or -
 
+    if (g_args.thresholds.empty())
+      g_args.thresholds.push_back(g_args.min_threshold);
+    if (g_args.min_depths.empty())
+      g_args.min_depths.push_back(g_args.min_depth);
+
+    // One consensus for every combination of threshold and minimum depth
+    std::vector<consensus_setting> settings;
+    for (std::vector<double>::iterator t = g_args.thresholds.begin(); t != g_args.thresholds.end(); ++t) {
+      for (std::vector<int>::iterator m = g_args.min_depths.begin(); m != g_args.min_depths.end(); ++m) {
+        settings.push_back(consensus_setting(*t, *m));
+      }
+    }
+
     std::cout <<"Minimum Quality: " << (uint16_t) g_args.min_qual << std::endl;
-    std::cout << "Threshold: " << g_args.min_threshold << std::endl;
-    std::cout << "Minimum depth: " << (unsigned) g_args.min_depth << std::endl;
+    std::cout << "Threshold: ";
+    for (std::vector<double>::iterator t = g_args.thresholds.begin(); t != g_args.thresholds.end(); ++t) {
+      std::cout << ((t == g_args.thresholds.begin()) ? "" : ",") << *t;
+    }
+    std::cout << std::endl;
+    std::cout << "Minimum depth: ";
+    for (std::vector<int>::iterator m = g_args.min_depths.begin(); m != g_args.min_depths.end(); ++m) {
+      std::cout << ((m == g_args.min_depths.begin()) ? "" : ",") << *m;
+    }
+    std::cout << std::endl;
 
     if (!g_args.keep_min_coverage)
       std::cout << "Regions with depth less than minimum depth will not added to consensus" << std::endl;
     else
       std::cout << "Regions with depth less than minimum depth covered by: " << g_args.gap << std::endl;
-    
-    res = call_consensus_from_plup(std::cin, g_args.seq_id, g_args.prefix, g_args.min_qual, g_args.min_threshold, g_args.min_depth, g_args.gap, g_args.keep_min_coverage);
+
+    if (g_args.live)
+      res = call_consensus_live(STDIN_FILENO, g_args.seq_id, g_args.prefix, g_args.min_qual, settings, g_args.gap, g_args.keep_min_coverage, g_args.live_interval);
+    else
+      res = call_consensus_from_plup(std::cin, g_args.seq_id, g_args.prefix, g_args.min_qual, settings, g_args.gap, g_args.keep_min_coverage, get_thread_count(g_args.nthreads));
   } else if (cmd.compare("removereads") == 0) {
     opt = getopt( argc, argv, removereads_opt_str);
+    g_args.nthreads = 1;
     while( opt != -1 ) {
       switch( opt ) {
         case 'i':
@@ -428,6 +699,9 @@ int main(int argc, char* argv[]){
         case 'p':
           g_args.prefix = optarg;
           break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
         case 'h':
         case '?':
           print_removereads_usage();
@@ -450,10 +724,49 @@ int main(int argc, char* argv[]){
     fin.close();
 
     g_args.prefix = get_filename_without_extension(g_args.prefix,".bam");
-    res = rmv_reads_from_amplicon(g_args.bam, g_args.region, g_args.prefix, amp, g_args.bed, cl_cmd.str());
+    res = rmv_reads_from_amplicon(g_args.bam, g_args.region, g_args.prefix, amp, g_args.bed, cl_cmd.str(), get_thread_count(g_args.nthreads));
+  } else if (cmd.compare("maskreads") == 0) {
+    opt = getopt( argc, argv, maskreads_opt_str);
+    g_args.nthreads = 1;
+    while( opt != -1 ) {
+      switch( opt ) {
+        case 'i':
+          g_args.bam = optarg;
+          break;
+        case 'v':
+          g_args.variants = optarg;
+          break;
+        case 'b':
+          g_args.bed = optarg;
+          break;
+        case 'f':
+          g_args.primer_pair_file = optarg;
+          break;
+        case 'p':
+          g_args.prefix = optarg;
+          break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'h':
+        case '?':
+          print_maskreads_usage();
+          return 0;
+      }
+      opt = getopt( argc, argv, maskreads_opt_str);
+    }
+
+    if (g_args.bam.empty() || g_args.variants.empty() || g_args.bed.empty() || g_args.primer_pair_file.empty() || g_args.prefix.empty()) {
+      print_maskreads_usage();
+      return -1;
+    }
+
+    g_args.prefix = get_filename_without_extension(g_args.prefix,".bam");
+    res = mask_reads_from_variants(g_args.bam, g_args.variants, g_args.bed, g_args.primer_pair_file, g_args.prefix, cl_cmd.str(), get_thread_count(g_args.nthreads));
   } else if (cmd.compare("filtervariants") == 0) {
     opt = getopt( argc, argv, filtervariants_opt_str);
     g_args.min_threshold = 1;
+    g_args.out_format = "tsv";
     while ( opt != -1 ) {
       switch( opt ) {
         case 'p':
@@ -465,6 +778,9 @@ int main(int argc, char* argv[]){
         case 'f':
           g_args.file_list = optarg;
           break;
+        case 'F':
+          g_args.out_format = optarg;
+          break;
         case 'h':
         case '?':
           print_filtervariants_usage();
@@ -488,38 +804,69 @@ int main(int argc, char* argv[]){
       return -1;
     }
 
+    char out_format = OUT_FORMAT_TSV;
+    if (g_args.out_format.compare("matrix") == 0) {
+      out_format = OUT_FORMAT_MATRIX;
+    } else if (g_args.out_format.compare("tsv") != 0) {
+      std::cout << "Output format must be one of tsv or matrix." << std::endl;
+      print_filtervariants_usage();
+      return -1;
+    }
+
     g_args.prefix = get_filename_without_extension(g_args.prefix,".tsv");
+    g_args.prefix = get_filename_without_extension(g_args.prefix, MATRIX_EXT);
 
     // Read files from list
-    char **files = new char*[100];
-    int nfiles = 100, ctr = 0;
     std::string line;
     if (!g_args.file_list.empty()) {	// File list supplied
+      std::vector<char*> files;
       std::ifstream file_fin = std::ifstream(g_args.file_list);
       while (std::getline(file_fin, line)) {
-        files[ctr] = strdup(line.c_str());
-
-        if(ctr == nfiles - 1){
-          nfiles += 100;
-          *files = (char*) realloc(*files, nfiles * (sizeof(char*)));
-        }
-
-        ctr++;
+        if (!line.empty())
+          files.push_back(strdup(line.c_str()));
       }
       file_fin.close();
 
-      nfiles = (nfiles > ctr) ? ctr : nfiles;
-      res = common_variants(g_args.prefix, g_args.min_threshold, files, nfiles);
+      res = common_variants(g_args.prefix, g_args.min_threshold, files.data(), files.size(), out_format);
 
-      // Free files, nfiles
-      for (int i = 0; i < nfiles; ++i) {
-        free(files[i]);
+      // Free files
+      for (std::vector<char*>::iterator it = files.begin(); it != files.end(); ++it) {
+        free(*it);
       }
-
-      free(files);
     } else {
-      res = common_variants(g_args.prefix, g_args.min_threshold, argv + optind, argc - optind);
+      res = common_variants(g_args.prefix, g_args.min_threshold, argv + optind, argc - optind, out_format);
     }
+  } else if (cmd.compare("slicematrix") == 0) {
+    opt = getopt( argc, argv, slicematrix_opt_str);
+    while( opt != -1 ) {
+      switch( opt ) {
+        case 'i':
+          g_args.bam = optarg;
+          break;
+        case 'p':
+          g_args.prefix = optarg;
+          break;
+        case 'R':
+          g_args.region = optarg;
+          break;
+        case 's':
+          g_args.samples = split_option_list(optarg);
+          break;
+        case 'h':
+        case '?':
+          print_slicematrix_usage();
+          return 0;
+      }
+      opt = getopt( argc, argv, slicematrix_opt_str);
+    }
+
+    if (g_args.bam.empty() || g_args.prefix.empty()) {
+      print_slicematrix_usage();
+      return -1;
+    }
+
+    g_args.prefix = get_filename_without_extension(g_args.prefix,".tsv");
+    res = slice_variant_matrix(g_args.bam, g_args.prefix, g_args.region, g_args.samples);
   } else if (cmd.compare("getmasked") == 0) {
     opt = getopt( argc, argv, getmasked_opt_str);
     while( opt != -1 ) {
@@ -553,6 +900,8 @@ int main(int argc, char* argv[]){
     res = get_primers_with_mismatches(g_args.bed, g_args.bam, g_args.prefix, g_args.primer_pair_file);
   } else if (cmd.compare("trimadapter") == 0) {
     opt = getopt( argc, argv, trimadapter_opt_str);
+    g_args.nthreads = 1;
+    g_args.out_format = "";
     while( opt != -1 ) {
       switch( opt ) {
         case '1':
@@ -567,6 +916,12 @@ int main(int argc, char* argv[]){
         case 'a':
           g_args.adp_path = optarg;
           break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'F':
+          g_args.out_format = optarg;
+          break;
         case 'h':
         case '?':
           print_trimadapter_usage();
@@ -580,7 +935,242 @@ int main(int argc, char* argv[]){
       return -1;
     }
 
-    res = trim_adapter(g_args.f1, g_args.f2, g_args.adp_path, g_args.prefix);
+    if (g_args.out_format.empty()) {
+      bool gz = g_args.f1.size() >= 3 && g_args.f1.compare(g_args.f1.size() - 3, 3, ".gz") == 0;
+      g_args.out_format = gz ? "fastq.gz" : "fastq";
+    }
+
+    char out_format = FASTQ_OUTPUT;
+    if (g_args.out_format.compare("fastq.gz") == 0) {
+      out_format = FASTQ_GZ_OUTPUT;
+    } else if (g_args.out_format.compare("fastq") != 0) {
+      std::cout << "Output format must be one of fastq or fastq.gz." << std::endl;
+      print_trimadapter_usage();
+      return -1;
+    }
+
+    res = trim_adapter(g_args.f1, g_args.f2, g_args.adp_path, g_args.prefix, out_format, get_thread_count(g_args.nthreads));
+  } else if (cmd.compare("pipeline") == 0) {
+    opt = getopt( argc, argv, pipeline_opt_str);
+    pipeline_settings settings;
+    g_args.bed = "";
+    g_args.primer_pair_file = "";
+    g_args.primer_offset = 0;
+    g_args.ref = "";
+    g_args.gff = "";
+    g_args.out_format = "tsv";
+    g_args.nthreads = 1;
+    while( opt != -1 ) {
+      switch( opt ) {
+        case 'i':
+          g_args.bam = optarg;
+          break;
+        case 'b':
+          g_args.bed = optarg;
+          break;
+        case 'f':
+          g_args.primer_pair_file = optarg;
+          break;
+        case 'x':
+          g_args.primer_offset = std::stoi(optarg);
+          break;
+        case 'r':
+          g_args.ref = optarg;
+          break;
+        case 'g':
+          g_args.gff = optarg;
+          break;
+        case 'p':
+          g_args.prefix = optarg;
+          break;
+        case 'q':
+          settings.min_qual = std::stoi(optarg);
+          settings.trim.min_qual = settings.min_qual;
+          break;
+        case 's':
+          settings.trim.sliding_window = std::stoi(optarg);
+          break;
+        case 'l':
+          settings.trim.min_length = std::stoi(optarg);
+          break;
+        case 'e':
+          settings.trim.write_no_primer_reads = true;
+          break;
+        case 'k':
+          settings.trim.keep_for_reanalysis = true;
+          break;
+        case 't':
+          settings.min_threshold = atof(optarg);
+          break;
+        case 'm':
+          settings.min_depth = std::stoi(optarg);
+          break;
+        case 'c':
+          settings.consensus_threshold = atof(optarg);
+          break;
+        case 'd':
+          settings.consensus_min_depth = std::stoi(optarg);
+          break;
+        case 'n':
+          settings.gap = optarg[0];
+          break;
+        case 'F':
+          g_args.out_format = optarg;
+          break;
+        case 'w':
+          settings.write_trimmed = true;
+          break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'h':
+        case '?':
+          print_pipeline_usage();
+          return 0;
+      }
+      opt = getopt( argc, argv, pipeline_opt_str);
+    }
+
+    if (g_args.bam.empty() || g_args.prefix.empty()) {
+      print_pipeline_usage();
+      return -1;
+    }
+    if (!g_args.gff.empty() && g_args.ref.empty()) {
+      std::cout << "Please specify reference (using -r) based on which the GFF file was computed." << std::endl;
+      print_pipeline_usage();
+      return -1;
+    }
+    if (g_args.out_format.compare("vcf") == 0) {
+      settings.variants_format = VCF_OUTPUT;
+    } else if (g_args.out_format.compare("bcf") == 0) {
+      settings.variants_format = BCF_OUTPUT;
+    } else if (g_args.out_format.compare("tsv.gz") == 0) {
+      settings.variants_format = TSV_GZ_OUTPUT;
+    } else if (g_args.out_format.compare("tsv") != 0) {
+      std::cout << "Output format must be one of tsv, tsv.gz, vcf or bcf." << std::endl;
+      print_pipeline_usage();
+      return -1;
+    }
+    if (output_format_needs_ref(settings.variants_format) && g_args.ref.empty()) {
+      std::cout << "Please specify a reference (using -r) to write VCF/BCF output." << std::endl;
+      print_pipeline_usage();
+      return -1;
+    }
+    settings.min_threshold = (settings.min_threshold < 0 || settings.min_threshold > 1) ? 0.03 : settings.min_threshold;
+    settings.consensus_threshold = (settings.consensus_threshold < 0 || settings.consensus_threshold > 1) ? 0 : settings.consensus_threshold;
+    settings.nthreads = get_thread_count(g_args.nthreads);
+    res = run_pipeline(g_args.bam, g_args.bed, g_args.primer_pair_file, g_args.primer_offset, g_args.ref, g_args.gff, g_args.prefix, settings, cl_cmd.str());
+  } else if (cmd.compare("batch") == 0) {
+    opt = getopt( argc, argv, batch_opt_str);
+    batch_settings settings;
+    g_args.nthreads = 1;
+    while( opt != -1 ) {
+      switch( opt ) {
+        case 'p':
+          g_args.prefix = optarg;
+          break;
+        case 'b':
+          settings.bed = optarg;
+          break;
+        case 'f':
+          settings.pair_info = optarg;
+          break;
+        case 'x':
+          settings.primer_offset = std::stoi(optarg);
+          break;
+        case 'r':
+          settings.ref = optarg;
+          break;
+        case 'g':
+          settings.gff = optarg;
+          break;
+        case 'q':
+          settings.min_qual = std::stoi(optarg);
+          break;
+        case 't':
+          settings.min_threshold = atof(optarg);
+          break;
+        case 'm':
+          settings.min_depth = std::stoi(optarg);
+          break;
+        case 'n':
+          settings.gap = optarg[0];
+          break;
+        case 'e':
+          settings.write_no_primer_reads = true;
+          break;
+        case 'k':
+          settings.keep_for_reanalysis = true;
+          break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'h':
+        case '?':
+          print_batch_usage();
+          return 0;
+      }
+      opt = getopt( argc, argv, batch_opt_str);
+    }
+
+    if (g_args.prefix.empty() || optind >= argc) {
+      print_batch_usage();
+      return -1;
+    }
+    g_args.prefix = get_filename_without_extension(g_args.prefix,".tsv");
+    res = run_batch(argv[optind], settings, g_args.prefix + ".tsv", get_thread_count(g_args.nthreads));
+  } else if (cmd.compare("serve") == 0) {
+    opt = getopt( argc, argv, serve_opt_str);
+    g_args.nthreads = 1;
+    while( opt != -1 ) {
+      switch( opt ) {
+        case 's':
+          g_args.socket = optarg;
+          break;
+        case '@':
+          g_args.nthreads = std::stoi(optarg);
+          break;
+        case 'h':
+        case '?':
+          print_serve_usage();
+          return 0;
+      }
+      opt = getopt( argc, argv, serve_opt_str);
+    }
+
+    if (g_args.socket.empty()) {
+      print_serve_usage();
+      return -1;
+    }
+    res = serve_jobs(g_args.socket, get_thread_count(g_args.nthreads));
+  } else if (cmd.compare("client") == 0) {
+    opt = getopt( argc, argv, client_opt_str);
+    while( opt != -1 ) {
+      switch( opt ) {
+        case 's':
+          g_args.socket = optarg;
+          break;
+        case 'j':
+          g_args.job = optarg;
+          break;
+        case 'h':
+        case '?':
+          print_client_usage();
+          return 0;
+      }
+      opt = getopt( argc, argv, client_opt_str);
+    }
+
+    if (g_args.socket.empty() || (g_args.job.empty() && isatty(STDIN_FILENO))) {
+      print_client_usage();
+      return -1;
+    }
+    if (!g_args.job.empty()) {
+      std::istringstream jobs(g_args.job);
+      res = submit_jobs(g_args.socket, jobs, std::cout);
+    } else {
+      res = submit_jobs(g_args.socket, std::cin, std::cout);
+    }
   } else if (cmd.compare("version") == 0) {
     print_version_info();
   } else {
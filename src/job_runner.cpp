@@ -0,0 +1,402 @@
+#include <stdlib.h>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+
+#include "job_runner.h"
+
+static void skip_space(const std::string &s, size_t &i) {
+  while (i < s.size() && isspace((unsigned char) s[i]))
+    i++;
+}
+
+// Append the UTF-8 encoding of code point cp to out
+static void append_utf8(std::string &out, unsigned int cp) {
+  if (cp < 0x80) {
+    out += (char) cp;
+  } else if (cp < 0x800) {
+    out += (char) (0xC0 | (cp >> 6));
+    out += (char) (0x80 | (cp & 0x3F));
+  } else {
+    out += (char) (0xE0 | (cp >> 12));
+    out += (char) (0x80 | ((cp >> 6) & 0x3F));
+    out += (char) (0x80 | (cp & 0x3F));
+  }
+}
+
+// Parse the JSON string that starts at the quote at i. i is left after the closing quote.
+static int parse_json_string(const std::string &s, size_t &i, std::string &out) {
+  out.clear();
+  if (i >= s.size() || s[i] != '"')
+    return -1;
+  for (i++; i < s.size(); i++) {
+    if (s[i] == '"') {
+      i++;
+      return 0;
+    }
+    if (s[i] != '\\') {
+      out += s[i];
+      continue;
+    }
+    if (++i >= s.size())
+      return -1;
+    switch (s[i]) {
+      case '"':
+      case '\\':
+      case '/':
+        out += s[i];
+        break;
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u':
+        if (i + 4 >= s.size())
+          return -1;
+        for (size_t j = i + 1; j <= i + 4; ++j) {
+          if (!isxdigit((unsigned char) s[j]))
+            return -1;
+        }
+        append_utf8(out, strtoul(s.substr(i + 1, 4).c_str(), NULL, 16));
+        i += 4;
+        break;
+      default:
+        return -1;
+    }
+  }
+  return -1;
+}
+
+static bool is_json_number(const std::string &s) {
+  char *end;
+  if (s.empty())
+    return false;
+  strtod(s.c_str(), &end);
+  return *end == '\0';
+}
+
+/*
+  Parse a flat JSON object into req. Values may be strings, numbers, true, false or null. Nested
+  objects and arrays are not accepted. null is kept as an empty value. Returns -1 if line is not
+  such an object.
+*/
+int parse_job_request(const std::string &line, job_request &req) {
+  size_t i = 0, start;
+  std::string key, value;
+  req.clear();
+  skip_space(line, i);
+  if (i >= line.size() || line[i] != '{')
+    return -1;
+  i++;
+  skip_space(line, i);
+  if (i < line.size() && line[i] == '}') {
+    i++;
+  } else {
+    while (true) {
+      skip_space(line, i);
+      if (parse_json_string(line, i, key) != 0)
+        return -1;
+      skip_space(line, i);
+      if (i >= line.size() || line[i] != ':')
+        return -1;
+      i++;
+      skip_space(line, i);
+      if (i < line.size() && line[i] == '"') {
+        if (parse_json_string(line, i, value) != 0)
+          return -1;
+      } else {
+        start = i;
+        while (i < line.size() && line[i] != ',' && line[i] != '}' && !isspace((unsigned char) line[i]))
+          i++;
+        value = line.substr(start, i - start);
+        if (value == "null")
+          value = "";
+        else if (value != "true" && value != "false" && !is_json_number(value))
+          return -1;
+      }
+      req[key] = value;
+      skip_space(line, i);
+      if (i < line.size() && line[i] == ',') {
+        i++;
+        continue;
+      }
+      if (i < line.size() && line[i] == '}') {
+        i++;
+        break;
+      }
+      return -1;
+    }
+  }
+  skip_space(line, i);
+  return (i == line.size()) ? 0 : -1;
+}
+
+// Write req as one line of JSON with every value as a string
+std::string write_job_request(const job_request &req) {
+  std::string line = "{";
+  for (job_request::const_iterator it = req.begin(); it != req.end(); ++it) {
+    if (it != req.begin())
+      line += ", ";
+    line += "\"" + json_escape(it->first) + "\": \"" + json_escape(it->second) + "\"";
+  }
+  return line + "}";
+}
+
+std::string json_escape(const std::string &s) {
+  std::string out;
+  char hex[8];
+  for (size_t i = 0; i < s.size(); ++i) {
+    switch (s[i]) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      default:
+        if ((unsigned char) s[i] < 0x20) {
+          snprintf(hex, sizeof(hex), "\\u%04x", (unsigned char) s[i]);
+          out += hex;
+        } else {
+          out += s[i];
+        }
+    }
+  }
+  return out;
+}
+
+static std::string get_value(const job_request &req, const std::string &key, const std::string &def = "") {
+  job_request::const_iterator it = req.find(key);
+  return (it == req.end() || it->second.empty()) ? def : it->second;
+}
+
+static int get_int(const job_request &req, const std::string &key, int def) {
+  std::string value = get_value(req, key);
+  return value.empty() ? def : std::stoi(value);
+}
+
+static double get_double(const job_request &req, const std::string &key, double def) {
+  std::string value = get_value(req, key);
+  return value.empty() ? def : std::stod(value);
+}
+
+static bool get_bool(const job_request &req, const std::string &key, bool def) {
+  std::string value = get_value(req, key);
+  return value.empty() ? def : (value == "true" || value == "1");
+}
+
+// Path in key. Relative paths are taken from "cwd", the directory the job was submitted from.
+static std::string get_path(const job_request &req, const std::string &key) {
+  std::string path = get_value(req, key), cwd = get_value(req, "cwd");
+  if (path.empty() || path[0] == '/' || cwd.empty())
+    return path;
+  return cwd + "/" + path;
+}
+
+static void add_field(std::ostringstream &fields, const std::string &key, const std::string &value) {
+  fields << ", \"" << key << "\": \"" << json_escape(value) << "\"";
+}
+
+template <typename T>
+static void add_number(std::ostringstream &fields, const std::string &key, T value) {
+  fields << ", \"" << key << "\": " << value;
+}
+
+static void add_bool(std::ostringstream &fields, const std::string &key, bool value) {
+  fields << ", \"" << key << "\": " << (value ? "true" : "false");
+}
+
+std::string error_response(const std::string &message) {
+  return "{\"status\": \"error\", \"message\": \"" + json_escape(message) + "\"}";
+}
+
+job_runner::job_runner() {
+  this->jobs_done = 0;
+  this->jobs_failed = 0;
+}
+
+/*
+  Run one job and return its response. Every response has "status", "ok" or "error". Jobs that
+  ran also have "cmd", "result", the return code of the command, "seconds" and the counts of
+  the command.
+*/
+std::string job_runner::run_job(const job_request &req) {
+  std::string cmd = get_value(req, "cmd");
+  std::ostringstream fields, response;
+  int res;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  if (cmd == "stats")
+    return get_stats();
+  try {
+    if (cmd == "trim") {
+      res = run_trim(req, fields);
+    } else if (cmd == "variants") {
+      res = run_variants(req, fields);
+    } else if (cmd == "consensus") {
+      res = run_consensus(req, fields);
+    } else {
+      return error_response("Unknown command: " + cmd);
+    }
+  } catch (const std::exception &e) {
+    // std::stoi and std::stod on values that are not numbers
+    res = -1;
+    fields.str("");
+    add_field(fields, "message", std::string("Invalid value in job: ") + e.what());
+  }
+  std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+  {
+    std::lock_guard<std::mutex> lock(stats_mtx);
+    jobs_done++;
+    if (res != 0)
+      jobs_failed++;
+  }
+  response << "{\"status\": \"" << ((res == 0) ? "ok" : "error") << "\", \"cmd\": \"" << cmd << "\", \"result\": " << res << ", \"seconds\": " << seconds.count() << fields.str() << "}";
+  return response.str();
+}
+
+// Schemes are keyed on all arguments of primer_scheme::load. Failed loads are not kept.
+const primer_scheme* job_runner::get_scheme(std::string bed, std::string pair_info, int32_t offset, bool &cached) {
+  std::string key = bed + "\t" + pair_info + "\t" + std::to_string(offset);
+  std::lock_guard<std::mutex> lock(schemes_mtx);
+  std::map<std::string, std::unique_ptr<primer_scheme> >::iterator it = schemes.find(key);
+  cached = (it != schemes.end());
+  if (cached)
+    return it->second.get();
+  std::unique_ptr<primer_scheme> scheme(new primer_scheme());
+  if (!bed.empty() && scheme->load(bed, pair_info, offset) != 0)
+    return NULL;
+  const primer_scheme *res = scheme.get();
+  schemes[key] = std::move(scheme);
+  return res;
+}
+
+int job_runner::run_trim(const job_request &req, std::ostringstream &fields) {
+  std::string bam = get_path(req, "bam"), prefix = get_path(req, "prefix"), bed = get_path(req, "bed"), cmd;
+  trim_settings settings;
+  trim_stats stats;
+  bool cached;
+  if (bam.empty() || prefix.empty()) {
+    add_field(fields, "message", "trim jobs need bam and prefix");
+    return -1;
+  }
+  settings.min_qual = get_int(req, "min_qual", settings.min_qual);
+  settings.sliding_window = get_int(req, "sliding_window", settings.sliding_window);
+  settings.min_length = get_int(req, "min_length", settings.min_length);
+  settings.write_no_primer_reads = get_bool(req, "write_no_primer_reads", settings.write_no_primer_reads);
+  settings.keep_for_reanalysis = get_bool(req, "keep_for_reanalysis", settings.keep_for_reanalysis);
+  const primer_scheme *scheme = get_scheme(bed, get_path(req, "pairs"), get_int(req, "primer_offset", 0), cached);
+  if (scheme == NULL) {
+    add_field(fields, "message", "Unable to load primers from " + bed);
+    return -1;
+  }
+  cmd = "ivar trim -i " + bam + " -p " + prefix + (bed.empty() ? "" : " -b " + bed);
+  int res = trim_bam_qual_primer(bam, *scheme, prefix, get_value(req, "region"), settings, cmd, stats);
+  add_bool(fields, "cached_primers", cached);
+  add_number(fields, "primer_trimmed", stats.primer_trimmed);
+  add_number(fields, "no_primer", stats.no_primer);
+  add_number(fields, "low_quality", stats.low_quality);
+  add_number(fields, "unmapped", stats.unmapped);
+  add_number(fields, "outside_amplicon", stats.outside_amplicon);
+  return res;
+}
+
+int job_runner::run_variants(const job_request &req, std::ostringstream &fields) {
+  std::string bam = get_path(req, "bam"), mpileup = get_path(req, "mpileup"), prefix = get_path(req, "prefix"), ref = get_path(req, "ref"), format = get_value(req, "format", "tsv");
+  char out_format = TSV_OUTPUT;
+  bool cached;
+  int res;
+  if ((bam.empty() && mpileup.empty()) || prefix.empty()) {
+    add_field(fields, "message", "variants jobs need bam or mpileup and prefix");
+    return -1;
+  }
+  if (format == "vcf") {
+    out_format = VCF_OUTPUT;
+  } else if (format == "bcf") {
+    out_format = BCF_OUTPUT;
+  } else if (format == "tsv.gz") {
+    out_format = TSV_GZ_OUTPUT;
+  } else if (format != "tsv") {
+    add_field(fields, "message", "Unknown output format: " + format);
+    return -1;
+  }
+  if (output_format_needs_ref(out_format) && ref.empty()) {
+    add_field(fields, "message", "VCF/BCF output needs ref");
+    return -1;
+  }
+  uint8_t min_qual = get_int(req, "min_qual", 20), min_depth = get_int(req, "min_depth", 0);
+  double min_threshold = get_double(req, "min_threshold", 0.03);
+  unsigned int threads = get_int(req, "threads", 1);
+  ref_antd &refantd = refs.get(ref, get_path(req, "gff"), &cached);
+  if (!bam.empty()) {
+    pileup_opts opts;
+    opts.min_base_qual = get_int(req, "min_base_qual", opts.min_base_qual);
+    opts.max_depth = get_int(req, "max_depth", opts.max_depth);
+    opts.min_map_qual = get_int(req, "min_map_qual", opts.min_map_qual);
+    opts.count_orphans = !get_bool(req, "skip_orphans", false);
+    opts.detect_overlaps = !get_bool(req, "ignore_overlaps", false);
+    res = call_variants_from_bam(bam, prefix, min_qual, min_threshold, min_depth, refantd, opts, threads, out_format);
+  } else {
+    std::ifstream plup(mpileup.c_str());
+    if (!plup.is_open()) {
+      add_field(fields, "message", "Unable to open " + mpileup);
+      return -1;
+    }
+    res = call_variants_from_plup(plup, prefix, min_qual, min_threshold, min_depth, refantd, threads, out_format);
+  }
+  add_bool(fields, "cached_reference", cached);
+  return res;
+}
+
+int job_runner::run_consensus(const job_request &req, std::ostringstream &fields) {
+  std::string mpileup = get_path(req, "mpileup"), prefix = get_path(req, "prefix"), gap = get_value(req, "gap", "N");
+  std::vector<consensus_setting> settings;
+  std::vector<consensus_stats> stats;
+  if (mpileup.empty() || prefix.empty()) {
+    add_field(fields, "message", "consensus jobs need mpileup and prefix");
+    return -1;
+  }
+  std::ifstream plup(mpileup.c_str());
+  if (!plup.is_open()) {
+    add_field(fields, "message", "Unable to open " + mpileup);
+    return -1;
+  }
+  settings.push_back(consensus_setting(get_double(req, "min_threshold", 0), get_int(req, "min_depth", 10)));
+  int res = call_consensus_from_plup(plup, get_value(req, "seq_id"), prefix, get_int(req, "min_qual", 20), settings, gap[0], get_bool(req, "keep_min_coverage", true), stats, get_int(req, "threads", 1));
+  add_number(fields, "total_bases", stats[0].total_bases);
+  add_number(fields, "bases_zero_depth", stats[0].bases_zero_depth);
+  add_number(fields, "bases_min_depth", stats[0].bases_min_depth);
+  return res;
+}
+
+std::string job_runner::get_stats() {
+  std::ostringstream response;
+  size_t nschemes;
+  {
+    std::lock_guard<std::mutex> lock(schemes_mtx);
+    nschemes = schemes.size();
+  }
+  std::lock_guard<std::mutex> lock(stats_mtx);
+  response << "{\"status\": \"ok\", \"cmd\": \"stats\", \"jobs\": " << jobs_done << ", \"failed\": " << jobs_failed << ", \"primer_schemes\": " << nschemes << ", \"references\": " << refs.size() << "}";
+  return response.str();
+}
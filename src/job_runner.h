@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "libivar.h"
+
+#ifndef IVAR_JOB_RUNNER_H
+#define IVAR_JOB_RUNNER_H
+
+// Flat JSON object of a job, every value kept as text. true and false are kept as "true" and "false".
+typedef std::map<std::string, std::string> job_request;
+
+int parse_job_request(const std::string &line, job_request &req);
+std::string write_job_request(const job_request &req);
+std::string json_escape(const std::string &s);
+std::string error_response(const std::string &message);
+
+/*
+  Runs trim, variants and consensus jobs given as job requests, for example
+
+  {"cmd": "variants", "bam": "s1.bam", "prefix": "s1", "ref": "ref.fa", "gff": "ref.gff"}
+
+  and returns one line of JSON with the result and the counts of the job. Primer schemes,
+  references and annotations are loaded by the first job that uses them and kept for later
+  jobs. Jobs can be run from many threads at once. Used by `ivar serve` and `ivar batch`.
+*/
+class job_runner {
+public:
+  job_runner();
+  std::string run_job(const job_request &req);
+
+private:
+  int run_trim(const job_request &req, std::ostringstream &fields);
+  int run_variants(const job_request &req, std::ostringstream &fields);
+  int run_consensus(const job_request &req, std::ostringstream &fields);
+  std::string get_stats();
+  const primer_scheme* get_scheme(std::string bed, std::string pair_info, int32_t offset, bool &cached);
+
+  reference_store refs;
+  std::map<std::string, std::unique_ptr<primer_scheme> > schemes;
+  std::mutex schemes_mtx;
+  uint64_t jobs_done, jobs_failed;
+  std::mutex stats_mtx;
+};
+
+#endif
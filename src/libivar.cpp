@@ -0,0 +1,74 @@
+#include "libivar.h"
+
+// Reference and annotation at these paths. cached is set if they were already loaded. Safe to call from several threads.
+ref_antd& reference_store::get(std::string ref_path, std::string gff_path, bool *cached) {
+  std::lock_guard<std::mutex> lock(mtx);
+  std::unique_ptr<ref_antd> &ref = refs[std::make_pair(ref_path, gff_path)];
+
+  if (cached != NULL)
+    *cached = (ref != NULL);
+
+  if (!ref)
+    ref.reset(new ref_antd(ref_path, gff_path));
+
+  return *ref;
+}
+
+size_t reference_store::size() const {
+  std::lock_guard<std::mutex> lock(mtx);
+  return refs.size();
+}
+
+variant_caller::variant_caller(ref_antd &refantd, uint8_t min_qual, double min_threshold, uint8_t min_depth, unsigned int nthreads) : refantd(refantd) {
+  this->min_qual = min_qual;
+  this->min_threshold = min_threshold;
+  this->min_depth = min_depth;
+  this->nthreads = nthreads;
+}
+
+// Call variants from mpileup text. header writes the tsv header line first.
+int variant_caller::call_pileup(std::istream &plup, std::ostream &out, bool header) {
+  if (header)
+    print_variants_header(out);
+
+  return call_variants_from_plup(plup, out, refantd, min_qual, min_threshold, min_depth, nthreads);
+}
+
+// Call variants from the reads in bam, the same as call_pileup() on `samtools mpileup` output with matching opts
+int variant_caller::call_bam(std::string bam, std::ostream &out, pileup_opts opts, bool header) {
+  if (header)
+    print_variants_header(out);
+
+  return call_variants_from_bam(bam, out, refantd, min_qual, min_threshold, min_depth, opts, nthreads);
+}
+
+consensus_caller::consensus_caller(const std::vector<consensus_setting> &settings, uint8_t min_qual, char gap, bool min_coverage_flag, unsigned int nthreads) : settings(settings) {
+  this->min_qual = min_qual;
+  this->gap = gap;
+  this->min_coverage_flag = min_coverage_flag;
+  this->nthreads = nthreads;
+}
+
+/*
+  Call the consensus of every setting from mpileup text into fout and qout, which hold one stream
+  per setting. Records are named as `ivar consensus -p <name>` would name them, or seq_id if it is
+  given. Counts of the call are returned by get_stats().
+*/
+int consensus_caller::call_pileup(std::istream &plup, std::string name, std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, std::string seq_id) {
+  std::vector<std::string> headers;
+
+  if (fout.size() != settings.size() || qout.size() != settings.size())
+    return -1;
+
+  for (size_t i = 0; i < settings.size(); ++i) {
+    headers.push_back(get_consensus_header(seq_id, get_consensus_out_file(name, settings[i], settings.size() > 1), settings[i], min_qual));
+  }
+
+  stats.assign(settings.size(), consensus_stats());
+
+  return call_consensus_from_plup(plup, fout, qout, headers, min_qual, settings, gap, min_coverage_flag, stats, nthreads);
+}
+
+const std::vector<consensus_stats>& consensus_caller::get_stats() const {
+  return stats;
+}
@@ -0,0 +1,79 @@
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "primer_bed.h"
+#include "interval_tree.h"
+#include "trim_primer_quality.h"
+#include "ref_seq.h"
+#include "bam_pileup.h"
+#include "call_variants.h"
+#include "call_consensus_pileup.h"
+#include "get_masked_amplicons.h"
+#include "remove_reads_from_amplicon.h"
+#include "suffix_tree.h"
+
+#ifndef IVAR_LIBIVAR_H
+#define IVAR_LIBIVAR_H
+
+/*
+  C++ API of libivar, the library the ivar command is built on. Inputs shared by many samples are
+  loaded once into objects that are then used for every sample:
+
+  primer_scheme      Primers and amplicons of a BED and primer pair file (trim_primer_quality.h)
+  read_trimmer       Primer and quality trimming of alignment records in memory (trim_primer_quality.h)
+  reference_store    References with their annotations, loaded once per path
+  variant_caller     Variants from a pileup stream or BAM file to a stream
+  consensus_caller   Consensus from a pileup stream to FASTA and quality streams
+
+  Callers write to streams the caller owns, so one process can run many samples without
+  temporary files. Errors are returned as -1 as in the rest of ivar.
+*/
+
+// References with their GFF annotations, loaded on first use and kept for the lifetime of the store
+class reference_store {
+public:
+  ref_antd& get(std::string ref_path, std::string gff_path = "", bool *cached = NULL);
+  size_t size() const;
+
+private:
+  std::map<std::pair<std::string, std::string>, std::unique_ptr<ref_antd> > refs;
+  mutable std::mutex mtx;
+};
+
+// Settings of `ivar variants` applied to one reference. Output is the tsv of `ivar variants`.
+class variant_caller {
+public:
+  variant_caller(ref_antd &refantd, uint8_t min_qual = 20, double min_threshold = 0.03, uint8_t min_depth = 0, unsigned int nthreads = 1);
+  int call_pileup(std::istream &plup, std::ostream &out, bool header = true);
+  int call_bam(std::string bam, std::ostream &out, pileup_opts opts = pileup_opts(), bool header = true);
+
+private:
+  ref_antd &refantd;
+  uint8_t min_qual;
+  double min_threshold;
+  uint8_t min_depth;
+  unsigned int nthreads;
+};
+
+// Settings of `ivar consensus` with one or more threshold and minimum depth pairs
+class consensus_caller {
+public:
+  consensus_caller(const std::vector<consensus_setting> &settings, uint8_t min_qual = 20, char gap = 'N', bool min_coverage_flag = true, unsigned int nthreads = 1);
+  int call_pileup(std::istream &plup, std::string name, std::vector<std::ostream*> &fout, std::vector<std::ostream*> &qout, std::string seq_id = "");
+  const std::vector<consensus_stats>& get_stats() const;
+
+private:
+  std::vector<consensus_setting> settings;
+  uint8_t min_qual;
+  char gap;
+  bool min_coverage_flag;
+  unsigned int nthreads;
+  std::vector<consensus_stats> stats;
+};
+
+#endif
@@ -0,0 +1,395 @@
+#include "live_consensus.h"
+
+live_column::live_column() : mdepth(0), covered(false), observed(false), changed(false) {
+  for (int s = 0; s < NUM_BASE_SYMBOLS; ++s) {
+    depth[s] = 0;
+    end[s] = 0;
+    qual_sum[s] = 0;
+  }
+}
+
+live_consensus::live_consensus(std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag) : settings(settings), min_qual(min_qual), gap(gap), min_coverage_flag(min_coverage_flag) {
+  for (size_t i = 0; i < settings.size(); ++i) {
+    out_files.push_back(get_consensus_out_file(out_file, settings[i], settings.size() > 1));
+    headers.push_back(get_consensus_header(seq_id, out_files[i], settings[i], min_qual));
+  }
+}
+
+uint32_t live_consensus::get_changed_count() const {
+  return changed.size();
+}
+
+// Add the alleles of one pileup line to the counts of a position
+void live_consensus::add_alleles(live_column &c, const std::vector<allele> &ad) {
+  std::vector<allele>::const_iterator it;
+  std::vector<live_allele>::iterator e;
+  uint64_t qual_sum;
+  int s;
+
+  for (it = ad.begin(); it != ad.end(); ++it) {
+    c.observed = true;
+    qual_sum = std::llround(it->tmp_mean_qual * it->depth);
+
+    s = (it->nuc.length() == 1) ? base_symbol_index(it->nuc[0]) : -1;
+    if (s >= 0) {
+      c.depth[s] += it->depth;
+      c.end[s] += it->end;
+      c.qual_sum[s] += qual_sum;
+      continue;
+    }
+
+    if (it->nuc.empty() || it->nuc[0] == '-')	// Not part of the consensus
+      continue;
+
+    for (e = c.extra.begin(); e != c.extra.end() && e->nuc != it->nuc; ++e);
+    if (e == c.extra.end()) {
+      live_allele a;
+      a.nuc = it->nuc;
+      a.depth = 0;
+      a.end = 0;
+      a.qual_sum = 0;
+      e = c.extra.insert(e, a);
+    }
+    e->depth += it->depth;
+    e->end += it->end;
+    e->qual_sum += qual_sum;
+  }
+}
+
+// Parse a whole cell as a non-negative integer of at most max. Returns -1 otherwise.
+static int64_t parse_cell(const std::string &cell, int64_t max) {
+  char *end;
+  errno = 0;
+  long long v = strtoll(cell.c_str(), &end, 10);
+  if (cell.empty() || *end != '\0' || errno != 0 || v < 0 || v > max)
+    return -1;
+  return v;
+}
+
+// Add one mpileup line of new reads. Returns -1 without changing the counts if the line is malformed.
+int live_consensus::add_line(const std::string &line) {
+  std::vector<std::string> cells;
+  size_t start = 0, tab;
+
+  while (cells.size() < 6) {
+    tab = line.find('\t', start);
+    cells.push_back(line.substr(start, (tab == std::string::npos) ? std::string::npos : tab - start));
+    if (tab == std::string::npos)
+      break;
+    start = tab + 1;
+  }
+
+  if (cells.size() < 4 || cells[2].empty())
+    return -1;
+  cells.resize(6);
+
+  int64_t pos = parse_cell(cells[1], MAX_LIVE_POS);
+  int64_t depth = parse_cell(cells[3], UINT32_MAX);
+  if (pos < 1 || depth < 0)
+    return -1;
+
+  std::map<std::string, size_t>::iterator r = region_ids.find(cells[0]);
+  if (r == region_ids.end()) {
+    r = region_ids.insert(std::make_pair(cells[0], regions.size())).first;
+    regions.push_back(live_region());
+    regions.back().name = cells[0];
+  }
+
+  live_region &region = regions[r->second];
+  if ((int64_t) region.columns.size() < pos)
+    region.columns.resize(pos);
+
+  live_column &c = region.columns[pos - 1];
+  c.covered = true;
+  c.mdepth += depth;
+  add_alleles(c, update_allele_depth(cells[2][0], cells[4], cells[5], min_qual));
+
+  if (!c.changed) {
+    c.changed = true;
+    changed.push_back(std::make_pair(r->second, pos - 1));
+  }
+
+  return 0;
+}
+
+// Consensus of one position from its summed counts. Mean qualities are taken from the sum of qualities.
+ret_t live_consensus::call_column(const live_column &c, double threshold) const {
+  ret_t t;
+  int s;
+
+  if (c.extra.empty()) {
+    base_counts counts;
+    char nuc, q;
+    for (s = 0; s < NUM_BASE_SYMBOLS; ++s) {
+      counts.depth[s] = c.depth[s];
+      counts.mean_qual[s] = (c.depth[s] == 0) ? 0 : (double) c.qual_sum[s] / c.depth[s];
+    }
+    counts.observed = c.observed;
+
+    int len = get_consensus_base(counts, min_qual, threshold, gap, nuc, q);
+    t.nuc.assign(len, nuc);
+    t.q.assign(len, q);
+    return t;
+  }
+
+  std::vector<allele> ad;
+  allele a;
+  a.reverse = 0;
+  a.beg = 0;
+
+  for (s = 0; s < NUM_BASE_SYMBOLS; ++s) {
+    if (c.depth[s] == 0)
+      continue;
+    a.nuc = std::string(1, BASE_SYMBOLS[s]);
+    a.depth = c.depth[s];
+    a.end = c.end[s];
+    a.tmp_mean_qual = (double) c.qual_sum[s] / c.depth[s];
+    a.mean_qual = (uint8_t) a.tmp_mean_qual;
+    ad.push_back(a);
+  }
+
+  for (std::vector<live_allele>::const_iterator it = c.extra.begin(); it != c.extra.end(); ++it) {
+    a.nuc = it->nuc;
+    a.depth = it->depth;
+    a.end = it->end;
+    a.tmp_mean_qual = (double) it->qual_sum / it->depth;
+    a.mean_qual = (uint8_t) a.tmp_mean_qual;
+    ad.push_back(a);
+  }
+
+  std::sort(ad.begin(), ad.end());
+
+  return get_consensus_allele(ad, min_qual, threshold, gap);
+}
+
+/*
+  Call the positions that changed since the last snapshot and write every setting to its FASTA and
+  quality file. Files are written next to the output and renamed so readers never see a partial
+  snapshot. Returns the number of positions that were called.
+*/
+int live_consensus::write_snapshot() {
+  size_t n = settings.size(), i, j;
+  std::vector<live_region>::iterator r;
+
+  for (r = regions.begin(); r != regions.end(); ++r) {
+    r->calls.resize(n);
+    for (i = 0; i < n; ++i) {
+      r->calls[i].resize(r->columns.size());
+    }
+  }
+
+  std::vector<std::pair<size_t, uint32_t> >::iterator it;
+  for (it = changed.begin(); it != changed.end(); ++it) {
+    live_region &region = regions[it->first];
+    live_column &c = region.columns[it->second];
+    for (i = 0; i < n; ++i) {
+      for (j = 0; j < i && settings[j].threshold != settings[i].threshold; ++j);
+      region.calls[i][it->second] = (j < i) ? region.calls[j][it->second] : call_column(c, settings[i].threshold);
+    }
+    c.changed = false;
+  }
+  int ncalled = changed.size();
+  changed.clear();
+
+  std::vector<std::unique_ptr<buffered_ofstream> > files;
+  std::vector<std::ostream*> fout, qout;
+  for (i = 0; i < n; ++i) {
+    files.push_back(std::unique_ptr<buffered_ofstream>(new buffered_ofstream(out_files[i] + ".fa.tmp")));
+    fout.push_back(files.back().get());
+    files.push_back(std::unique_ptr<buffered_ofstream>(new buffered_ofstream(out_files[i] + ".qual.txt.tmp")));
+    qout.push_back(files.back().get());
+  }
+
+  consensus_records records(fout, qout, headers);
+  std::string seq, qual;
+  uint32_t pos, prev_pos;
+
+  for (r = regions.begin(); r != regions.end(); ++r) {
+    records.start(r->name);
+    for (i = 0; i < n; ++i) {
+      seq.clear();
+      qual.clear();
+      prev_pos = 0;
+      for (pos = 1; pos <= r->columns.size(); ++pos) {
+        const live_column &c = r->columns[pos - 1];
+        if (!c.covered)
+          continue;
+
+        if (prev_pos == 0)		// No -/N before alignment starts
+          prev_pos = pos;
+
+        if (pos > prev_pos && min_coverage_flag) {
+          seq.append((pos - prev_pos) - 1, gap);
+          qual.append((pos - prev_pos) - 1, '!');
+        }
+
+        if (c.mdepth >= settings[i].min_depth) {
+          seq += r->calls[i][pos - 1].nuc;
+          qual += r->calls[i][pos - 1].q;
+        } else if (min_coverage_flag) {
+          seq += gap;
+          qual += '!';
+        }
+
+        prev_pos = pos;
+      }
+      records.append(i, seq, qual);
+    }
+  }
+
+  records.finish();
+
+  for (i = 0; i < files.size(); ++i) {
+    files[i]->close();
+  }
+
+  for (i = 0; i < n; ++i) {
+    if (std::rename((out_files[i] + ".fa.tmp").c_str(), (out_files[i] + ".fa").c_str()) != 0 || std::rename((out_files[i] + ".qual.txt.tmp").c_str(), (out_files[i] + ".qual.txt").c_str()) != 0) {
+      std::cout << "Unable to write consensus to " << out_files[i] << ".fa" << std::endl;
+      return -1;
+    }
+  }
+
+  return ncalled;
+}
+
+static int write_live_snapshot(live_consensus &live, int &nsnapshots) {
+  int ncalled = live.write_snapshot();
+  if (ncalled < 0)
+    return -1;
+  nsnapshots++;
+  std::cout << "Snapshot " << nsnapshots << ": " << ncalled << " positions updated" << std::endl;
+  return 0;
+}
+
+/*
+  Read mpileup lines of new reads from cin until it is closed. A snapshot is written once interval
+  seconds have passed since the last one, on an empty line, which marks the end of a batch, and
+  when the input ends. With an interval of 0 snapshots are only written on empty lines and at the end.
+  The interval is only checked after a line is read, use the overload that takes a file descriptor
+  to also write snapshots while the input is idle.
+*/
+int call_consensus_live(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, double interval) {
+  live_consensus live(seq_id, out_file, min_qual, settings, gap, min_coverage_flag);
+  std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now(), now;
+  std::string line;
+  int nsnapshots = 0;
+  bool snapshot;
+
+  while (true) {
+    snapshot = !std::getline(cin, line);
+    if (!snapshot) {
+      if (line.empty()) {
+        snapshot = true;
+      } else if (live.add_line(line) != 0) {
+        std::cout << "Skipping malformed pileup line: " << line << std::endl;
+      }
+    }
+
+    now = std::chrono::steady_clock::now();
+    if (interval > 0 && live.get_changed_count() > 0 && std::chrono::duration<double>(now - last).count() >= interval)
+      snapshot = true;
+
+    if (snapshot) {
+      if (write_live_snapshot(live, nsnapshots) != 0)
+        return -1;
+      last = now;
+    }
+
+    if (!cin)
+      break;
+  }
+
+  return 0;
+}
+
+// Lines of a file descriptor. start is the beginning of the next line in pending.
+struct live_input {
+  int fd;
+  std::string pending;
+  size_t start;
+  bool eof;
+};
+
+// Read the next line of in without the newline. Returns 0 if no line came within timeout_ms, -1 at the end of the input.
+static int read_live_line(live_input &in, std::string &line, int timeout_ms) {
+  char buf[65536];
+  size_t nl;
+  ssize_t len;
+  int ready;
+
+  while ((nl = in.pending.find('\n', in.start)) == std::string::npos && !in.eof) {
+    in.pending.erase(0, in.start);
+    in.start = 0;
+    struct pollfd p = {in.fd, POLLIN, 0};
+    ready = poll(&p, 1, timeout_ms);
+    if (ready < 0 && errno == EINTR)
+      continue;
+    if (ready == 0)
+      return 0;
+    len = (ready < 0) ? -1 : read(in.fd, buf, sizeof(buf));
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+      in.eof = true;
+    else
+      in.pending.append(buf, len);
+  }
+
+  if (nl == std::string::npos) {	// Last line without a newline
+    if (in.start >= in.pending.size())
+      return -1;
+    nl = in.pending.size();
+  }
+
+  line.assign(in.pending, in.start, nl - in.start);
+  in.start = std::min(nl + 1, in.pending.size());
+  return 1;
+}
+
+/*
+  Same as above for the mpileup lines of file descriptor fd. Reads wait at most until the next
+  snapshot is due, so snapshots are also written every interval seconds while no new reads come in.
+*/
+int call_consensus_live(int fd, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, double interval) {
+  live_consensus live(seq_id, out_file, min_qual, settings, gap, min_coverage_flag);
+  std::chrono::steady_clock::time_point last = std::chrono::steady_clock::now(), now;
+  live_input in = {fd, "", 0, false};
+  std::string line;
+  int nsnapshots = 0, res, timeout_ms;
+  double wait;
+  bool snapshot;
+
+  while (true) {
+    timeout_ms = -1;
+    if (interval > 0 && live.get_changed_count() > 0) {
+      wait = interval - std::chrono::duration<double>(std::chrono::steady_clock::now() - last).count();
+      timeout_ms = (wait > 0) ? (int) std::ceil(wait * 1000) : 0;
+    }
+
+    res = read_live_line(in, line, timeout_ms);
+    snapshot = (res < 0);
+    if (res > 0) {
+      if (line.empty()) {
+        snapshot = true;
+      } else if (live.add_line(line) != 0) {
+        std::cout << "Skipping malformed pileup line: " << line << std::endl;
+      }
+    }
+
+    now = std::chrono::steady_clock::now();
+    if (interval > 0 && live.get_changed_count() > 0 && std::chrono::duration<double>(now - last).count() >= interval)
+      snapshot = true;
+
+    if (snapshot) {
+      if (write_live_snapshot(live, nsnapshots) != 0)
+        return -1;
+      last = now;
+    }
+
+    if (res < 0)
+      break;
+  }
+
+  return 0;
+}
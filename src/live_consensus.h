@@ -0,0 +1,79 @@
+#include<stdint.h>
+#include<iostream>
+#include<string>
+#include<vector>
+#include<map>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<memory>
+#include<algorithm>
+#include<cerrno>
+#include<poll.h>
+#include<unistd.h>
+
+#include "allele_functions.h"
+#include "call_consensus_pileup.h"
+#include "buffered_writer.h"
+
+#ifndef IVAR_LIVE_CONSENSUS_H
+#define IVAR_LIVE_CONSENSUS_H
+
+const int64_t MAX_LIVE_POS = 10000000;	// Well above the longest viral genome. Counts are kept for every position up to the last one seen, about 130 bytes each
+
+// Allele other than A, C, G, T, N and * at one position, mostly insertions
+struct live_allele {
+  std::string nuc;
+  uint32_t depth, end;
+  uint64_t qual_sum;
+};
+
+// Counts of one position summed over every pileup added so far
+struct live_column {
+  uint32_t depth[NUM_BASE_SYMBOLS];
+  uint32_t end[NUM_BASE_SYMBOLS];
+  uint64_t qual_sum[NUM_BASE_SYMBOLS];
+  uint32_t mdepth;
+  bool covered, observed, changed;
+  std::vector<live_allele> extra;
+  live_column();
+};
+
+struct live_region {
+  std::string name;
+  std::vector<live_column> columns;	// Indexed by position - 1
+  std::vector<std::vector<ret_t> > calls;	// Consensus of every setting at every position
+};
+
+/*
+  Consensus that is updated as pileups of new reads come in. Allele counts of every position are
+  kept in memory and add_line() adds one mpileup line of new reads to them. write_snapshot() only
+  calls the positions that changed since the last snapshot and rewrites the FASTA and quality
+  files from the stored calls.
+*/
+class live_consensus {
+public:
+  live_consensus(std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag);
+  int add_line(const std::string &line);
+  int write_snapshot();
+  uint32_t get_changed_count() const;
+
+private:
+  void add_alleles(live_column &c, const std::vector<allele> &ad);
+  ret_t call_column(const live_column &c, double threshold) const;
+
+  std::vector<consensus_setting> settings;
+  std::vector<std::string> out_files, headers;
+  uint8_t min_qual;
+  char gap;
+  bool min_coverage_flag;
+  std::vector<live_region> regions;	// In the order they were first seen
+  std::map<std::string, size_t> region_ids;
+  std::vector<std::pair<size_t, uint32_t> > changed;	// Region and 0-based position
+};
+
+int call_consensus_live(std::istream &cin, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, double interval);
+int call_consensus_live(int fd, std::string seq_id, std::string out_file, uint8_t min_qual, const std::vector<consensus_setting> &settings, char gap, bool min_coverage_flag, double interval);
+
+#endif
@@ -0,0 +1,155 @@
+#include "ordered_pool.h"
+
+ordered_pool::ordered_pool(unsigned int nthreads, unsigned int max_pending) {
+  this->nthreads = (nthreads == 0) ? 1 : nthreads;
+  this->max_pending = (max_pending == 0) ? 4 * this->nthreads : max_pending;
+  this->closing = false;
+  this->finished = false;
+
+  for (unsigned int i = 0; i < this->nthreads; ++i) {
+    workers.push_back(std::thread(&ordered_pool::worker_loop, this, i));
+  }
+
+  writer = std::thread(&ordered_pool::writer_loop, this);
+}
+
+ordered_pool::~ordered_pool() {
+  finish();
+}
+
+unsigned int ordered_pool::size() const {
+  return nthreads;
+}
+
+void ordered_pool::submit(std::function<void(unsigned int)> work, std::function<void()> emit) {
+  job *j = new job;
+  j->work = work;
+  j->emit = emit;
+  j->done = false;
+
+  std::unique_lock<std::mutex> lock(mtx);
+  cv_space.wait(lock, [this] { return pending.size() < max_pending; });
+
+  queued.push_back(j);
+  pending.push_back(j);
+  cv_work.notify_one();
+}
+
+void ordered_pool::worker_loop(unsigned int id) {
+  job *j;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv_work.wait(lock, [this] { return closing || !queued.empty(); });
+
+      if (queued.empty())	// Closing and nothing left to do
+        return;
+
+      j = queued.front();
+      queued.pop_front();
+    }
+
+    j->work(id);
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      j->done = true;
+    }
+
+    cv_done.notify_all();
+  }
+}
+
+void ordered_pool::writer_loop() {
+  job *j;
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv_done.wait(lock, [this] { return (!pending.empty() && pending.front()->done) || (closing && pending.empty()); });
+
+      if (pending.empty())
+        return;
+
+      j = pending.front();
+    }
+
+    j->emit();
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      pending.pop_front();
+    }
+
+    delete j;
+    cv_space.notify_all();
+  }
+}
+
+void ordered_pool::finish() {
+  if (finished)
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    closing = true;
+  }
+
+  cv_work.notify_all();
+  cv_done.notify_all();
+
+  for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    it->join();
+  }
+
+  writer.join();
+  finished = true;
+}
+
+// Number of threads to use. Values less than 1 use all available cores.
+unsigned int get_thread_count(int requested) {
+  if (requested > 0)
+    return requested;
+
+  unsigned int n = std::thread::hardware_concurrency();
+
+  return (n == 0) ? 1 : n;
+}
+
+/*
+  Read roughly block_size bytes of whole lines from in into block. The partial line at the end
+  of the read is kept in carry and put at the start of the next block. Blocks always end with a
+  newline. Returns false once the stream is exhausted and no lines are left.
+*/
+bool read_line_block(std::istream &in, std::string &block, std::string &carry, size_t block_size) {
+  size_t offset, nl;
+
+  block.swap(carry);
+  carry.clear();
+
+  while (true) {
+    offset = block.size();
+    block.resize(offset + block_size);
+    in.read(&block[offset], block_size);
+    block.resize(offset + in.gcount());
+
+    if (in.gcount() == 0) {	// End of stream
+      if (block.empty())
+        return false;
+
+      if (block[block.size() - 1] != '\n')
+        block += '\n';
+
+      return true;
+    }
+
+    nl = block.rfind('\n');
+
+    if (nl != std::string::npos && nl >= offset) {
+      carry.assign(block, nl + 1, std::string::npos);
+      block.resize(nl + 1);
+      return true;
+    }
+  }
+}
@@ -0,0 +1,60 @@
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#ifndef IVAR_ORDERED_POOL_H
+#define IVAR_ORDERED_POOL_H
+
+/*
+  Worker pool that runs jobs concurrently but emits their results in the order
+  the jobs were submitted.
+
+  Each job has two parts,
+  work: Run on one of the worker threads. Receives the index of the worker (0 to n-1) so
+        callers can keep per worker state (reference handles, scratch buffers).
+  emit: Run on the writer thread once the job and every job submitted before it is done.
+
+  submit() blocks once max_pending jobs are queued or waiting to be written so that a
+  fast reader cannot buffer the whole input in memory.
+*/
+
+class ordered_pool {
+public:
+  ordered_pool(unsigned int nthreads, unsigned int max_pending = 0);
+  ~ordered_pool();
+  void submit(std::function<void(unsigned int)> work, std::function<void()> emit);
+  void finish();
+  unsigned int size() const;
+
+private:
+  struct job {
+    std::function<void(unsigned int)> work;
+    std::function<void()> emit;
+    bool done;
+  };
+
+  void worker_loop(unsigned int id);
+  void writer_loop();
+
+  std::vector<std::thread> workers;
+  std::thread writer;
+  std::deque<job*> queued;	// Waiting for a worker
+  std::deque<job*> pending;	// Submitted and not yet emitted, in submission order
+  std::mutex mtx;
+  std::condition_variable cv_work, cv_done, cv_space;
+  unsigned int nthreads, max_pending;
+  bool closing, finished;
+};
+
+const size_t LINE_BLOCK_SIZE = 1 << 20;
+
+unsigned int get_thread_count(int requested);
+bool read_line_block(std::istream &in, std::string &block, std::string &carry, size_t block_size = LINE_BLOCK_SIZE);
+
+#endif
@@ -2,49 +2,60 @@
 
 gff3_feature::gff3_feature(std::string line) {
   int ctr = 0;
+  size_t beg = 0, end;
+  const char *cell;
+
+  this->start = 0;
+  this->end = 0;
+  this->score = 0;
+  this->strand = 0;
+  this->phase = 0;
+  this->seqid_id = -1;
+  this->type_id = -1;
+
+  // Split on tabs without copying the line into a stream. A trailing tab does not start a new column.
+  while (beg < line.size()) {
+    end = line.find('\t', beg);
+    if (end == std::string::npos)
+      end = line.size();
+    cell = line.c_str() + beg;
 
-  std::stringstream line_stream;
-  std::string cell;
-  line_stream << line;
-
-  while (std::getline(line_stream,cell,'\t')) {
     switch(ctr) {
       case 0:			// Name
-        this->seqid = cell;
+        this->seqid.assign(line, beg, end - beg);
         break;
       case 1:
-        this->source = cell;
+        this->source.assign(line, beg, end - beg);
         break;
       case 2:
-        this->type = cell;
+        this->type.assign(line, beg, end - beg);
         break;
       case 3:
-        this->start = atoi(cell.c_str());
+        this->start = atoi(cell);
         break;
       case 4:
-        this->end = atoi(cell.c_str());
+        this->end = atoi(cell);
         break;
       case 5:
-        this->score = atof(cell.c_str());
+        this->score = atof(cell);
         break;
       case 6:
-        this->strand = cell[0];
+        this->strand = line[beg];
         break;
       case 7:
-        this->phase = atoi(cell.c_str());
+        this->phase = atoi(cell);
         break;
       case 8:
-        this->set_attributes(cell);
+        this->set_attributes(line.substr(beg, end - beg));
         break;
     }
 
     ctr++;
+    beg = end + 1;
   }
 
   if (ctr < 9)
     std::cout << "GFF file is not in GFF3 file format!" << std::endl;
-
-  line_stream.clear();
 }
 
 int gff3_feature::print() {
@@ -67,56 +78,66 @@ int gff3_feature::print() {
   return 0;
 }
 
-std::string gff3_feature::get_attribute(std::string key) {
-  std::string val;
+std::string gff3_feature::get_attribute(std::string key) const {
+  std::map<std::string, std::string>::const_iterator it = attributes.find(key);
 
-  if (attributes.find(key) != attributes.end()) {
-    val = attributes[key];
-  }
+  if (it == attributes.end())
+    return "";
 
-  return val;
+  return it->second;
 }
 
+// Attributes are ; separated tag=value pairs. Empty pairs are skipped.
 int gff3_feature::set_attributes(std::string attr) {
-  std::string key, val;
-  std::regex exp("[^;]+");
-  std::regex_iterator<std::string::iterator> it(attr.begin(), attr.end(), exp);
-  std::regex_iterator<std::string::iterator> rend;
-  std::string delimiter = "=";
-
-  while (it!=rend) {
-    key = it->str().substr(0, it->str().find(delimiter));
-    val = it->str().substr(it->str().find(delimiter)+1, it->str().length());
-
-    if (!key.empty() && !val.empty()) {
-      this->attributes[key] = val;
+  std::string key, val, pair;
+  size_t beg = 0, end, eq;
+
+  while (beg < attr.size()) {
+    end = attr.find(';', beg);
+    if (end == std::string::npos)
+      end = attr.size();
+
+    if (end > beg) {
+      pair = attr.substr(beg, end - beg);
+      eq = pair.find('=');
+      key = pair.substr(0, eq);
+      val = pair.substr(eq + 1, pair.length());	// Whole pair if there is no =
+
+      if (!key.empty() && !val.empty()) {
+        this->attributes[key] = val;
+      }
     }
-    ++it;
+
+    beg = end + 1;
   }
 
   return 0;
 }
 
-uint64_t gff3_feature::get_start() {
+std::string gff3_feature::get_seqid() const {
+  return seqid;
+}
+
+uint64_t gff3_feature::get_start() const {
   return start;
 }
 
-uint64_t gff3_feature::get_end() {
+uint64_t gff3_feature::get_end() const {
   return end;
 }
 
-int gff3_feature::get_phase() {
+int gff3_feature::get_phase() const {
   return phase;
 }
 
-std::string gff3_feature::get_type() {
+std::string gff3_feature::get_type() const {
   return type;
 }
 
-int64_t gff3_feature::get_edit_position() {
+int64_t gff3_feature::get_edit_position() const {
   int64_t edit_pos = -1;
 
-  std::map<std::string, std::string>::iterator it;
+  std::map<std::string, std::string>::const_iterator it;
   for (it = attributes.begin(); it != attributes.end(); it++) {
     if (it->first.compare(EDIT_POSITION) == 0) {
       edit_pos = stoi(it->second);
@@ -127,10 +148,10 @@ int64_t gff3_feature::get_edit_position() {
   return edit_pos;
 }
 
-std::string gff3_feature::get_edit_sequence() {
+std::string gff3_feature::get_edit_sequence() const {
   std::string edit_seq = "";
 
-  std::map<std::string, std::string>::iterator it;
+  std::map<std::string, std::string>::const_iterator it;
   for (it = attributes.begin(); it != attributes.end(); it++) {
     if (it->first.compare(EDIT_SEQUENCE) == 0) {
       edit_seq = it->second;
@@ -150,7 +171,7 @@ int gff3::print() {
   return 0;
 }
 
-std::vector<gff3_feature> gff3::get_features() {
+const std::vector<gff3_feature>& gff3::get_features() const {
   return features;
 }
 
@@ -179,22 +200,122 @@ int gff3::read_file(std::string path) {
 
   this->is_empty = false;
 
-  return 0;
+  return build_indexes();
 }
 
-std::vector<gff3_feature> gff3::query_features(uint64_t pos, std::string type) {
-  std::vector<gff3_feature> res;
+// Id of an interned seqid or type. -1 if it does not occur in the file.
+int gff3::get_name_id(const std::string &name) const {
+  std::map<std::string, int>::const_iterator it = name_ids.find(name);
 
-  std::vector<gff3_feature>::iterator it;
-  for (it = features.begin(); it != features.end(); it++) {
-    if (it->get_type() != type)
-      continue;
-      
-    if (pos >= it->get_start() && pos <= it->get_end()) {
-      res.push_back(*it);
+  if (it == name_ids.end())
+    return -1;
+
+  return it->second;
+}
+
+int gff3::intern(const std::string &name) {
+  std::map<std::string, int>::iterator it = name_ids.find(name);
+
+  if (it != name_ids.end())
+    return it->second;
+
+  names.push_back(name);
+  name_ids[name] = names.size() - 1;
+
+  return names.size() - 1;
+}
+
+/*
+  Group features by seqid and type, sorted by start. max_end[i] is the largest end among the
+  first i + 1 features so a query can stop at the first feature that cannot reach pos.
+*/
+int gff3::build_indexes() {
+  indexes.clear();
+
+  for (uint32_t i = 0; i < features.size(); ++i) {
+    features[i].seqid_id = intern(features[i].seqid);
+    features[i].type_id = intern(features[i].type);
+    indexes[std::make_pair(features[i].seqid_id, features[i].type_id)].order.push_back(i);
+  }
+
+  std::map<std::pair<int, int>, interval_index>::iterator it;
+  for (it = indexes.begin(); it != indexes.end(); ++it) {
+    interval_index &index = it->second;
+    std::stable_sort(index.order.begin(), index.order.end(), [this](uint32_t a, uint32_t b) {
+        return features[a].start < features[b].start;
+      });
+
+    index.max_end.resize(index.order.size());
+    uint64_t max_end = 0;
+    for (uint32_t i = 0; i < index.order.size(); ++i) {
+      max_end = std::max(max_end, features[index.order[i]].end);
+      index.max_end[i] = max_end;
     }
   }
 
+  return 0;
+}
+
+void gff3::query_index(const interval_index &index, uint64_t pos, std::vector<uint32_t> &res) const {
+  // First feature that starts after pos
+  std::vector<uint32_t>::const_iterator first = std::upper_bound(index.order.begin(), index.order.end(), pos, [this](uint64_t p, uint32_t i) {
+      return p < features[i].start;
+    });
+
+  for (int64_t i = (first - index.order.begin()) - 1; i >= 0 && index.max_end[i] >= pos; --i) {
+    if (features[index.order[i]].end >= pos)
+      res.push_back(index.order[i]);
+  }
+}
+
+bool gff3::has_seqid(const std::string &seqid) const {
+  int seqid_id = get_name_id(seqid);
+  std::map<std::pair<int, int>, interval_index>::const_iterator it;
+
+  for (it = indexes.begin(); it != indexes.end(); ++it) {
+    if (it->first.first == seqid_id)
+      return true;
+  }
+
+  return false;
+}
+
+// Features of type that contain pos on any seqid, in the order of the GFF file
+std::vector<const gff3_feature*> gff3::query_features(uint64_t pos, std::string type) const {
+  std::vector<const gff3_feature*> res;
+  std::vector<uint32_t> ind;
+  int type_id = get_name_id(type);
+
+  std::map<std::pair<int, int>, interval_index>::const_iterator it;
+  for (it = indexes.begin(); it != indexes.end(); ++it) {
+    if (it->first.second == type_id)
+      query_index(it->second, pos, ind);
+  }
+
+  std::sort(ind.begin(), ind.end());
+  for (std::vector<uint32_t>::iterator i = ind.begin(); i != ind.end(); ++i) {
+    res.push_back(&features[*i]);
+  }
+
+  return res;
+}
+
+// Features of type on seqid that contain pos, in the order of the GFF file
+std::vector<const gff3_feature*> gff3::query_features(std::string seqid, uint64_t pos, std::string type) const {
+  std::vector<const gff3_feature*> res;
+  std::vector<uint32_t> ind;
+
+  std::map<std::pair<int, int>, interval_index>::const_iterator it = indexes.find(std::make_pair(get_name_id(seqid), get_name_id(type)));
+  if (it == indexes.end())
+    return res;
+
+  query_index(it->second, pos, ind);
+
+  std::sort(ind.begin(), ind.end());
+  for (std::vector<uint32_t>::iterator i = ind.begin(); i != ind.end(); ++i) {
+    res.push_back(&features[*i]);
+  }
+
   return res;
 }
 
@@ -1,12 +1,13 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <regex>
 #include <map>
+#include <vector>
+#include <algorithm>
 #include <iterator>
 
-#ifndef parse_gff
-#define parse_gff
+#ifndef IVAR_PARSE_GFF_H
+#define IVAR_PARSE_GFF_H
 
 /* 
 GFF3 file format:
@@ -35,20 +36,23 @@ EditSequence: Sequence to be inserted
 const std::string EDIT_POSITION = "EditPosition";
 const std::string EDIT_SEQUENCE = "EditSequence";
 
+class gff3;
+
 class gff3_feature{
+  friend class gff3;
 public:
   gff3_feature(std::string line);
   int print();
   
-  std::string get_seqid();
+  std::string get_seqid() const;
   std::string get_source();
-  std::string get_type();
-  uint64_t get_start();
-  uint64_t get_end();
+  std::string get_type() const;
+  uint64_t get_start() const;
+  uint64_t get_end() const;
   char get_strand();
-  int get_phase();
+  int get_phase() const;
   std::map<std::string, std::string> get_attributes();
-  std::string get_attribute(std::string key);
+  std::string get_attribute(std::string key) const;
 
   int set_seqid();
   int set_source();
@@ -58,11 +62,12 @@ public:
   int set_strand();
   int set_phase();
   int set_attributes(std::string attr);
-  int64_t get_edit_position();
-  std::string get_edit_sequence();
+  int64_t get_edit_position() const;
+  std::string get_edit_sequence() const;
   
 private:
   std::string seqid, source, type;
+  int seqid_id, type_id;	// Interned by gff3
   std::map<std::string, std::string> attributes;
   uint64_t start, end;
   float score;
@@ -74,15 +79,31 @@ class gff3{
 public:
   gff3();
   gff3(std::string path);
-  std::vector<gff3_feature> get_features();
+  const std::vector<gff3_feature>& get_features() const;
   int print();
   int read_file(std::string path);
-  std::vector<gff3_feature> query_features(uint64_t pos, std::string type);
+  std::vector<const gff3_feature*> query_features(uint64_t pos, std::string type) const;
+  std::vector<const gff3_feature*> query_features(std::string seqid, uint64_t pos, std::string type) const;
+  bool has_seqid(const std::string &seqid) const;
+  int get_name_id(const std::string &name) const;
   int get_count();
   bool empty();
 
 private:
+  // Features of one seqid and type sorted by start
+  struct interval_index {
+    std::vector<uint32_t> order;
+    std::vector<uint64_t> max_end;
+  };
+
+  int intern(const std::string &name);
+  int build_indexes();
+  void query_index(const interval_index &index, uint64_t pos, std::vector<uint32_t> &res) const;
+
   std::vector<gff3_feature> features;
+  std::vector<std::string> names;	// Interned seqids and types
+  std::map<std::string, int> name_ids;
+  std::map<std::pair<int, int>, interval_index> indexes;	// Keyed by (seqid, type)
   // Flag to see if file has been populated
   bool is_empty;
 };
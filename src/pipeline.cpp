@@ -0,0 +1,216 @@
+#include "pipeline.h"
+
+trimmed_reads::trimmed_reads(samFile *in, bam_hdr_t *header, read_trimmer &trimmer, const pileup_opts &opts, BGZF *out) : in(in), header(header), trimmer(trimmer), opts(opts), out(out), in_tid(-1), in_pos(-1), eof(false), error(false), count(0) {}
+
+trimmed_reads::~trimmed_reads() {
+  for (std::map<read_order, bam1_t*>::iterator it = pending.begin(); it != pending.end(); ++it)
+    bam_destroy1(it->second);
+  for (std::vector<bam1_t*>::iterator it = free_reads.begin(); it != free_reads.end(); ++it)
+    bam_destroy1(*it);
+}
+
+// Read and trim one record of the input. Returns -1 on errors.
+int trimmed_reads::read_input() {
+  bam1_t *r;
+  read_trim_status status;
+
+  if (free_reads.empty()) {
+    r = bam_init1();
+  } else {
+    r = free_reads.back();
+    free_reads.pop_back();
+  }
+
+  int ret = sam_read1(in, header, r);
+  if (ret < 0) {
+    free_reads.push_back(r);
+    if (ret < -1) {
+      std::cout << "Unable to read BAM file." << std::endl;
+      return -1;
+    }
+    eof = true;
+    return 0;
+  }
+  count++;
+
+  if (r->core.tid >= 0) {
+    if (r->core.tid < in_tid || (r->core.tid == in_tid && r->core.pos < in_pos)) {
+      std::cout << "BAM file is not sorted by coordinate at read " << bam_get_qname(r) << "." << std::endl;
+      free_reads.push_back(r);
+      return -1;
+    }
+    in_tid = r->core.tid;
+    in_pos = r->core.pos;
+  }
+
+  if (!trimmer.trim(r, status)) {
+    free_reads.push_back(r);
+    return 0;
+  }
+
+  pending.insert(std::make_pair(read_order(r->core.tid, r->core.pos, bam_is_rev(r), count), r));
+
+  return 0;
+}
+
+// Next trimmed read for the pileup. Returns -1 at the end of the input and -2 on errors, as bam_plp_auto_f.
+int trimmed_reads::next(bam1_t *b) {
+  if (error)
+    return -2;
+
+  while (true) {
+    if (!pending.empty()) {
+      std::map<read_order, bam1_t*>::iterator it = pending.begin();
+      int32_t tid = std::get<0>(it->first);
+      hts_pos_t pos = std::get<1>(it->first);
+
+      // No read still to come can start before a held read that starts before the last input read
+      if (eof || tid < in_tid || (tid == in_tid && pos < in_pos)) {
+        bam1_t *r = it->second;
+        pending.erase(it);
+        free_reads.push_back(r);
+
+        if (out != NULL && bam_write1(out, r) < 0) {
+          std::cout << "Unable to write trimmed reads." << std::endl;
+          error = true;
+          return -2;
+        }
+
+        if (!pileup_read_passes(r, opts))
+          continue;
+
+        bam_copy1(b, r);
+        return 0;
+      }
+    }
+
+    if (eof)
+      return -1;
+
+    if (read_input() != 0) {
+      error = true;
+      return -2;
+    }
+  }
+}
+
+bool trimmed_reads::failed() const {
+  return error;
+}
+
+uint64_t trimmed_reads::get_count() const {
+  return count;
+}
+
+static int read_trimmed(void *data, bam1_t *b) {
+  return ((trimmed_reads*) data)->next(b);
+}
+
+/*
+  Trim the reads of a coordinate sorted BAM file and call variants and the consensus from them in
+  one pass, without writing the trimmed reads to disk first. Writes <prefix>.tsv (or the VCF/BCF of
+  settings.variants_format), <prefix>.fa, <prefix>.qual.txt and, with settings.write_trimmed, the
+  trimmed reads sorted by coordinate to <prefix>.trimmed.bam.
+
+  Output is the same as ivar trim, samtools sort and `samtools mpileup -aa -A -d 0 -B -Q 0` piped
+  into ivar variants and ivar consensus, except that reads of every reference are trimmed.
+*/
+int run_pipeline(std::string bam, const primer_scheme &scheme, ref_antd &refantd, std::string prefix, const pipeline_settings &settings, std::string cmd, pipeline_stats &stats) {
+  int res = 0;
+  samFile *in = hts_open(bam.c_str(), "r");
+  bam_hdr_t *header = NULL;
+  BGZF *out = NULL;
+
+  if (in == NULL) {
+    std::cout << "Unable to open BAM file." << std::endl;
+    return -1;
+  }
+  if (settings.nthreads > 1)
+    hts_set_threads(in, settings.nthreads);
+
+  header = sam_hdr_read(in);
+  if (header == NULL) {
+    std::cout << "Unable to open BAM header." << std::endl;
+    sam_close(in);
+    return -1;
+  }
+
+  if (settings.write_trimmed) {
+    std::string trimmed = prefix + ".trimmed.bam";
+    bam_hdr_t *out_header = sam_hdr_dup(header);
+    out = bgzf_open(trimmed.c_str(), "w");
+    if (out != NULL && settings.nthreads > 1)
+      bgzf_mt(out, settings.nthreads, 256);
+    add_pg_line_to_header(&out_header, const_cast<char *>(cmd.c_str()));
+    if (out == NULL || bam_hdr_write(out, out_header) < 0) {
+      std::cout << "Unable to write " << trimmed << std::endl;
+      res = -1;
+    }
+    bam_hdr_destroy(out_header);
+  }
+
+  variants_output variants;
+  variant_sink *vout = (res == 0) ? variants.open(prefix, settings.variants_format, refantd, settings.nthreads) : NULL;
+  if (vout == NULL) {
+    if (out != NULL)
+      bgzf_close(out);
+    bam_hdr_destroy(header);
+    sam_close(in);
+    return -1;
+  }
+
+  std::vector<consensus_setting> consensus_settings(1, consensus_setting(settings.consensus_threshold, settings.consensus_min_depth));
+  std::vector<consensus_stats> consensus_counts;
+  buffered_ofstream fa(prefix + ".fa"), qual(prefix + ".qual.txt");
+  std::vector<std::ostream*> fout(1, &fa), qout(1, &qual);
+  std::vector<std::string> headers(1, get_consensus_header("", prefix, consensus_settings[0], settings.min_qual));
+  consensus_records records(fout, qout, headers);
+  consensus_builder consensus(records, consensus_settings, consensus_counts, settings.min_qual, settings.gap, true);
+
+  read_trimmer trimmer(scheme, settings.trim);
+  pileup_opts opts = settings.pileup;
+  trimmed_reads reads(in, header, trimmer, opts, out);
+  res = pileup_reads(read_trimmed, &reads, header, NULL, opts, refantd, settings.min_qual, 0, [&consensus, &settings](unsigned int, const std::string &region, int64_t pos, char ref, uint32_t depth, std::vector<allele> &ad, variant_sink &out) {
+      consensus.add(region, pos, depth, ad);
+      call_variants_from_alleles(region, pos, ref, depth, ad, out, settings.min_threshold, settings.min_depth);
+    }, *vout);
+  if (reads.failed())
+    res = -1;
+
+  consensus.finish();
+  if (variants.close() != 0 || fa.close() != 0 || qual.close() != 0)
+    res = -1;
+  if (out != NULL && bgzf_close(out) != 0) {
+    std::cout << "Unable to write " << prefix << ".trimmed.bam" << std::endl;
+    res = -1;
+  }
+  bam_hdr_destroy(header);
+  sam_close(in);
+
+  stats.reads = reads.get_count();
+  stats.trim = trimmer.get_stats();
+  stats.consensus = consensus_counts[0];
+
+  std::cout << "Read " << stats.reads << " reads." << std::endl;
+  std::cout << "Trimmed primers from " << stats.trim.primer_trimmed << " reads." << std::endl;
+  std::cout << stats.trim.low_quality << " reads were quality trimmed below the minimum length of " << settings.trim.min_length << " bp." << std::endl;
+  std::cout << stats.trim.no_primer << " reads started outside of primer regions." << std::endl;
+  std::cout << "Reference length: " << stats.consensus.total_bases << std::endl;
+  std::cout << "Positions with 0 depth: " << stats.consensus.bases_zero_depth << std::endl;
+  std::cout << "Positions with depth below " << (unsigned) settings.consensus_min_depth << ": " << stats.consensus.bases_min_depth << std::endl;
+
+  return res;
+}
+
+int run_pipeline(std::string bam, std::string bed, std::string pair_info, int32_t primer_offset, std::string ref_path, std::string gff_path, std::string prefix, const pipeline_settings &settings, std::string cmd) {
+  primer_scheme scheme;
+  pipeline_stats stats;
+
+  if (!bed.empty() && scheme.load(bed, pair_info, primer_offset) != 0) {
+    std::cout << "Unable to load primers from " << bed << std::endl;
+    return -1;
+  }
+  ref_antd refantd(ref_path, gff_path);
+
+  return run_pipeline(bam, scheme, refantd, prefix, settings, cmd, stats);
+}
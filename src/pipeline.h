@@ -0,0 +1,77 @@
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+#include <htslib/sam.h>
+#include <htslib/bgzf.h>
+
+#include "trim_primer_quality.h"
+#include "bam_pileup.h"
+#include "call_variants.h"
+#include "call_consensus_pileup.h"
+
+#ifndef IVAR_PIPELINE_H
+#define IVAR_PIPELINE_H
+
+// Settings of ivar pipeline. Defaults are those of ivar trim, ivar variants and ivar consensus.
+struct pipeline_settings {
+  trim_settings trim;
+  pileup_opts pileup;
+  uint8_t min_qual;		// -q for variants and consensus
+  double min_threshold;		// -t
+  uint8_t min_depth;		// -m
+  double consensus_threshold;	// -c
+  uint8_t consensus_min_depth;	// -d
+  char gap;			// -n
+  char variants_format;		// -F
+  bool write_trimmed;		// -w
+  unsigned int nthreads;	// -@
+  pipeline_settings() : min_qual(20), min_threshold(0.03), min_depth(0), consensus_threshold(0), consensus_min_depth(10), gap('N'), variants_format(TSV_OUTPUT), write_trimmed(false), nthreads(1) {}
+};
+
+struct pipeline_stats {
+  uint64_t reads;		// Records read from the input BAM
+  trim_stats trim;
+  consensus_stats consensus;
+  pipeline_stats() : reads(0) {}
+};
+
+// Order of samtools sort: reference, position, forward before reverse reads, then input order
+typedef std::tuple<int32_t, hts_pos_t, bool, uint64_t> read_order;
+
+/*
+  Reads of a coordinate sorted BAM file, trimmed as they are read and returned in sorted order.
+  Trimming only moves the start of a read forward, so a trimmed read is held until the input has
+  moved past its new start. Reads kept by the trimmer are written to out, if it is not NULL, as
+  they are returned. Reads that samtools mpileup would skip are written but not returned.
+*/
+class trimmed_reads {
+public:
+  trimmed_reads(samFile *in, bam_hdr_t *header, read_trimmer &trimmer, const pileup_opts &opts, BGZF *out);
+  ~trimmed_reads();
+  int next(bam1_t *b);
+  bool failed() const;
+  uint64_t get_count() const;
+
+private:
+  int read_input();
+
+  samFile *in;
+  bam_hdr_t *header;
+  read_trimmer &trimmer;
+  const pileup_opts &opts;
+  BGZF *out;
+  std::map<read_order, bam1_t*> pending;
+  std::vector<bam1_t*> free_reads;
+  int32_t in_tid;
+  hts_pos_t in_pos;
+  bool eof, error;
+  uint64_t count;
+};
+
+int run_pipeline(std::string bam, const primer_scheme &scheme, ref_antd &refantd, std::string prefix, const pipeline_settings &settings, std::string cmd, pipeline_stats &stats);
+int run_pipeline(std::string bam, std::string bed, std::string pair_info, int32_t primer_offset, std::string ref_path, std::string gff_path, std::string prefix, const pipeline_settings &settings, std::string cmd);
+
+#endif
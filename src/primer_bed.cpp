@@ -253,6 +253,38 @@ std::vector<primer> get_primers(std::vector<primer> p, unsigned int pos) {
   return primers_with_mismatches;
 }
 
+primer_index::primer_index(std::vector<primer> &primers) {
+  std::vector<std::pair<uint32_t, int> > order;
+  for (std::vector<primer>::iterator it = primers.begin(); it != primers.end(); ++it) {
+    order.push_back(std::make_pair(it->get_start(), it - primers.begin()));
+  }
+  std::sort(order.begin(), order.end());
+
+  uint32_t max_end = 0;
+  for (std::vector<std::pair<uint32_t, int> >::iterator it = order.begin(); it != order.end(); ++it) {
+    starts.push_back(it->first);
+    ends.push_back(primers[it->second].get_end());
+    max_end = std::max(max_end, ends.back());
+    max_ends.push_back(max_end);
+    indices.push_back(it->second);
+  }
+}
+
+/*
+  Indices of the primers with start <= pos <= end, like get_primers(). Primers that start after
+  pos are skipped by binary search and the scan back stops once no earlier primer reaches pos.
+*/
+void primer_index::get_primers(unsigned int pos, std::vector<int> &overlapping) const {
+  overlapping.clear();
+  size_t i = std::upper_bound(starts.begin(), starts.end(), pos) - starts.begin();
+  while (i > 0 && max_ends[i - 1] >= pos) {
+    i--;
+    if (ends[i] >= pos)
+      overlapping.push_back(indices[i]);
+  }
+  std::sort(overlapping.begin(), overlapping.end());	// BED order, as get_primers()
+}
+
 // Assumes unique primer names in BED file
 int get_primer_indice(std::vector<primer> p, std::string name) {
   for (std::vector<primer>::iterator it = p.begin(); it != p.end(); ++it) {
@@ -264,6 +296,28 @@ int get_primer_indice(std::vector<primer> p, std::string name) {
   return -1;
 }
 
+/*
+  Bitset over primer indices with the primers in names set. Names are resolved once so a read can
+  be tested with a single lookup of its primer index. Like get_primer_indice(), a name matches the
+  first primer with that name.
+*/
+std::vector<bool> get_primer_mask(std::vector<primer> &p, const std::vector<std::string> &names) {
+  std::vector<bool> mask(p.size(), false);
+  std::map<std::string, int> indices;
+  for (std::vector<primer>::iterator it = p.begin(); it != p.end(); ++it) {
+    indices.insert(std::make_pair(it->get_name(), it - p.begin()));
+  }
+
+  std::map<std::string, int>::iterator f;
+  for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+    f = indices.find(*it);
+    if (f != indices.end())
+      mask[f->second] = true;
+  }
+
+  return mask;
+}
+
 int populate_pair_indices(std::vector<primer> &primers, std::string path) {
   std::ifstream fin(path.c_str());
   std::string line, cell, p1,p2;
@@ -3,9 +3,10 @@
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <map>
 
-#ifndef primer_bed
-#define primer_bed
+#ifndef IVAR_PRIMER_BED_H
+#define IVAR_PRIMER_BED_H
 
 class primer {
  private:
@@ -46,10 +47,24 @@ class primer {
 
 };
 
+// Primers sorted by start with the running maximum of their ends, to find the primers covering a position
+class primer_index {
+ private:
+  std::vector<uint32_t> starts;
+  std::vector<uint32_t> ends;
+  std::vector<uint32_t> max_ends;
+  std::vector<int> indices;
+
+ public:
+  primer_index(std::vector<primer> &primers);
+  void get_primers(unsigned int pos, std::vector<int> &overlapping) const;
+};
+
 std::vector<primer> populate_from_file(std::string path, int32_t offset);
 std::vector<primer> populate_from_file(std::string path);
 std::vector<primer> get_primers(std::vector<primer> p, unsigned int pos);
 int get_primer_indice(std::vector<primer> p, std::string name);
+std::vector<bool> get_primer_mask(std::vector<primer> &p, const std::vector<std::string> &names);
 int populate_pair_indices(std::vector<primer> &primers, std::string path);
 primer get_min_start(std::vector<primer> primers);
 primer get_max_end(std::vector<primer> primers);
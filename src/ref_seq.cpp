@@ -1,100 +1,200 @@
 #include "ref_seq.h"
 
-char ref_antd::get_base(int64_t pos, std::string region) { // 1-based position
-  int len;
-  char base = 0;
+// Id of region in the reference or -1 if it is not present
+int ref_antd::get_region_id(const std::string &region) const {
+  std::map<std::string, int>::const_iterator it = region_ids.find(region);
+
+  if (it == region_ids.end())
+    return -1;
+
+  return it->second;
+}
 
-  if (!region.empty() && this->fai != NULL) {
-    seq = fai_fetch(this->fai, region.c_str(), &len);
+region_cache::region_cache() : id(-1), valid(false) {}
+
+int region_cache::get_region_id(const ref_antd &refantd, const std::string &region) {
+  if (!valid || region != name) {
+    name = region;
+    id = refantd.get_region_id(region);
+    valid = true;
   }
+  return id;
+}
 
-  if (seq) base = *(seq + (pos - 1));
+int ref_antd::get_region_count() const {
+  return seqs.size();
+}
 
-  free(seq);
+std::string ref_antd::get_region_name(int region_id) const {
+  return region_names.at(region_id);
+}
 
-  return base;
+int64_t ref_antd::get_region_length(int region_id) const {
+  return seqs.at(region_id).size();
 }
 
-char* ref_antd::get_codon(int64_t pos, std::string region, gff3_feature feature) {
-  int len;
-  seq = fai_fetch(this->fai, region.c_str(), &len);
+// 0-based lookup that returns UNKNOWN_BASE outside of the reference
+char ref_antd::get_ref_base(int region_id, int64_t i) const {
+  if (region_id < 0 || i < 0 || i >= (int64_t) seqs[region_id].size())
+    return UNKNOWN_BASE;
 
-  int64_t edit_pos = feature.get_edit_position(), codon_start_pos;
-  std::string edit_sequence = feature.get_edit_sequence();
+  return seqs[region_id][i];
+}
 
-  int64_t edit_sequence_size = edit_sequence.size();
-  char *codon = new char[3];
+char ref_antd::get_base(int64_t pos, int region_id) const { // 1-based position
+  if (region_id < 0 || pos < 1 || pos > (int64_t) seqs[region_id].size())
+    return 0;
 
+  return seqs[region_id][pos - 1];
+}
+
+char ref_antd::get_base(int64_t pos, std::string region) const { // 1-based position
+  return get_base(pos, get_region_id(region));
+}
+
+/*
+  Fill codon with the three bases of the codon that contains pos in a CDS, applying the insertion
+  given by EditPosition and EditSequence. With mask_outside_cds bases outside the CDS are 'N'.
+  Returns the 0-based start of the codon and sets alt_index to the index of pos in the codon.
+*/
+int64_t ref_antd::fill_codon(int64_t pos, int region_id, int64_t start, int64_t end, int phase, int64_t edit_pos, const std::string &edit_sequence, bool mask_outside_cds, char *codon, int64_t &alt_index) const {
+  int64_t edit_sequence_size = edit_sequence.size(), codon_start_pos;
+  int64_t edit_offset = 0, pos_edit_offset;
   int i;
-  int64_t edit_offset = 0;
 
   if (pos > edit_pos + edit_sequence_size && edit_pos != -1) {
     edit_offset = (pos - edit_pos) > edit_sequence_size ? edit_sequence_size : (pos - edit_pos); // Account for edits in position of insertion
   }
 
-  codon_start_pos = (feature.get_start() - 1) + feature.get_phase() + (((pos + edit_offset - (feature.get_start() + feature.get_phase())))/3)*3;
+  pos_edit_offset = edit_offset;
+  codon_start_pos = (start - 1) + phase + (((pos + edit_offset - (start + phase)))/3)*3;
 
   for (i = 0; i < 3; ++i) {
-    if (codon_start_pos +i < (int32_t)feature.get_start() - 1 || codon_start_pos +i > (int32_t)feature.get_end() - 1) { // If before or after CDS region return 'N'.
+    if (mask_outside_cds && (codon_start_pos + i < start - 1 || codon_start_pos + i > end - 1)) { // If before or after CDS region return 'N'.
       codon[i] = 'N';
     } else if (codon_start_pos + i < edit_pos - 1 || edit_pos == -1) { // If before edit or with no edit
-      codon[i] = *(seq + codon_start_pos + i);
+      codon[i] = get_ref_base(region_id, codon_start_pos + i);
     } else if (codon_start_pos + i >= edit_pos - 1 && codon_start_pos + i <= edit_pos - 1 + edit_sequence_size - 1) { // size() - 1 since edit_pos include one base already
       codon[i] = edit_sequence[codon_start_pos + i - (edit_pos - 1)];
     } else if (codon_start_pos + i > edit_pos - 1 + edit_sequence_size - 1) {
       edit_offset = (codon_start_pos + i) - (edit_pos - 1) > edit_sequence_size ? edit_sequence_size : (codon_start_pos + i) - (edit_pos - 1);
-      codon[i] = *(seq + codon_start_pos + i - edit_offset);
+      codon[i] = get_ref_base(region_id, codon_start_pos + i - edit_offset);
     }
   }
 
-  free(seq);
+  alt_index = pos + pos_edit_offset - 1 - codon_start_pos;
+
+  return codon_start_pos;
+}
+
+char* ref_antd::get_codon(int64_t pos, std::string region, gff3_feature feature) {
+  char *codon = new char[3];
+  int64_t alt_index;
+
+  fill_codon(pos, get_region_id(region), feature.get_start(), feature.get_end(), feature.get_phase(), feature.get_edit_position(), feature.get_edit_sequence(), true, codon, alt_index);
 
   return codon;
 }
 
 char* ref_antd::get_codon(int64_t pos, std::string region, gff3_feature feature, char alt) {
-  int len;
-  seq = fai_fetch(this->fai, region.c_str(), &len);
+  char *codon = new char[3];
+  int64_t alt_index;
 
-  int64_t edit_pos = feature.get_edit_position(), codon_start_pos;
-  std::string edit_sequence = feature.get_edit_sequence();
+  fill_codon(pos, get_region_id(region), feature.get_start(), feature.get_end(), feature.get_phase(), feature.get_edit_position(), feature.get_edit_sequence(), false, codon, alt_index);
 
-  int64_t edit_sequence_size = edit_sequence.size();
-  char *codon = new char[3];
+  if (alt_index >= 0 && alt_index < 3)
+    codon[alt_index] = alt;
 
-  int i;
-  int64_t edit_offset = 0, alt_pos = pos;
+  return codon;
+}
 
-  if (pos > edit_pos + edit_sequence_size && edit_pos != -1) {
-    edit_offset = (pos - edit_pos) > edit_sequence_size ? edit_sequence_size : (pos - edit_pos); // Account for edits in position of insertion
+/*
+  Precompute the codons of every CDS at every position of every reference contig. Entries of a
+  position are kept in GFF order, which is the order query_features() returns them in. A contig
+  only gets the CDS on its own seqid. If the GFF has no features on the contig every CDS is
+  matched on position only, as older versions did.
+*/
+int ref_antd::build_codon_tables() {
+  codon_offsets.clear();
+  codon_entries.clear();
+  cds_ids.clear();
+
+  if (seqs.empty() || gff.empty())
+    return 0;
+
+  const std::vector<gff3_feature> &features = gff.get_features();
+  std::vector<gff3_feature>::const_iterator it;
+  std::vector<uint32_t> cds;
+  std::vector<int64_t> edit_pos;
+  std::vector<std::string> edit_seq;
+
+  for (it = features.begin(); it != features.end(); ++it) {
+    if (it->get_type() != "CDS")
+      continue;
+    cds.push_back(it - features.begin());
+    cds_ids.push_back(it->get_attribute("ID"));
+    edit_pos.push_back(it->get_edit_position());
+    edit_seq.push_back(it->get_edit_sequence());
   }
 
-  codon_start_pos = (feature.get_start() - 1) + feature.get_phase() + (((pos + edit_offset - (feature.get_start() + feature.get_phase())))/3)*3;
+  codon_offsets.resize(seqs.size());
+  codon_entries.resize(seqs.size());
 
-  for (i = 0; i < 3; ++i) {
-    if (codon_start_pos + i < edit_pos - 1 || edit_pos == -1) { // If before edit or with no edit
-      codon[i] = *(seq + codon_start_pos + i);
-    } else if (codon_start_pos + i >= edit_pos - 1 && codon_start_pos + i <= edit_pos - 1 + edit_sequence_size - 1) { // size() - 1 since edit_pos include one base already
-      codon[i] = edit_sequence[codon_start_pos + i - (edit_pos - 1)];
-    } else if (codon_start_pos + i > edit_pos - 1 + edit_sequence_size - 1) {
-      edit_offset = (codon_start_pos + i) - (edit_pos - 1) > edit_sequence_size ? edit_sequence_size : (codon_start_pos + i) - (edit_pos - 1);
-      codon[i] = *(seq + codon_start_pos + i - edit_offset);
+  codon_entry e;
+  int64_t len, beg, end, pos, alt_index;
+  std::vector<uint32_t> counts, region_cds;
+
+  for (int r = 0; r < (int) seqs.size(); ++r) {
+    len = seqs[r].size();
+    counts.assign(len + 2, 0);
+
+    region_cds.clear();
+    bool match_seqid = gff.has_seqid(region_names[r]);
+    for (uint32_t c = 0; c < cds.size(); ++c) {
+      if (!match_seqid || features[cds[c]].get_seqid() == region_names[r])
+        region_cds.push_back(c);
     }
-  }
 
-  // Recompute alt position
-  edit_offset = 0;
+    for (std::vector<uint32_t>::iterator c = region_cds.begin(); c != region_cds.end(); ++c) {
+      beg = std::max((int64_t) features[cds[*c]].get_start(), (int64_t) 1);
+      end = std::min((int64_t) features[cds[*c]].get_end(), len);
+      for (pos = beg; pos <= end; ++pos) {
+        counts[pos + 1]++;
+      }
+    }
 
-  if (alt_pos > edit_pos + edit_sequence_size && edit_pos != -1) {
-    edit_offset = (pos - edit_pos) > edit_sequence_size ? edit_sequence_size : (pos - edit_pos); // Account for edits in position of insertion
-  }
+    for (pos = 1; pos < len + 2; ++pos) {
+      counts[pos] += counts[pos - 1];
+    }
 
-  alt_pos += edit_offset;
-  codon[alt_pos - 1 - codon_start_pos] = alt;
+    if (counts[len + 1] == 0)	// No CDS in region
+      continue;
+
+    codon_entries[r].resize(counts[len + 1]);
+
+    for (std::vector<uint32_t>::iterator c = region_cds.begin(); c != region_cds.end(); ++c) {
+      const gff3_feature &f = features[cds[*c]];
+      beg = std::max((int64_t) f.get_start(), (int64_t) 1);
+      end = std::min((int64_t) f.get_end(), len);
+      for (pos = beg; pos <= end; ++pos) {
+        e.cds = *c;
+        fill_codon(pos, r, f.get_start(), f.get_end(), f.get_phase(), edit_pos[*c], edit_seq[*c], true, e.ref_codon, alt_index);
+        e.ref_aa = codon2aa(e.ref_codon[0], e.ref_codon[1], e.ref_codon[2]);
+        fill_codon(pos, r, f.get_start(), f.get_end(), f.get_phase(), edit_pos[*c], edit_seq[*c], false, e.alt_codon, alt_index);
+        e.alt_index = (alt_index >= 0 && alt_index < 3) ? alt_index : -1;
+        codon_entries[r][counts[pos]++] = e;
+      }
+    }
 
-  free(seq);
+    // counts[pos] now holds the end of pos which is the start of pos + 1
+    for (pos = len + 1; pos > 0; --pos) {
+      counts[pos] = counts[pos - 1];
+    }
+    counts[0] = 0;
+    codon_offsets[r] = counts;
+  }
 
-  return codon;
+  return 0;
 }
 
 int ref_antd::add_gff(std::string path) {
@@ -102,7 +202,7 @@ int ref_antd::add_gff(std::string path) {
   if (!path.empty())
     gff.read_file(path);
 
-  return 0;
+  return build_codon_tables();
 }
 
 int ref_antd::add_seq(std::string path) {
@@ -117,16 +217,35 @@ int ref_antd::add_seq(std::string path) {
     return -1;
   }
 
-  return 0;
+  if (!this->fai)
+    return 0;
+
+  // Load every contig once so that lookups do not go back to the file
+  int len;
+  char *contig;
+  std::string name;
+
+  for (int i = 0; i < faidx_nseq(this->fai); ++i) {
+    name = faidx_iseq(this->fai, i);
+    contig = fai_fetch(this->fai, name.c_str(), &len);
+    region_ids[name] = seqs.size();
+    region_names.push_back(name);
+    if (contig) {
+      seqs.push_back(std::string(contig, len));
+      free(contig);
+    } else {
+      seqs.push_back(std::string());
+    }
+  }
+
+  return build_codon_tables();
 }
 
 ref_antd::ref_antd(std::string ref_path) {
-  this->seq = NULL;
   this->add_seq(ref_path);
 }
 
 ref_antd::ref_antd(std::string ref_path, std::string gff_path) {
-  this->seq = NULL;
   this->add_seq(ref_path);
   this->add_gff(gff_path);
 }
@@ -135,29 +254,77 @@ ref_antd::~ref_antd() {
   if (this->fai) fai_destroy(this->fai);
 }
 
-int ref_antd::codon_aa_stream(std::string region, std::ostringstream &line_stream, std::ofstream &fout, int64_t pos, char alt) {
-  std::vector<gff3_feature> features = gff.query_features(pos, "CDS");
+int ref_antd::codon_aa_stream(std::string region, std::ostringstream &line_stream, std::ostream &fout, int64_t pos, char alt) {
+  return codon_aa_stream(get_region_id(region), region, line_stream, fout, pos, alt);
+}
+
+// Same as above with the id of region already looked up
+int ref_antd::codon_aa_stream(int region_id, const std::string &region, std::ostringstream &line_stream, std::ostream &fout, int64_t pos, char alt) {
+  if (region_id < 0 || codon_offsets.empty())	// Region not in reference
+    return codon_aa_stream_features(region, line_stream, fout, pos, alt);
+
+  int64_t len = seqs[region_id].size();
+  uint32_t beg = 0, end = 0;
+
+  if (pos >= 1 && pos <= len && !codon_offsets[region_id].empty()) {
+    beg = codon_offsets[region_id][pos];
+    end = codon_offsets[region_id][pos + 1];
+  }
+
+  if (beg == end) {	// No matching CDS
+    fout << line_stream.str() << "NA\tNA\tNA\tNA\tNA\n";
+    return 0;
+  }
+
+  std::string line = line_stream.str();
+  char alt_codon[3];
+
+  for (uint32_t i = beg; i < end; ++i) {
+    const codon_entry &e = codon_entries[region_id][i];
+    alt_codon[0] = e.alt_codon[0];
+    alt_codon[1] = e.alt_codon[1];
+    alt_codon[2] = e.alt_codon[2];
+    if (e.alt_index >= 0)
+      alt_codon[(int) e.alt_index] = alt;
+
+    fout << line;
+    fout << cds_ids[e.cds] << "\t";
+    fout << e.ref_codon[0] << e.ref_codon[1] << e.ref_codon[2] << "\t";
+    fout << e.ref_aa << "\t";
+    fout << alt_codon[0] << alt_codon[1] << alt_codon[2] << "\t";
+    fout << codon2aa(alt_codon[0], alt_codon[1], alt_codon[2]) << "\n";
+  }
+
+  return 0;
+}
+
+// Annotate from the GFF features directly. Used for regions that are not in the reference.
+int ref_antd::codon_aa_stream_features(std::string region, std::ostringstream &line_stream, std::ostream &fout, int64_t pos, char alt) {
+  std::vector<const gff3_feature*> features;
+  if (gff.has_seqid(region))
+    features = gff.query_features(region, pos, "CDS");
+  else
+    features = gff.query_features(pos, "CDS");
 
   if (features.size() == 0) {	// No matching CDS
-    fout << line_stream.str() << "NA\tNA\tNA\tNA\tNA" << std::endl;
+    fout << line_stream.str() << "NA\tNA\tNA\tNA\tNA\n";
     return 0;
   }
 
-  std::vector<gff3_feature>::iterator it;
+  std::vector<const gff3_feature*>::iterator it;
   char *ref_codon, *alt_codon;
 
   for (it = features.begin(); it != features.end(); it++) {
     fout << line_stream.str();
-    fout << it->get_attribute("ID") << "\t";
+    fout << (*it)->get_attribute("ID") << "\t";
 
-    ref_codon = this->get_codon(pos, region, *it);
+    ref_codon = this->get_codon(pos, region, **it);
     fout << ref_codon[0] << ref_codon[1] << ref_codon[2] << "\t";
     fout << codon2aa(ref_codon[0], ref_codon[1], ref_codon[2]) << "\t";
 
-    alt_codon = this->get_codon(pos, region, *it, alt);
+    alt_codon = this->get_codon(pos, region, **it, alt);
     fout << alt_codon[0] << alt_codon[1] << alt_codon[2] << "\t";
-    fout << codon2aa(alt_codon[0], alt_codon[1], alt_codon[2]);
-    fout << std::endl;
+    fout << codon2aa(alt_codon[0], alt_codon[1], alt_codon[2]) << "\n";
 
     delete[] ref_codon;
     delete[] alt_codon;
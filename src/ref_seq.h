@@ -1,34 +1,73 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <vector>
+#include <map>
+#include <algorithm>
 
 #include <htslib/faidx.h>
 #include "parse_gff.h"
 #include "allele_functions.h"
 
-#ifndef ref_seq
-#define ref_seq
+#ifndef IVAR_REF_SEQ_H
+#define IVAR_REF_SEQ_H
 
 const char UNKNOWN_BASE = 'N';
 
+// Codon of a CDS at one reference position
+struct codon_entry {
+  uint32_t cds;			// Index of the CDS in the order of the GFF file
+  char ref_codon[3];
+  char ref_aa;
+  char alt_codon[3];		// Reference codon before the alternate base is substituted
+  int8_t alt_index;		// Index of the position in alt_codon. -1 if outside of the codon.
+};
+
 class ref_antd{
 public:
   ref_antd(std::string ref_path);
   ref_antd(std::string ref_path, std::string gff_path);
   ~ref_antd();
-  char get_base(int64_t pos, std::string region);
+  char get_base(int64_t pos, std::string region) const;
+  char get_base(int64_t pos, int region_id) const;
+  int get_region_id(const std::string &region) const;
+  int get_region_count() const;
+  std::string get_region_name(int region_id) const;
+  int64_t get_region_length(int region_id) const;
   int add_gff(std::string path);
   int add_seq(std::string path);
-  int codon_aa_stream(std::string region, std::ostringstream &line_stream, std::ofstream &fout, int64_t pos, char alt);
+  int codon_aa_stream(std::string region, std::ostringstream &line_stream, std::ostream &fout, int64_t pos, char alt);
+  int codon_aa_stream(int region_id, const std::string &region, std::ostringstream &line_stream, std::ostream &fout, int64_t pos, char alt);
+  int codon_aa_stream_features(std::string region, std::ostringstream &line_stream, std::ostream &fout, int64_t pos, char alt);
   char* get_codon(int64_t pos, std::string region, gff3_feature feature);
   char* get_codon(int64_t pos, std::string region, gff3_feature feature, char alt);
   std::vector<gff3_feature> get_gff_features();
 
 private:
-  char *seq;
+  char get_ref_base(int region_id, int64_t i) const;
+  int64_t fill_codon(int64_t pos, int region_id, int64_t start, int64_t end, int phase, int64_t edit_pos, const std::string &edit_sequence, bool mask_outside_cds, char *codon, int64_t &alt_index) const;
+  int build_codon_tables();
+
   gff3 gff;
   faidx_t *fai;
-  std::string region;
+  std::vector<std::string> seqs;	// Contig sequences indexed by region id
+  std::vector<std::string> region_names;
+  std::map<std::string, int> region_ids;
+  std::vector<std::vector<uint32_t> > codon_offsets;	// Per region, entries of pos are codon_entries[pos] to codon_entries[pos + 1]
+  std::vector<std::vector<codon_entry> > codon_entries;
+  std::vector<std::string> cds_ids;
+};
+
+// Id of the last region looked up. Pileup lines and variants come grouped by region, so most lookups skip the map.
+class region_cache {
+public:
+  region_cache();
+  int get_region_id(const ref_antd &refantd, const std::string &region);
+
+private:
+  std::string name;
+  int id;
+  bool valid;
 };
 
 #endif
@@ -1,11 +1,11 @@
 #include "remove_reads_from_amplicon.h"
 
-int rmv_reads_from_amplicon (std::string bam, std::string region_, std::string bam_out, std::vector<std::string> amp, std::string bed, std::string cmd) {
-  std::vector<primer> primers = populate_from_file(bed);
-  if (primers.size() == 0) {
-    return 0;
-  }
-
+/*
+  Write every read whose primer, in the XA tag, is not set in mask. Without a region the whole file,
+  every reference and the unmapped reads, is streamed and no index is needed. With a region only
+  the reads in it are read through the index. The BAM is compressed on nthreads threads.
+*/
+int rmv_reads_with_primer_mask(std::string bam, std::string region_, std::string bam_out, const std::vector<bool> &mask, std::string cmd, int nthreads) {
   bam_out += ".bam";
   std::cout << "Writing to " << bam_out << std::endl;
   if (bam.empty()) {
@@ -15,99 +15,94 @@ int rmv_reads_from_amplicon (std::string bam, std::string region_, std::string b
 
   //open BAM for reading
   samFile *in = hts_open(bam.c_str(), "r");
-  BGZF *out = bgzf_open(bam_out.c_str(), "w");
   if (in == NULL) {
     std::cout << ("Unable to open BAM/SAM file.") << std::endl;
     return -1;
   }
 
-  //Load the index
-  hts_idx_t *idx = sam_index_load(in, bam.c_str());
-  if (idx == NULL) {
-    if (sam_index_build2(bam.c_str(), 0, 0)< 0) {
-      std::cout << ("Unable to open BAM/SAM index.") << std::endl;
-      return -1;
-    } else {
-      idx = sam_index_load(in, bam.c_str());
-    }
-  }
-  
   //Get the header
   bam_hdr_t *header = sam_hdr_read(in);
-  add_pg_line_to_header(&header, const_cast<char *>(cmd.c_str()));
-  if (bam_hdr_write(out, header) < 0) {
-    std::cout << "Unable to write BAM header to path." << std::endl;
-    sam_close(in);
-    return -1;
-  }
-
   if (header == NULL) {
     sam_close(in);
     std::cout << "Unable to open BAM/SAM header." << std::endl;
+    return -1;
   }
 
-  if (region_.empty()) {
-    std::cout << "Number of references: " << header->n_targets << std::endl;
-
-    for (int i = 0; i < header->n_targets; ++i) {
-      std::cout << "Reference Name: " << header->target_name[i] << std::endl;
-      std::cout << "Reference Length: " << header->target_len[i] << std::endl;
-      if (i==0) {
-        region_.assign(header->target_name[i]);
+  //Load the index only to read a region
+  hts_idx_t *idx = NULL;
+  hts_itr_t *iter = NULL;
+  if (!region_.empty()) {
+    idx = sam_index_load(in, bam.c_str());
+    if (idx == NULL) {
+      if (sam_index_build2(bam.c_str(), 0, 0)< 0) {
+        std::cout << ("Unable to open BAM/SAM index.") << std::endl;
+        bam_hdr_destroy(header);
+        sam_close(in);
+        return -1;
+      } else {
+        idx = sam_index_load(in, bam.c_str());
       }
     }
 
     std::cout << "Using Region: " << region_ << std::endl;
+    if (idx != NULL)
+      iter = sam_itr_querys(idx, header, region_.c_str());
+    if (iter == NULL) {
+      std::cout << "Unable to iterate to region within BAM/SAM." << std::endl;
+      hts_idx_destroy(idx);
+      bam_hdr_destroy(header);
+      sam_close(in);
+      return -1;
+    }
   }
 
-  std::string temp(header->text);
-  std::string sortFlag ("SO:coordinate");
-  if (temp.find(sortFlag)) {
-    std::cout << "Sorted By Coordinate" << std::endl; // Sort by coordinate
-  } else {
-    std::cout << "Not sorted" << std::endl;
+  BGZF *out = bgzf_open(bam_out.c_str(), "w");
+  if (out == NULL) {
+    std::cout << "Unable to open " << bam_out << std::endl;
+    hts_itr_destroy(iter);
+    hts_idx_destroy(idx);
+    bam_hdr_destroy(header);
+    sam_close(in);
+    return -1;
   }
 
-  //Initialize iterator
-  hts_itr_t *iter = NULL;
+  if (nthreads > 1) {
+    hts_set_threads(in, nthreads);
+    bgzf_mt(out, nthreads, 256);
+  }
 
-  //Move the iterator to the region we are interested in
-  iter  = sam_itr_querys(idx, header, region_.c_str());
-  if (header == NULL || iter == NULL) {
+  add_pg_line_to_header(&header, const_cast<char *>(cmd.c_str()));
+  if (bam_hdr_write(out, header) < 0) {
+    std::cout << "Unable to write BAM header to path." << std::endl;
+    hts_itr_destroy(iter);
+    hts_idx_destroy(idx);
+    bam_hdr_destroy(header);
     sam_close(in);
-    std::cout << "Unable to iterate to region within BAM/SAM." << std::endl;
+    bgzf_close(out);
     return -1;
   }
 
   //Initiate the alignment record
   bam1_t *aln = bam_init1();
-  int ctr = 0, rmv_ctr = 0;
+  int ctr = 0, rmv_ctr = 0, res = 0;
+  int64_t p;
   bool w;
 
-  while (sam_itr_next(in, iter, aln) >= 0) {
+  while (((iter != NULL) ? sam_itr_next(in, iter, aln) : sam_read1(in, header, aln)) >= 0) {
     uint8_t* a = bam_aux_get(aln, "XA");
     w = true;
 
     if (a != 0) {
-      for (std::vector<std::string>::iterator it = amp.begin(); it != amp.end(); ++it) {
-        if (bam_aux2i(a) == get_primer_indice(primers, *it)) {
-          w = false;
-        }
-      }
+      p = bam_aux2i(a);
+      if (p >= 0 && p < (int64_t) mask.size() && mask[p])
+        w = false;
     }
 
     if (w) {
       if (bam_write1(out, aln) < 0) {
         std::cout << "Not able to write to BAM" << std::endl;
-
-        hts_itr_destroy(iter);
-        hts_idx_destroy(idx);
-        bam_destroy1(aln);
-        bam_hdr_destroy(header);
-        sam_close(in);
-        bgzf_close(out);
-
-        return -1;
+        res = -1;
+        break;
       }
     } else {
       rmv_ctr++;
@@ -118,16 +113,58 @@ int rmv_reads_from_amplicon (std::string bam, std::string region_, std::string b
       std::cout << "Processed " << ctr << " reads" << std::endl;
     }
   }
-  
-  std::cout << "Results:" << std::endl;
-  std::cout << rmv_ctr << " reads were removed." << std::endl;
+
+  if (res == 0) {
+    std::cout << "Results:" << std::endl;
+    std::cout << rmv_ctr << " reads were removed." << std::endl;
+  }
 
   hts_itr_destroy(iter);
   hts_idx_destroy(idx);
   bam_destroy1(aln);
   bam_hdr_destroy(header);
   sam_close(in);
-  bgzf_close(out);
-  
-  return 0;
+  if (bgzf_close(out) != 0)
+    res = -1;
+
+  return res;
+}
+
+int rmv_reads_from_amplicon (std::string bam, std::string region_, std::string bam_out, std::vector<std::string> amp, std::string bed, std::string cmd, int nthreads) {
+  std::vector<primer> primers = populate_from_file(bed);
+  if (primers.size() == 0) {
+    return 0;
+  }
+
+  // Primers to remove, by primer index
+  return rmv_reads_with_primer_mask(bam, region_, bam_out, get_primer_mask(primers, amp), cmd, nthreads);
+}
+
+/*
+  getmasked and removereads in one pass. The primers covering the variants in vpath and their
+  pairs are found through a primer_index and the reads of those primers are removed from bam
+  without writing the primer names to a file.
+*/
+int mask_reads_from_variants(std::string bam, std::string vpath, std::string bed, std::string primer_pair_file, std::string bam_out, std::string cmd, int nthreads) {
+  std::vector<primer> primers = populate_from_file(bed);
+  if (primers.size() == 0) {
+    return 0;
+  }
+
+  populate_pair_indices(primers, primer_pair_file);
+  std::vector<int> masked;
+  if (get_masked_primers(primers, vpath, masked) != 0)
+    return -1;
+
+  std::vector<bool> mask(primers.size(), false);
+  std::cout << "Masked primers: ";
+  for (std::vector<int>::iterator it = masked.begin(); it != masked.end(); ++it) {
+    mask[*it] = true;
+    std::cout << primers[*it].get_name();
+    if (it != masked.end() - 1)
+      std::cout << "\t";
+  }
+  std::cout << std::endl;
+
+  return rmv_reads_with_primer_mask(bam, "", bam_out, mask, cmd, nthreads);
 }
@@ -1,14 +1,17 @@
 #include "primer_bed.h"
 #include "trim_primer_quality.h"
+#include "get_masked_amplicons.h"
 #include "htslib/sam.h"
 #include "htslib/bgzf.h"
 
 #include<iostream>
 #include <stdint.h>
 
-#ifndef removereads_from_amplicon
-#define removereads_from_amplicon
+#ifndef IVAR_REMOVE_READS_FROM_AMPLICON_H
+#define IVAR_REMOVE_READS_FROM_AMPLICON_H
 
-int rmv_reads_from_amplicon(std::string bam, std::string region_, std::string bam_out, std::vector<std::string> amp, std::string bed, std::string cmd);
+int rmv_reads_with_primer_mask(std::string bam, std::string region_, std::string bam_out, const std::vector<bool> &mask, std::string cmd, int nthreads = 1);
+int rmv_reads_from_amplicon(std::string bam, std::string region_, std::string bam_out, std::vector<std::string> amp, std::string bed, std::string cmd, int nthreads = 1);
+int mask_reads_from_variants(std::string bam, std::string vpath, std::string bed, std::string primer_pair_file, std::string bam_out, std::string cmd, int nthreads = 1);
 
 #endif
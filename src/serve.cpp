@@ -0,0 +1,285 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <cerrno>
+#include <cstring>
+
+#include "serve.h"
+
+static int connect_socket(const std::string &socket_path);
+
+job_server::job_server(unsigned int nthreads, int read_timeout) {
+  this->nthreads = (nthreads == 0) ? 1 : nthreads;
+  this->read_timeout = read_timeout;
+  this->listen_fd = -1;
+  this->stopping = false;
+}
+
+job_server::~job_server() {
+  stop();
+  for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it) {
+    if (it->joinable())
+      it->join();
+  }
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(socket_path.c_str());
+  }
+}
+
+// Remove a socket left at socket_path by a server that has stopped. Anything else at the path is left in place.
+static int remove_stale_socket(const std::string &socket_path) {
+  struct stat st;
+  if (lstat(socket_path.c_str(), &st) != 0)
+    return (errno == ENOENT) ? 0 : -1;
+  if (!S_ISSOCK(st.st_mode)) {
+    std::cout << socket_path << " exists and is not a socket" << std::endl;
+    return -1;
+  }
+  int fd = connect_socket(socket_path);
+  if (fd >= 0) {
+    close(fd);
+    std::cout << "Another server is listening on " << socket_path << std::endl;
+    return -1;
+  }
+  unlink(socket_path.c_str());
+  return 0;
+}
+
+// Listen on socket_path and start the workers. The socket is only accessible to the user running the server.
+int job_server::start(std::string socket_path) {
+  struct sockaddr_un addr;
+  if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cout << "Socket path must be between 1 and " << sizeof(addr.sun_path) - 1 << " characters long: " << socket_path << std::endl;
+    return -1;
+  }
+  if (remove_stale_socket(socket_path) != 0)
+    return -1;
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    std::cout << "Unable to create socket: " << strerror(errno) << std::endl;
+    return -1;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  mode_t mask = umask(0177);	// Create the socket with mode 0600
+  int bound = bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr));
+  umask(mask);
+  if (bound != 0 || listen(listen_fd, SOMAXCONN) != 0) {
+    std::cout << "Unable to listen on " << socket_path << ": " << strerror(errno) << std::endl;
+    if (bound == 0)
+      unlink(socket_path.c_str());
+    close(listen_fd);
+    listen_fd = -1;
+    return -1;
+  }
+  this->socket_path = socket_path;
+  for (unsigned int i = 0; i < nthreads; ++i)
+    workers.push_back(std::thread(&job_server::worker_loop, this));
+  return 0;
+}
+
+// Accept connections until stop() or a shutdown job. Jobs already accepted are finished before returning.
+int job_server::run() {
+  int res = 0, fd;
+  struct pollfd pfd;
+  pfd.fd = listen_fd;
+  pfd.events = POLLIN;
+  while (listen_fd >= 0) {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      if (stopping)
+        break;
+    }
+    int n = poll(&pfd, 1, SERVE_POLL_MS);
+    if (n < 0 && errno != EINTR) {
+      std::cout << "Unable to accept connections: " << strerror(errno) << std::endl;
+      res = -1;
+      break;
+    }
+    if (n <= 0)
+      continue;
+    fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0)
+      continue;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      connections.push_back(fd);
+    }
+    cv.notify_one();
+  }
+  stop();
+  for (std::vector<std::thread>::iterator it = workers.begin(); it != workers.end(); ++it)
+    it->join();
+  workers.clear();
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    listen_fd = -1;
+  }
+  return res;
+}
+
+void job_server::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    stopping = true;
+  }
+  cv.notify_all();
+}
+
+void job_server::worker_loop() {
+  int fd;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [this] { return stopping || !connections.empty(); });
+      if (connections.empty())
+        return;
+      fd = connections.front();
+      connections.pop_front();
+    }
+    handle_connection(fd);
+  }
+}
+
+static int send_all(int fd, const std::string &s) {
+  size_t sent = 0;
+  while (sent < s.size()) {
+    ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    sent += n;
+  }
+  return 0;
+}
+
+// Read up to the first newline, the end of the connection or max bytes
+static std::string read_line(int fd, size_t max) {
+  std::string line;
+  char buf[4096];
+  while (line.find('\n') == std::string::npos && line.size() < max) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    line.append(buf, n);
+  }
+  return line.substr(0, line.find('\n'));
+}
+
+// Clients that do not send their job within read_timeout seconds are closed, so they cannot hold a worker
+void job_server::handle_connection(int fd) {
+  struct timeval tv;
+  tv.tv_sec = read_timeout;
+  tv.tv_usec = 0;
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string line = read_line(fd, MAX_JOB_REQUEST_SIZE), response;
+  job_request req;
+  if (parse_job_request(line, req) != 0) {
+    response = error_response("Job is not a JSON object on one line of at most " + std::to_string(MAX_JOB_REQUEST_SIZE) + " bytes");
+  } else {
+    response = run_job(req);
+  }
+  send_all(fd, response + "\n");
+  close(fd);
+}
+
+// Shutdown jobs stop the server, every other job is run by the shared job_runner
+std::string job_server::run_job(const job_request &req) {
+  job_request::const_iterator cmd = req.find("cmd");
+  if (cmd != req.end() && cmd->second == "shutdown") {
+    stop();
+    return "{\"status\": \"ok\", \"cmd\": \"shutdown\"}";
+  }
+  return runner.run_job(req);
+}
+
+int serve_jobs(std::string socket_path, unsigned int nthreads) {
+  job_server server(nthreads);
+  if (server.start(socket_path) != 0)
+    return -1;
+  std::cout << "Listening on " << socket_path << " with " << nthreads << " worker threads" << std::endl;
+  return server.run();
+}
+
+static int connect_socket(const std::string &socket_path) {
+  struct sockaddr_un addr;
+  if (socket_path.size() >= sizeof(addr.sun_path))
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/*
+  Send every line of jobs to the server at socket_path and write the response of each job to out
+  in the order of the jobs. Up to MAX_CLIENT_JOBS jobs are sent before waiting on the first
+  response. Relative paths in jobs are resolved from the current directory. Returns -1 if any job
+  failed.
+*/
+int submit_jobs(std::string socket_path, std::istream &jobs, std::ostream &out) {
+  std::deque<std::pair<int, std::string> > pending;	// Connection of a job, or -1 and the response of a job that was not sent
+  std::string line, cwd, response;
+  job_request req;
+  int res = 0, fd;
+  char *dir = getcwd(NULL, 0);
+  if (dir != NULL) {
+    cwd = dir;
+    free(dir);
+  }
+  while (true) {
+    bool more = (bool) std::getline(jobs, line);
+    if (more && line.find_first_not_of(" \t\r") == std::string::npos)
+      continue;
+    if (more) {
+      if (parse_job_request(line, req) != 0) {
+        pending.push_back(std::make_pair(-1, error_response("Job is not a JSON object on one line: " + line)));
+      } else {
+        if (req.find("cwd") == req.end() && !cwd.empty())
+          req["cwd"] = cwd;
+        fd = connect_socket(socket_path);
+        if (fd < 0) {
+          pending.push_back(std::make_pair(-1, error_response("Unable to connect to " + socket_path + ": " + strerror(errno))));
+        } else {
+          send_all(fd, write_job_request(req) + "\n");
+          shutdown(fd, SHUT_WR);
+          pending.push_back(std::make_pair(fd, std::string()));
+        }
+      }
+    }
+    while (!pending.empty() && (!more || pending.size() >= MAX_CLIENT_JOBS)) {
+      fd = pending.front().first;
+      response = pending.front().second;
+      pending.pop_front();
+      if (fd >= 0) {
+        response = read_line(fd, std::string::npos);
+        close(fd);
+        if (response.empty())
+          response = error_response("No response from " + socket_path);
+      }
+      if (response.find("\"status\": \"ok\"") == std::string::npos)
+        res = -1;
+      out << response << std::endl;
+    }
+    if (!more)
+      break;
+  }
+  return res;
+}
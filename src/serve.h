@@ -0,0 +1,60 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "job_runner.h"
+
+#ifndef IVAR_SERVE_H
+#define IVAR_SERVE_H
+
+const size_t MAX_JOB_REQUEST_SIZE = 1 << 16;	// Longest request line accepted
+const int SERVE_POLL_MS = 200;			// Interval at which the server checks for shutdown
+const unsigned int MAX_CLIENT_JOBS = 64;		// Jobs a client keeps open on the server at a time
+const int SERVE_READ_TIMEOUT_S = 30;			// Time a connection has to send its job before it is closed
+
+/*
+  Server for `ivar serve`. Clients connect to a Unix domain socket and send one job per connection
+  as a line of JSON, for example
+
+  {"cmd": "variants", "bam": "s1.bam", "prefix": "s1", "ref": "ref.fa", "gff": "ref.gff"}
+
+  Jobs run on a shared pool of worker threads and the worker writes one line of JSON with the
+  result and the counts of the job back before closing the connection. All workers share one
+  job_runner, so primer schemes, references and annotations are kept until the server stops.
+
+  Jobs read and write files as the user running the server, so the socket is only accessible to
+  that user (mode 0600).
+*/
+class job_server {
+public:
+  job_server(unsigned int nthreads, int read_timeout = SERVE_READ_TIMEOUT_S);
+  ~job_server();
+  int start(std::string socket_path);
+  int run();
+  void stop();
+  std::string run_job(const job_request &req);
+
+private:
+  void worker_loop();
+  void handle_connection(int fd);
+
+  unsigned int nthreads;
+  int read_timeout;
+  std::string socket_path;
+  int listen_fd;
+  bool stopping;
+  std::vector<std::thread> workers;
+  std::deque<int> connections;
+  std::mutex mtx;
+  std::condition_variable cv;
+  job_runner runner;
+};
+
+int serve_jobs(std::string socket_path, unsigned int nthreads);
+int submit_jobs(std::string socket_path, std::istream &jobs, std::ostream &out);
+
+#endif
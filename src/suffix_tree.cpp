@@ -2,252 +2,19 @@
 #include "algorithm"
 #include "fstream"
 #include "vector"
+#include "memory"
+#include "functional"
 
 #include "suffix_tree.h"
 #include "alignment.h"
-
-suffix_node::suffix_node(int b, int *e, suffix_node *p, suffix_node *l) {
-  this->children = new suffix_node*[MAX_CHAR];
-
-  for (unsigned int i = 0; i < MAX_CHAR;i++)
-    this->children[i] = 0;
-
-  this->begin = b;
-  this->end = e;
-  this->nchildren = 0;
-  this->parent = p;
-  this->suffix_link =l;
-}
-
-bool suffix_node::is_leaf_node() {
-  return (nchildren == 0);
-}
-
-bool suffix_node::contains_child(int ext) {
-  return !(this->children[ext] == 0);
-}
-
-int suffix_node::get_length() {
-  if (this->end == 0)
-    return 0;			// For root
-
-  return *(this->end) - this->begin + 1;
-}
-
-int suffix_node::get_depth() {
-  int ctr = 0;
-  suffix_node* n = this;
-
-  while (n->begin!=-1) {
-    n = n->parent;
-    ctr++;
-  }
-
-  return ctr;
-}
-
-int get_hamming_distance(std::string s1, std::string s2, int k) {
-  int n = 0;
-  for (unsigned int i = 0; i < s1.length(); i++) {
-    if (s1[i] != s2[i]) {
-      n++;
-    }
-
-    if (n > k)
-      return -1;
-  }
-
-  return n;
-}
-
-std::string suffix_node::get_longest_common_substring(std::string s1, std::string s2) {
-  std::string str = s1+"#"+s2+"@";
-  std::string p="", tmp, longest_trvsl = "";
-  unsigned int max = 0, i;
-  suffix_node* node = this;
-
-  if (node->begin == -1)
-    p = "";
-  else {
-    tmp = node->get_path(str);
-    if (s1.find(p+tmp) != std::string::npos && s2.find(p+tmp) != std::string::npos)
-      p += tmp;
-  }
-
-  tmp = "";
-
-  for (i = 0; i < MAX_CHAR;i++) {
-    if (node->children[i] == 0)
-      continue;
-    longest_trvsl = node->children[i]->get_longest_common_substring(s1, s2);
-    if (longest_trvsl.length() > max) {
-      max = longest_trvsl.length();
-      tmp = longest_trvsl;
-    }
-  }
-
-  p += tmp;
-
-  return p;
-}
-
-std::string suffix_node::get_path(std::string s) {
-  if (this->begin == -1)
-    return "R";
-
-  return s.substr(this->begin, *(this->end) - this->begin + 1);
-}
-
-void suffix_node::extend_path(int *e) {
-  this->end = e;
-}
-
-suffix_node* suffix_node::add_child(int ext, int b, int *e, suffix_node* l) {
-  suffix_node *n = new suffix_node(b, e, this, l);
-
-  this->children[ext] = n;
-  this->nchildren++;
-
-  return n;
-}
-
-void suffix_node::add_child(suffix_node* c, int ext) {
-  this->children[ext] = c;
-  c->parent = this;
-  this->nchildren++;
-}
-
-suffix_node* suffix_node::get_child(int ext) {
-  return this->children[ext];
-}
-
-bool suffix_node::contains_depth(int depth) {
-  return this->get_depth() <= depth && depth <= (this->get_length() + this->get_depth());
-}
-
-void suffix_node::print(std::string s) {
-  for (int i = 0; i < this->get_depth(); i++) {
-    std::cout << " ";
-  }
-
-  std::string t = (this->begin == -1) ? "R" : " "+s.substr(this->begin, *(this->end) - this->begin + 1);
-  std::cout << t;
-
-  if (this->suffix_link != 0)
-    std::cout << " --- ( " << this->suffix_link->parent->get_path(s) << " " << this->suffix_link->get_path(s) << ")";
-
-  if (this->begin!=-1)
-    std::cout << " - " << this->parent->get_path(s);
-
-  std::cout << std::endl;
-
-  for (unsigned int i = 0; i<alphabet.length();i++) {
-    if (this->children[i]!=0)
-      this->children[i]->print(s);
-  }
-}
-
-bool suffix_node::walk_next(int &beg, int &suffix_length) {
-  suffix_node *node = this;
-
-  if (suffix_length >= node->get_length()) {
-    beg += node->get_length();
-    suffix_length -= node->get_length();
-    return true;
-  }
-
-  return false;
-}
-
-suffix_node* build_suffix_tree(std::string s) {
-  suffix_node *root = new suffix_node(-1,0,0,0);
-  root->suffix_link = root;
-  root->parent = root;
-  suffix_node *cur_node = root, *new_node = 0, *new_cur_node = 0;
-
-  int str_ind[MAX_SIZE], suffix_length = 0, *leaf_end=  new int, suffix_count = 0, beg = -1, *end;
-  unsigned int i = 0, n_str_ind = 0;
-
-  for (i = 0; i < s.length();i++) {
-    str_ind[i] = alphabet.find(s[i]);
-    n_str_ind++;
-  }
-
-  *leaf_end = 0;
-
-  // root->add_child(str_ind[0], 0, leaf_end, root);
-  for (i = 0; i < n_str_ind;i++) {
-    *leaf_end = i;		// Handle Extension Rule 1
-    suffix_count++;
-    new_node = 0;
-
-    while (suffix_count > 0) {
-      if (suffix_length == 0)
-        beg = i;
-
-      if (cur_node->children[str_ind[beg]] == 0) {	     // Rule 2
-        cur_node->add_child(str_ind[beg], beg, leaf_end, 0); // Trick 3
-
-        if (new_node != 0) {
-          new_node->suffix_link = cur_node;
-          new_node = 0;		// No internal node created in Rule 2 here.
-        }
-      } else {
-        new_cur_node = cur_node->children[str_ind[beg]];
-        if (new_cur_node->walk_next(beg, suffix_length)) {
-          cur_node = new_cur_node;
-          continue;
-        }
-
-        if (str_ind[new_cur_node->begin + suffix_length] == str_ind[i]) { // Rule 3
-          if (new_node != 0 && cur_node->end != 0) {
-            new_node->suffix_link = cur_node;
-            new_node = 0;		// No internal node created in Rule 2 here.
-          }
-          suffix_length++;
-          break;
-        }
-
-        // Rule 2 - New internal node created
-        suffix_node *new_int_node;
-        end = new int;
-        *end = new_cur_node->begin + suffix_length - 1;
-
-        //New internal node
-        new_int_node = cur_node->add_child(str_ind[beg], new_cur_node->begin, end, 0);
-        new_int_node->add_child(str_ind[i], i, leaf_end, 0);
-        new_cur_node->begin += suffix_length;
-        new_int_node->add_child(new_cur_node, str_ind[new_cur_node->begin]);
-
-        if (new_node != 0)
-          new_node->suffix_link = new_int_node;
-
-        new_node = new_int_node;
-      }
-
-      suffix_count--;
-
-      if (cur_node->end==0 && suffix_length > 0) {
-        suffix_length--;
-        beg = i - suffix_count + 1;
-      } else if (cur_node->end!=0) {
-        if (cur_node->suffix_link != 0) {
-          cur_node = cur_node->suffix_link;
-        } else {
-          cur_node = cur_node->parent->suffix_link;
-        }
-      } else if (cur_node->get_length() == 1) {
-        cur_node = root;
-      }
-    }
-  }
-
-  return root;
-}
+#include "buffered_writer.h"
+#include "bgzf_stream.h"
+#include "ordered_pool.h"
 
 std::string get_reverse_complement(std::string rev_read) {
-  char t = 'N';
+  char t;
   for (unsigned int i = 0;i< rev_read.length();i++) {
+    t = 'N';
     switch(rev_read[i]) {
       case 'A':
         t = 'T';
@@ -277,7 +44,7 @@ std::vector<std::string> read_adapters_from_fasta(std::string p) {
   std::string line;
 
   while (std::getline(fin, line)) {
-    if (line[0] == '>')
+    if (line.empty() || line[0] == '>')
       continue;
 
     adp.push_back(line);
@@ -286,134 +53,286 @@ std::vector<std::string> read_adapters_from_fasta(std::string p) {
   return adp;
 }
 
-std::string extend_till_mismatches(std::string cmn, std::string l, std::string adp) {
-  if (cmn.length() < MIN_LENGTH) {
-    return cmn;
+/*
+  Part of read to keep, [beg, beg + len), given the longest exact match with an adapter. The match
+  is extended towards the start of the adapter with up to MAX_MISMATCHES mismatches. If that does
+  not reach the start of the adapter within the read, the read is aligned to the adapter. A
+  forward adapter removes the read from its start onwards and a reverse complemented adapter
+  removes the read up to its end.
+*/
+bool get_adapter_trim(const std::string &read, adapter_index &index, const adapter_hit &hit, unsigned int &beg, unsigned int &len) {
+  if (hit.adapter == -1)
+    return false;
+
+  const std::string &adp = index.get_adapter(hit.adapter, hit.reverse);
+  int k = 0, r, a, start;
+  beg = 0;
+  len = read.length();
+
+  if (!hit.reverse) {
+    r = hit.read_pos - 1;
+    a = hit.adapter_pos - 1;
+    while (r >= 0 && a >= 0 && k <= MAX_MISMATCHES) {
+      if (read[r] != adp[a])
+        k++;
+      r--;
+      a--;
+    }
+
+    if (a < 0 && k <= MAX_MISMATCHES) {
+      len = r + 1;
+      return true;
+    }
+
+    if (index.get_aligner(hit.adapter).align(read, start) == -1)
+      return false;
+    len = start;
+  } else {
+    r = hit.read_pos + hit.length;
+    a = hit.adapter_pos + hit.length;
+    while (r < (int) read.length() && a < (int) adp.length() && k <= MAX_MISMATCHES) {
+      if (read[r] != adp[a])
+        k++;
+      r++;
+      a++;
+    }
+
+    if (a == (int) adp.length() && k <= MAX_MISMATCHES) {
+      beg = r;
+      len = read.length() - r;
+      return true;
+    }
+
+    if (index.get_aligner(hit.adapter).align(get_reverse_complement(read), start) == -1)
+      return false;
+    beg = read.length() - start;
+    len = start;
   }
 
-  int pos = adp.find(cmn);
-  int r_pos = l.find(cmn);
+  return true;
+}
 
-  if (pos == 0)			// Beginning of adapter match
-    return cmn;
+/*
+  Insert length of a read pair from the overlap of read 1 with the reverse complement of read 2,
+  or -1 if they do not overlap. When the insert is shorter than the reads, the reverse
+  complement of read 2 starts with adapter, so read 1 lines up with it at an offset. Offsets are
+  tried from 0 upwards with an ungapped comparison and the first with few enough mismatches
+  gives the insert length.
+*/
+int get_insert_length(const std::string &r1, const std::string &r2_rc) {
+  int len1 = r1.length(), len2 = r2_rc.length(), ov, max_mismatches;
+  for (int d = 0; len2 - d >= MIN_MATE_OVERLAP; d++) {
+    ov = std::min(len1, len2 - d);
+    if (ov < MIN_MATE_OVERLAP)
+      break;
+    max_mismatches = std::min(MAX_MATE_MISMATCHES, ov / 10);
+    if (count_mismatches(r1.c_str(), r2_rc.c_str() + d, ov, max_mismatches) <= max_mismatches)
+      return len2 - d;
+  }
 
-  int k = 0;
-  pos--;
-  r_pos--;
+  return -1;
+}
 
-  while (r_pos >= 0 && pos >= 0 && k <= MAX_MISMATCHES) {
-    cmn = l[r_pos] + cmn;
+// Part of a single read to keep after adapter trimming. The whole read is kept if no adapter is found.
+static bool trim_read(const std::string &seq, adapter_index &index, unsigned int &beg, unsigned int &len) {
+  if (get_adapter_trim(seq, index, index.find(seq), beg, len))
+    return true;
 
-    if (l[r_pos]!=adp[pos])
-      k++;
+  beg = 0;
+  len = seq.length();
 
-    r_pos--;
-    pos--;
+  return false;
+}
+
+// Batch of single reads or read pairs with the part of every read to keep
+struct trim_job {
+  fastq_batch r1, r2;
+  std::vector<unsigned int> beg1, len1, beg2, len2;
+  unsigned int n_trimmed, n_overlap;
+};
+
+/*
+  Trim every record of job. Mates are first checked for overlap, which gives the insert length
+  without looking at the adapters. Pairs that do not overlap are trimmed read by read with the
+  adapter index. seq1 and seq2 are scratch buffers of the worker.
+*/
+static void trim_batch(trim_job &job, bool paired, adapter_index &index, std::string &seq1, std::string &seq2) {
+  size_t n = job.r1.size();
+  int insert;
+
+  job.beg1.resize(n);
+  job.len1.resize(n);
+  job.beg2.resize(paired ? n : 0);
+  job.len2.resize(paired ? n : 0);
+  job.n_trimmed = 0;
+  job.n_overlap = 0;
+
+  for (size_t i = 0; i < n; ++i) {
+    seq1.assign(job.r1.line(i, 1), job.r1.line_length(i, 1));
+    if (!paired) {
+      if (trim_read(seq1, index, job.beg1[i], job.len1[i]))
+        job.n_trimmed++;
+      continue;
+    }
+
+    seq2.assign(job.r2.line(i, 1), job.r2.line_length(i, 1));
+    job.beg1[i] = 0;
+    job.beg2[i] = 0;
+    job.len1[i] = seq1.length();
+    job.len2[i] = seq2.length();
+    insert = get_insert_length(seq1, get_reverse_complement(seq2));
+    if (insert != -1) {
+      job.n_overlap++;
+      job.len1[i] = std::min(job.len1[i], (unsigned int) insert);
+      job.len2[i] = std::min(job.len2[i], (unsigned int) insert);
+    } else {
+      trim_read(seq1, index, job.beg1[i], job.len1[i]);
+      trim_read(seq2, index, job.beg2[i], job.len2[i]);
+    }
+
+    if (job.len1[i] != seq1.length() || job.len2[i] != seq2.length())
+      job.n_trimmed++;
   }
+}
+
+// Write record rec of batch with its sequence and quality cut to [beg, beg + len)
+static void write_fastq_record(std::ostream &out, const fastq_batch &batch, size_t rec, unsigned int beg, unsigned int len) {
+  size_t qual_len = batch.line_length(rec, 3), qual_beg = std::min((size_t) beg, qual_len);
 
-  return cmn;
+  out.write(batch.line(rec, 0), batch.line_length(rec, 0) + 1);
+  out.write(batch.line(rec, 1) + beg, len);
+  out.put('\n');
+  out.write(batch.line(rec, 2), batch.line_length(rec, 2) + 1);
+  out.write(batch.line(rec, 3) + qual_beg, std::min((size_t) len, qual_len - qual_beg));
+  out.put('\n');
 }
 
-int trim_adapter(std::string f1, std::string f2, std::string adp_path, std::string p) {
-  std::string l1, l2, l1_rc, l2_rc, s, cmn, trmd_read;
+// Trimmed FASTQ file, plain or bgzipped on nthreads threads
+class fastq_output {
+public:
+  std::ostream* open(const std::string &fname, char out_format, unsigned int nthreads);
+  int close();
+
+private:
+  char format;
+  buffered_ofstream fq;
+  bgzf_ostream fq_gz;
+};
+
+std::ostream* fastq_output::open(const std::string &fname, char out_format, unsigned int nthreads) {
+  this->format = out_format;
+
+  if (out_format == FASTQ_GZ_OUTPUT) {
+    if (fq_gz.open(fname, nthreads) != 0) {
+      std::cout << "Unable to write " << fname << std::endl;
+      return NULL;
+    }
+    return &fq_gz;
+  }
 
-  int *t = new int[2], beg;
-  unsigned int pos;
+  if (fq.open(fname) != 0) {
+    std::cout << "Unable to write " << fname << std::endl;
+    return NULL;
+  }
 
-  std::ifstream ff1(f1.c_str()), ff2, pf(p.c_str());
-  std::ofstream out((p+".trimmed.fastq").c_str());
+  return &fq;
+}
 
-  std::vector<std::string>::iterator it;
-  suffix_node *root = (suffix_node*) malloc(sizeof(suffix_node));
-  std::vector<std::string> adp = read_adapters_from_fasta(adp_path);
+int fastq_output::close() {
+  if (format == FASTQ_GZ_OUTPUT)
+    return fq_gz.close();
 
-  int i = -1, n = 0, adp_pos;
+  return fq.close();
+}
 
-  if (!f2.empty()) {
-    ff2.open(f2.c_str());
+/*
+  Trim adapters from single reads to <p>.trimmed.fastq or from read pairs to <p>_1.trimmed.fastq
+  and <p>_2.trimmed.fastq, with .gz added for bgzipped output. Input can be plain, gzipped or
+  bgzipped. Reads are trimmed in batches, by the pool with more than one thread, and batches are
+  written in input order so the output matches a run with one thread. Alignment keeps scratch
+  rows in the index, so every worker gets its own copy of it.
+*/
+int trim_adapter(std::string f1, std::string f2, std::string adp_path, std::string p, char out_format, unsigned int nthreads) {
+  bool paired = !f2.empty();
+  std::string ext = (out_format == FASTQ_GZ_OUTPUT) ? ".trimmed.fastq.gz" : ".trimmed.fastq";
+  fastq_reader in1, in2;
+  fastq_output out1, out2;
+  std::ostream *fout1, *fout2 = NULL;
+
+  if (in1.open(f1, nthreads) != 0 || (paired && in2.open(f2, nthreads) != 0)) {
+    std::cout << "Unable to open " << f1 << (paired ? " or " + f2 : "") << std::endl;
+    return -1;
+  }
 
-    while (std::getline(ff1, l1) && std::getline(ff2, l2)) {
-      i++;
-      if ((i - 1)%4 != 0)
-        continue;
+  fout1 = out1.open(paired ? p + "_1" + ext : p + ext, out_format, nthreads);
+  if (paired)
+    fout2 = out2.open(p + "_2" + ext, out_format, nthreads);
+  if (fout1 == NULL || (paired && fout2 == NULL))
+    return -1;
+
+  std::vector<std::string> adp = read_adapters_from_fasta(adp_path);
+  adapter_index index(adp);	// Built once for all reads
+  std::unique_ptr<ordered_pool> pool((nthreads > 1) ? new ordered_pool(nthreads) : NULL);
+  std::vector<adapter_index> indexes(pool ? pool->size() : 1, index);
+  std::vector<std::string> seq1(indexes.size()), seq2(indexes.size());
+  unsigned int n = 0, n_overlap = 0;
+  int res = 0;
+
+  while (true) {
+    std::shared_ptr<trim_job> job(new trim_job);
+    if (in1.read(job->r1, FASTQ_BATCH_SIZE) == 0) {
+      if (paired && in2.read(job->r2, 1) != 0)
+        res = -1;
+      break;
     }
-  } else {
-    while (std::getline(ff1, l1)) {
-      i++;
-      if ((i - 1)%4 != 0) {
-        out << l1 << std::endl;
-        continue;
-      }
 
-      beg = 0;
-      pos = l1.length();
-      trmd_read = l1;
-
-      for (it = adp.begin(); it != adp.end(); ++it) {
-        s = l1 + "#" + *it + "@";
-        root = build_suffix_tree(s);
-        cmn = root->get_longest_common_substring(l1, *it);
-        cmn = extend_till_mismatches(cmn, l1, *it);
-
-        if (cmn.empty()) {
-          l1_rc = get_reverse_complement(l1);
-          s = l1_rc + "#" + *it + "@";
-          root = build_suffix_tree(s);
-
-          cmn = root->get_longest_common_substring(l1_rc, *it);
-          cmn = extend_till_mismatches(cmn, l1_rc, *it);
-
-          pos = l1_rc.find(cmn);
-          beg = l1_rc.length() - pos;
-
-          adp_pos = (*it).find(cmn);
-        } else {
-          beg = 0;
-          pos = l1.find(cmn);
-          adp_pos = (*it).find(cmn);
-        }
-
-        if (cmn.length() >= MIN_LENGTH && adp_pos != 0) {
-          beg = 0;
-          pos = l1.length();
-          t = align_seqs(l1, *it);
-
-          if (*t != -1) {
-            beg = 0;
-            pos = *(t+1);
-          } else {
-            std::cout << "Reverse!" << std::endl;
-            l1_rc = get_reverse_complement(l1);
-            t = align_seqs(l1_rc, *it);
-
-            if (*t != -1) {
-              pos = l1.length() - *(t+1);
-              beg = *(t+1);
-            }
-          }
-        }
-
-        std::cout << beg << " " << pos << std::endl;
-
-        if (beg != 0 || pos != l1.length()) {
-          trmd_read = l1.substr(beg, pos);
-          n++;
-          break;
-        }
-      }
+    if (paired && in2.read(job->r2, job->r1.size()) != job->r1.size()) {
+      res = -1;
+      break;
+    }
 
-      out << trmd_read << std::endl;
+    std::function<void(unsigned int)> work = [=, &indexes, &seq1, &seq2](unsigned int id) {
+      trim_batch(*job, paired, indexes[id], seq1[id], seq2[id]);
+    };
+    std::function<void()> emit = [=, &n, &n_overlap]() {
+      for (size_t i = 0; i < job->r1.size(); ++i) {
+        write_fastq_record(*fout1, job->r1, i, job->beg1[i], job->len1[i]);
+        if (paired)
+          write_fastq_record(*fout2, job->r2, i, job->beg2[i], job->len2[i]);
+      }
+      n += job->n_trimmed;
+      n_overlap += job->n_overlap;
+    };
+
+    if (pool) {
+      pool->submit(work, emit);
+    } else {
+      work(0);
+      emit();
     }
   }
 
-  std::cout << "Number of Adapter Trimmed: :" << n << std::endl;
+  if (pool)
+    pool->finish();
+
+  if (res != 0)
+    std::cout << f1 << " and " << f2 << " do not have the same number of reads" << std::endl;
+
+  if (in1.truncated() || in2.truncated()) {
+    std::cout << "Input ends with an incomplete FASTQ record" << std::endl;
+    res = -1;
+  }
 
-  delete root;
-  delete[] t;
+  in1.close();
+  in2.close();
+  if (out1.close() != 0 || (paired && out2.close() != 0)) {
+    std::cout << "Unable to write trimmed reads to " << p << std::endl;
+    res = -1;
+  }
+
+  if (paired)
+    std::cout << "Number of Pairs Overlapping: " << n_overlap << std::endl;
+  std::cout << "Number of Adapter Trimmed: :" << n << std::endl;
 
-  ff1.close();
-  ff2.close();
-  pf.close();
-  
-  return 0;
+  return res;
 }
@@ -556,31 +556,201 @@ bool amplicon_filter(IntervalTree amplicons, bam1_t* r) {
   return amplicon_flag;
 }
 
-int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out, std::string region_, uint8_t min_qual, uint8_t sliding_window, std::string cmd, bool write_no_primer_reads, bool keep_for_reanalysis, int min_length = 30, std::string pair_info = "", int32_t primer_offset = 0) {
-  int retval = 0;
-  std::vector<primer> primers;
-  int max_primer_len = 0;
+primer_scheme::primer_scheme() {
+  this->amplicons_loaded = false;
+  this->max_primer_len = 0;
+}
+
+// Load primers from bed and, if pair_info is given, the amplicons of the primer pairs. Returns -1 if bed has no primers.
+int primer_scheme::load(std::string bed, std::string pair_info, int32_t primer_offset) {
+  primers.clear();
+  amplicons = IntervalTree();
+  amplicons_loaded = false;
 
   if (!bed.empty()) {
     primers = populate_from_file(bed, primer_offset);
 
-    if (primers.size() == 0) {
-      std::cout << "Exiting." << std::endl;
+    if (primers.size() == 0)
       return -1;
-    }
   }
 
   max_primer_len = get_bigger_primer(primers);
 
-  // get coordinates of each amplicon
-  IntervalTree amplicons;
-
   if (!pair_info.empty()) {
     amplicons = populate_amplicons(pair_info, primers);
+    amplicons_loaded = true;
   }
 
-  std::cout << "Amplicons detected: " << std::endl;
-  amplicons.inOrder();
+  return 0;
+}
+
+const std::vector<primer>& primer_scheme::get_primers() const {
+  return primers;
+}
+
+IntervalTree primer_scheme::get_amplicons() const {
+  return amplicons;
+}
+
+bool primer_scheme::has_amplicons() const {
+  return amplicons_loaded;
+}
+
+int primer_scheme::get_max_primer_length() const {
+  return max_primer_len;
+}
+
+read_trimmer::read_trimmer(const primer_scheme &scheme, trim_settings settings) : scheme(scheme), settings(settings) {
+  stats.primer_counts.assign(scheme.get_primers().size(), 0);
+}
+
+const trim_stats& read_trimmer::get_stats() const {
+  return stats;
+}
+
+void read_trimmer::add_primer_count(const primer &p) {
+  const std::vector<primer> &primers = scheme.get_primers();
+  std::vector<primer>::const_iterator cit = std::find(primers.begin(), primers.end(), p);
+
+  if (cit != primers.end())
+    stats.primer_counts[cit - primers.begin()]++;
+}
+
+/*
+  Trim primers and low quality bases from aln in place. Returns true if the read should be
+  written. Reads that are kept for reanalysis (-k) but failed a filter are marked QC fail.
+*/
+bool read_trimmer::trim(bam1_t *aln, read_trim_status &status) {
+  const std::vector<primer> &primers = scheme.get_primers();
+  std::vector<primer> overlapping_primers;
+  primer cand_primer;
+  cigar_ t;
+  bool primer_trimmed = false, isize_flag;
+
+  if ((aln->core.flag&BAM_FUNMAP) != 0) {
+    stats.unmapped++;
+    status = READ_UNMAPPED;
+    return false;
+  }
+
+  // if primer pair info provided, check if read correctly overlaps with atleast one amplicon
+  if (scheme.has_amplicons() && !amplicon_filter(scheme.get_amplicons(), aln)) {
+    stats.outside_amplicon++;
+    status = READ_OUTSIDE_AMPLICON;
+    if (settings.keep_for_reanalysis)	// -k (keep) option
+      aln->core.flag |= BAM_FQCFAIL;
+    return settings.keep_for_reanalysis;
+  }
+
+  isize_flag = (abs(aln->core.isize) - scheme.get_max_primer_length()) > abs(aln->core.l_qseq);
+
+  if ((aln->core.flag&BAM_FPAIRED) != 0 && isize_flag) { // If paired
+    get_overlapping_primers(aln, primers, overlapping_primers);
+
+    if (overlapping_primers.size() > 0) { // If read starts before overlapping regions (?)
+      primer_trimmed = true;
+
+      if (bam_is_rev(aln)) {	// Reverse read
+        cand_primer = get_min_start(overlapping_primers); // fetch reverse primer (?)
+
+        t = primer_trim(aln, isize_flag, cand_primer.get_start() - 1, false);
+      } else {		// Forward read
+        cand_primer = get_max_end(overlapping_primers); // fetch forward primer (?)
+
+        t = primer_trim(aln, isize_flag, cand_primer.get_end() + 1, false);
+        aln->core.pos += t.start_pos;
+      }
+
+      replace_cigar(aln, t.nlength, t.cigar);
+      free(t.cigar);
+
+      add_primer_count(cand_primer);
+    }
+
+    t = quality_trim(aln, settings.min_qual, settings.sliding_window);	// Quality Trimming
+
+    if (bam_is_rev(aln))  // if reverse strand
+      aln->core.pos = t.start_pos;
+
+    condense_cigar(&t);
+    replace_cigar(aln, t.nlength, t.cigar);
+  } else {			// Unpaired reads: Might be stitched reads
+    if (abs(aln->core.isize) <= abs(aln->core.l_qseq)) {
+      stats.failed_frag_size++;
+    }
+
+    // Forward primer
+    get_overlapping_primers(aln, primers, overlapping_primers, false);
+    if (overlapping_primers.size() > 0) {
+      primer_trimmed = true;
+      cand_primer = get_max_end(overlapping_primers);
+
+      t = primer_trim(aln, isize_flag, cand_primer.get_end() + 1, false);
+
+      // Update read's left-most coordinate
+      aln->core.pos += t.start_pos;
+      replace_cigar(aln, t.nlength, t.cigar);
+
+      add_primer_count(cand_primer);
+    }
+
+    // Reverse primer
+    get_overlapping_primers(aln, primers, overlapping_primers, true);
+    if (overlapping_primers.size() > 0) {
+      primer_trimmed = true;
+      cand_primer = get_min_start(overlapping_primers);
+
+      t = primer_trim(aln, isize_flag, cand_primer.get_start() - 1, true);
+      replace_cigar(aln, t.nlength, t.cigar);
+
+      add_primer_count(cand_primer);
+    }
+
+    t = quality_trim(aln, settings.min_qual, settings.sliding_window);	// Quality Trimming
+
+    if (bam_is_rev(aln))  // if reverse strand
+      aln->core.pos = t.start_pos;
+
+    condense_cigar(&t);
+    replace_cigar(aln, t.nlength, t.cigar);
+  }
+
+  if (primer_trimmed)
+    stats.primer_trimmed++;
+
+  if (bam_cigar2rlen(aln->core.n_cigar, bam_get_cigar(aln)) < settings.min_length) {
+    stats.low_quality++;
+    status = READ_TOO_SHORT;
+    if (settings.keep_for_reanalysis)
+      aln->core.flag |= BAM_FQCFAIL;
+    return settings.keep_for_reanalysis;
+  }
+
+  if (primer_trimmed) {	// Write to BAM only if primer found.
+    int16_t cand_ind = cand_primer.get_indice();
+    bam_aux_append(aln, "XA", 's', sizeof(cand_ind), (uint8_t*) &cand_ind);
+    status = READ_PRIMER_TRIMMED;
+    return true;
+  }
+
+  // no primer found
+  stats.no_primer++;
+  status = READ_NO_PRIMER;
+  if (settings.keep_for_reanalysis) {   // -k (keep) option
+    if (primers.size() == 0 || !settings.write_no_primer_reads) // -k only option
+      aln->core.flag |= BAM_FQCFAIL;
+    return true;
+  }
+
+  return primers.size() == 0 || settings.write_no_primer_reads;	// -e only option
+}
+
+/*
+  Trim the reads of bam with a loaded primer scheme and write them to <bam_out>.bam. Counts of the
+  run are returned in stats.
+*/
+int trim_bam_qual_primer(std::string bam, const primer_scheme &scheme, std::string bam_out, std::string region_, trim_settings settings, std::string cmd, trim_stats &stats) {
+  int retval = 0;
 
   if (bam.empty()) {
     std::cout << "Bam file is empty." << std::endl;
@@ -676,179 +846,21 @@ int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out,
   bam1_t *aln = bam_init1();
   int ctr = 0;
 
-  cigar_ t;
-  init_cigar(&t);
-  uint32_t primer_trim_count = 0, no_primer_counter = 0, low_quality = 0;
-
-  bool unmapped_flag = false;
-  bool amplicon_flag = false;
-  bool isize_flag = true;
+  read_trimmer trimmer(scheme, settings);
+  read_trim_status status;
 
-  uint32_t failed_frag_size = 0;
-  uint32_t unmapped_counter = 0;
-  uint32_t amplicon_flag_ctr = 0;
-  primer cand_primer;
-
-  std::vector<primer> overlapping_primers;
-  std::vector<primer>::iterator cit;
-  bool primer_trimmed = false;
+  const std::vector<primer> &primers = scheme.get_primers();
+  const trim_stats &counts = trimmer.get_stats();
 
   //Iterate through reads
   while (sam_itr_next(in, iter, aln) >= 0) {
-    unmapped_flag = false;
-    primer_trimmed = false;
-    get_overlapping_primers(aln, primers, overlapping_primers);
-
-    if ((aln->core.flag&BAM_FUNMAP) == 0) { // If mapped
-      // if primer pair info provided, check if read correctly overlaps with atleast one amplicon
-      if (!pair_info.empty()) {
-        amplicon_flag = amplicon_filter(amplicons, aln);
-        if (!amplicon_flag) {
-          if (keep_for_reanalysis) {   // -k (keep) option
-            aln->core.flag |= BAM_FQCFAIL;
-            if (bam_write1(out, aln) < 0) { retval = -1; goto error; }
-          }
-
-          amplicon_flag_ctr++;
-          continue;
-        }
-      }
-
-      isize_flag = (abs(aln->core.isize) - max_primer_len) > abs(aln->core.l_qseq);
-
-      // if reverse strand
-      if ((aln->core.flag&BAM_FPAIRED) != 0 && isize_flag) { // If paired
-        get_overlapping_primers(aln, primers, overlapping_primers);
-
-        if (overlapping_primers.size() > 0) { // If read starts before overlapping regions (?)
-          primer_trimmed = true;
-
-          if (bam_is_rev(aln)) {	// Reverse read
-            cand_primer = get_min_start(overlapping_primers); // fetch reverse primer (?)
-
-            t = primer_trim(aln, isize_flag, cand_primer.get_start() - 1, false);
-          } else {		// Forward read
-            cand_primer = get_max_end(overlapping_primers); // fetch forward primer (?)
-
-            t = primer_trim(aln, isize_flag, cand_primer.get_end() + 1, false);
-            aln->core.pos += t.start_pos;
-          }
-
-          replace_cigar(aln, t.nlength, t.cigar);
-          free(t.cigar);
-
-          // Add count to primer
-          cit = std::find(primers.begin(), primers.end(), cand_primer);
-
-          if (cit != primers.end())
-            cit->add_read_count(1);
-        }
-
-        t = quality_trim(aln, min_qual, sliding_window);	// Quality Trimming
-
-        if (bam_is_rev(aln))  // if reverse strand
-          aln->core.pos = t.start_pos;
-
-        condense_cigar(&t);
-
-        // aln->core.pos += t.start_pos;
-        replace_cigar(aln, t.nlength, t.cigar);
-      } else {			// Unpaired reads: Might be stitched reads
-        if (abs(aln->core.isize) <= abs(aln->core.l_qseq)) {
-          failed_frag_size++;
-        }
-
-        // Forward primer
-        get_overlapping_primers(aln, primers, overlapping_primers, false);
-        if (overlapping_primers.size() > 0) {
-          primer_trimmed = true;
-          cand_primer = get_max_end(overlapping_primers);
-
-          t = primer_trim(aln, isize_flag, cand_primer.get_end() + 1, false);
-
-          // Update read's left-most coordinate
-          aln->core.pos += t.start_pos;
-          replace_cigar(aln, t.nlength, t.cigar);
-
-          // Add count to primer
-          cit = std::find(primers.begin(), primers.end(), cand_primer);
-          if (cit != primers.end())
-            cit->add_read_count(1);
-        }
-
-        // Reverse primer
-        get_overlapping_primers(aln, primers, overlapping_primers, true);
-        if (overlapping_primers.size() > 0) {
-          primer_trimmed = true;
-          cand_primer = get_min_start(overlapping_primers);
-
-          t = primer_trim(aln, isize_flag, cand_primer.get_start() - 1, true);
-          replace_cigar(aln, t.nlength, t.cigar);
-
-          // Add count to primer
-          cit = std::find(primers.begin(), primers.end(), cand_primer);
-          if (cit != primers.end())
-            cit->add_read_count(1);
-        }
-
-        t = quality_trim(aln, min_qual, sliding_window);	// Quality Trimming
-
-        if (bam_is_rev(aln))  // if reverse strand
-          aln->core.pos = t.start_pos;
-
-        condense_cigar(&t);
-        replace_cigar(aln, t.nlength, t.cigar);
-      }
-
-      if (primer_trimmed) {
-        primer_trim_count++;
-      }
-    } else {
-      unmapped_flag = true;
-      unmapped_counter++;
+    if (trimmer.trim(aln, status) && bam_write1(out, aln) < 0) {
+      retval = -1;
+      goto error;
+    }
 
+    if (status == READ_UNMAPPED || status == READ_OUTSIDE_AMPLICON)
       continue;
-    }
-    if (bam_cigar2rlen(aln->core.n_cigar, bam_get_cigar(aln)) >= min_length) {
-      if (primer_trimmed) {	// Write to BAM only if primer found.
-        int16_t cand_ind = cand_primer.get_indice();
-        bam_aux_append(aln, "XA", 's', sizeof(cand_ind), (uint8_t*) &cand_ind);
-
-        if (bam_write1(out, aln) < 0) {
-          retval = -1;
-          goto error;
-        }
-      } else {  // no primer found
-        if (keep_for_reanalysis) {   // -k (keep) option
-          if ((primers.size() == 0 || !write_no_primer_reads) && !unmapped_flag) { // -k only option
-            aln->core.flag |= BAM_FQCFAIL;
-          }
-
-          if (bam_write1(out, aln) < 0) {
-            retval = -1;
-            goto error;
-          }
-        } else {        // no -k option
-          if ((primers.size() == 0 || write_no_primer_reads) && !unmapped_flag) { // -e only option
-            if (bam_write1(out, aln) < 0) {
-              retval = -1;
-              goto error;
-            }
-          }
-        }
-        no_primer_counter++;
-      }
-    } else {
-      low_quality++;
-      if (keep_for_reanalysis) {
-        aln->core.flag |= BAM_FQCFAIL;
-
-        if (bam_write1(out, aln) < 0) {
-          retval = -1;
-          goto error;
-        }
-      }
-    }
 
     ctr++;
     if (ctr % log_skip == 0) {
@@ -860,32 +872,33 @@ int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out,
   std::cout << "Results: " << std::endl;
   std::cout << "Primer Name" << "\t" << "Read Count" << std::endl;
 
-  for (cit = primers.begin(); cit != primers.end(); ++cit) {
-    std::cout << cit->get_name() << "\t" << cit->get_read_count() << std::endl;
+  for (size_t i = 0; i < primers.size(); ++i) {
+    primer p = primers[i];
+    std::cout << p.get_name() << "\t" << counts.primer_counts[i] << std::endl;
   }
 
-  std::cout << std::endl << "Trimmed primers from " << round_int(primer_trim_count, mapped) << "% (" << primer_trim_count <<  ") of reads." << std::endl;
-  std::cout << round_int( low_quality, mapped) << "% (" << low_quality << ") of reads were quality trimmed below the minimum length of " << min_length << " bp and were ";
+  std::cout << std::endl << "Trimmed primers from " << round_int(counts.primer_trimmed, mapped) << "% (" << counts.primer_trimmed <<  ") of reads." << std::endl;
+  std::cout << round_int(counts.low_quality, mapped) << "% (" << counts.low_quality << ") of reads were quality trimmed below the minimum length of " << settings.min_length << " bp and were ";
 
-  if (keep_for_reanalysis) {
+  if (settings.keep_for_reanalysis) {
     std::cout << "marked as failed" << std::endl;
   } else {
     std::cout << "not written to file." << std::endl;
   }
 
-  if (write_no_primer_reads) {
-    std::cout << round_int(no_primer_counter, mapped) << "% ("  << no_primer_counter << ")"
+  if (settings.write_no_primer_reads) {
+    std::cout << round_int(counts.no_primer, mapped) << "% ("  << counts.no_primer << ")"
               << " of reads started outside of primer regions. Since the "
-              << (keep_for_reanalysis ? "-ek flags were " : "-e flag was ")
+              << (settings.keep_for_reanalysis ? "-ek flags were " : "-e flag was ")
               << "given, these reads were written to file";
     std::cout << "." << std::endl;
   } else if (primers.size() == 0) {
-    std::cout << round_int(no_primer_counter, mapped) << "% ("  << no_primer_counter << ") of reads started outside of primer regions. Since there were no primers found in BED file, these reads were written to file." << std::endl;
+    std::cout << round_int(counts.no_primer, mapped) << "% ("  << counts.no_primer << ") of reads started outside of primer regions. Since there were no primers found in BED file, these reads were written to file." << std::endl;
   } else {
-    std::cout << round_int(no_primer_counter, mapped) << "% ("  << no_primer_counter
+    std::cout << round_int(counts.no_primer, mapped) << "% ("  << counts.no_primer
               << ") of reads that started outside of primer regions were ";
 
-    if (keep_for_reanalysis) {
+    if (settings.keep_for_reanalysis) {
       std::cout << "written to file and marked as failed";
     } else {
       std::cout << "not written to file";
@@ -894,20 +907,20 @@ int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out,
     std::cout << std::endl;
   }
 
-  if (unmapped_counter > 0) {
-    std::cout << unmapped_counter << " unmapped reads were not written to file." << std::endl;
+  if (counts.unmapped > 0) {
+    std::cout << counts.unmapped << " unmapped reads were not written to file." << std::endl;
   }
 
-  if (amplicon_flag_ctr > 0) {
-    std::cout << round_int(amplicon_flag_ctr, mapped) 
-              << "% (" << amplicon_flag_ctr 
+  if (counts.outside_amplicon > 0) {
+    std::cout << round_int(counts.outside_amplicon, mapped) 
+              << "% (" << counts.outside_amplicon 
               << ") reads were ignored because they did not fall within an amplicon" 
               << std::endl;
   }
 
-  if (failed_frag_size > 0) {
-    std::cout << round_int(failed_frag_size, mapped)
-              << "% (" << failed_frag_size
+  if (counts.failed_frag_size > 0) {
+    std::cout << round_int(counts.failed_frag_size, mapped)
+              << "% (" << counts.failed_frag_size
               << ") of reads had their insert size smaller than their read length"
               << std::endl;
   }
@@ -915,6 +928,8 @@ int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out,
  error:
   if (retval) std::cout << "Not able to write to BAM" << std::endl;
 
+  stats = counts;
+
   hts_itr_destroy(iter);
   hts_idx_destroy(idx);
 
@@ -926,3 +941,25 @@ int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out,
   
   return retval;
 }
+
+int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out, std::string region_, uint8_t min_qual, uint8_t sliding_window, std::string cmd, bool write_no_primer_reads, bool keep_for_reanalysis, int min_length = 30, std::string pair_info = "", int32_t primer_offset = 0) {
+  primer_scheme scheme;
+  trim_settings settings;
+  trim_stats stats;
+
+  if (scheme.load(bed, pair_info, primer_offset) != 0) {
+    std::cout << "Exiting." << std::endl;
+    return -1;
+  }
+
+  std::cout << "Amplicons detected: " << std::endl;
+  scheme.get_amplicons().inOrder();
+
+  settings.min_qual = min_qual;
+  settings.sliding_window = sliding_window;
+  settings.min_length = min_length;
+  settings.write_no_primer_reads = write_no_primer_reads;
+  settings.keep_for_reanalysis = keep_for_reanalysis;
+
+  return trim_bam_qual_primer(bam, scheme, bam_out, region_, settings, cmd, stats);
+}
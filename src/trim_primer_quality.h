@@ -15,8 +15,8 @@
 #include "primer_bed.h"
 #include "interval_tree.h"
 
-#ifndef trim_primer_quality
-#define trim_primer_quality
+#ifndef IVAR_TRIM_PRIMER_QUALITY_H
+#define IVAR_TRIM_PRIMER_QUALITY_H
 
 struct cigar_ {
   uint32_t *cigar;
@@ -28,9 +28,73 @@ struct cigar_ {
 inline void init_cigar(cigar_ *t) { t->cigar=NULL; t->free_cig=false; t->nlength=0; t->start_pos=0; }
 inline void free_cigar(cigar_ t) { if (t.free_cig) free(t.cigar); }
 
+/*
+  Primers of a BED file with the amplicons of a primer pair file, loaded once and shared by every
+  read_trimmer that uses them.
+*/
+class primer_scheme {
+public:
+  primer_scheme();
+  int load(std::string bed, std::string pair_info = "", int32_t primer_offset = 0);
+  const std::vector<primer>& get_primers() const;
+  IntervalTree get_amplicons() const;
+  bool has_amplicons() const;
+  int get_max_primer_length() const;
+
+private:
+  std::vector<primer> primers;
+  IntervalTree amplicons;
+  bool amplicons_loaded;
+  int max_primer_len;
+};
+
+struct trim_settings {
+  uint8_t min_qual;
+  uint8_t sliding_window;
+  int min_length;
+  bool write_no_primer_reads;		// -e
+  bool keep_for_reanalysis;		// -k
+  trim_settings() : min_qual(20), sliding_window(4), min_length(30), write_no_primer_reads(false), keep_for_reanalysis(false) {}
+};
+
+// Outcome of trimming one read
+enum read_trim_status {
+  READ_UNMAPPED,
+  READ_OUTSIDE_AMPLICON,
+  READ_PRIMER_TRIMMED,
+  READ_NO_PRIMER,
+  READ_TOO_SHORT
+};
+
+struct trim_stats {
+  uint32_t primer_trimmed, no_primer, low_quality, unmapped, outside_amplicon, failed_frag_size;
+  std::vector<uint32_t> primer_counts;	// Reads trimmed by every primer of the scheme
+  trim_stats() : primer_trimmed(0), no_primer(0), low_quality(0), unmapped(0), outside_amplicon(0), failed_frag_size(0) {}
+};
+
+/*
+  Primer and quality trimming of reads in memory, one alignment record at a time. The scheme is
+  not changed, so one scheme can be used by the trimmers of many samples. Counts are kept per
+  trimmer.
+*/
+class read_trimmer {
+public:
+  read_trimmer(const primer_scheme &scheme, trim_settings settings);
+  bool trim(bam1_t *aln, read_trim_status &status);
+  const trim_stats& get_stats() const;
+
+private:
+  void add_primer_count(const primer &p);
+
+  const primer_scheme &scheme;
+  trim_settings settings;
+  trim_stats stats;
+};
+
 void add_pg_line_to_header(bam_hdr_t** hdr, char *cmd);
 
 
+int trim_bam_qual_primer(std::string bam, const primer_scheme &scheme, std::string bam_out, std::string region_, trim_settings settings, std::string cmd, trim_stats &stats);
 int trim_bam_qual_primer(std::string bam, std::string bed, std::string bam_out, std::string region_, uint8_t min_qual, uint8_t sliding_window, std::string cmd, bool write_no_primer_reads, bool mark_qcfail_flag, int min_length, std::string pair_info, int32_t primer_offset);
 void free_cigar(cigar_ t);
 int32_t get_pos_on_query(uint32_t *cigar, uint32_t ncigar, int32_t pos, int32_t ref_start);
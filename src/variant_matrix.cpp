@@ -0,0 +1,436 @@
+#include "variant_matrix.h"
+#include "buffered_writer.h"
+
+static uint64_t align8(uint64_t n) {
+  return (n + 7) & ~((uint64_t) 7);
+}
+
+variant_matrix_writer::variant_matrix_writer() {
+  memset(&header, 0, sizeof(header));
+}
+
+int variant_matrix_writer::open(const std::string &fname, const std::vector<std::string> &samples) {
+  fout.open(fname, std::ios::binary | std::ios::trunc);
+  if (!fout.is_open()) {
+    std::cout << "Unable to open " << fname << std::endl;
+    return -1;
+  }
+
+  this->samples = samples;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC));
+  header.nsamples = samples.size();
+  header.block_variants = MATRIX_BLOCK_VARIANTS;
+  header.tile_size = align8(13 * MATRIX_BLOCK_VARIANTS);
+  header.blocks_offset = align8(sizeof(header));
+  block.assign(header.tile_size * samples.size(), 0);
+
+  fout.write((const char*) &header, sizeof(header));
+  fout.write(std::string(header.blocks_offset - sizeof(header), '\0').c_str(), header.blocks_offset - sizeof(header));
+
+  return 0;
+}
+
+// Value of one column of a variant row or MATRIX_MISSING_DP if it is NA
+static uint32_t parse_dp(const std::string &cell) {
+  if (cell.empty() || cell == "NA")
+    return MATRIX_MISSING_DP;
+  return strtoul(cell.c_str(), NULL, 10);
+}
+
+void variant_matrix_writer::write_block() {
+  fout.write(block.data(), block.size());
+  std::fill(block.begin(), block.end(), 0);
+}
+
+/*
+  Add the values of one variant. tab_delimited_key has REGION, POS, REF, ALT, GFF_FEATURE, REF_CODON,
+  REF_AA, ALT_CODON and ALT_AA each followed by a tab. values has the REF_DP to PASS columns of every
+  sample or NULL if the sample does not have the variant.
+*/
+int variant_matrix_writer::add_variant(const std::string &tab_delimited_key, const std::vector<const std::string*> &values) {
+  size_t tab1 = tab_delimited_key.find('\t'), tab2, end;
+  if (tab1 == std::string::npos || (tab2 = tab_delimited_key.find('\t', tab1 + 1)) == std::string::npos)
+    return -1;
+
+  std::string region = tab_delimited_key.substr(0, tab1);
+  std::map<std::string, uint32_t>::iterator r = region_ids.find(region);
+  if (r == region_ids.end()) {
+    r = region_ids.insert(std::make_pair(region, regions.size())).first;
+    regions.push_back(region);
+  }
+
+  end = tab_delimited_key.size();
+  if (end > tab2 + 1 && tab_delimited_key[end - 1] == '\t')
+    end--;
+
+  variant_matrix_key key;
+  key.region = r->second;
+  key.pos = strtoll(tab_delimited_key.c_str() + tab1 + 1, NULL, 10);
+  key.str_offset = strings.size();
+  key.str_len = end - (tab2 + 1);
+  strings.append(tab_delimited_key, tab2 + 1, key.str_len);
+  keys.push_back(key);
+
+  uint64_t b = header.block_variants, i = header.nvariants % b;
+  uint32_t n = header.nsamples, alt_dp, total_dp;
+  uint8_t pass;
+  char *tile;
+  float freq;
+  std::vector<std::string> cells;
+  std::string cell;
+
+  for (uint32_t j = 0; j < n; ++j) {
+    alt_dp = MATRIX_MISSING_DP;
+    total_dp = MATRIX_MISSING_DP;
+    freq = NAN;
+    pass = MATRIX_MISSING_PASS;
+
+    if (j < values.size() && values[j] != NULL) {
+      std::stringstream line_stream(*values[j]);
+      cells.clear();
+      while (std::getline(line_stream, cell, '\t')) {
+        cells.push_back(cell);
+      }
+      cells.resize(10);
+      alt_dp = parse_dp(cells[3]);
+      total_dp = parse_dp(cells[7]);
+      if (!cells[6].empty() && cells[6] != "NA")
+        freq = strtof(cells[6].c_str(), NULL);
+      if (cells[9] == "TRUE")
+        pass = 1;
+      else if (cells[9] == "FALSE")
+        pass = 0;
+    }
+
+    tile = &block[j * header.tile_size];
+    memcpy(tile + 4 * i, &alt_dp, 4);
+    memcpy(tile + 4 * (b + i), &total_dp, 4);
+    memcpy(tile + 4 * (2 * b + i), &freq, 4);
+    tile[12 * b + i] = pass;
+  }
+
+  header.nvariants++;
+  if (header.nvariants % b == 0)
+    write_block();
+
+  return fout.good() ? 0 : -1;
+}
+
+static void add_names(const std::vector<std::string> &names, std::string &strings, std::vector<variant_matrix_name> &table) {
+  variant_matrix_name name;
+  for (std::vector<std::string>::const_iterator it = names.begin(); it != names.end(); ++it) {
+    name.str_offset = strings.size();
+    name.str_len = it->size();
+    strings += *it;
+    table.push_back(name);
+  }
+}
+
+// Write the keys, names and the final header
+int variant_matrix_writer::close() {
+  if (!fout.is_open())
+    return 0;
+
+  uint64_t nblocks = (header.nvariants + header.block_variants - 1) / header.block_variants;
+  if (header.nvariants % header.block_variants != 0)
+    write_block();
+
+  std::vector<variant_matrix_name> region_table, sample_table;
+  add_names(regions, strings, region_table);
+  add_names(samples, strings, sample_table);
+
+  header.nregions = regions.size();
+  header.keys_offset = header.blocks_offset + nblocks * header.nsamples * header.tile_size;
+  header.regions_offset = header.keys_offset + keys.size() * sizeof(variant_matrix_key);
+  header.samples_offset = header.regions_offset + region_table.size() * sizeof(variant_matrix_name);
+  header.strings_offset = header.samples_offset + sample_table.size() * sizeof(variant_matrix_name);
+
+  fout.write((const char*) keys.data(), keys.size() * sizeof(variant_matrix_key));
+  fout.write((const char*) region_table.data(), region_table.size() * sizeof(variant_matrix_name));
+  fout.write((const char*) sample_table.data(), sample_table.size() * sizeof(variant_matrix_name));
+  fout.write(strings.data(), strings.size());
+  fout.seekp(0);
+  fout.write((const char*) &header, sizeof(header));
+
+  bool ok = fout.good();
+  fout.close();
+
+  return ok ? 0 : -1;
+}
+
+variant_matrix::variant_matrix() : data(NULL), size(0), header(NULL) {}
+
+variant_matrix::~variant_matrix() {
+  close();
+}
+
+int variant_matrix::open(const std::string &fname) {
+  close();
+
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cout << "Unable to open " << fname << std::endl;
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(variant_matrix_header)) {
+    std::cout << fname << " is not a variant matrix" << std::endl;
+    ::close(fd);
+    return -1;
+  }
+
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    std::cout << "Unable to map " << fname << std::endl;
+    return -1;
+  }
+
+  data = (const char*) p;
+  size = st.st_size;
+  header = (const variant_matrix_header*) data;
+
+  if (memcmp(header->magic, MATRIX_MAGIC, sizeof(MATRIX_MAGIC)) != 0 || !check_layout()) {
+    std::cout << fname << " is not a variant matrix" << std::endl;
+    close();
+    return -1;
+  }
+
+  return 0;
+}
+
+// Table of count items of item_size bytes at offset fits in size bytes. end is set to its end.
+static bool table_fits(uint64_t offset, uint64_t count, uint64_t item_size, uint64_t size, uint64_t &end) {
+  if (offset > size || offset % 8 != 0 || (item_size > 0 && count > (size - offset) / item_size))
+    return false;
+  end = offset + count * item_size;
+  return true;
+}
+
+static bool string_fits(uint64_t offset, uint64_t len, uint64_t strings_len) {
+  return offset <= strings_len && len <= strings_len - offset;
+}
+
+// Sections follow each other in the mapped file and every string is inside the strings section
+bool variant_matrix::check_layout() const {
+  uint64_t b = header->block_variants, end;
+
+  if (b == 0 || b > UINT32_MAX || header->tile_size != align8(13 * b) || header->blocks_offset < sizeof(variant_matrix_header))
+    return false;
+  if (header->nsamples > 0 && !table_fits(header->blocks_offset, header->nsamples, header->tile_size, size, end))
+    return false;
+  if (!table_fits(header->blocks_offset, header->nvariants / b + (header->nvariants % b != 0), header->nsamples * header->tile_size, size, end) || end != header->keys_offset)
+    return false;
+  if (!table_fits(header->keys_offset, header->nvariants, sizeof(variant_matrix_key), size, end) || end != header->regions_offset)
+    return false;
+  if (!table_fits(header->regions_offset, header->nregions, sizeof(variant_matrix_name), size, end) || end != header->samples_offset)
+    return false;
+  if (!table_fits(header->samples_offset, header->nsamples, sizeof(variant_matrix_name), size, end) || end != header->strings_offset)
+    return false;
+
+  uint64_t strings_len = size - header->strings_offset;
+  const variant_matrix_key *keys = (const variant_matrix_key*) (data + header->keys_offset);
+  for (uint64_t i = 0; i < header->nvariants; ++i) {
+    if (keys[i].region >= header->nregions || !string_fits(keys[i].str_offset, keys[i].str_len, strings_len))
+      return false;
+  }
+
+  const variant_matrix_name *names = (const variant_matrix_name*) (data + header->regions_offset);
+  for (uint64_t i = 0; i < (uint64_t) header->nregions + header->nsamples; ++i) {	// Sample names follow the region names
+    if (!string_fits(names[i].str_offset, names[i].str_len, strings_len))
+      return false;
+  }
+
+  return true;
+}
+
+void variant_matrix::close() {
+  if (data != NULL)
+    munmap((void*) data, size);
+  data = NULL;
+  size = 0;
+  header = NULL;
+}
+
+uint32_t variant_matrix::get_sample_count() const {
+  return header->nsamples;
+}
+
+uint64_t variant_matrix::get_variant_count() const {
+  return header->nvariants;
+}
+
+uint32_t variant_matrix::get_region_count() const {
+  return header->nregions;
+}
+
+std::string variant_matrix::get_string(uint64_t offset, uint64_t len) const {
+  return std::string(data + header->strings_offset + offset, len);
+}
+
+std::string variant_matrix::get_sample_name(uint32_t sample) const {
+  const variant_matrix_name *n = (const variant_matrix_name*) (data + header->samples_offset) + sample;
+  return get_string(n->str_offset, n->str_len);
+}
+
+std::string variant_matrix::get_region_name(uint32_t region) const {
+  const variant_matrix_name *n = (const variant_matrix_name*) (data + header->regions_offset) + region;
+  return get_string(n->str_offset, n->str_len);
+}
+
+// Id of region or -1 if the matrix has no variants in it
+int variant_matrix::get_region_id(const std::string &region) const {
+  for (uint32_t i = 0; i < header->nregions; ++i) {
+    if (get_region_name(i) == region)
+      return i;
+  }
+
+  return -1;
+}
+
+const variant_matrix_key& variant_matrix::get_key(uint64_t variant) const {
+  return ((const variant_matrix_key*) (data + header->keys_offset))[variant];
+}
+
+// REF, ALT, GFF_FEATURE, REF_CODON, REF_AA, ALT_CODON and ALT_AA, tab separated
+std::string variant_matrix::get_key_fields(uint64_t variant) const {
+  const variant_matrix_key &k = get_key(variant);
+  return get_string(k.str_offset, k.str_len);
+}
+
+// Tile of sample in the block of variant
+const char* variant_matrix::get_tile(uint64_t variant, uint32_t sample) const {
+  return data + header->blocks_offset + (variant / header->block_variants) * header->nsamples * header->tile_size + sample * header->tile_size;
+}
+
+uint32_t variant_matrix::get_alt_dp(uint64_t variant, uint32_t sample) const {
+  uint32_t v;
+  memcpy(&v, get_tile(variant, sample) + 4 * (variant % header->block_variants), 4);
+  return v;
+}
+
+uint32_t variant_matrix::get_total_dp(uint64_t variant, uint32_t sample) const {
+  uint32_t v;
+  memcpy(&v, get_tile(variant, sample) + 4 * (header->block_variants + variant % header->block_variants), 4);
+  return v;
+}
+
+float variant_matrix::get_alt_freq(uint64_t variant, uint32_t sample) const {
+  float v;
+  memcpy(&v, get_tile(variant, sample) + 4 * (2 * header->block_variants + variant % header->block_variants), 4);
+  return v;
+}
+
+uint8_t variant_matrix::get_pass(uint64_t variant, uint32_t sample) const {
+  return (uint8_t) get_tile(variant, sample)[12 * header->block_variants + variant % header->block_variants];
+}
+
+// First variant at or after pos in region. Variants are sorted by region and position.
+uint64_t variant_matrix::lower_bound(uint32_t region, int64_t pos) const {
+  uint64_t lo = 0, hi = header->nvariants, mid;
+
+  while (lo < hi) {
+    mid = lo + (hi - lo) / 2;
+    const variant_matrix_key &k = get_key(mid);
+    if (k.region < region || (k.region == region && k.pos < pos))
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  return lo;
+}
+
+/*
+  Write the variants of a matrix in region, given as name or name:start-end with 1-based inclusive
+  positions, for the samples in samples to <out>.tsv. An empty region or sample list selects all.
+*/
+int slice_variant_matrix(std::string matrix_file, std::string out, std::string region, std::vector<std::string> samples) {
+  variant_matrix m;
+  if (m.open(matrix_file) != 0)
+    return -1;
+
+  uint64_t beg = 0, end = m.get_variant_count();
+  if (!region.empty()) {
+    int64_t start = 1, stop = INT64_MAX;
+    size_t colon = region.rfind(':');
+    std::string name = region;
+    int region_id = m.get_region_id(region);
+    if (region_id < 0 && colon != std::string::npos) {	// Region names can have colons
+      name = region.substr(0, colon);
+      std::string range = region.substr(colon + 1);
+      size_t dash = range.find('-');
+      start = strtoll(range.c_str(), NULL, 10);
+      if (dash != std::string::npos && dash + 1 < range.size())
+        stop = strtoll(range.c_str() + dash + 1, NULL, 10);
+      region_id = m.get_region_id(name);
+    }
+
+    if (region_id < 0) {
+      beg = end = 0;
+    } else {
+      beg = m.lower_bound(region_id, start);
+      end = (stop == INT64_MAX) ? m.lower_bound(region_id + 1, INT64_MIN) : m.lower_bound(region_id, stop + 1);
+    }
+  }
+
+  std::vector<uint32_t> ids;
+  if (samples.empty()) {
+    for (uint32_t j = 0; j < m.get_sample_count(); ++j) {
+      ids.push_back(j);
+    }
+  } else {
+    std::map<std::string, uint32_t> sample_ids;
+    for (uint32_t j = 0; j < m.get_sample_count(); ++j) {
+      sample_ids[m.get_sample_name(j)] = j;
+    }
+    for (std::vector<std::string>::iterator it = samples.begin(); it != samples.end(); ++it) {
+      std::map<std::string, uint32_t>::iterator s = sample_ids.find(*it);
+      if (s == sample_ids.end()) {
+        std::cout << "Sample " << *it << " is not in " << matrix_file << std::endl;
+        return -1;
+      }
+      ids.push_back(s->second);
+    }
+  }
+
+  buffered_ofstream fout(out + ".tsv");
+  std::vector<uint32_t>::iterator j;
+  std::string name;
+
+  fout << "REGION\tPOS\tREF\tALT\tGFF_FEATURE\tREF_CODON\tREF_AA\tALT_CODON\tALT_AA";
+  for (j = ids.begin(); j != ids.end(); ++j) {
+    name = m.get_sample_name(*j);
+    fout << "\tALT_DP_" << name << "\tTOTAL_DP_" << name << "\tALT_FREQ_" << name << "\tPASS_" << name;
+  }
+  fout << "\n";
+
+  uint32_t dp;
+  float freq;
+  uint8_t pass;
+
+  for (uint64_t i = beg; i < end; ++i) {
+    const variant_matrix_key &k = m.get_key(i);
+    fout << m.get_region_name(k.region) << "\t" << k.pos << "\t" << m.get_key_fields(i);
+    for (j = ids.begin(); j != ids.end(); ++j) {
+      dp = m.get_alt_dp(i, *j);
+      fout << "\t";
+      if (dp == MATRIX_MISSING_DP) fout << "NA"; else fout << dp;
+      dp = m.get_total_dp(i, *j);
+      fout << "\t";
+      if (dp == MATRIX_MISSING_DP) fout << "NA"; else fout << dp;
+      freq = m.get_alt_freq(i, *j);
+      fout << "\t";
+      if (std::isnan(freq)) fout << "NA"; else fout << freq;
+      pass = m.get_pass(i, *j);
+      fout << "\t" << ((pass == MATRIX_MISSING_PASS) ? "NA" : (pass ? "TRUE" : "FALSE"));
+    }
+    fout << "\n";
+  }
+
+  fout.close();
+
+  return 0;
+}
@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifndef IVAR_VARIANT_MATRIX_H
+#define IVAR_VARIANT_MATRIX_H
+
+/*
+  Binary variants x samples matrix written by filtervariants -F matrix. The file is laid out so it
+  can be memory-mapped and read in place, in native byte order.
+
+  header      variant_matrix_header
+  blocks      Values of block_variants variants at a time in position order, the last block padded.
+              A block has one tile per sample. A tile has ALT_DP (uint32), TOTAL_DP (uint32),
+              ALT_FREQ (float) and PASS (uint8) of each of the variants of the block, field after
+              field, padded to 8 bytes. Missing values are MATRIX_MISSING_DP, NaN and
+              MATRIX_MISSING_PASS. Reading a few samples only touches their tiles.
+  keys        variant_matrix_key of every variant
+  regions     variant_matrix_name of every region, indexed by the region of a key
+  samples     variant_matrix_name of every sample, in the order of the input files
+  strings     Names and the REF, ALT, GFF_FEATURE, REF_CODON, REF_AA, ALT_CODON and ALT_AA of every
+              variant, tab separated
+*/
+
+const char MATRIX_MAGIC[8] = {'I', 'V', 'A', 'R', 'M', 'T', 'X', '2'};
+const std::string MATRIX_EXT = ".ivm";
+const uint32_t MATRIX_MISSING_DP = UINT32_MAX;
+const uint8_t MATRIX_MISSING_PASS = UINT8_MAX;
+const uint64_t MATRIX_BLOCK_VARIANTS = 512;	// A tile of one sample is 6.5 KB
+
+struct variant_matrix_header {
+  char magic[8];
+  uint32_t nsamples;
+  uint32_t nregions;
+  uint64_t nvariants;
+  uint64_t block_variants;
+  uint64_t tile_size;		// Bytes of one sample in a block
+  uint64_t blocks_offset, keys_offset, regions_offset, samples_offset, strings_offset;
+};
+
+struct variant_matrix_key {
+  uint32_t region;
+  uint32_t str_len;
+  int64_t pos;
+  uint64_t str_offset;
+};
+
+struct variant_matrix_name {
+  uint64_t str_offset;
+  uint64_t str_len;
+};
+
+// Writes a block each time it is full. Keys and names are kept in memory until close().
+class variant_matrix_writer {
+public:
+  variant_matrix_writer();
+  int open(const std::string &fname, const std::vector<std::string> &samples);
+  int add_variant(const std::string &tab_delimited_key, const std::vector<const std::string*> &values);
+  int close();
+
+private:
+  void write_block();
+
+  std::ofstream fout;
+  variant_matrix_header header;
+  std::vector<std::string> samples;
+  std::vector<std::string> regions;
+  std::map<std::string, uint32_t> region_ids;
+  std::vector<variant_matrix_key> keys;
+  std::string strings;
+  std::vector<char> block;
+};
+
+// Read only view of a matrix file through mmap
+class variant_matrix {
+public:
+  variant_matrix();
+  ~variant_matrix();
+  int open(const std::string &fname);
+  void close();
+  uint32_t get_sample_count() const;
+  uint64_t get_variant_count() const;
+  uint32_t get_region_count() const;
+  std::string get_sample_name(uint32_t sample) const;
+  std::string get_region_name(uint32_t region) const;
+  int get_region_id(const std::string &region) const;
+  const variant_matrix_key& get_key(uint64_t variant) const;
+  std::string get_key_fields(uint64_t variant) const;
+  uint32_t get_alt_dp(uint64_t variant, uint32_t sample) const;
+  uint32_t get_total_dp(uint64_t variant, uint32_t sample) const;
+  float get_alt_freq(uint64_t variant, uint32_t sample) const;
+  uint8_t get_pass(uint64_t variant, uint32_t sample) const;
+  uint64_t lower_bound(uint32_t region, int64_t pos) const;
+
+private:
+  const char* get_tile(uint64_t variant, uint32_t sample) const;
+  std::string get_string(uint64_t offset, uint64_t len) const;
+  bool check_layout() const;
+
+  const char *data;
+  size_t size;
+  const variant_matrix_header *header;
+};
+
+int slice_variant_matrix(std::string matrix_file, std::string out, std::string region, std::vector<std::string> samples);
+
+#endif
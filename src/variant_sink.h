@@ -0,0 +1,50 @@
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#ifndef IVAR_VARIANT_SINK_H
+#define IVAR_VARIANT_SINK_H
+
+// One alternate allele called at a position, with the counts of the reference allele
+struct variant_record {
+  std::string region;
+  int64_t pos;			// 1-based
+  char ref;
+  std::string alt;		// Base, or +/- followed by the inserted or deleted bases
+  uint32_t ref_dp, ref_rv, alt_dp, alt_rv;
+  uint8_t ref_qual, alt_qual;
+  double freq;
+  uint32_t total_dp;		// Ungapped depth for bases, mpileup depth for indels
+  double pval;
+  bool pass;
+};
+
+// Output of variant calling. Implemented by the tsv and VCF/BCF writers.
+class variant_sink {
+public:
+  virtual ~variant_sink() {}
+  virtual int write(const variant_record &v) = 0;
+};
+
+// Variants kept in memory, for blocks called on worker threads and written out in order afterwards
+class variant_buffer : public variant_sink {
+public:
+  int write(const variant_record &v) { records.push_back(v); return 0; }
+  bool empty() const { return records.empty(); }
+
+  // Write the buffered variants to out and clear the buffer. Returns -1 if out failed on any of them.
+  int write_to(variant_sink &out) {
+    int res = 0;
+    for (std::vector<variant_record>::const_iterator it = records.begin(); it != records.end(); ++it) {
+      if (out.write(*it) != 0)
+        res = -1;
+    }
+    records.clear();
+    return res;
+  }
+
+private:
+  std::vector<variant_record> records;
+};
+
+#endif
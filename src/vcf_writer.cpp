@@ -1,123 +1,146 @@
 #include "vcf_writer.h"
 
-int vcf_writer::init_header() {
-  this->hdr = bcf_hdr_init("w");
-  int res;
+vcf_writer::vcf_writer() {
+  this->file = NULL;
+  this->hdr = NULL;
+  this->rec = NULL;
+  this->mode = 'z';
+}
+
+vcf_writer::~vcf_writer() {
+  close();
+}
 
-  res = bcf_hdr_append(hdr,"##ALT=<ID=*,Description=\"Represents allele(s) other than observed.\">");
-  res = bcf_hdr_append(hdr,"##INFO=<ID=DP,Number=1,Type=Integer,Description=\"Raw read depth\">");
-  res = bcf_hdr_append(hdr, "##INFO=<ID=AD,Number=R,Type=Integer,Description=\"Total read depth for each allele (based on minimum quality threshold)\">");
-  res = bcf_hdr_append(hdr, "##INFO=<ID=ADF,Number=R,Type=Integer,Description=\"Total read depth for each allele on forward strand (based on minimum quality threshold)\">");
-  res = bcf_hdr_append(hdr, "##INFO=<ID=ADR,Number=R,Type=Integer,Description=\"Total read depth for each allele on reverse strand (based on minimum quality threshold)\">");
-  res = bcf_hdr_append(hdr, "##INFO=<ID=AF,Number=A,Type=Float,Description=\"Allele frequency for each ALT allele in the same order as listed (estimated from primary data, not called genotypes)\">");
-  res = bcf_hdr_append(hdr, ("##contig=<ID=cref,assembly="+this->region+">").c_str());
-  res = bcf_hdr_append(hdr, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">");
-  res = bcf_hdr_append(hdr, "##FORMAT=<ID=GQ,Number=1,Type=Integer,Description=\"Genotype Quality\">");
-  res = bcf_hdr_append(hdr, "##FILTER=<ID=fobs,Description=\"Fisher's exact test to check if frequency of the iSNV is significantly higher than the mean error rate at that position\">");
+int vcf_writer::init_header(const ref_antd &ref) {
+  this->hdr = bcf_hdr_init("w");
+  int res = 0;
+
+  res |= bcf_hdr_append(hdr, "##source=iVar");
+  res |= bcf_hdr_append(hdr, "##ALT=<ID=*,Description=\"Represents allele(s) other than observed.\">");
+  res |= bcf_hdr_append(hdr, "##INFO=<ID=DP,Number=1,Type=Integer,Description=\"Raw read depth\">");
+  res |= bcf_hdr_append(hdr, "##INFO=<ID=AD,Number=R,Type=Integer,Description=\"Total read depth for each allele (based on minimum quality threshold)\">");
+  res |= bcf_hdr_append(hdr, "##INFO=<ID=ADF,Number=R,Type=Integer,Description=\"Total read depth for each allele on forward strand (based on minimum quality threshold)\">");
+  res |= bcf_hdr_append(hdr, "##INFO=<ID=ADR,Number=R,Type=Integer,Description=\"Total read depth for each allele on reverse strand (based on minimum quality threshold)\">");
+  res |= bcf_hdr_append(hdr, "##INFO=<ID=AF,Number=A,Type=Float,Description=\"Allele frequency for each ALT allele in the same order as listed (estimated from primary data, not called genotypes)\">");
+  for (int i = 0; i < ref.get_region_count(); ++i) {
+    res |= bcf_hdr_append(hdr, ("##contig=<ID=" + ref.get_region_name(i) + ",length=" + std::to_string(ref.get_region_length(i)) + ">").c_str());
+  }
+  res |= bcf_hdr_append(hdr, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">");
+  res |= bcf_hdr_append(hdr, "##FILTER=<ID=fobs,Description=\"Fisher's exact test to check if frequency of the iSNV is significantly higher than the mean error rate at that position\">");
 
-  bcf_hdr_add_sample(hdr, this->sample_name.c_str());
+  res |= bcf_hdr_add_sample(hdr, this->sample_name.c_str());
+  res |= bcf_hdr_add_sample(hdr, NULL);	// Sync sample names
 
   if (res != 0)
     return -1;
-    
+
   return 0;
 }
 
-int vcf_writer::init(char _mode, std::string fname, std::string region, std::string sample_name, std::string ref_path) {
-  this->ref = new ref_antd(ref_path);
-  this->region = region;
+/*
+  Open fname for writing. _mode is the htslib mode letter, 'z' for bgzipped VCF and 'b' for BCF.
+  Contigs in the header are the sequences of the reference.
+*/
+int vcf_writer::init(char _mode, std::string fname, std::string sample_name, const ref_antd &ref) {
+  this->fname = fname;
   this->sample_name = sample_name;
+  this->mode = _mode;
+
+  if (ref.get_region_count() == 0) {
+    std::cout << "A reference file is required to write BCF/VCF files" << std::endl;
+    return -1;
+  }
 
   std::string mode = "w";
   mode += _mode;
-  vcfFile *vcf_file = bcf_open(fname.c_str(), mode.c_str());
+  this->file = bcf_open(fname.c_str(), mode.c_str());
 
-  this->init_header();
-
-  if (hdr == NULL || vcf_file == NULL) {
+  if (this->file == NULL || this->init_header(ref) != 0) {
     std::cout << "Unable to write BCF/VCF file" << std::endl;
     return -1;
   }
 
-  if (bcf_hdr_write(vcf_file, hdr) < 0) {
+  if (bcf_hdr_write(this->file, hdr) < 0) {
     std::cout << "Unable to write BCF/VCF file" << std::endl;
     return -1;
   }
 
-  return 0;
-}
-
-int vcf_writer::write_record(uint32_t pos, std::vector<allele> &alleles, char ref) {
-  bcf1_t *rec = bcf_init();
+  this->rec = bcf_init();
 
-  rec->rid  = rec->rid = bcf_hdr_name2id(this->hdr, this->region.c_str());
-  rec->pos  = pos;
-
-  allele aref = alleles.at(find_ref_in_allele(alleles, ref));
-  rec->qual = aref.mean_qual;
+  return 0;
 }
 
-int main(int argc, char *argv[]) {
-  vcfFile *vcf_file = bcf_open("../data/test.vcf", "w");
-  bcf_hdr_t *h = bcf_hdr_init("w");
+// Write one variant. Insertions and deletions are anchored on the reference base.
+int vcf_writer::write(const variant_record &v) {
+  if (this->file == NULL)
+    return 0;
 
-  int res;
-  if (res<0)
-    std::cout << "Unable to write BCF header" << std::endl;
+  bcf_clear(rec);
 
-  // Add sample
-  bcf_hdr_add_sample(h, "TEST");
-
-  // bcf_hdr_add_sample(h, NULL);
-  bcf_hdr_write(vcf_file, h);
-
-  // Write record
-  bcf1_t *rec = bcf_init();
-  rec->rid  = rec->rid = bcf_hdr_name2id(h, "20");
-  rec->pos  = 0;
-  rec->qual = 20;
-
-  // ID
-  bcf_update_id(h, rec, "rs6054257");
-
-  // INFO
-  bcf_update_alleles_str(h, rec, "G,A,TA");
-
-  // FILTER
-  int32_t tmpi = bcf_hdr_id2int(h, BCF_DT_ID, "PASS");
-  bcf_update_filter(h, rec, &tmpi, 1);
+  rec->rid = bcf_hdr_name2id(this->hdr, v.region.c_str());
+  if (rec->rid < 0) {
+    std::cout << "Region " << v.region << " is not in the reference. Skipping variant at " << v.pos << std::endl;
+    return -1;
+  }
 
-  // FORMAT
-  int32_t *tmpia = (int*)malloc(bcf_hdr_nsamples(h)*2*sizeof(int));
+  rec->pos = v.pos - 1;
+  bcf_float_set_missing(rec->qual);
 
-  tmpia[0] = bcf_gt_phased(0);
-  tmpia[1] = bcf_gt_phased(0);
+  std::string alleles(1, v.ref);
+  if (v.alt[0] == '+') {
+    alleles += "," + std::string(1, v.ref) + v.alt.substr(1);
+  } else if (v.alt[0] == '-') {
+    alleles += v.alt.substr(1) + "," + std::string(1, v.ref);
+  } else {
+    alleles += "," + v.alt;
+  }
+  bcf_update_alleles_str(hdr, rec, alleles.c_str());
+
+  int32_t filter = bcf_hdr_id2int(hdr, BCF_DT_ID, v.pass ? "PASS" : "fobs");
+  bcf_update_filter(hdr, rec, &filter, 1);
+
+  int32_t dp = v.total_dp;
+  int32_t ad[2] = {(int32_t) v.ref_dp, (int32_t) v.alt_dp};
+  int32_t adf[2] = {(int32_t) (v.ref_dp - v.ref_rv), (int32_t) (v.alt_dp - v.alt_rv)};
+  int32_t adr[2] = {(int32_t) v.ref_rv, (int32_t) v.alt_rv};
+  float af = v.freq;
+  bcf_update_info_int32(hdr, rec, "DP", &dp, 1);
+  bcf_update_info_int32(hdr, rec, "AD", ad, 2);
+  bcf_update_info_int32(hdr, rec, "ADF", adf, 2);
+  bcf_update_info_int32(hdr, rec, "ADR", adr, 2);
+  bcf_update_info_float(hdr, rec, "AF", &af, 1);
+
+  int32_t gt = bcf_gt_unphased(1);	// Haploid call of the alternate allele of this record
+  bcf_update_genotypes(hdr, rec, &gt, 1);
+
+  if (bcf_write1(this->file, hdr, rec) < 0) {
+    std::cout << "Unable to write BCF/VCF record" << std::endl;
+    return -1;
+  }
 
-  bcf_update_genotypes(h, rec, &tmpi, bcf_hdr_nsamples(h));
-  tmpia[0] = 12;
-  tmpia[1] = 4;
+  return 0;
+}
 
-  bcf_update_format_int32(h, rec, "GQ", tmpia, bcf_hdr_nsamples(h));
-  tmpi = 1;
+// Close the file and build a CSI index next to it
+int vcf_writer::close() {
+  int res = 0;
 
-  bcf_update_info_int32(h, rec, "NS", &tmpi, 1);
+  if (this->rec) bcf_destroy(this->rec);
+  this->rec = NULL;
 
-  if (res < 0)
-    std::cout << "Alleles not updated" << std::endl;
+  if (this->hdr) bcf_hdr_destroy(this->hdr);
+  this->hdr = NULL;
 
-  int32_t td = 12;
-  int32_t ad = 4;
+  if (this->file == NULL)
+    return 0;
 
-  bcf_update_info_int32(h, rec, "DP", &td, 1);
-  bcf_update_info_int32(h, rec, "AD", &ad, 1);
+  bcf_close(this->file);
+  this->file = NULL;
 
-  std::cout << bcf_hdr_nsamples(h) << std::endl;
-  std::cout << rec->n_sample << std::endl;
+  if (bcf_index_build(fname.c_str(), 14) != 0) {
+    std::cout << "Unable to build index for " << fname << std::endl;
+    res = -1;
+  }
 
-  bcf_write1(vcf_file, h, rec);
-  bcf_hdr_destroy(h);
-  bcf_close(vcf_file);
-  
-  return 0;
+  return res;
 }
-
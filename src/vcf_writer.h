@@ -1,19 +1,32 @@
 #include <iostream>
 #include <fstream>
-#include <vector>
+#include <sstream>
 #include "allele_functions.h"
 #include "ref_seq.h"
+#include "variant_sink.h"
 #include "htslib/vcf.h"
-#include "htslib/kstring.h"
 
-class vcf_writer{
+#ifndef IVAR_VCF_WRITER_H
+#define IVAR_VCF_WRITER_H
+
+/*
+  Writes called variants as bgzipped VCF or BCF records. Every alternate allele gets its own record.
+*/
+
+class vcf_writer : public variant_sink {
   vcfFile *file;
-  ref_antd *ref;
   bcf_hdr_t *hdr;
-  std::string region;
+  bcf1_t *rec;
+  std::string fname;
   std::string sample_name;
-  int write_record(uint32_t pos, std::vector<allele> &alleles, char ref);
-  int init_header();
+  char mode;
+  int init_header(const ref_antd &ref);
 public:
-  int init(char _mode, std::string fname, std::string region, std::string sample_name, std::string ref_path);
+  vcf_writer();
+  ~vcf_writer();
+  int init(char _mode, std::string fname, std::string sample_name, const ref_antd &ref);
+  int write(const variant_record &v);
+  int close();
 };
+
+#endif
@@ -0,0 +1,347 @@
+/*
+  Throughput of the trimming, allele counting, consensus and translation kernels. Run with
+  `make bench`, which writes bench.json. Pass an earlier bench.json with -c to print the change in
+  the median time per item of every benchmark.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "../src/trim_primer_quality.h"
+#include "../src/allele_functions.h"
+#include "../src/call_consensus_pileup.h"
+#include "../src/ref_seq.h"
+
+struct bench_result {
+  std::string name;
+  std::string unit;		// What items counts, e.g. reads or columns
+  uint64_t items;		// Items per repetition
+  std::vector<double> ns;	// Time of every repetition, sorted
+  double median() const { return ns[ns.size() / 2]; }
+  double p99() const { return ns[(ns.size() * 99 + 99) / 100 - 1]; }
+  double per_second() const { return items / (median() / 1e9); }
+};
+
+const int MPILEUP_PASSES = 100;	// The test pileups are short, so they are counted this many times per repetition
+
+static uint64_t sink = 0;	// Results of every kernel are added here so calls are not optimized away
+
+static uint32_t next_random(uint32_t &state) {
+  state = state * 1103515245 + 12345;
+  return (state >> 16) & 0x7fff;
+}
+
+template <typename F>
+bench_result run_bench(std::string name, std::string unit, uint64_t items, int warmup, int reps, F f) {
+  bench_result r;
+  r.name = name;
+  r.unit = unit;
+  r.items = items;
+  for (int i = 0; i < warmup; ++i)
+    f();
+  for (int i = 0; i < reps; ++i) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    r.ns.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(r.ns.begin(), r.ns.end());
+  std::cout << name << "\t" << items << " " << unit << "\tmedian " << r.median() / 1e6 << " ms\tp99 " << r.p99() / 1e6 << " ms\t" << (uint64_t) r.per_second() << " " << unit << "/s" << std::endl;
+  return r;
+}
+
+// Mapped reads of a BAM file. Returns -1 if the file cannot be read.
+int load_reads(std::string bam, std::vector<bam1_t*> &reads) {
+  samFile *in = hts_open(bam.c_str(), "r");
+  if (in == NULL)
+    return -1;
+  bam_hdr_t *header = sam_hdr_read(in);
+  if (header == NULL) {
+    sam_close(in);
+    return -1;
+  }
+  bam1_t *b = bam_init1();
+  while (sam_read1(in, header, b) >= 0) {
+    if ((b->core.flag & BAM_FUNMAP) == 0)
+      reads.push_back(bam_dup1(b));
+  }
+  bam_destroy1(b);
+  bam_hdr_destroy(header);
+  sam_close(in);
+  return 0;
+}
+
+// Pileup column in mpileup format with depth reads, some of them mismatches, deletions, insertions and read ends
+void synthetic_column(uint32_t &state, uint32_t depth, std::string &bases, std::string &quals) {
+  const char alts[] = "ACGTacgt*";
+  bases.clear();
+  quals.clear();
+  for (uint32_t i = 0; i < depth; ++i) {
+    uint32_t r = next_random(state) % 100;
+    if (r < 2)
+      bases += "^]";
+    if (r < 85)
+      bases += (i % 2 == 0) ? '.' : ',';
+    else
+      bases += alts[r % 9];
+    if (r == 90)
+      bases += "+2AG";
+    else if (r == 91)
+      bases += "-1c";
+    if (r == 3)
+      bases += '$';
+    quals += (char) (33 + 10 + next_random(state) % 31);
+  }
+}
+
+// Cigar of a trimmed read with neighbouring operations of the same type left for condense_cigar()
+std::vector<uint32_t> synthetic_cigar(uint32_t &state) {
+  const int ops[] = {BAM_CSOFT_CLIP, BAM_CMATCH, BAM_CINS, BAM_CDEL};
+  std::vector<uint32_t> cigar;
+  uint32_t n = 4 + next_random(state) % 9;
+  for (uint32_t i = 0; i < n; ++i) {
+    int op = (i == 0 || next_random(state) % 3 == 0) ? BAM_CSOFT_CLIP : ops[next_random(state) % 4];
+    cigar.push_back(bam_cigar_gen(1 + next_random(state) % 50, op));
+  }
+  return cigar;
+}
+
+std::string json_number(double d) {
+  std::ostringstream s;
+  s.precision(15);
+  s << d;
+  return s.str();
+}
+
+// One benchmark per line so results of earlier runs can be read back by read_baseline()
+int write_json(std::string path, const std::vector<bench_result> &results, int warmup, int reps) {
+  std::ofstream out(path.c_str());
+  if (!out.is_open()) {
+    std::cout << "Unable to write " << path << std::endl;
+    return -1;
+  }
+  out << "{\n  \"compiler\": \"" << __VERSION__ << "\",\n  \"warmup\": " << warmup << ",\n  \"repetitions\": " << reps << ",\n  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const bench_result &r = results[i];
+    out << "    {\"name\": \"" << r.name << "\", \"unit\": \"" << r.unit << "\", \"items\": " << r.items << ", \"median_ns\": " << json_number(r.median()) << ", \"p99_ns\": " << json_number(r.p99()) << ", \"min_ns\": " << json_number(r.ns.front()) << ", \"per_second\": " << json_number(r.per_second()) << "}" << ((i + 1 < results.size()) ? "," : "") << "\n";
+  }
+  out << "  ]\n}\n";
+  return 0;
+}
+
+std::string json_field(const std::string &line, std::string key) {
+  size_t p = line.find("\"" + key + "\": ");
+  if (p == std::string::npos)
+    return "";
+  p += key.size() + 4;
+  if (line[p] == '"')
+    return line.substr(p + 1, line.find('"', p + 1) - p - 1);
+  return line.substr(p, line.find_first_of(",}", p) - p);
+}
+
+// Median time per item of every benchmark of a bench.json written by an earlier run
+int read_baseline(std::string path, std::map<std::string, double> &medians) {
+  std::ifstream in(path.c_str());
+  std::string line;
+  if (!in.is_open()) {
+    std::cout << "Unable to read " << path << std::endl;
+    return -1;
+  }
+  while (std::getline(in, line)) {
+    std::string name = json_field(line, "name"), median = json_field(line, "median_ns"), items = json_field(line, "items");
+    if (!name.empty() && !median.empty() && atof(items.c_str()) > 0)
+      medians[name] = atof(median.c_str()) / atof(items.c_str());
+  }
+  return 0;
+}
+
+void print_bench_usage() {
+  std::cout <<
+    "Usage: bench_kernels [-o <results.json>] [-c <baseline.json>] [-w <warmup>] [-r <repetitions>] [-i <sorted.bam>] [-b <primers.bed>] [-m <pileup>] [-f <reference-fasta>] [-g <GFF file>]\n\n"
+    "           -o    Write results as JSON (Default: bench.json)\n"
+    "           -c    Print the change in median time per item against the results of an earlier run\n"
+    "           -w    Untimed repetitions before timing (Default: 3)\n"
+    "           -r    Timed repetitions (Default: 20)\n"
+    "           -i    Reads to trim (Default: ../data/test.sorted.bam)\n"
+    "           -b    Primers to trim (Default: ../data/test.bed)\n"
+    "           -m    mpileup to count alleles from (Default: ../data/test.gap.sorted.mpileup)\n"
+    "           -f    Reference to translate (Default: ../data/db/test_ref.fa)\n"
+    "           -g    GFF file of the reference (Default: ../data/test.gff)\n";
+}
+
+int main(int argc, char **argv) {
+  std::string out = "bench.json", baseline, bam = "../data/test.sorted.bam", bed = "../data/test.bed", mpileup = "../data/test.gap.sorted.mpileup", ref = "../data/db/test_ref.fa", gff = "../data/test.gff";
+  int warmup = 3, reps = 20, opt;
+  while ((opt = getopt(argc, argv, "o:c:w:r:i:b:m:f:g:h?")) != -1) {
+    switch (opt) {
+      case 'o': out = optarg; break;
+      case 'c': baseline = optarg; break;
+      case 'w': warmup = atoi(optarg); break;
+      case 'r': reps = atoi(optarg); break;
+      case 'i': bam = optarg; break;
+      case 'b': bed = optarg; break;
+      case 'm': mpileup = optarg; break;
+      case 'f': ref = optarg; break;
+      case 'g': gff = optarg; break;
+      default:
+        print_bench_usage();
+        return 0;
+    }
+  }
+  if (reps < 1) {
+    print_bench_usage();
+    return -1;
+  }
+
+  std::vector<bench_result> results;
+  uint32_t state = 1;
+
+  // Trimming, on the reads of a BAM file
+  std::vector<bam1_t*> reads;
+  std::vector<primer> primers = populate_from_file(bed);
+  if (load_reads(bam, reads) != 0 || reads.empty() || primers.empty()) {
+    std::cout << "Unable to load reads from " << bam << " and primers from " << bed << ". Skipping trimming." << std::endl;
+  } else {
+    int max_primer_len = get_bigger_primer(primers);
+    std::vector<primer> overlapping;
+    std::vector<std::pair<size_t, int32_t> > trims;	// Read and position to trim to for reads that start in a primer
+    for (size_t i = 0; i < reads.size(); ++i) {
+      get_overlapping_primers(reads[i], primers, overlapping);
+      if (!overlapping.empty())
+        trims.push_back(std::make_pair(i, bam_is_rev(reads[i]) ? get_min_start(overlapping).get_start() - 1 : get_max_end(overlapping).get_end() + 1));
+    }
+    results.push_back(run_bench("get_overlapping_primers", "reads", reads.size(), warmup, reps, [&]() {
+      for (size_t i = 0; i < reads.size(); ++i) {
+        get_overlapping_primers(reads[i], primers, overlapping);
+        sink += overlapping.size();
+      }
+    }));
+    results.push_back(run_bench("primer_trim", "reads", trims.size(), warmup, reps, [&]() {
+      for (size_t i = 0; i < trims.size(); ++i) {
+        bam1_t *r = reads[trims[i].first];
+        bool isize_flag = (abs(r->core.isize) - max_primer_len) > abs(r->core.l_qseq);
+        cigar_ t = primer_trim(r, isize_flag, trims[i].second, false);
+        sink += t.nlength;
+        free_cigar(t);
+      }
+    }));
+    results.push_back(run_bench("quality_trim", "reads", reads.size(), warmup, reps, [&]() {
+      for (size_t i = 0; i < reads.size(); ++i) {
+        cigar_ t = quality_trim(reads[i], 20, 4);
+        sink += t.nlength + t.start_pos;
+        free_cigar(t);
+      }
+    }));
+  }
+
+  std::vector<std::vector<uint32_t> > cigars;
+  for (int i = 0; i < 100000; ++i)
+    cigars.push_back(synthetic_cigar(state));
+  std::vector<uint32_t> scratch;
+  results.push_back(run_bench("condense_cigar", "cigars", cigars.size(), warmup, reps, [&]() {
+    for (size_t i = 0; i < cigars.size(); ++i) {
+      scratch = cigars[i];
+      cigar_ t;
+      init_cigar(&t);
+      t.cigar = scratch.data();
+      t.nlength = scratch.size();
+      condense_cigar(&t);
+      sink += t.nlength;
+    }
+  }));
+
+  // Allele counting and consensus, on synthetic columns of depth 1000 and on an mpileup file
+  std::vector<char> col_ref;
+  std::vector<std::string> col_bases, col_quals;
+  for (int i = 0; i < 5000; ++i) {
+    col_ref.push_back("ACGT"[i % 4]);
+    col_bases.push_back(std::string());
+    col_quals.push_back(std::string());
+    synthetic_column(state, 1000, col_bases.back(), col_quals.back());
+  }
+  std::vector<std::vector<allele> > ads(col_bases.size());
+  results.push_back(run_bench("update_allele_depth", "columns", col_bases.size(), warmup, reps, [&]() {
+    for (size_t i = 0; i < col_bases.size(); ++i) {
+      ads[i] = update_allele_depth(col_ref[i], col_bases[i], col_quals[i], 20);
+      sink += ads[i].size();
+    }
+  }));
+
+  std::ifstream mplp(mpileup.c_str());
+  std::vector<char> file_ref;
+  std::vector<std::string> file_bases, file_quals;
+  std::string line, field;
+  while (std::getline(mplp, line)) {
+    std::vector<std::string> fields;
+    std::istringstream s(line);
+    while (std::getline(s, field, '\t'))
+      fields.push_back(field);
+    if (fields.size() < 6)
+      continue;
+    file_ref.push_back(fields[2][0]);
+    file_bases.push_back(fields[4]);
+    file_quals.push_back(fields[5]);
+  }
+  if (file_bases.empty()) {
+    std::cout << "Unable to read " << mpileup << ". Skipping allele counting on it." << std::endl;
+  } else {
+    results.push_back(run_bench("update_allele_depth.mpileup", "columns", file_bases.size() * MPILEUP_PASSES, warmup, reps, [&]() {
+      for (int pass = 0; pass < MPILEUP_PASSES; ++pass) {
+        for (size_t i = 0; i < file_bases.size(); ++i)
+          sink += update_allele_depth(file_ref[i], file_bases[i], file_quals[i], 20).size();
+      }
+    }));
+  }
+
+  results.push_back(run_bench("get_consensus_allele", "columns", ads.size(), warmup, reps, [&]() {
+    for (size_t i = 0; i < ads.size(); ++i) {
+      ret_t t = get_consensus_allele(ads[i], 20, 0.5, 'N');
+      sink += t.nuc.size() + t.q.size();
+    }
+  }));
+
+  // Translation of every position of the reference with every base
+  ref_antd refantd(ref, gff);
+  int64_t ref_len = (refantd.get_region_count() > 0) ? refantd.get_region_length(0) : 0;
+  if (ref_len == 0) {
+    std::cout << "Unable to load " << ref << ". Skipping translation." << std::endl;
+  } else {
+    std::string region = refantd.get_region_name(0);
+    std::ostringstream prefix, annotated;
+    prefix << region << "\t1\tA\tG\t";
+    results.push_back(run_bench("codon_aa_stream", "positions", ref_len * 4, warmup, reps, [&]() {
+      for (int64_t pos = 1; pos <= ref_len; ++pos) {
+        for (int i = 0; i < 4; ++i) {
+          annotated.str("");
+          refantd.codon_aa_stream(region, prefix, annotated, pos, "ACGT"[i]);
+          sink += annotated.tellp();
+        }
+      }
+    }));
+  }
+
+  for (size_t i = 0; i < reads.size(); ++i)
+    bam_destroy1(reads[i]);
+
+  std::map<std::string, double> medians;
+  if (!baseline.empty() && read_baseline(baseline, medians) == 0) {
+    std::cout << std::endl << "Change in median time per item against " << baseline << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+      std::map<std::string, double>::iterator it = medians.find(results[i].name);
+      if (it == medians.end() || it->second <= 0)
+        continue;
+      std::cout << results[i].name << "\t" << json_number((results[i].median() / results[i].items / it->second - 1) * 100) << "%" << std::endl;
+    }
+  }
+
+  std::cout << "Checksum " << sink << std::endl;
+  return write_json(out, results, warmup, reps);
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "../src/adapter_index.h"
+#include "../src/suffix_tree.h"
+#include "../src/bgzf_stream.h"
+
+const std::string insert = "TTGACCGTAGGCATTCAGGTACCATGGAATTCCGTTAGCA";
+
+int check_trim(adapter_index &index, std::string read, unsigned int exp_beg, unsigned int exp_len){
+  adapter_hit hit = index.find(read);
+  unsigned int beg, len;
+  if (!get_adapter_trim(read, index, hit, beg, len) || beg != exp_beg || len != exp_len) {
+    std::cout << read << " was not trimmed to " << exp_beg << " " << exp_len << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+std::string read_file(std::string path){
+  bgzf_istream in;
+  std::ostringstream s;
+  in.open(path);
+  s << in.rdbuf();
+  return s.str();
+}
+
+int main() {
+  int num_success = 0;
+  std::vector<std::string> adapters;
+  adapters.push_back("AGATCGGAAGAGCACACGTCTGAACTCCAGTCA");
+  adapters.push_back("CTGTCTCTTATACACATCT");
+  adapter_index index(adapters);
+
+  // Adapter at the end of the read
+  adapter_hit hit = index.find(insert + adapters[0].substr(0, 20));
+  if (hit.adapter != 0 || hit.reverse || hit.read_pos != 40 || hit.adapter_pos != 0 || hit.length != 20)
+    num_success -= 1;
+  num_success += check_trim(index, insert + adapters[0].substr(0, 20), 0, 40);
+
+  // Mismatch near the start of the adapter
+  std::string adp = adapters[0];
+  adp[3] = 'A';
+  num_success += check_trim(index, insert + adp, 0, 40);
+
+  // Reverse complemented adapter at the start of the read
+  num_success += check_trim(index, get_reverse_complement(adapters[1]) + insert, 19, 40);
+
+  // No adapter
+  hit = index.find(insert);
+  unsigned int beg, len;
+  if (hit.adapter != -1 || get_adapter_trim(insert, index, hit, beg, len))
+    num_success -= 1;
+
+  // Sequence and quality lines are trimmed
+  std::ofstream fa("../data/test.adapters.fa");
+  fa << ">adapter_1\n" << adapters[0] << "\n>adapter_2\n" << adapters[1] << "\n";
+  fa.close();
+  std::ofstream fq("../data/test.adapter.fastq");
+  fq << "@read1\n" << insert << adapters[0] << "\n+\n" << std::string(insert.length() + adapters[0].length(), 'I') << "\n";
+  fq << "@read2\n" << insert << "\n+\n" << std::string(insert.length(), 'I') << "\n";
+  fq.close();
+  trim_adapter("../data/test.adapter.fastq", "", "../data/test.adapters.fa", "../data/test.adapter");
+  std::ifstream trimmed("../data/test.adapter.trimmed.fastq");
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(trimmed, line)) {
+    lines.push_back(line);
+  }
+  if (lines.size() != 8 || lines[1] != insert || lines[3] != std::string(insert.length(), 'I') || lines[5] != insert) {
+    std::cout << "Trimmed fastq does not match" << std::endl;
+    num_success -= 1;
+  }
+
+  // Mates overlap over the insert
+  std::string r1 = insert + adapters[0].substr(0, 30), r2 = get_reverse_complement(insert) + adapters[1] + "ACGTACGTACG";
+  if (get_insert_length(r1, get_reverse_complement(r2)) != 40)
+    num_success -= 1;
+  std::string mismatched = r2;
+  mismatched[5] = (mismatched[5] == 'A') ? 'C' : 'A';
+  if (get_insert_length(r1, get_reverse_complement(mismatched)) != 40)
+    num_success -= 1;
+  std::string long_r1 = "GGCATCAGTTACCGATTGCA" + insert, long_r2 = get_reverse_complement(insert + "CCTAGGATTACAGGCTTAAC");
+  if (get_insert_length(long_r1, get_reverse_complement(long_r2)) != -1)
+    num_success -= 1;
+
+  // Paired reads are written to two files in step
+  std::ofstream fq1("../data/test.adapter_1.fastq"), fq2("../data/test.adapter_2.fastq");
+  fq1 << "@pair1/1\n" << r1 << "\n+\n" << std::string(r1.length(), 'I') << "\n";
+  fq2 << "@pair1/2\n" << r2 << "\n+\n" << std::string(r2.length(), 'I') << "\n";
+  fq1 << "@pair2/1\n" << long_r1 << "\n+\n" << std::string(long_r1.length(), 'I') << "\n";
+  fq2 << "@pair2/2\n" << long_r2 << "\n+\n" << std::string(long_r2.length(), 'I') << "\n";
+  fq1.close();
+  fq2.close();
+  trim_adapter("../data/test.adapter_1.fastq", "../data/test.adapter_2.fastq", "../data/test.adapters.fa", "../data/test.adapter");
+  std::ifstream t1("../data/test.adapter_1.trimmed.fastq"), t2("../data/test.adapter_2.trimmed.fastq");
+  std::vector<std::string> lines1, lines2;
+  while (std::getline(t1, line)) {
+    lines1.push_back(line);
+  }
+  while (std::getline(t2, line)) {
+    lines2.push_back(line);
+  }
+  if (lines1.size() != 8 || lines2.size() != 8 || lines1[1] != insert || lines1[3] != std::string(insert.length(), 'I') || lines2[1] != get_reverse_complement(insert) || lines1[5] != long_r1 || lines2[5] != long_r2 || lines2[6] != "+") {
+    std::cout << "Trimmed pairs do not match" << std::endl;
+    num_success -= 1;
+  }
+
+  // Mates with a different number of reads
+  std::ofstream short_fq("../data/test.adapter_2.fastq");
+  short_fq << "@pair1/2\n" << r2 << "\n+\n" << std::string(r2.length(), 'I') << "\n";
+  short_fq.close();
+  if (trim_adapter("../data/test.adapter_1.fastq", "../data/test.adapter_2.fastq", "../data/test.adapters.fa", "../data/test.adapter") != -1)
+    num_success -= 1;
+
+  // Batches trimmed on several threads and written bgzipped match a single thread
+  fq1.open("../data/test.adapter_1.fastq");
+  fq2.open("../data/test.adapter_2.fastq");
+  srand(3);
+  for (int i = 0; i < 5000; ++i) {
+    std::string s1 = (i % 3 == 0) ? r1 : (i % 3 == 1) ? long_r1 : insert + adapters[rand() % 2].substr(0, rand() % 20);
+    std::string s2 = (i % 3 == 0) ? r2 : (i % 3 == 1) ? long_r2 : get_reverse_complement(s1);
+    fq1 << "@pair" << i << "/1\n" << s1 << "\n+\n" << std::string(s1.length(), 'I') << "\n";
+    fq2 << "@pair" << i << "/2\n" << s2 << "\n+\n" << std::string(s2.length(), 'I') << "\n";
+  }
+  fq1.close();
+  fq2.close();
+  if (trim_adapter("../data/test.adapter_1.fastq", "../data/test.adapter_2.fastq", "../data/test.adapters.fa", "../data/test.adapter") != 0 ||
+      trim_adapter("../data/test.adapter_1.fastq", "../data/test.adapter_2.fastq", "../data/test.adapters.fa", "../data/test.adapter.mt", FASTQ_GZ_OUTPUT, 4) != 0)
+    num_success -= 1;
+  std::string single_1 = read_file("../data/test.adapter_1.trimmed.fastq"), single_2 = read_file("../data/test.adapter_2.trimmed.fastq");
+  if (single_1.empty() || single_1 != read_file("../data/test.adapter.mt_1.trimmed.fastq.gz") || single_2 != read_file("../data/test.adapter.mt_2.trimmed.fastq.gz")) {
+    std::cout << "Threaded trimming does not match a single thread" << std::endl;
+    num_success -= 1;
+  }
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
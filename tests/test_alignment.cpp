@@ -0,0 +1,78 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "../src/alignment.h"
+
+std::string random_seq(int len, bool with_n){
+  const std::string bases = with_n ? "ACGTACGTACGTN" : "ACGT";
+  std::string s;
+  for (int i = 0; i < len; ++i) {
+    s += bases[rand() % bases.length()];
+  }
+  return s;
+}
+
+// SIMD alignment gives the same score and start as the scalar alignment
+int check_alignment(adapter_aligner &aligner, std::string read, std::string adap){
+  int start, expected_start;
+  int score = aligner.align(read, start), expected = align_seqs_scalar(read, adap, expected_start);
+  if (score != expected || start != expected_start) {
+    std::cout << read << " " << adap << ": " << score << " " << start << " expected " << expected << " " << expected_start << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  srand(7);
+
+  // Adapter at the end of the read
+  std::string adap = "AGATCGGAAGAGCACACGTCTGAACTCCAGTCA", read = "TTGACCGTAGGCATTCAGGTACCATGGAATTCCGTTAGCA" + adap.substr(0, 25);
+  int start, score = align_seqs_scalar(read, adap, start);
+  if (score != 50 || start != 40)
+    num_success -= 1;
+  int *rt = align_seqs(read, adap);
+  if (rt[0] != score || rt[1] != start)
+    num_success -= 1;
+  delete[] rt;
+
+  // Adapters of several lengths against random reads, reads with adapters and reads longer than 500 bases
+  int lengths[] = {1, 7, 8, 9, 19, 33, 64, 65, 100};
+  for (int l = 0; l < 9; ++l) {
+    for (int with_n = 0; with_n < 2; ++with_n) {
+      adap = random_seq(lengths[l], with_n);
+      adapter_aligner aligner(adap);
+      for (int r = 0; r < 200; ++r) {
+        read = random_seq(rand() % 150, with_n);
+        if (r % 2 == 0)
+          read += adap.substr(0, rand() % (adap.length() + 1)) + random_seq(rand() % 5, with_n);
+        num_success += check_alignment(aligner, read, adap);
+      }
+      num_success += check_alignment(aligner, random_seq(3000, with_n) + adap, adap);
+      num_success += check_alignment(aligner, "", adap);
+    }
+  }
+
+  // Mismatch counts across the vector and scalar parts of the comparison
+  for (int r = 0; r < 200; ++r) {
+    std::string a = random_seq(rand() % 70, true), b = a;
+    int expected = 0;
+    for (unsigned int i = 0; i < b.length(); ++i) {
+      if (rand() % 8 == 0) {
+        b[i] = (b[i] == 'A') ? 'C' : 'A';
+        expected++;
+      }
+    }
+    if (count_mismatches(a.c_str(), b.c_str(), a.length(), a.length()) != expected)
+      num_success -= 1;
+    if (expected > 0 && count_mismatches(a.c_str(), b.c_str(), a.length(), 0) < 1)
+      num_success -= 1;
+  }
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/batch.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+int main() {
+  int num_success = 0;
+  std::vector<job_request> samples;
+
+  // Manifests
+  std::istringstream manifest("# samples\nsample\tbam\ttrim\tbed\r\ns1\ts1.bam\ts1.trimmed\t\n\ns2\ts2.bam\ts2.trimmed\tother.bed\ns3\n");
+  if (read_batch_manifest(manifest, samples) != 0 || samples.size() != 3 || samples[0]["bam"] != "s1.bam" || samples[0]["bed"] != "" || samples[1]["bed"] != "other.bed" || samples[2]["sample"] != "s3") {
+    std::cout << "Manifest not read" << std::endl;
+    num_success -= 1;
+  }
+  std::istringstream unknown("sample\tfastq\ns1\ts1.fq\n"), no_sample("bam\ttrim\ns1.bam\ts1\n"), extra("sample\tbam\ns1\ts1.bam\tx\n"), empty("");
+  if (read_batch_manifest(unknown, samples) != -1 || read_batch_manifest(no_sample, samples) != -1 || read_batch_manifest(extra, samples) != -1 || read_batch_manifest(empty, samples) != -1) {
+    std::cout << "Invalid manifest read" << std::endl;
+    num_success -= 1;
+  }
+
+  // Jobs use the shared settings unless the sample sets them
+  batch_settings settings;
+  settings.bed = "primers.bed";
+  job_request sample;
+  sample["sample"] = "s1";
+  sample["bam"] = "s1.bam";
+  sample["trim"] = "s1.trimmed";
+  std::vector<job_request> jobs = get_batch_jobs(sample, settings);
+  if (jobs.size() != 1 || jobs[0]["cmd"] != "trim" || jobs[0]["bed"] != "primers.bed" || jobs[0]["min_qual"] != "20")
+    num_success -= 1;
+  sample["bed"] = "other.bed";
+  sample["mpileup"] = "s1.mpileup";
+  sample["variants"] = "s1.variants";
+  sample["consensus"] = "s1.consensus";
+  jobs = get_batch_jobs(sample, settings);
+  if (jobs.size() != 3 || jobs[0]["bed"] != "other.bed" || jobs[1]["cmd"] != "variants" || jobs[1]["mpileup"] != "s1.mpileup" || jobs[1].count("bam") != 0 || jobs[2]["cmd"] != "consensus" || jobs[2]["min_depth"] != "10") {
+    std::cout << "Jobs do not match the manifest" << std::endl;
+    num_success -= 1;
+  }
+
+  // Samples run in parallel, the report is in manifest order and a failed sample does not stop the others
+  std::ofstream out("../data/test.batch.manifest.tsv");
+  out << "sample\tmpileup\tvariants\tconsensus\n";
+  for (int i = 0; i < 6; ++i)
+    out << "s" << i << "\t../data/test.indel.mpileup\t../data/test.batch.s" << i << "\t../data/test.batch.s" << i << "\n";
+  out << "missing\t../data/test.batch.missing.mpileup\t../data/test.batch.missing\t\n";
+  out << "trim_only\t\t\t\n";
+  out.close();
+  settings = batch_settings();
+  settings.ref = "../data/db/test_ref.fa";
+  settings.gff = "../data/test.gff";
+  settings.min_depth = 0;
+  if (run_batch("../data/test.batch.manifest.tsv", settings, "../data/test.batch.tsv", 3) != -1)
+    num_success -= 1;
+  std::ifstream mplp("../data/test.indel.mpileup");
+  call_variants_from_plup(mplp, "../data/test.batch.direct", 20, 0.03, 0, "../data/db/test_ref.fa", "../data/test.gff");
+  std::string expected = read_file("../data/test.batch.direct.tsv");
+  for (int i = 0; i < 6; ++i) {
+    if (expected.empty() || read_file("../data/test.batch.s" + std::to_string(i) + ".tsv") != expected || read_file("../data/test.batch.s" + std::to_string(i) + ".fa").empty()) {
+      std::cout << "Variants of sample " << i << " do not match ivar variants" << std::endl;
+      num_success -= 1;
+    }
+  }
+  std::istringstream report(read_file("../data/test.batch.tsv"));
+  std::string line;
+  std::vector<std::string> lines;
+  while (std::getline(report, line))
+    lines.push_back(line);
+  if (lines.size() != 9 || lines[0].compare(0, 14, "SAMPLE\tSTATUS\t") != 0) {
+    std::cout << "Report does not have a line per sample" << std::endl;
+    num_success -= 1;
+  } else {
+    for (int i = 0; i < 6; ++i) {
+      if (lines[i + 1].compare(0, 6, "s" + std::to_string(i) + "\tok\t") != 0 || lines[i + 1].find("\tNA\tok\tok\t") == std::string::npos)
+        num_success -= 1;
+    }
+    if (lines[7].compare(0, 14, "missing\terror\t") != 0 || lines[7].find("\tNA\terror\tNA\t") == std::string::npos || lines[7].find("Unable to open") == std::string::npos)
+      num_success -= 1;
+    if (lines[8].compare(0, 13, "trim_only\tok\t") != 0)
+      num_success -= 1;
+  }
+  if (run_batch("../data/test.batch.missing.tsv", settings, "../data/test.batch.tsv", 1) != -1)
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,82 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include "../src/call_variants.h"
+#include "../src/get_common_variants.h"
+#include "../src/get_masked_amplicons.h"
+
+std::string read_all(std::istream &in){
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+int main() {
+  int num_success = 0;
+  // Bgzipped tsv has the same rows as the plain tsv, on one or more compression threads
+  std::ifstream mplp("../data/test.indel.mpileup");
+  call_variants_from_plup(mplp, "../data/test.indel.plain", 20, 0.02, 0, "../data/db/test_ref.fa", "../data/test.gff", 1, TSV_OUTPUT);
+  std::ifstream plain("../data/test.indel.plain.tsv");
+  std::string expected = read_all(plain);
+  for (unsigned int nthreads = 1; nthreads <= 4; nthreads += 3) {
+    std::ifstream in("../data/test.indel.mpileup");
+    num_success += call_variants_from_plup(in, "../data/test.indel.gz", 20, 0.02, 0, "../data/db/test_ref.fa", "../data/test.gff", nthreads, TSV_GZ_OUTPUT);
+    bgzf_istream gz;
+    gz.open("../data/test.indel.gz.tsv.gz");
+    if (read_all(gz) != expected) {
+      std::cout << "Bgzipped tsv with " << nthreads << " threads does not match" << std::endl;
+      num_success -= 1;
+    }
+    if (!std::ifstream("../data/test.indel.gz.tsv.gz.tbi")) {
+      std::cout << "Missing tabix index" << std::endl;
+      num_success -= 1;
+    }
+  }
+  // Bgzipped tsv does not need a reference, unlike VCF and BCF
+  if (output_format_needs_ref(TSV_OUTPUT) || output_format_needs_ref(TSV_GZ_OUTPUT) || !output_format_needs_ref(VCF_OUTPUT) || !output_format_needs_ref(BCF_OUTPUT))
+    num_success -= 1;
+  std::ifstream noref_mplp("../data/test.indel.mpileup");
+  call_variants_from_plup(noref_mplp, "../data/test.indel.noref", 20, 0.02, 0, "", "", 1, TSV_OUTPUT);
+  std::ifstream noref_plain("../data/test.indel.noref.tsv");
+  std::string noref_expected = read_all(noref_plain);
+  std::ifstream noref_in("../data/test.indel.mpileup");
+  if (call_variants_from_plup(noref_in, "../data/test.indel.noref", 20, 0.02, 0, "", "", 1, TSV_GZ_OUTPUT) != 0) {
+    std::cout << "Bgzipped tsv without a reference failed" << std::endl;
+    num_success -= 1;
+  }
+  bgzf_istream noref_gz;
+  noref_gz.open("../data/test.indel.noref.tsv.gz");
+  if (noref_expected.empty() || read_all(noref_gz) != noref_expected) {
+    std::cout << "Bgzipped tsv without a reference does not match" << std::endl;
+    num_success -= 1;
+  }
+  // filtervariants reads bgzipped files
+  std::map<std::string, unsigned int> counts, gz_counts;
+  std::map<std::string, std::string> str, gz_str;
+  std::ifstream fin("../data/test.indel.plain.tsv");
+  read_variant_file(fin, 0, counts, str);
+  bgzf_istream gz_fin;
+  gz_fin.open("../data/test.indel.gz.tsv.gz");
+  num_success += read_variant_file(gz_fin, 0, gz_counts, gz_str);
+  if (counts.empty() || counts != gz_counts || str != gz_str)
+    num_success -= 1;
+  // getmasked reads bgzipped files
+  std::ifstream filtered("../data/test.filtered.tsv");
+  bgzf_ostream filtered_gz;
+  filtered_gz.open("../data/test.filtered.tmp.tsv.gz");
+  filtered_gz << read_all(filtered);
+  filtered_gz.close();
+  get_primers_with_mismatches("../data/test.bed", "../data/test.filtered.tmp.tsv.gz", "../data/test.masked_primer_indices.gz", "../data/pair_information.tsv");
+  std::ifstream masked("../data/test.masked_primer_indices.gz.txt");
+  std::string indices;
+  getline(masked, indices);
+  if (indices != "WNV_400_2_LEFT\tWNV_400_2_RIGHT\tWNV_400_2_LEFT_alt\tWNV_400_1_LEFT\tWNV_400_1_RIGHT\tWNV_400_1_LEFT_alt\tWNV_400_3_LEFT") {
+    std::cout << "getmasked: " << indices << std::endl;
+    num_success -= 1;
+  }
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,52 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include "../src/buffered_writer.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+int main() {
+  int num_success = 0;
+  std::string path = "../data/test.buffered.txt", expected;
+  buffered_ofstream out(path, 64);
+  // Nothing is written until the buffer is full
+  out << "REGION\tPOS" << '\n';
+  expected += "REGION\tPOS\n";
+  if (!read_file(path).empty()) {
+    std::cout << "Written before the buffer was full" << std::endl;
+    num_success -= 1;
+  }
+  // Small writes across the end of the buffer, single characters and blocks larger than the buffer
+  for (int i = 0; i < 100; ++i) {
+    out << "test\t" << i << '\n';
+    expected += "test\t" + std::to_string(i) + "\n";
+  }
+  std::string block(1000, 'A');
+  out << block << 'C';
+  expected += block + "C";
+  out.flush();
+  if (read_file(path) != expected) {
+    std::cout << "Flush did not write buffered output" << std::endl;
+    num_success -= 1;
+  }
+  out << "\nend\n";
+  expected += "\nend\n";
+  out.close();
+  if (read_file(path) != expected || !out.good()) {
+    std::cout << "Close did not write buffered output" << std::endl;
+    num_success -= 1;
+  }
+  buffered_ofstream missing("../data/missing/test.buffered.txt");
+  if (missing.is_open() || missing.good())
+    num_success -= 1;
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,53 @@
+#include<iostream>
+#include<sstream>
+#include<string>
+#include "../src/ref_seq.h"
+
+int check_codons(ref_antd &refantd, int64_t pos, char alt, std::string expected) {
+  std::ostringstream line, out;
+  line << "test\t";
+  refantd.codon_aa_stream("test", line, out, pos, alt);
+  if (out.str().compare(expected) != 0) {
+    std::cout << "Pos: " << pos << " Alt: " << alt << std::endl << out.str() << "Correct:" << std::endl << expected;
+    return -1;
+  }
+  return 0;
+}
+
+// Annotation from the precomputed tables must match annotating from the GFF features
+int main() {
+  int num_success = 0;
+  ref_antd refantd("../data/db/test_ref.fa", "../data/test.gff");
+  std::ostringstream line, table, features;
+  const char alts[] = {'A', 'C', 'G', 'T'};
+
+  // Codons and amino acids of ivar variants on data/test.gff and of test_ref_seq
+  num_success += check_codons(refantd, 42, 'T', "test\tid-test3\tAGG\tR\tATG\tM\ntest\tid-test4\tCAG\tQ\tCAT\tH\ntest\tid-testedit1\tAGG\tR\tATG\tM\ntest\tid-testedit2\tAGG\tR\tATG\tM\n");
+  num_success += check_codons(refantd, 69, 'G', "test\tid-test3\tTTG\tL\tTGG\tW\ntest\tid-testedit1\tTTG\tL\tTGG\tW\ntest\tid-testedit2\tTTG\tL\tTGG\tW\n");
+  num_success += check_codons(refantd, 30, 'G', "test\tid-test3\tCAT\tH\tCGT\tR\ntest\tid-test4\tTCA\tS\tTCG\tS\ntest\tid-testedit1\tCAT\tH\tCGT\tR\ntest\tid-testedit2\tCAT\tH\tCGT\tR\n");
+  // After the edits of id-testedit1 and id-testedit2
+  num_success += check_codons(refantd, 107, 'G', "test\tid-test3\tAAT\tN\tGAT\tD\ntest\tid-testedit1\tCAA\tQ\tCGA\tR\ntest\tid-testedit2\tTCA\tS\tTCG\tS\n");
+  num_success += check_codons(refantd, 101, 'A', "test\tid-test3\tCTC\tL\tATC\tI\ntest\tid-testedit1\tTCT\tS\tACT\tT\ntest\tid-testedit2\tCAA\tQ\tAAA\tK\n");
+  num_success += check_codons(refantd, 100, 'T', "test\tid-test3\tGGT\tG\tGGT\tG\ntest\tid-testedit1\tGGA\tG\tGGT\tG\ntest\tid-testedit2\tGGT\tG\tGGT\tG\n");
+  num_success += check_codons(refantd, 140, 'A', "test\tid-test3\tATG\tM\tATG\tM\ntest\tid-testedit1\tTAT\tY\tTAT\tY\ntest\tid-testedit2\tCTA\tL\tCTA\tL\n");
+  // Outside of every CDS
+  num_success += check_codons(refantd, 300, 'A', "test\tNA\tNA\tNA\tNA\tNA\n");
+
+  line << "test\t";
+  for (int64_t pos = 1; pos <= 600; ++pos) {
+    for (int i = 0; i < 4; ++i) {
+      table.str("");
+      features.str("");
+      refantd.codon_aa_stream("test", line, table, pos, alts[i]);
+      refantd.codon_aa_stream_features("test", line, features, pos, alts[i]);
+      if (table.str().compare(features.str()) != 0) {
+        std::cout << "Pos: " << pos << " Table: " << table.str() << " Features: " << features.str() << std::endl;
+        num_success = -1;
+      }
+    }
+  }
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,75 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/call_consensus_pileup.h"
+
+// Consensus of alleles counted from every line of an mpileup file, the way a BAM pileup passes them
+int build_consensus(std::string mpileup, const std::vector<consensus_setting> &settings, std::vector<std::ostringstream> &seqs, std::vector<std::ostringstream> &quals, std::vector<consensus_stats> &stats) {
+  std::ifstream in(mpileup);
+  std::string line, region, pos, ref, depth, bases, qualities;
+  std::vector<std::ostream*> fout, qout;
+  std::vector<std::string> headers;
+  for (size_t i = 0; i < settings.size(); ++i) {
+    fout.push_back(&seqs[i]);
+    qout.push_back(&quals[i]);
+    headers.push_back(">consensus");
+  }
+  consensus_records records(fout, qout, headers);
+  consensus_builder builder(records, settings, stats, 20, 'N', true);
+  while (std::getline(in, line)) {
+    std::istringstream cols(line);
+    std::getline(cols, region, '\t');
+    std::getline(cols, pos, '\t');
+    std::getline(cols, ref, '\t');
+    std::getline(cols, depth, '\t');
+    std::getline(cols, bases, '\t');
+    std::getline(cols, qualities, '\t');
+    builder.add(region, std::stoi(pos), std::stoi(depth), update_allele_depth(ref[0], bases, qualities, 20));
+  }
+  builder.finish();
+  return 0;
+}
+
+int check_matches_plup(std::string mpileup, const std::vector<consensus_setting> &settings) {
+  int num_success = 0;
+  std::vector<std::ostringstream> seqs(settings.size()), quals(settings.size()), exp_seqs(settings.size()), exp_quals(settings.size());
+  std::vector<std::ostream*> fout, qout;
+  std::vector<std::string> headers;
+  std::vector<consensus_stats> stats, exp_stats;
+  for (size_t i = 0; i < settings.size(); ++i) {
+    fout.push_back(&exp_seqs[i]);
+    qout.push_back(&exp_quals[i]);
+    headers.push_back(">consensus");
+  }
+  std::ifstream in(mpileup);
+  call_consensus_from_plup(in, fout, qout, headers, 20, settings, 'N', true, exp_stats);
+  build_consensus(mpileup, settings, seqs, quals, stats);
+  for (size_t i = 0; i < settings.size(); ++i) {
+    if (seqs[i].str() != exp_seqs[i].str() || quals[i].str() != exp_quals[i].str() || seqs[i].str().empty()) {
+      std::cout << mpileup << " setting " << i << " does not match:" << std::endl << seqs[i].str() << exp_seqs[i].str();
+      num_success -= 1;
+    }
+    if (stats[i].total_bases != exp_stats[i].total_bases || stats[i].bases_zero_depth != exp_stats[i].bases_zero_depth || stats[i].bases_min_depth != exp_stats[i].bases_min_depth)
+      num_success -= 1;
+  }
+  return num_success;
+}
+
+int main() {
+  int num_success = 0;
+  std::vector<consensus_setting> settings;
+  settings.push_back(consensus_setting(0, 10));
+  num_success += check_matches_plup("../data/test.gap.sorted.mpileup", settings);
+  num_success += check_matches_plup("../data/test.contigs.mpileup", settings);
+  settings.push_back(consensus_setting(0.75, 0));
+  settings.push_back(consensus_setting(0, 1));
+  num_success += check_matches_plup("../data/test.gap.sorted.mpileup", settings);
+  num_success += check_matches_plup("../data/test.indel.mpileup", settings);
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,69 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include "../src/call_consensus_pileup.h"
+
+std::vector<std::string> read_lines(std::string path){
+  std::ifstream in(path);
+  std::vector<std::string> lines;
+  std::string l;
+  while (std::getline(in, l)) {
+    lines.push_back(l);
+  }
+  return lines;
+}
+
+/*
+  test.contigs.mpileup has the pileup of test.gap.sorted.mpileup twice, on seg1 and on seg2
+  shifted by 1000 bases. Both records must match the consensus of the single reference.
+*/
+int check_contigs(std::string seq_id, char gap, bool min_coverage_flag, unsigned int nthreads){
+  int num_success = 0;
+  std::ifstream single_mplp("../data/test.gap.sorted.mpileup");
+  call_consensus_from_plup(single_mplp, seq_id, "../data/test.contigs_single", 20, 0, 0, gap, min_coverage_flag);
+  std::ifstream mplp("../data/test.contigs.mpileup");
+  call_consensus_from_plup(mplp, seq_id, "../data/test.contigs", 20, 0, 0, gap, min_coverage_flag, nthreads);
+
+  std::vector<std::string> single = read_lines("../data/test.contigs_single.fa"), single_qual = read_lines("../data/test.contigs_single.qual.txt");
+  std::vector<std::string> fa = read_lines("../data/test.contigs.fa"), qual = read_lines("../data/test.contigs.qual.txt");
+  std::string hdr = seq_id.empty() ? ">Consensus_test.contigs_threshold_0_quality_20" : ">" + seq_id;
+  std::string single_hdr = seq_id.empty() ? ">Consensus_test.contigs_single_threshold_0_quality_20" : ">" + seq_id;
+
+  if (single.size() != 2 || single[0] != single_hdr || single_qual.size() != 1) {
+    std::cout << "Single reference output changed" << std::endl;
+    return -1;
+  }
+
+  if (fa.size() != 4 || qual.size() != 2) {
+    std::cout << "Expected 2 records. Got " << fa.size() / 2 << std::endl;
+    return -1;
+  }
+
+  if (fa[0] != hdr + "_seg1" || fa[2] != hdr + "_seg2") {
+    std::cout << "Headers " << fa[0] << " " << fa[2] << std::endl;
+    num_success -= 1;
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    if (fa[2 * i + 1] != single[1] || qual[i] != single_qual[0]) {
+      std::cout << "Record " << i << " does not match the single reference" << std::endl;
+      num_success -= 1;
+    }
+  }
+
+  return num_success;
+}
+
+int main() {
+  int num_success = 0;
+  num_success += check_contigs("", 'N', true, 1);
+  num_success += check_contigs("", '-', true, 4);
+  num_success += check_contigs("TESTID", 'N', false, 1);
+  num_success += check_contigs("TESTID", 'N', true, 3);
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,98 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include "../src/call_consensus_pileup.h"
+#include "../src/allele_functions.h"
+
+double thresholds[] = {0, 0.1, 0.25, 0.3, 0.5, 0.6, 0.75, 0.9, 1};
+int fast_columns = 0;
+
+// count_bases() and get_consensus_base() must give the same base and quality as get_consensus_allele()
+int check_column(char ref, std::string bases, std::string qualities, uint8_t min_qual, char gap){
+  base_counts counts;
+  if (!count_bases(ref, bases, qualities, min_qual, counts))
+    return 0;
+  fast_columns++;
+  std::vector<allele> ad = update_allele_depth(ref, bases, qualities, min_qual);
+  int num_success = 0;
+  for (int i = 0; i < 9; ++i) {
+    ret_t t = get_consensus_allele(ad, min_qual, thresholds[i], gap);
+    char nuc, q;
+    int len = get_consensus_base(counts, min_qual, thresholds[i], gap, nuc, q);
+    std::string fast_nuc(len, nuc), fast_q(len, q);
+    if (fast_nuc != t.nuc || fast_q != t.q) {
+      std::cout << ref << " " << bases << " " << qualities << " " << thresholds[i] << ": " << fast_nuc << " " << fast_q << " != " << t.nuc << " " << t.q << std::endl;
+      num_success -= 1;
+    }
+  }
+  return num_success;
+}
+
+int check_pileup(std::string path, uint8_t min_qual){
+  std::ifstream mplp(path);
+  std::string line, cell;
+  int num_success = 0;
+  while (std::getline(mplp, line)) {
+    std::stringstream lineStream(line);
+    std::vector<std::string> cells;
+    while (std::getline(lineStream, cell, '\t')) {
+      cells.push_back(cell);
+    }
+    cells.resize(6);
+    num_success += check_column(cells[2][0], cells[4], cells[5], min_qual, 'N');
+  }
+  return num_success;
+}
+
+// Random columns with ties, deletions, reference skips and low quality bases
+int check_random(uint8_t min_qual){
+  const char symbols[] = ".,ACGTNacgtn**><";
+  uint32_t seed = 12345;
+  int num_success = 0;
+  for (int c = 0; c < 20000; ++c) {
+    std::string bases, qualities;
+    seed = seed * 1103515245 + 12345;
+    int n = (seed >> 16) % 12;
+    for (int i = 0; i < n; ++i) {
+      seed = seed * 1103515245 + 12345;
+      uint32_t r = seed >> 16;
+      if (r % 13 == 0)
+        bases += "^]";
+      bases += symbols[r % 16];
+      if ((r >> 4) % 11 == 0)
+        bases += "-2AC";
+      if ((r >> 4) % 17 == 0)
+        bases += '$';
+      qualities += (char) (33 + (r >> 8) % 40);
+    }
+    num_success += check_column("ACGTN"[c % 5], bases, qualities, min_qual, (c % 2) ? 'N' : '-');
+  }
+  return num_success;
+}
+
+int main() {
+  int num_success = 0;
+  num_success += check_pileup("../data/test.gap.sorted.mpileup", 20);
+  num_success += check_pileup("../data/test.gap.sorted.mpileup", 0);
+  num_success += check_pileup("../data/test.indel.mpileup", 20);
+  num_success += check_random(20);
+  num_success += check_random(0);
+  num_success += check_column('A', "", "", 20, 'N');
+  num_success += check_column('A', "..,,TTtt", "IIIIIIII", 20, 'N');
+  num_success += check_column('A', "..**", "IIII", 20, '-');
+  num_success += check_column('A', "**", "II", 20, '-');
+  num_success += check_column('A', ".-3ACG", "!", 20, '-');
+  num_success += check_column('A', "><", "II", 20, 'N');
+  // Insertions and other bases are left to get_consensus_allele()
+  base_counts counts;
+  if (count_bases('A', "..+2AC", "II", 20, counts) || count_bases('A', "RR", "II", 20, counts))
+    num_success -= 1;
+  if (fast_columns < 1000)
+    num_success -= 1;
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,55 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include "../src/call_consensus_pileup.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+// Every setting of a single pass must match a run with only that setting
+int check_settings(std::vector<consensus_setting> settings, char gap, bool min_coverage_flag, unsigned int nthreads){
+  int num_success = 0;
+  std::string path = "../data/test.gap.sorted.mpileup";
+  std::ifstream mplp(path);
+  call_consensus_from_plup(mplp, "TESTID", "../data/test.multi", 20, settings, gap, min_coverage_flag, nthreads);
+  for (std::vector<consensus_setting>::iterator it = settings.begin(); it != settings.end(); ++it) {
+    std::ifstream single_mplp(path);
+    call_consensus_from_plup(single_mplp, "TESTID", "../data/test.single", 20, it->threshold, it->min_depth, gap, min_coverage_flag);
+    std::string multi = get_consensus_out_file("../data/test.multi", *it, settings.size() > 1);
+    if (read_file(multi + ".fa") != read_file("../data/test.single.fa") || read_file(multi + ".qual.txt") != read_file("../data/test.single.qual.txt")) {
+      std::cout << multi << " does not match a single run" << std::endl;
+      num_success -= 1;
+    }
+    if (read_file(multi + ".fa").empty())
+      num_success -= 1;
+  }
+  return num_success;
+}
+
+int main() {
+  int num_success = 0;
+  std::vector<consensus_setting> settings;
+  double thresholds[] = {0, 0.5, 0.75, 0.9};
+  int depths[] = {0, 10};
+  for (int t = 0; t < 4; ++t) {
+    for (int m = 0; m < 2; ++m) {
+      settings.push_back(consensus_setting(thresholds[t], depths[m]));
+    }
+  }
+  num_success += check_settings(settings, 'N', true, 1);
+  num_success += check_settings(settings, '-', false, 4);
+  if (get_consensus_out_file("../data/test", consensus_setting(0.5, 10), true) != "../data/test_t0.5_m10" || get_consensus_out_file("../data/test", consensus_setting(0.5, 10), false) != "../data/test")
+    num_success -= 1;
+  // One setting keeps the old file names
+  num_success += check_settings(std::vector<consensus_setting>(1, consensus_setting(0.5, 10)), 'N', true, 1);
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,61 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "../src/fastq_reader.h"
+#include "../src/bgzf_stream.h"
+
+std::string get_line(const fastq_batch &batch, size_t rec, int l){
+  return std::string(batch.line(rec, l), batch.line_length(rec, l));
+}
+
+int main() {
+  int num_success = 0;
+  std::string long_seq(100000, 'A'), content;
+  content = "@read1\nACGT\n+\nIIII\n@read2\n" + long_seq + "\n+read2\n" + std::string(long_seq.length(), 'I') + "\n@read3\nGG\n+\nII";
+  std::ofstream fq("../data/test.reader.fastq");
+  fq << content;
+  fq.close();
+
+  // Records across reads from the file and a last line without a newline
+  fastq_reader reader;
+  fastq_batch batch;
+  if (reader.open("../data/test.reader.fastq") != 0)
+    num_success -= 1;
+  if (reader.read(batch, 2) != 2 || get_line(batch, 0, 0) != "@read1" || get_line(batch, 0, 3) != "IIII" || get_line(batch, 1, 1) != long_seq || get_line(batch, 1, 2) != "+read2") {
+    std::cout << "First batch does not match" << std::endl;
+    num_success -= 1;
+  }
+  if (reader.read(batch, 2) != 1 || get_line(batch, 0, 0) != "@read3" || get_line(batch, 0, 3) != "II") {
+    std::cout << "Last record does not match" << std::endl;
+    num_success -= 1;
+  }
+  if (reader.read(batch, 2) != 0 || batch.size() != 0 || reader.truncated())
+    num_success -= 1;
+  reader.close();
+
+  // Bgzipped input gives the same records
+  bgzf_ostream gz;
+  gz.open("../data/test.reader.fastq.gz");
+  gz << content << "\n";
+  gz.close();
+  reader.open("../data/test.reader.fastq.gz", 2);
+  if (reader.read(batch, 10) != 3 || get_line(batch, 1, 1) != long_seq || get_line(batch, 2, 1) != "GG") {
+    std::cout << "Bgzipped batch does not match" << std::endl;
+    num_success -= 1;
+  }
+  reader.close();
+
+  // Partial record at the end of the file
+  fq.open("../data/test.reader.fastq");
+  fq << "@read1\nACGT\n+\nIIII\n@read2\nACGT\n";
+  fq.close();
+  reader.open("../data/test.reader.fastq");
+  if (reader.read(batch, 10) != 1 || get_line(batch, 0, 1) != "ACGT" || !reader.truncated())
+    num_success -= 1;
+  reader.close();
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
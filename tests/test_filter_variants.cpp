@@ -0,0 +1,121 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "../src/get_common_variants.h"
+
+const std::string header = "REGION\tPOS\tREF\tALT\tREF_DP\tREF_RV\tREF_QUAL\tALT_DP\tALT_RV\tALT_QUAL\tALT_FREQ\tTOTAL_DP\tPVAL\tPASS\tGFF_FEATURE\tREF_CODON\tREF_AA\tALT_CODON\tALT_AA\n";
+
+std::string row(std::string region, int pos, std::string ref, std::string alt, int alt_dp, std::string feature){
+  std::ostringstream r;
+  r << region << "\t" << pos << "\t" << ref << "\t" << alt << "\t10\t2\t35\t" << alt_dp << "\t1\t36\t0.5\t" << 10 + alt_dp << "\t0.01\tTRUE\t" << feature << "\tNA\tNA\tNA\tNA\n";
+  return r.str();
+}
+
+void write_file(std::string path, std::string content){
+  std::ofstream out(path);
+  out << header << content;
+}
+
+std::vector<std::string> read_rows(std::string path){
+  std::ifstream in(path);
+  std::vector<std::string> rows;
+  std::string line;
+  std::getline(in, line);
+  while (std::getline(in, line)) {
+    rows.push_back(line);
+  }
+  return rows;
+}
+
+// Rows of the filtered output as the previous version built them, from read_variant_file()
+std::vector<std::string> expected_rows(char* files[], unsigned int nfiles, double min_threshold){
+  std::map<std::string, unsigned int> counts;
+  std::map<std::string, std::string> values;
+  for (unsigned int i = 0; i < nfiles; ++i) {
+    std::ifstream fin(files[i]);
+    read_variant_file(fin, i, counts, values);
+  }
+  std::vector<std::string> rows;
+  for (std::map<std::string, unsigned int>::iterator it = counts.begin(); it != counts.end(); ++it) {
+    if (((float)it->second)/(float)nfiles < min_threshold)
+      continue;
+    std::string r = it->first;
+    for (unsigned int j = 0; j < nfiles; ++j) {
+      std::map<std::string, std::string>::iterator v = values.find(it->first + std::to_string(j));
+      r += (v == values.end()) ? "NA\tNA\tNA\tNA\tNA\tNA\tNA\tNA\tNA\tNA" : v->second;
+      if (j < nfiles - 1)
+        r += "\t";
+    }
+    rows.push_back(r);
+  }
+  return rows;
+}
+
+int check_filter(char* files[], unsigned int nfiles, double min_threshold, std::vector<std::string> order){
+  int num_success = 0;
+  common_variants("../data/test.filter_out", min_threshold, files, nfiles);
+  std::vector<std::string> rows = read_rows("../data/test.filter_out.tsv"), expected = expected_rows(files, nfiles, min_threshold);
+  // Rows are in position order
+  if (rows.size() != order.size()) {
+    std::cout << "Expected " << order.size() << " rows. Got " << rows.size() << std::endl;
+    return -1;
+  }
+  for (unsigned int i = 0; i < rows.size(); ++i) {
+    if (rows[i].compare(0, order[i].size(), order[i]) != 0) {
+      std::cout << "Row " << i << ": " << rows[i] << std::endl;
+      num_success -= 1;
+    }
+  }
+  // Same rows as before
+  std::sort(rows.begin(), rows.end());
+  if (rows != expected) {
+    std::cout << "Rows do not match the rows of the previous version" << std::endl;
+    num_success -= 1;
+  }
+  return num_success;
+}
+
+int main() {
+  int num_success = 0;
+  write_file("../data/test.filter.1.tsv", row("seg1", 10, "A", "T", 3, "NA") + row("seg1", 10, "A", "G", 4, "NA") + row("seg1", 50, "G", "+AA", 5, "NA") + row("seg2", 5, "T", "C", 6, "id-b") + row("seg2", 5, "T", "C", 6, "id-a"));
+  write_file("../data/test.filter.2.tsv", row("seg2", 5, "T", "C", 7, "id-b") + row("seg2", 7, "G", "A", 8, "NA"));
+  write_file("../data/test.filter.3.tsv", row("seg1", 2, "A", "C", 1, "NA") + row("seg1", 10, "A", "G", 9, "NA") + row("seg2", 5, "T", "C", 2, "id-a") + row("seg3", 1, "A", "C", 2, "NA"));
+  write_file("../data/test.filter.unsorted.tsv", row("seg1", 10, "A", "G", 4, "NA") + row("seg1", 2, "A", "C", 1, "NA"));
+
+  char f1[] = "../data/test.filter.1.tsv", f2[] = "../data/test.filter.2.tsv", f3[] = "../data/test.filter.3.tsv", unsorted[] = "../data/test.filter.unsorted.tsv";
+  char* files[] = {f1, f2, f3};
+
+  std::vector<std::string> all;
+  all.push_back("seg1\t2\tA\tC\t");
+  all.push_back("seg1\t10\tA\tG\t");
+  all.push_back("seg1\t10\tA\tT\t");
+  all.push_back("seg1\t50\tG\t+AA\t");
+  all.push_back("seg2\t5\tT\tC\tid-a\t");
+  all.push_back("seg2\t5\tT\tC\tid-b\t");
+  all.push_back("seg2\t7\tG\tA\t");
+  all.push_back("seg3\t1\tA\tC\t");
+  num_success += check_filter(files, 3, 0, all);
+
+  std::vector<std::string> common;
+  common.push_back("seg1\t10\tA\tG\t");
+  common.push_back("seg2\t5\tT\tC\tid-a\t");
+  common.push_back("seg2\t5\tT\tC\tid-b\t");
+  num_success += check_filter(files, 3, 0.5, common);
+
+  // Files that start in a later region
+  char* reversed[] = {f2, f3, f1};
+  num_success += check_filter(reversed, 3, 0, all);
+
+  char* with_unsorted[] = {f1, unsorted};
+  if (common_variants("../data/test.filter_out", 0, with_unsorted, 2) != -1)
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,76 @@
+#include<iostream>
+#include<string>
+#include<vector>
+#include "../src/ref_seq.h"
+
+// Indexed queries must return the same features, in the same order, as a scan of the GFF
+int check_query(gff3 &gff, std::string seqid, uint64_t pos, std::string type){
+  const std::vector<gff3_feature> &features = gff.get_features();
+  std::vector<const gff3_feature*> expected, res;
+  for (std::vector<gff3_feature>::const_iterator it = features.begin(); it != features.end(); ++it) {
+    if (it->get_type() == type && (seqid.empty() || it->get_seqid() == seqid) && pos >= it->get_start() && pos <= it->get_end())
+      expected.push_back(&(*it));
+  }
+  res = seqid.empty() ? gff.query_features(pos, type) : gff.query_features(seqid, pos, type);
+  if (res != expected) {
+    std::cout << seqid << ":" << pos << " " << type << " Expected: " << expected.size() << " Res: " << res.size() << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int check_attribute(const gff3_feature &f, std::string key, std::string expected){
+  if (f.get_attribute(key) != expected) {
+    std::cout << key << " Expected: " << expected << " Res: " << f.get_attribute(key) << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  std::string seqids[] = {"", "contig1", "contig2", "missing"};
+  std::string types[] = {"CDS", "gene", "missing"};
+  gff3 gff("../data/test_multi.gff");
+  for (int s = 0; s < 4; ++s) {
+    for (int t = 0; t < 3; ++t) {
+      for (uint64_t pos = 0; pos <= 20; ++pos) {
+        num_success += check_query(gff, seqids[s], pos, types[t]);
+      }
+    }
+  }
+  gff3 viral("../data/test.gff");
+  for (uint64_t pos = 0; pos <= 2000; ++pos) {
+    num_success += check_query(viral, "test", pos, "CDS");
+    num_success += check_query(viral, "", pos, "CDS");
+  }
+  if (!gff.has_seqid("contig2") || gff.has_seqid("missing") || gff.get_count() != 5)
+    num_success -= 1;
+  // Attributes
+  const std::vector<gff3_feature> &features = gff.get_features();
+  num_success += check_attribute(features[0], "ID", "c1a");
+  num_success += check_attribute(features[0], "Name", "first");
+  num_success += check_attribute(features[2], "ID", "c1b");
+  num_success += check_attribute(features[2], "Note", "Note");
+  num_success += check_attribute(features[2], "missing", "");
+  if (features[3].get_seqid() != "contig2" || features[3].get_start() != 2 || features[3].get_end() != 10 || features[3].get_phase() != 0)
+    num_success -= 1;
+  // CDS only annotate the contig they are on
+  ref_antd refantd("../data/db/test_multi_ref.fa", "../data/test_multi.gff");
+  std::ostringstream line, out;
+  refantd.codon_aa_stream("contig2", line, out, 2, 'A');
+  if (out.str() != "c2a\tTTT\tF\tATT\tI\n") {
+    std::cout << "contig2 Res: " << out.str();
+    num_success -= 1;
+  }
+  out.str("");
+  refantd.codon_aa_stream("contig1", line, out, 5, 'A');
+  if (out.str() != "c1a\tTAC\tY\tTAC\tY\nc1b\tTAC\tY\tTAC\tY\n") {
+    std::cout << "contig1 Res: " << out.str();
+    num_success -= 1;
+  }
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../src/libivar.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+int main() {
+  int num_success = 0;
+
+  // References are loaded once per path
+  reference_store refs;
+  ref_antd &refantd = refs.get("../data/db/test_ref.fa", "../data/test.gff");
+  if (&refs.get("../data/db/test_ref.fa", "../data/test.gff") != &refantd || refs.size() != 1)
+    num_success -= 1;
+
+  // Variants written to a stream match the tsv of ivar variants, with one and several threads
+  std::ifstream mplp("../data/test.indel.mpileup");
+  call_variants_from_plup(mplp, "../data/test.libivar", 20, 0.03, 0, "../data/db/test_ref.fa", "../data/test.gff");
+  std::string expected = read_file("../data/test.libivar.tsv");
+  for (unsigned int nthreads = 1; nthreads <= 4; nthreads += 3) {
+    variant_caller caller(refantd, 20, 0.03, 0, nthreads);
+    std::ifstream in("../data/test.indel.mpileup");
+    std::ostringstream out;
+    if (caller.call_pileup(in, out) != 0 || out.str() != expected || expected.empty()) {
+      std::cout << "Variants with " << nthreads << " threads do not match ivar variants" << std::endl;
+      num_success -= 1;
+    }
+  }
+
+  // One consensus caller used for two samples gives the files of ivar consensus each time
+  std::vector<consensus_setting> settings;
+  settings.push_back(consensus_setting(0, 10));
+  settings.push_back(consensus_setting(0.75, 0));
+  std::ifstream gap_mplp("../data/test.gap.sorted.mpileup");
+  call_consensus_from_plup(gap_mplp, "", "../data/test.libivar", 20, settings, 'N', true);
+  consensus_caller consensus(settings);
+  for (int sample = 0; sample < 2; ++sample) {
+    std::ifstream in("../data/test.gap.sorted.mpileup");
+    std::vector<std::ostringstream> seqs(settings.size()), quals(settings.size());
+    std::vector<std::ostream*> fout, qout;
+    for (size_t i = 0; i < settings.size(); ++i) {
+      fout.push_back(&seqs[i]);
+      qout.push_back(&quals[i]);
+    }
+    if (consensus.call_pileup(in, "../data/test.libivar", fout, qout) != 0)
+      num_success -= 1;
+    for (size_t i = 0; i < settings.size(); ++i) {
+      std::string out_file = get_consensus_out_file("../data/test.libivar", settings[i], true);
+      if (seqs[i].str() != read_file(out_file + ".fa") || quals[i].str() != read_file(out_file + ".qual.txt") || seqs[i].str().empty()) {
+        std::cout << "Consensus of " << out_file << " does not match ivar consensus" << std::endl;
+        num_success -= 1;
+      }
+    }
+    if (consensus.get_stats().size() != settings.size() || consensus.get_stats()[0].total_bases == 0)
+      num_success -= 1;
+  }
+
+  // Primer scheme with amplicons
+  primer_scheme scheme;
+  if (scheme.load("../data/test_isize.bed", "../data/pair_info_2.tsv") != 0 || scheme.get_primers().size() != populate_from_file("../data/test_isize.bed").size() || !scheme.has_amplicons())
+    num_success -= 1;
+  read_trimmer trimmer(scheme, trim_settings());
+  if (trimmer.get_stats().primer_counts.size() != scheme.get_primers().size())
+    num_success -= 1;
+  if (scheme.load("../data/test.missing.bed") != -1)
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,174 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include<vector>
+#include<thread>
+#include<chrono>
+#include<cstdio>
+#include<unistd.h>
+#include "../src/call_consensus_pileup.h"
+#include "../src/live_consensus.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+// Sequences of a FASTA file without the headers
+std::string read_sequences(std::string path){
+  std::ifstream in(path);
+  std::string line, seqs;
+  while (std::getline(in, line)) {
+    if (line[0] != '>')
+      seqs += line + "\n";
+  }
+  return seqs;
+}
+
+// Split the reads of every pileup line in two, as if they came from two batches of reads
+void split_pileup(std::string path, std::string &first, std::string &second){
+  std::ifstream mplp(path);
+  std::string line, cell;
+  while (std::getline(mplp, line)) {
+    std::stringstream lineStream(line);
+    std::vector<std::string> cells;
+    while (std::getline(lineStream, cell, '\t')) {
+      cells.push_back(cell);
+    }
+    cells.resize(6);
+    std::string b[2], q[2];
+    size_t i = 0, q_ind = 0;
+    int k = 0;
+    while (i < cells[4].length()) {
+      size_t start = i;
+      if (cells[4][i] == '^')
+        i += 2;
+      i++;
+      if (i < cells[4].length() && (cells[4][i] == '+' || cells[4][i] == '-')) {
+        size_t j = i + 1;
+        while (isdigit(cells[4][j])) j++;
+        i = j + std::stoi(cells[4].substr(i + 1, j - i - 1));
+      }
+      if (i < cells[4].length() && cells[4][i] == '$')
+        i++;
+      b[k] += cells[4].substr(start, i - start);
+      q[k] += cells[5][q_ind++];
+      k = 1 - k;
+    }
+    int depth = std::stoi(cells[3]);
+    first += cells[0] + "\t" + cells[1] + "\t" + cells[2] + "\t" + std::to_string(depth - depth / 2) + "\t" + b[0] + "\t" + q[0] + "\n";
+    second += cells[0] + "\t" + cells[1] + "\t" + cells[2] + "\t" + std::to_string(depth / 2) + "\t" + b[1] + "\t" + q[1] + "\n";
+  }
+}
+
+int add_lines(live_consensus &live, std::string lines){
+  std::istringstream in(lines);
+  std::string line;
+  int n = 0;
+  while (std::getline(in, line)) {
+    live.add_line(line);
+    n++;
+  }
+  return n;
+}
+
+// Two batches of reads added to a live consensus must give the consensus of the whole pileup
+int check_batches(std::string path, std::vector<consensus_setting> settings, char gap, bool min_coverage_flag){
+  int num_success = 0;
+  std::ifstream mplp(path);
+  call_consensus_from_plup(mplp, "", "../data/test.live_full", 20, settings, gap, min_coverage_flag);
+
+  std::string first, second;
+  split_pileup(path, first, second);
+  live_consensus live("", "../data/test.live", 20, settings, gap, min_coverage_flag);
+  int n = add_lines(live, first);
+  if (live.write_snapshot() != n || live.write_snapshot() != 0) {	// Nothing changed in the second snapshot
+    std::cout << path << " snapshot did not update every position once" << std::endl;
+    num_success -= 1;
+  }
+  add_lines(live, second);
+  live.write_snapshot();
+
+  for (size_t i = 0; i < settings.size(); ++i) {
+    std::string full = get_consensus_out_file("../data/test.live_full", settings[i], settings.size() > 1), out = get_consensus_out_file("../data/test.live", settings[i], settings.size() > 1);
+    if (read_sequences(out + ".fa") != read_sequences(full + ".fa") || read_file(out + ".qual.txt") != read_file(full + ".qual.txt")) {
+      std::cout << path << " " << out << " does not match the consensus of the whole pileup" << std::endl;
+      num_success -= 1;
+    }
+  }
+  return num_success;
+}
+
+int main() {
+  int num_success = 0;
+  std::vector<consensus_setting> settings;
+  settings.push_back(consensus_setting(0, 0));
+  num_success += check_batches("../data/test.gap.sorted.mpileup", settings, 'N', true);
+  num_success += check_batches("../data/test.indel.mpileup", settings, 'N', true);
+  num_success += check_batches("../data/test.contigs.mpileup", settings, '-', false);
+  settings.push_back(consensus_setting(0.5, 10));
+  settings.push_back(consensus_setting(0.9, 10));
+  num_success += check_batches("../data/test.gap.sorted.mpileup", settings, 'N', true);
+  num_success += check_batches("../data/test.indel.mpileup", settings, '-', false);
+
+  // Batches separated by empty lines through the command
+  std::string first, second;
+  split_pileup("../data/test.gap.sorted.mpileup", first, second);
+  std::istringstream in(first + "\n" + second);
+  call_consensus_live(in, "TESTID", "../data/test.live", 20, std::vector<consensus_setting>(1, consensus_setting(0, 0)), 'N', true, 0);
+  std::ifstream mplp("../data/test.gap.sorted.mpileup");
+  call_consensus_from_plup(mplp, "TESTID", "../data/test.live_full", 20, 0, 0, 'N', true);
+  if (read_file("../data/test.live.fa") != read_file("../data/test.live_full.fa"))
+    num_success -= 1;
+
+  // Malformed lines and positions past the limit are rejected and skipped by the command
+  live_consensus bad("TESTID", "../data/test.live_bad", 20, std::vector<consensus_setting>(1, consensus_setting(0, 0)), 'N', true);
+  const char *malformed[] = {"ref\tx\tA\t1\t.\tI", "ref\t10x\tA\t1\t.\tI", "ref\t\tA\t1\t.\tI", "ref\t0\tA\t1\t.\tI", "ref\t-5\tA\t1\t.\tI",
+                             "ref\t10\tA\tx\t.\tI", "ref\t10\tA\t1y\t.\tI", "ref\t10\tA\t-1\t.\tI", "ref\t99999999999999999999\tA\t1\t.\tI",
+                             "ref\t10000001\tA\t1\t.\tI", "ref\t10\tA\t4294967296\t.\tI"};
+  for (size_t i = 0; i < sizeof(malformed) / sizeof(malformed[0]); ++i) {
+    if (bad.add_line(malformed[i]) != -1) {
+      std::cout << "Accepted malformed line: " << malformed[i] << std::endl;
+      num_success -= 1;
+    }
+  }
+  if (bad.get_changed_count() != 0 || bad.add_line("ref\t10\tA\t1\t.\tI") != 0)
+    num_success -= 1;
+  std::istringstream in_bad(first + "ref\tx\tA\t1\t.\tI\nref\t1000000000\tA\t1\t.\tI\n\n" + second);
+  call_consensus_live(in_bad, "TESTID", "../data/test.live_bad", 20, std::vector<consensus_setting>(1, consensus_setting(0, 0)), 'N', true, 0);
+  if (read_file("../data/test.live_bad.fa") != read_file("../data/test.live_full.fa"))
+    num_success -= 1;
+
+  // Snapshots are written every interval while the input is idle
+  int fds[2];
+  if (pipe(fds) != 0)
+    return -1;
+  std::remove("../data/test.live_pipe.fa");
+  std::thread reader([&fds]() {
+      call_consensus_live(fds[0], "TESTID", "../data/test.live_pipe", 20, std::vector<consensus_setting>(1, consensus_setting(0, 0)), 'N', true, 0.1);
+    });
+  if (write(fds[1], first.c_str(), first.size()) != (ssize_t) first.size())
+    num_success -= 1;
+  for (int i = 0; i < 100 && read_file("../data/test.live_pipe.fa").empty(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  if (read_file("../data/test.live_pipe.fa").empty()) {
+    std::cout << "No snapshot while the input is idle" << std::endl;
+    num_success -= 1;
+  }
+  if (write(fds[1], second.c_str(), second.size()) != (ssize_t) second.size())
+    num_success -= 1;
+  close(fds[1]);
+  reader.join();
+  close(fds[0]);
+  if (read_file("../data/test.live_pipe.fa") != read_file("../data/test.live_full.fa"))
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,68 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include "../src/call_consensus_pileup.h"
+#include "../src/call_variants.h"
+#include "../src/ordered_pool.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// Blocks must reassemble to the input for any block size
+int check_line_blocks(std::string path, size_t block_size){
+  std::ifstream in(path);
+  std::string block, carry, joined;
+  while (read_line_block(in, block, carry, block_size)) {
+    if (block[block.size() - 1] != '\n')
+      return -1;
+    joined += block;
+  }
+  return joined.compare(read_file(path));
+}
+
+// Repeat input so that it spans several blocks
+std::string repeat_file(std::string path, int n){
+  std::string content = read_file(path), out;
+  for (int i = 0; i < n; ++i)
+    out += content;
+  return out;
+}
+
+// Outputs with several threads must match one thread
+int check_consensus(std::string path, std::string prefix, unsigned int nthreads){
+  std::string input = repeat_file(path, 400);
+  std::istringstream serial(input), parallel(input);
+  call_consensus_from_plup(serial, "", prefix, 20, 0, 0, '-', true);
+  std::string fa = read_file(prefix + ".fa"), qual = read_file(prefix + ".qual.txt");
+  call_consensus_from_plup(parallel, "", prefix, 20, 0, 0, '-', true, nthreads);
+  return fa.compare(read_file(prefix + ".fa")) + qual.compare(read_file(prefix + ".qual.txt"));
+}
+
+int check_variants(std::string path, std::string prefix, unsigned int nthreads){
+  std::string input = repeat_file(path, 50000);
+  std::istringstream serial(input), parallel(input);
+  call_variants_from_plup(serial, prefix, 20, 0.02, 0, "../data/db/test_ref.fa", "../data/test.gff");
+  std::string tsv = read_file(prefix + ".tsv");
+  call_variants_from_plup(parallel, prefix, 20, 0.02, 0, "../data/db/test_ref.fa", "../data/test.gff", nthreads);
+  return tsv.compare(read_file(prefix + ".tsv"));
+}
+
+int main() {
+  int num_success = 0;
+  num_success = check_line_blocks("../data/test.gap.sorted.mpileup", 1);
+  num_success += check_line_blocks("../data/test.gap.sorted.mpileup", 100);
+  num_success += check_line_blocks("../data/test.gap.sorted.mpileup", 1 << 20);
+  std::cout << num_success << std::endl;
+  num_success += check_consensus("../data/test.gap.sorted.mpileup", "../data/test.parallel", 4);
+  std::cout << num_success << std::endl;
+  num_success += check_variants("../data/test.indel.mpileup", "../data/test.parallel", 4);
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,182 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "../src/pipeline.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+// Name, position and cigar of every read. Returns -1 if reads are not sorted by coordinate.
+int get_reads(std::string bam, std::vector<std::string> &reads){
+  samFile *in = hts_open(bam.c_str(), "r");
+  if (in == NULL)
+    return -1;
+  bam_hdr_t *header = sam_hdr_read(in);
+  bam1_t *b = bam_init1();
+  int res = 0;
+  int32_t tid = -1;
+  hts_pos_t pos = -1;
+  reads.clear();
+  while (sam_read1(in, header, b) >= 0) {
+    if (b->core.tid < tid || (b->core.tid == tid && b->core.pos < pos))
+      res = -1;
+    tid = b->core.tid;
+    pos = b->core.pos;
+    std::ostringstream read;
+    read << bam_get_qname(b) << "\t" << b->core.pos << "\t";
+    for (uint32_t i = 0; i < b->core.n_cigar; ++i)
+      read << bam_cigar_oplen(bam_get_cigar(b)[i]) << bam_cigar_opchr(bam_get_cigar(b)[i]);
+    reads.push_back(read.str());
+  }
+  bam_destroy1(b);
+  bam_hdr_destroy(header);
+  sam_close(in);
+  return res;
+}
+
+// FASTA or quality file without the header lines
+std::string without_headers(std::string path){
+  std::ifstream in(path);
+  std::string line, seqs;
+  while (std::getline(in, line)) {
+    if (line.empty() || line[0] != '>')
+      seqs += line + "\n";
+  }
+  return seqs;
+}
+
+/*
+  test.gap.sorted.mpileup is the output of `samtools mpileup -A -d 0 -Q 0` on test.gap.sorted.bam.
+  Positions without reads are added as `samtools mpileup -aa` writes them.
+*/
+std::string gap_mpileup_aa(int64_t len){
+  std::ifstream in("../data/test.gap.sorted.mpileup");
+  std::ostringstream aa;
+  std::string line;
+  int64_t next = 1, pos;
+  while (std::getline(in, line)) {
+    pos = std::stoll(line.substr(line.find('\t') + 1));
+    for (; next < pos; ++next) {
+      aa << "test\t" << next << "\tN\t0\t*\t*\n";
+    }
+    aa << line << "\n";
+    next = pos + 1;
+  }
+  for (; next <= len; ++next) {
+    aa << "test\t" << next << "\tN\t0\t*\t*\n";
+  }
+  return aa.str();
+}
+
+// Consensus and its counts match ivar consensus on the mpileup -aa of the reads
+int check_consensus_matches_mpileup(std::string prefix, const pipeline_settings &settings, const pipeline_stats &stats, int64_t len){
+  std::istringstream mplp(gap_mpileup_aa(len));
+  std::ostringstream fa, qual;
+  std::vector<std::ostream*> fout(1, &fa), qout(1, &qual);
+  std::vector<consensus_setting> consensus_settings(1, consensus_setting(settings.consensus_threshold, settings.consensus_min_depth));
+  std::vector<std::string> headers(1, get_consensus_header("", prefix, consensus_settings[0], settings.min_qual));
+  std::vector<consensus_stats> counts;
+  call_consensus_from_plup(mplp, fout, qout, headers, settings.min_qual, consensus_settings, settings.gap, true, counts);
+  if (fa.str() != read_file(prefix + ".fa") || qual.str() != read_file(prefix + ".qual.txt")) {
+    std::cout << prefix << " consensus does not match ivar consensus on mpileup -aa" << std::endl;
+    return -1;
+  }
+  if (counts[0].total_bases != stats.consensus.total_bases || counts[0].bases_zero_depth != stats.consensus.bases_zero_depth || counts[0].bases_min_depth != stats.consensus.bases_min_depth || stats.consensus.total_bases != (uint64_t) len || stats.consensus.bases_zero_depth == 0) {
+    std::cout << prefix << " consensus counts do not match ivar consensus on mpileup -aa" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  primer_scheme scheme;
+  ref_antd refantd("../data/db/test_ref.fa", "../data/test.gff");
+  pipeline_settings settings;
+  pipeline_stats stats;
+  settings.write_trimmed = true;
+  scheme.load("../data/test.bed");
+
+  if (run_pipeline("../data/test.sorted.bam", scheme, refantd, "../data/test.pipeline", settings, "@PG\tID:ivar-pipeline\n", stats) != 0 || stats.reads == 0 || stats.trim.primer_trimmed == 0) {
+    std::cout << "Pipeline failed" << std::endl;
+    num_success -= 1;
+  }
+
+  // Trimmed reads are written sorted and match ivar trim
+  std::vector<std::string> piped, trimmed;
+  trim_stats counts;
+  trim_bam_qual_primer("../data/test.sorted.bam", scheme, "../data/test.pipeline.ivar_trim", "", settings.trim, "@PG\tID:ivar-trim\n", counts);
+  if (get_reads("../data/test.pipeline.trimmed.bam", piped) != 0) {
+    std::cout << "Trimmed reads are not sorted" << std::endl;
+    num_success -= 1;
+  }
+  get_reads("../data/test.pipeline.ivar_trim.bam", trimmed);
+  std::sort(piped.begin(), piped.end());
+  std::sort(trimmed.begin(), trimmed.end());
+  if (piped.empty() || piped != trimmed || counts.primer_trimmed != stats.trim.primer_trimmed) {
+    std::cout << "Trimmed reads do not match ivar trim" << std::endl;
+    num_success -= 1;
+  }
+
+  // Variants match ivar variants on the trimmed reads, with one and several threads
+  std::string variants = read_file("../data/test.pipeline.tsv");
+  call_variants_from_bam("../data/test.pipeline.trimmed.bam", "../data/test.pipeline.direct", 20, 0.03, 0, "../data/db/test_ref.fa", "../data/test.gff", pileup_opts());
+  if (variants.empty() || variants != read_file("../data/test.pipeline.direct.tsv")) {
+    std::cout << "Variants do not match ivar variants" << std::endl;
+    num_success -= 1;
+  }
+  settings.nthreads = 4;
+  settings.write_trimmed = false;
+  run_pipeline("../data/test.sorted.bam", scheme, refantd, "../data/test.pipeline.threads", settings, "", stats);
+  if (read_file("../data/test.pipeline.threads.tsv") != variants || without_headers("../data/test.pipeline.threads.fa") != without_headers("../data/test.pipeline.fa") || read_file("../data/test.pipeline.threads.qual.txt") != read_file("../data/test.pipeline.qual.txt")) {
+    std::cout << "Output with threads does not match" << std::endl;
+    num_success -= 1;
+  }
+  if (std::ifstream("../data/test.pipeline.threads.trimmed.bam").good())
+    num_success -= 1;
+
+  // Consensus counts every position of the reference
+  int64_t ref_len = refantd.get_region_length(refantd.get_region_id("test"));
+  if (stats.consensus.total_bases != (uint64_t) ref_len || without_headers("../data/test.pipeline.fa").size() != (size_t) ref_len + 1 || read_file("../data/test.pipeline.fa").find(">Consensus_test.pipeline") == std::string::npos || read_file("../data/test.pipeline.qual.txt").size() != (size_t) ref_len + 1) {
+    std::cout << "Consensus does not cover the reference" << std::endl;
+    num_success -= 1;
+  }
+
+  // Same consensus as ivar consensus on mpileup -aa, including the positions before, between and
+  // after the reads. Without primers and quality trimming the trimmed reads are the input reads.
+  primer_scheme no_primers;
+  ref_antd no_ref("");
+  pipeline_settings untrimmed;
+  untrimmed.trim.min_qual = 0;
+  untrimmed.trim.min_length = 0;
+  samFile *gap_in = hts_open("../data/test.gap.sorted.bam", "r");
+  bam_hdr_t *gap_header = sam_hdr_read(gap_in);
+  int64_t gap_len = sam_hdr_tid2len(gap_header, 0);
+  bam_hdr_destroy(gap_header);
+  sam_close(gap_in);
+  for (unsigned int nthreads = 1; nthreads <= 4; nthreads += 3) {
+    untrimmed.nthreads = nthreads;
+    std::string prefix = "../data/test.pipeline.gap" + std::to_string(nthreads);
+    if (run_pipeline("../data/test.gap.sorted.bam", no_primers, no_ref, prefix, untrimmed, "", stats) != 0 || stats.trim.low_quality != 0) {
+      std::cout << "Pipeline failed on test.gap.sorted.bam" << std::endl;
+      num_success -= 1;
+      continue;
+    }
+    num_success += check_consensus_matches_mpileup(prefix, untrimmed, stats, gap_len);
+  }
+
+  if (run_pipeline("../data/test.pipeline.missing.bam", scheme, refantd, "../data/test.pipeline.missing", settings, "", stats) != -1)
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -4,7 +4,7 @@
 #include "../src/primer_bed.h"
 
 int main(){
-  int num_tests = 2;
+  int num_tests = 4;
   int success = 0;
   std::vector<primer>::iterator it;
   std::vector<primer> primers = populate_from_file("../data/test.bed");
@@ -37,5 +37,40 @@ int main(){
     }
   }
   success += flag;
+  // Mask agrees with get_primer_indice() for every primer
+  std::vector<std::string> masked;
+  masked.push_back("WNV_400_2_LEFT");
+  masked.push_back("WNV_400_3_LEFT");
+  masked.push_back("NOT_A_PRIMER");
+  std::vector<bool> mask = get_primer_mask(primers, masked);
+  flag = (mask.size() == primers.size()) ? 1 : 0;
+  for(it = primers.begin(); it != primers.end() && flag; ++it) {
+    bool expected = it->get_name() == "WNV_400_2_LEFT" || it->get_name() == "WNV_400_3_LEFT";
+    if(mask[get_primer_indice(primers, it->get_name())] != expected){
+      std::cout << "Wrong mask for " << it->get_name() << std::endl;
+      flag = 0;
+    }
+  }
+  success += flag;
+  // Index finds the same primers as get_primers()
+  primer_index index(primers);
+  std::vector<int> overlapping;
+  flag = 1;
+  for(unsigned int pos = 0; pos < 800; ++pos) {
+    std::vector<primer> expected = get_primers(primers, pos);
+    index.get_primers(pos, overlapping);
+    if(overlapping.size() != expected.size()){
+      std::cout << "Wrong primers at " << pos << std::endl;
+      flag = 0;
+      continue;
+    }
+    for(unsigned int i = 0; i < expected.size(); ++i) {
+      if(primers[overlapping[i]].get_name() != expected[i].get_name()){
+        std::cout << "Wrong primers at " << pos << std::endl;
+        flag = 0;
+      }
+    }
+  }
+  success += flag;
   return (num_tests == success) ? 0 : -1;
 }
@@ -0,0 +1,39 @@
+#include<iostream>
+#include<string>
+#include "../src/ref_seq.h"
+
+int check_base(ref_antd &refantd, int64_t pos, std::string region, char expected){
+  char base = refantd.get_base(pos, region);
+  if (base != expected) {
+    std::cout << region << ":" << pos << " Expected: " << (int) expected << " Res: " << (int) base << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  ref_antd refantd("../data/db/test_ref.fa");
+  num_success += check_base(refantd, 1, "test", 'G');
+  num_success += check_base(refantd, 9, "test", 'C');
+  num_success += check_base(refantd, 1, "missing", 0);	// Unknown region
+  num_success += check_base(refantd, 0, "test", 0);	// Outside of reference
+  num_success += check_base(refantd, 100000, "test", 0);
+  // Lines of multiple contigs are joined and contigs are kept apart
+  ref_antd multi("../data/db/test_multi_ref.fa");
+  num_success += check_base(multi, 10, "contig1", 'C');
+  num_success += check_base(multi, 11, "contig1", 'G');
+  num_success += check_base(multi, 16, "contig1", 'A');
+  num_success += check_base(multi, 17, "contig1", 0);
+  num_success += check_base(multi, 1, "contig2", 'T');
+  num_success += check_base(multi, 10, "contig2", 'C');
+  if (multi.get_region_id("contig2") != 1 || multi.get_base(5, multi.get_region_id("contig2")) != 'G')
+    num_success -= 1;
+  // No reference
+  ref_antd empty("");
+  num_success += check_base(empty, 1, "test", 0);
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
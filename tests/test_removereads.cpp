@@ -5,8 +5,22 @@
 
 #include "htslib/sam.h"
 
+// Names of the reads in a BAM file, in file order
+std::vector<std::string> read_names(std::string path){
+  std::vector<std::string> names;
+  samFile *in = hts_open(path.c_str(), "r");
+  bam_hdr_t *header = sam_hdr_read(in);
+  bam1_t *aln = bam_init1();
+  while(sam_read1(in, header, aln) >= 0)
+    names.push_back(bam_get_qname(aln));
+  bam_destroy1(aln);
+  bam_hdr_destroy(header);
+  sam_close(in);
+  return names;
+}
+
 int main(){
-  int num_success = 0, num_tests = 1;
+  int num_success = 0, num_tests = 2;
   std::vector<std::string> amp;
   std::ifstream fin("../data/test.masked_primer_indices.txt");
   std::string s, region = "Consensus_ZI-27_threshold_0_quality_20";
@@ -44,5 +58,17 @@ int main(){
   bam_destroy1(aln);
   bam_hdr_destroy(header);
   sam_close(in);
+  // Single pass from the filtered variants gives the same reads as getmasked and removereads
+  mask_reads_from_variants("../data/test.trimmed.sorted.bam", "../data/test.filtered.tsv", "../data/test.bed", "../data/pair_information.tsv", "../data/test.trimmed.maskreads", "@PG\tID:ivar-maskreads\tPN:ivar\tVN:1.0.0\tCL:ivar maskreads\n\0", 2);
+  get_primers_with_mismatches("../data/test.bed", "../data/test.filtered.tsv", "../data/test.maskreads_primers", "../data/pair_information.tsv");
+  amp.clear();
+  std::ifstream masked("../data/test.maskreads_primers.txt");
+  while(getline(masked, s, '\t' ) ){
+    amp.push_back(s);
+  }
+  rmv_reads_from_amplicon("../data/test.trimmed.sorted.bam", "", "../data/test.trimmed.removereads", amp, "../data/test.bed", "@PG\tID:ivar-removereads\tPN:ivar\tVN:1.0.0\tCL:ivar removereads\n\0");
+  std::vector<std::string> fused = read_names("../data/test.trimmed.maskreads.bam");
+  if(!fused.empty() && fused == read_names("../data/test.trimmed.removereads.bam"))
+    num_success += 1;
   return (num_success == num_tests) ? 0 : 1;
 }
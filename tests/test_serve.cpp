@@ -0,0 +1,177 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/serve.h"
+
+int connect_idle(std::string path){
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd >= 0 && connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::ostringstream s;
+  s << in.rdbuf();
+  return s.str();
+}
+
+int main() {
+  int num_success = 0;
+  job_request req;
+
+  // Flat JSON objects
+  if (parse_job_request("{\"cmd\": \"trim\", \"min_qual\": 20, \"keep_for_reanalysis\": true, \"region\": null, \"prefix\": \"a \\\"b\\\"\\u0041\"}", req) != 0 || req["cmd"] != "trim" || req["min_qual"] != "20" || req["keep_for_reanalysis"] != "true" || req["region"] != "" || req["prefix"] != "a \"b\"A") {
+    std::cout << "Job request not parsed" << std::endl;
+    num_success -= 1;
+  }
+  if (parse_job_request("{}", req) != 0 || !req.empty())
+    num_success -= 1;
+  job_request written;
+  written["prefix"] = "tab\there \"quoted\"";
+  if (parse_job_request(write_job_request(written), req) != 0 || req != written)
+    num_success -= 1;
+  if (parse_job_request("{\"cmd\": \"trim\"", req) != -1 || parse_job_request("{\"cmd\": [1]}", req) != -1 || parse_job_request("{\"min_qual\": twenty}", req) != -1 || parse_job_request("{} x", req) != -1) {
+    std::cout << "Invalid job request parsed" << std::endl;
+    num_success -= 1;
+  }
+
+  // Files that are not sockets are not replaced
+  std::ofstream("../data/test.serve.file") << "keep";
+  job_server on_file(1);
+  if (on_file.start("../data/test.serve.file") != -1 || read_file("../data/test.serve.file") != "keep") {
+    std::cout << "Server replaced a regular file" << std::endl;
+    num_success -= 1;
+  }
+  unlink("../data/test.serve.file");
+
+  job_server server(2, 1);
+  if (server.start("../data/test.serve.sock") != 0) {
+    std::cout << "Server did not start" << std::endl;
+    return -1;
+  }
+  std::thread runner(&job_server::run, &server);
+
+  // Only the user running the server can connect, and a second server does not take over the socket
+  struct stat st;
+  if (stat("../data/test.serve.sock", &st) != 0 || (st.st_mode & 0777) != 0600) {
+    std::cout << "Socket is accessible to other users" << std::endl;
+    num_success -= 1;
+  }
+  job_server second(1);
+  if (second.start("../data/test.serve.sock") != -1) {
+    std::cout << "Second server took over the socket" << std::endl;
+    num_success -= 1;
+  }
+
+  // Two variants jobs share one reference and give the tsv of ivar variants
+  std::ifstream mplp("../data/test.indel.mpileup");
+  call_variants_from_plup(mplp, "../data/test.serve.direct", 20, 0.03, 0, "../data/db/test_ref.fa", "../data/test.gff");
+  std::istringstream jobs(
+    "{\"cmd\": \"variants\", \"mpileup\": \"../data/test.indel.mpileup\", \"prefix\": \"../data/test.serve.v1\", \"ref\": \"../data/db/test_ref.fa\", \"gff\": \"../data/test.gff\"}\n"
+    "{\"cmd\": \"variants\", \"mpileup\": \"../data/test.indel.mpileup\", \"prefix\": \"../data/test.serve.v2\", \"ref\": \"../data/db/test_ref.fa\", \"gff\": \"../data/test.gff\", \"threads\": 2}\n"
+    "{\"cmd\": \"consensus\", \"mpileup\": \"../data/test.gap.sorted.mpileup\", \"prefix\": \"../data/test.serve.c\", \"min_depth\": 10}\n"
+    "{\"cmd\": \"variants\", \"mpileup\": \"../data/test.indel.mpileup\", \"prefix\": \"../data/test.serve.gz\", \"format\": \"tsv.gz\"}\n");
+  std::ostringstream out;
+  if (submit_jobs("../data/test.serve.sock", jobs, out) != 0) {
+    std::cout << "Jobs failed: " << out.str() << std::endl;
+    num_success -= 1;
+  }
+  std::string expected = read_file("../data/test.serve.direct.tsv");
+  if (expected.empty() || read_file("../data/test.serve.v1.tsv") != expected || read_file("../data/test.serve.v2.tsv") != expected) {
+    std::cout << "Variants from the server do not match ivar variants" << std::endl;
+    num_success -= 1;
+  }
+  std::istringstream responses(out.str());
+  std::string line;
+  std::vector<job_request> results;
+  while (std::getline(responses, line)) {
+    results.push_back(job_request());
+    parse_job_request(line, results.back());
+  }
+  if (results.size() != 4 || results[0]["cached_reference"] != "false" || results[1]["cached_reference"] != "true" || results[2]["status"] != "ok" || results[2]["total_bases"] == "0") {
+    std::cout << "Responses do not match: " << out.str() << std::endl;
+    num_success -= 1;
+  }
+
+  // Bgzipped tsv does not need a reference
+  if (results.size() != 4 || results[3]["status"] != "ok" || !std::ifstream("../data/test.serve.gz.tsv.gz").good()) {
+    std::cout << "Bgzipped variants without a reference failed: " << out.str() << std::endl;
+    num_success -= 1;
+  }
+
+  // Consensus matches ivar consensus
+  std::ifstream gap_mplp("../data/test.gap.sorted.mpileup");
+  call_consensus_from_plup(gap_mplp, "", "../data/test.serve.direct", 20, 0, 10, 'N', true);
+  std::string served = read_file("../data/test.serve.c.fa"), direct = read_file("../data/test.serve.direct.fa");
+  if (served.empty() || served.substr(served.find('\n')) != direct.substr(direct.find('\n'))) {
+    std::cout << "Consensus from the server does not match ivar consensus" << std::endl;
+    num_success -= 1;
+  }
+
+  // Failed jobs are reported and primer schemes are kept across jobs
+  std::istringstream failing(
+    "{\"cmd\": \"trim\", \"bam\": \"../data/test.serve.missing.bam\", \"bed\": \"../data/test_isize.bed\", \"prefix\": \"../data/test.serve.t\"}\n"
+    "{\"cmd\": \"trim\", \"bam\": \"../data/test.serve.missing.bam\", \"bed\": \"../data/test_isize.bed\", \"prefix\": \"../data/test.serve.t\"}\n"
+    "{\"cmd\": \"variants\", \"prefix\": \"../data/test.serve.v3\", \"min_qual\": \"high\"}\n"
+    "{\"cmd\": \"variants\", \"mpileup\": \"../data/test.indel.mpileup\", \"prefix\": \"../data/test.serve.v3\", \"min_qual\": \"high\"}\n"
+    "{\"cmd\": \"align\"}\n"
+    "not json\n");
+  out.str("");
+  if (submit_jobs("../data/test.serve.sock", failing, out) != -1)
+    num_success -= 1;
+  responses.clear();
+  responses.str(out.str());
+  results.clear();
+  while (std::getline(responses, line)) {
+    results.push_back(job_request());
+    parse_job_request(line, results.back());
+  }
+  if (results.size() != 6 || results[0]["cached_primers"] != "false" || results[1]["cached_primers"] != "true") {
+    std::cout << "Trim responses do not match: " << out.str() << std::endl;
+    num_success -= 1;
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (results[i]["status"] != "error")
+      num_success -= 1;
+  }
+
+  // Clients that do not send a job are closed after the read timeout instead of holding the workers
+  int idle[2] = {connect_idle("../data/test.serve.sock"), connect_idle("../data/test.serve.sock")};
+
+  // Stats count every job that ran
+  std::istringstream stats("{\"cmd\": \"stats\"}\n{\"cmd\": \"shutdown\"}\n");
+  out.str("");
+  submit_jobs("../data/test.serve.sock", stats, out);
+  parse_job_request(out.str().substr(0, out.str().find('\n')), req);
+  if (req["jobs"] != "8" || req["failed"] != "4" || req["references"] != "2" || req["primer_schemes"] != "1") {
+    std::cout << "Stats do not match: " << out.str() << std::endl;
+    num_success -= 1;
+  }
+  runner.join();
+  close(idle[0]);
+  close(idle[1]);
+  if (idle[0] < 0 || idle[1] < 0)
+    num_success -= 1;
+  if (std::ifstream("../data/test.serve.sock").good())
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
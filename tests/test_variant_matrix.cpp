@@ -0,0 +1,162 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <iterator>
+#include "../src/get_common_variants.h"
+#include "../src/variant_matrix.h"
+
+const std::string header = "REGION\tPOS\tREF\tALT\tREF_DP\tREF_RV\tREF_QUAL\tALT_DP\tALT_RV\tALT_QUAL\tALT_FREQ\tTOTAL_DP\tPVAL\tPASS\tGFF_FEATURE\tREF_CODON\tREF_AA\tALT_CODON\tALT_AA\n";
+
+std::string row(std::string region, int pos, std::string ref, std::string alt, int alt_dp, std::string pass){
+  std::ostringstream r;
+  r << region << "\t" << pos << "\t" << ref << "\t" << alt << "\t10\t2\t35\t" << alt_dp << "\t1\t36\t" << alt_dp / (10.0 + alt_dp) << "\t" << 10 + alt_dp << "\t0.01\t" << pass << "\tNA\tNA\tNA\tNA\tNA\n";
+  return r.str();
+}
+
+void write_file(std::string path, std::string content){
+  std::ofstream out(path);
+  out << header << content;
+}
+
+std::vector<std::string> read_lines(std::string path){
+  std::ifstream in(path);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+int check_cell(variant_matrix &m, uint64_t i, uint32_t j, uint32_t alt_dp, bool pass){
+  float freq = alt_dp / (10.0 + alt_dp);
+  if (m.get_alt_dp(i, j) != alt_dp || m.get_total_dp(i, j) != 10 + alt_dp || std::fabs(m.get_alt_freq(i, j) - freq) > 1e-5 || m.get_pass(i, j) != pass) {
+    std::cout << "Variant " << i << " sample " << j << " does not match" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int check_missing(variant_matrix &m, uint64_t i, uint32_t j){
+  if (m.get_alt_dp(i, j) != MATRIX_MISSING_DP || m.get_total_dp(i, j) != MATRIX_MISSING_DP || !std::isnan(m.get_alt_freq(i, j)) || m.get_pass(i, j) != MATRIX_MISSING_PASS) {
+    std::cout << "Variant " << i << " sample " << j << " is not missing" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  write_file("../data/test.matrix.1.tsv", row("seg1", 10, "A", "T", 3, "TRUE") + row("seg1", 50, "G", "+AA", 5, "FALSE") + row("seg2", 5, "T", "C", 6, "TRUE"));
+  write_file("../data/test.matrix.2.tsv", row("seg1", 10, "A", "T", 7, "FALSE") + row("seg2", 7, "G", "A", 8, "TRUE"));
+
+  char f1[] = "../data/test.matrix.1.tsv", f2[] = "../data/test.matrix.2.tsv";
+  char* files[] = {f1, f2};
+
+  if (common_variants("../data/test.matrix_out", 0, files, 2, OUT_FORMAT_MATRIX) != 0)
+    num_success -= 1;
+
+  variant_matrix m;
+  if (m.open("../data/test.matrix_out" + MATRIX_EXT) != 0) {
+    std::cout << "Unable to open matrix" << std::endl;
+    return -1;
+  }
+
+  if (m.get_sample_count() != 2 || m.get_variant_count() != 4 || m.get_region_count() != 2)
+    num_success -= 1;
+  if (m.get_sample_name(0) != f1 || m.get_sample_name(1) != f2 || m.get_region_name(0) != "seg1" || m.get_region_name(1) != "seg2")
+    num_success -= 1;
+  if (m.get_key(1).pos != 50 || m.get_key(3).region != 1 || m.get_key_fields(1) != "G\t+AA\tNA\tNA\tNA\tNA\tNA")
+    num_success -= 1;
+
+  num_success += check_cell(m, 0, 0, 3, true);
+  num_success += check_cell(m, 0, 1, 7, false);
+  num_success += check_cell(m, 1, 0, 5, false);
+  num_success += check_missing(m, 1, 1);
+  num_success += check_cell(m, 2, 0, 6, true);
+  num_success += check_missing(m, 3, 0);
+  num_success += check_cell(m, 3, 1, 8, true);
+
+  if (m.lower_bound(0, 11) != 1 || m.lower_bound(1, 0) != 2 || m.lower_bound(1, 6) != 3 || m.lower_bound(2, 0) != 4)
+    num_success -= 1;
+  m.close();
+
+  // Slice by region
+  slice_variant_matrix("../data/test.matrix_out" + MATRIX_EXT, "../data/test.matrix_slice", "seg1:20-60", std::vector<std::string>());
+  std::vector<std::string> lines = read_lines("../data/test.matrix_slice.tsv");
+  if (lines.size() != 2 || lines[1] != "seg1\t50\tG\t+AA\tNA\tNA\tNA\tNA\tNA\t5\t15\t0.333333\tFALSE\tNA\tNA\tNA\tNA") {
+    std::cout << "Region slice does not match" << std::endl;
+    num_success -= 1;
+  }
+
+  // Slice by sample
+  slice_variant_matrix("../data/test.matrix_out" + MATRIX_EXT, "../data/test.matrix_slice", "seg2", std::vector<std::string>(1, f2));
+  lines = read_lines("../data/test.matrix_slice.tsv");
+  if (lines.size() != 3 || lines[0].find("ALT_DP_../data/test.matrix.2.tsv") == std::string::npos || lines[0].find("ALT_DP_../data/test.matrix.1.tsv") != std::string::npos || lines[1] != "seg2\t5\tT\tC\tNA\tNA\tNA\tNA\tNA\tNA\tNA\tNA\tNA" || lines[2] != "seg2\t7\tG\tA\tNA\tNA\tNA\tNA\tNA\t8\t18\t0.444444\tTRUE") {
+    std::cout << "Sample slice does not match" << std::endl;
+    num_success -= 1;
+  }
+
+  // Unknown sample
+  if (slice_variant_matrix("../data/test.matrix_out" + MATRIX_EXT, "../data/test.matrix_slice", "", std::vector<std::string>(1, "missing.tsv")) != -1)
+    num_success -= 1;
+
+  // Variants over several blocks
+  std::string rows1, rows2;
+  for (int pos = 1; pos <= 1200; ++pos) {
+    rows1 += row("seg1", pos, "A", "T", pos % 50, "TRUE");
+    if (pos % 3 == 0)
+      rows2 += row("seg1", pos, "A", "T", pos % 70, "FALSE");
+  }
+  write_file("../data/test.matrix.1.tsv", rows1);
+  write_file("../data/test.matrix.2.tsv", rows2);
+  if (common_variants("../data/test.matrix_out", 0, files, 2, OUT_FORMAT_MATRIX) != 0 || m.open("../data/test.matrix_out" + MATRIX_EXT) != 0) {
+    std::cout << "Unable to write matrix with several blocks" << std::endl;
+    return -1;
+  }
+  if (m.get_variant_count() != 1200 || m.get_key(1199).pos != 1200)
+    num_success -= 1;
+  uint64_t blocks[] = {0, 510, 511, 512, 1023, 1024, 1199};
+  for (int i = 0; i < 7; ++i) {
+    uint64_t v = blocks[i], pos = v + 1;
+    num_success += check_cell(m, v, 0, pos % 50, true);
+    num_success += (pos % 3 == 0) ? check_cell(m, v, 1, pos % 70, false) : check_missing(m, v, 1);
+  }
+  m.close();
+
+  // Matrices with strings or sections outside of the file are rejected
+  std::ifstream in("../data/test.matrix_out" + MATRIX_EXT, std::ios::binary);
+  std::string matrix((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  variant_matrix_header h;
+  memcpy(&h, matrix.data(), sizeof(h));
+  std::string bad = matrix;
+  uint64_t len = UINT32_MAX;
+  memcpy(&bad[h.keys_offset + offsetof(variant_matrix_key, str_offset)], &len, 8);
+  std::ofstream("../data/test.matrix_bad" + MATRIX_EXT, std::ios::binary) << bad;
+  if (m.open("../data/test.matrix_bad" + MATRIX_EXT) != -1)
+    num_success -= 1;
+  bad = matrix;
+  memcpy(&bad[h.regions_offset + offsetof(variant_matrix_name, str_len)], &len, 8);
+  std::ofstream("../data/test.matrix_bad" + MATRIX_EXT, std::ios::binary) << bad;
+  if (m.open("../data/test.matrix_bad" + MATRIX_EXT) != -1)
+    num_success -= 1;
+  std::ofstream("../data/test.matrix_bad" + MATRIX_EXT, std::ios::binary) << matrix.substr(0, matrix.size() - 1);
+  if (m.open("../data/test.matrix_bad" + MATRIX_EXT) != -1)
+    num_success -= 1;
+  bad = matrix;
+  h.nvariants++;
+  memcpy(&bad[0], &h, sizeof(h));
+  std::ofstream("../data/test.matrix_bad" + MATRIX_EXT, std::ios::binary) << bad;
+  if (m.open("../data/test.matrix_bad" + MATRIX_EXT) != -1)
+    num_success -= 1;
+
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
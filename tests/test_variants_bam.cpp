@@ -0,0 +1,86 @@
+#include<iostream>
+#include<fstream>
+#include<sstream>
+#include<string>
+#include "../src/call_variants.h"
+
+std::string read_file(std::string path){
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+// test.gap.sorted.mpileup is the output of `samtools mpileup -A -d 0 -Q 0` on test.gap.sorted.bam
+int check_bam_matches_mpileup(std::string prefix, uint8_t min_qual, double min_threshold){
+  std::ifstream mplp("../data/test.gap.sorted.mpileup");
+  call_variants_from_plup(mplp, prefix, min_qual, min_threshold, 0, "", "");
+  std::string expected = read_file(prefix + ".tsv");
+  call_variants_from_bam("../data/test.gap.sorted.bam", prefix, min_qual, min_threshold, 0, "", "", pileup_opts());
+  return expected.compare(read_file(prefix + ".tsv"));
+}
+
+int check_threads(std::string prefix, unsigned int nthreads){
+  call_variants_from_bam("../data/test.gap.sorted.bam", prefix, 20, 0, 0, "../data/db/test_ref.fa", "../data/test.gff", pileup_opts());
+  std::string expected = read_file(prefix + ".tsv");
+  call_variants_from_bam("../data/test.gap.sorted.bam", prefix, 20, 0, 0, "../data/db/test_ref.fa", "../data/test.gff", pileup_opts(), nthreads);
+  return expected.compare(read_file(prefix + ".tsv"));
+}
+
+/*
+  Copy of test.gap.sorted.bam with the reads in their own BGZF block, indexed and then cut off in
+  the middle of that block. The header and index can be read but the reads cannot.
+*/
+int write_truncated_bam(std::string path){
+  samFile *in = hts_open("../data/test.gap.sorted.bam", "r");
+  bam_hdr_t *header = (in != NULL) ? sam_hdr_read(in) : NULL;
+  BGZF *out = bgzf_open(path.c_str(), "w");
+  bam1_t *b = bam_init1();
+  int res = (header != NULL && out != NULL && bam_hdr_write(out, header) >= 0 && bgzf_flush(out) == 0) ? 0 : -1;
+  while (res == 0 && sam_read1(in, header, b) >= 0) {
+    if (bam_write1(out, b) < 0)
+      res = -1;
+  }
+  bam_destroy1(b);
+  if (out != NULL && bgzf_close(out) != 0)
+    res = -1;
+  if (header != NULL)
+    bam_hdr_destroy(header);
+  if (in != NULL)
+    sam_close(in);
+  if (res != 0 || sam_index_build(path.c_str(), 0) != 0)
+    return -1;
+
+  // Block size is BSIZE + 1, stored at byte 16 of the block
+  std::string bam = read_file(path);
+  size_t first = (uint8_t) bam[16] + ((uint8_t) bam[17] << 8) + 1;
+  if (bam.size() < first + 18)
+    return -1;
+  size_t second = (uint8_t) bam[first + 16] + ((uint8_t) bam[first + 17] << 8) + 1;
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << bam.substr(0, first + second / 2);
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  num_success = check_bam_matches_mpileup("../data/test.bam_variants", 20, 0.03);
+  std::cout << num_success << std::endl;
+  num_success += check_bam_matches_mpileup("../data/test.bam_variants", 0, 0);
+  std::cout << num_success << std::endl;
+  num_success += check_threads("../data/test.bam_variants", 4);
+  std::cout << num_success << std::endl;
+
+  // Reads that cannot be read fail the call, with one thread and through the index
+  if (write_truncated_bam("../data/test.truncated.bam") != 0) {
+    std::cout << "Unable to write truncated BAM" << std::endl;
+    num_success -= 1;
+  }
+  if (call_variants_from_bam("../data/test.truncated.bam", "../data/test.bam_variants", 20, 0.03, 0, "", "", pileup_opts()) != -1)
+    num_success -= 1;
+  if (call_variants_from_bam("../data/test.truncated.bam", "../data/test.bam_variants", 20, 0.03, 0, "", "", pileup_opts(), 4) != -1)
+    num_success -= 1;
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}
@@ -0,0 +1,88 @@
+#include<iostream>
+#include<fstream>
+#include<string>
+#include<vector>
+#include "../src/call_variants.h"
+
+// Records of the VCF at path, without the header
+std::vector<std::string> read_records(std::string path){
+  std::vector<std::string> records;
+  htsFile *fp = hts_open(path.c_str(), "r");
+  if (fp == NULL)
+    return records;
+  kstring_t str = {0, 0, NULL};
+  while (hts_getline(fp, '\n', &str) >= 0) {
+    if (str.s[0] != '#')
+      records.push_back(str.s);
+  }
+  free(str.s);
+  hts_close(fp);
+  return records;
+}
+
+int check_vcf(std::string prefix, uint8_t min_qual, double min_threshold, unsigned int nthreads, std::vector<std::string> expected){
+  std::ifstream mplp("../data/test.indel.mpileup");
+  if (call_variants_from_plup(mplp, prefix, min_qual, min_threshold, 0, "../data/db/test_ref.fa", "../data/test.gff", nthreads, VCF_OUTPUT) != 0) {
+    std::cout << "Unable to write " << prefix << ".vcf.gz" << std::endl;
+    return -1;
+  }
+  std::vector<std::string> records = read_records(prefix + ".vcf.gz");
+  if (records != expected) {
+    std::cout << prefix << " Expected " << expected.size() << " records. Res:" << std::endl;
+    for (std::vector<std::string>::iterator it = records.begin(); it != records.end(); ++it) {
+      std::cout << *it << std::endl;
+    }
+    return -1;
+  }
+  if (!std::ifstream(prefix + ".vcf.gz.csi")) {
+    std::cout << "Missing index for " << prefix << ".vcf.gz" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+int main() {
+  int num_success = 0;
+  // One record per alternate allele, not one per CDS, and insertions are anchored on the reference base.
+  std::vector<std::string> t_20_02;
+  t_20_02.push_back("test\t210\t.\tA\tT\t.\tfobs\tDP=3;AD=1,2;ADF=0,1;ADR=1,1;AF=0.666667\tGT\t1");
+  t_20_02.push_back("test\t210\t.\tA\tAGT\t.\tfobs\tDP=4;AD=1,1;ADF=0,1;ADR=1,0;AF=0.25\tGT\t1");
+  num_success += check_vcf("../data/test.indel", 20, 0.02, 1, t_20_02);
+  num_success += check_vcf("../data/test.indel.threads", 20, 0.02, 4, t_20_02);
+  std::vector<std::string> t_25_03;
+  t_25_03.push_back("test\t210\t.\tA\tT\t.\tfobs\tDP=2;AD=1,1;ADF=0,0;ADR=1,1;AF=0.5\tGT\t1");
+  t_25_03.push_back("test\t210\t.\tA\tAGT\t.\tfobs\tDP=4;AD=1,1;ADF=0,1;ADR=1,0;AF=0.25\tGT\t1");
+  num_success += check_vcf("../data/test.indel", 25, 0.03, 1, t_25_03);
+  // BCF
+  std::ifstream mplp("../data/test.indel.mpileup");
+  num_success += call_variants_from_plup(mplp, "../data/test.indel", 20, 0.02, 0, "../data/db/test_ref.fa", "../data/test.gff", 1, BCF_OUTPUT);
+  if (!std::ifstream("../data/test.indel.bcf.csi"))
+    num_success -= 1;
+  // VCF output needs the reference contigs
+  std::ifstream no_ref("../data/test.indel.mpileup");
+  if (call_variants_from_plup(no_ref, "../data/test.indel.noref", 20, 0.02, 0, "", "", 1, VCF_OUTPUT) == 0)
+    num_success -= 1;
+  // Depths of a million and more are written exactly
+  ref_antd refantd("../data/db/test_ref.fa");
+  vcf_writer deep;
+  std::vector<allele> ad(2);
+  ad[0].nuc = "A";
+  ad[0].depth = 925926;
+  ad[0].reverse = 400000;
+  ad[0].mean_qual = 30;
+  ad[1].nuc = "T";
+  ad[1].depth = 308642;
+  ad[1].reverse = 100000;
+  ad[1].mean_qual = 30;
+  if (deep.init(VCF_OUTPUT, "../data/test.indel.deep.vcf.gz", "deep", refantd) != 0 || call_variants_from_alleles("test", 210, 'A', 1234568, ad, deep, 0.03, 0) != 0 || deep.close() != 0)
+    num_success -= 1;
+  std::vector<std::string> records = read_records("../data/test.indel.deep.vcf.gz");
+  if (records.size() != 1 || records[0] != "test\t210\t.\tA\tT\t.\tPASS\tDP=1234568;AD=925926,308642;ADF=525926,208642;ADR=400000,100000;AF=0.25\tGT\t1") {
+    std::cout << "Deep record does not match: " << (records.empty() ? "" : records[0]) << std::endl;
+    num_success -= 1;
+  }
+  std::cout << num_success << std::endl;
+  if(num_success == 0)
+    return 0;
+  return -1;
+}